@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cmd.h"
+#include "extract.h"
+
+#define local static
+#include "../src/vec.h"
+#include "../src/lib/mascara.h"
+
+/* A normalized input file. */
+struct text {
+   char *str;
+   size_t len;
+};
+
+/* Ways of running the tokenizers: plain tokenization, and sentence splitting
+ * with each sentencizer. The name is appended to the language name.
+ */
+static const struct {
+   const char *name;
+   const char *suffix;
+   enum mr_mode mode;
+} bench_modes[] = {
+   {"tokens", "", MR_TOKEN},
+   {"fsm", " fsm", MR_SENTENCE},
+   {"bayes", "", MR_SENTENCE},
+};
+
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Runs a tokenizer over all the texts, as many times as needed for at least
+ * "min_time" seconds to elapse, so that small inputs are not timed below the
+ * resolution of the clock. Returns the mean time of a pass, and stores the
+ * number of tokens found in a pass in "tokens".
+ */
+static double run(struct mascara *mr, const struct text *texts,
+                  double min_time, size_t *tokens)
+{
+   size_t passes = 0, nr;
+   double start = now(), elapsed;
+   do {
+      nr = 0;
+      for (size_t i = 0; i < gn_vec_len(texts); i++) {
+         mr_set_text(mr, texts[i].str, texts[i].len);
+         struct mr_token *tk;
+         size_t len;
+         while ((len = mr_next(mr, &tk)))
+            nr += len;
+      }
+      passes++;
+   } while ((elapsed = now() - start) < min_time);
+   *tokens = nr;
+   return elapsed / passes;
+}
+
+static void bench(const char *lang, const struct text *texts, size_t size,
+                  size_t repeat, double min_time)
+{
+   for (size_t i = 0; i < sizeof bench_modes / sizeof *bench_modes; i++) {
+      char name[64];
+      snprintf(name, sizeof name, "%s%s", lang, bench_modes[i].suffix);
+      struct mascara *mr;
+      int ret = mr_alloc(&mr, name, bench_modes[i].mode);
+      if (ret) {
+         complain("cannot create tokenizer '%s' (%s): %s", lang,
+                  bench_modes[i].name, mr_strerror(ret));
+         continue;
+      }
+
+      /* Keep the fastest run, which is the least disturbed by other
+       * processes.
+       */
+      size_t tokens;
+      double best = run(mr, texts, min_time, &tokens);
+      for (size_t j = 1; j < repeat; j++) {
+         double t = run(mr, texts, min_time, &tokens);
+         if (t < best)
+            best = t;
+      }
+      mr_dealloc(mr);
+
+      printf("%s\t%s\t%zu\t%zu\t%.6f\t%.1f\n", lang, bench_modes[i].name,
+             size, tokens, best, best > 0 ? size / best / 1e6 : 0.);
+      fflush(stdout);
+   }
+}
+
+void cmd_bench(int argc, char **argv)
+{
+   const char *lang = NULL;
+   size_t repeat = 3;
+   double min_time = 0.5;
+   struct option opts[] = {
+      {'l', "lang", OPT_STR(lang)},
+      {'r', "repeat", OPT_SIZE_T(repeat)},
+      {'t', "min-time", OPT_DOUBLE(min_time)},
+      {0},
+   };
+   const char help[] =
+      #include "bench.ih"
+   ;
+   parse_options(opts, help, &argc, &argv);
+   if (!argc)
+      die("no input file given");
+   if (!repeat)
+      die("--repeat must be at least 1");
+   if (!(min_time >= 0))
+      die("--min-time must not be negative");
+
+   struct text *texts = GN_VEC_INIT;
+   size_t size = 0;
+   while (*argv) {
+      const char *path = strcmp(*argv, "-") ? *argv : NULL;
+      struct text t;
+      t.str = read_file(path, &t.len);
+      if (!t.str)
+         exit(EXIT_FAILURE);
+      gn_vec_push(texts, t);
+      size += t.len;
+      argv++;
+   }
+
+   if (lang) {
+      bench(lang, texts, size, repeat, min_time);
+   } else {
+      for (const char *const *langs = mr_langs(); *langs; langs++)
+         bench(*langs, texts, size, repeat, min_time);
+   }
+
+   for (size_t i = 0; i < gn_vec_len(texts); i++)
+      free(texts[i].str);
+   gn_vec_free(texts);
+}
@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "cmd.h"
+#include "checkpoint.h"
+#include "store.h"
+#include "../src/vec.h"
+
+/* Segments are committed when they reach this size, or after this delay, so
+ * that little work is lost when a run is interrupted, even when inputs produce
+ * little output.
+ */
+#define SEGMENT_SIZE ((uint64_t)256 << 20)
+#define COMMIT_INTERVAL 60
+
+#define SIGNATURE "gourgandine-checkpoint"
+
+struct entry {
+   char *input;
+   struct progress pos;
+   bool replaced;             /* Whether the input was seen in this run. */
+};
+
+struct checkpoint {
+   char *path;
+   enum format format;
+   struct entry *prev;        /* Entries of previous runs, sorted by input. */
+   struct entry *cur;         /* Entries of this run, in output order. */
+   size_t segment;            /* Number of the segment being written. */
+   FILE *fp;                  /* Segment being written, or NULL. */
+   uint64_t written;          /* Bytes written to it. */
+   time_t committed;          /* Time of the last commit. */
+};
+
+static struct entry *find(const struct checkpoint *ck, const char *input)
+{
+   struct entry key = {.input = (char *)input};
+   return bsearch(&key, ck->prev, gn_vec_len(ck->prev), sizeof key,
+                  compare_inputs);
+}
+
+/* Parses a line of the checkpoint file, without its newline. */
+static int parse_line(void *arg, char *line, size_t line_no)
+{
+   struct checkpoint *ck = arg;
+   if (line_no == 1) {
+      char fmt[16];
+      if (sscanf(line, SIGNATURE " %15s %zu", fmt, &ck->segment) != 2)
+         die("'%s' is not a checkpoint file", ck->path);
+      if ((int)ck->format != output_format(fmt))
+         die("'%s' was made with another output format", ck->path);
+      return 0;
+   }
+
+   uint64_t f[5];
+   char *input = parse_fields(line, f, 5, 10);
+   if (!input || f[4] > 1)
+      return -1;
+   struct entry e = {
+      .input = strdup(input),
+      .pos = {
+         .offset = f[0],
+         .text_pos = f[1],
+         .sentences = f[2],
+         .lines = f[3],
+         .done = f[4],
+      },
+   };
+   if (!e.input)
+      die("out of memory");
+   gn_vec_push(ck->prev, e);
+   return 0;
+}
+
+/* Removes what an interrupted run may have left after the last commit. */
+static void discard_segment(const struct checkpoint *ck)
+{
+   for (int tmp = 0; tmp <= 1; tmp++) {
+      char *path = segment_path(ck->path, ck->segment, tmp);
+      if (unlink(path) && errno != ENOENT)
+         die("cannot remove '%s':", path);
+      free(path);
+   }
+}
+
+struct checkpoint *checkpoint_open(const char *path, enum format fmt)
+{
+   struct checkpoint *ck = calloc(1, sizeof *ck);
+   if (!ck)
+      die("out of memory");
+   ck->path = strdup(path);
+   if (!ck->path)
+      die("out of memory");
+   ck->format = fmt;
+   ck->prev = GN_VEC_INIT;
+   ck->cur = GN_VEC_INIT;
+   ck->committed = time(NULL);
+
+   FILE *fp = fopen(path, "r");
+   if (fp) {
+      read_index(path, fp, parse_line, ck);
+      qsort(ck->prev, gn_vec_len(ck->prev), sizeof *ck->prev, compare_inputs);
+      fclose(fp);
+   } else if (errno != ENOENT) {
+      die("cannot open '%s':", path);
+   }
+   discard_segment(ck);
+   return ck;
+}
+
+struct progress checkpoint_get(const struct checkpoint *ck, const char *input)
+{
+   const struct entry *e = find(ck, input);
+   return e ? e->pos : (struct progress){0};
+}
+
+static void write_entry(FILE *fp, const struct entry *e)
+{
+   fprintf(fp, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %d %s\n",
+           e->pos.offset, e->pos.text_pos, e->pos.sentences, e->pos.lines,
+           e->pos.done, e->input);
+}
+
+static void commit(struct checkpoint *ck)
+{
+   if (ck->fp) {
+      char *tmp = segment_path(ck->path, ck->segment, true);
+      char *path = segment_path(ck->path, ck->segment, false);
+      output_trailer(ck->format, ck->fp);
+      /* The segment must be in place before the checkpoint refers to it. */
+      commit_file(ck->fp, tmp, path);
+      free(tmp);
+      free(path);
+      ck->fp = NULL;
+      ck->written = 0;
+      ck->segment++;
+   }
+
+   char *tmp = format_path("%s.tmp", ck->path);
+   FILE *fp = fopen(tmp, "w");
+   if (!fp)
+      die("cannot open '%s':", tmp);
+   fprintf(fp, SIGNATURE " %s %zu\n",
+           ck->format == FORMAT_BINARY ? "binary" : "tsv", ck->segment);
+   for (size_t i = 0; i < gn_vec_len(ck->prev); i++)
+      if (!ck->prev[i].replaced)
+         write_entry(fp, &ck->prev[i]);
+   for (size_t i = 0; i < gn_vec_len(ck->cur); i++)
+      write_entry(fp, &ck->cur[i]);
+   commit_file(fp, tmp, ck->path);
+   free(tmp);
+   ck->committed = time(NULL);
+}
+
+void checkpoint_write(struct checkpoint *ck, const char *input,
+                      const struct progress *pos, const char *data, size_t len)
+{
+   if (len) {
+      if (!ck->fp) {
+         char *tmp = segment_path(ck->path, ck->segment, true);
+         if (!(ck->fp = fopen(tmp, "w")))
+            die("cannot open '%s':", tmp);
+         free(tmp);
+         output_header(ck->format, ck->fp);
+      }
+      if (fwrite(data, 1, len, ck->fp) != len)
+         die("cannot write output:");
+      ck->written += len;
+   }
+
+   size_t nr = gn_vec_len(ck->cur);
+   if (nr && !strcmp(ck->cur[nr - 1].input, input)) {
+      ck->cur[nr - 1].pos = *pos;
+   } else {
+      if (strchr(input, '\n'))
+         die("cannot checkpoint '%s': its name contains a newline", input);
+      struct entry e = {.input = strdup(input), .pos = *pos};
+      if (!e.input)
+         die("out of memory");
+      gn_vec_push(ck->cur, e);
+      struct entry *old = find(ck, input);
+      if (old)
+         old->replaced = true;
+   }
+
+   if (ck->written >= SEGMENT_SIZE || time(NULL) - ck->committed >= COMMIT_INTERVAL)
+      commit(ck);
+}
+
+void checkpoint_close(struct checkpoint *ck)
+{
+   commit(ck);
+   for (size_t i = 0; i < gn_vec_len(ck->prev); i++)
+      free(ck->prev[i].input);
+   for (size_t i = 0; i < gn_vec_len(ck->cur); i++)
+      free(ck->cur[i].input);
+   gn_vec_free(ck->prev);
+   gn_vec_free(ck->cur);
+   free(ck->path);
+   free(ck);
+}
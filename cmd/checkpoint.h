@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "output.h"
+
+/* Checkpoints, for resuming interrupted runs.
+ *
+ * Output is written to numbered segments FILE.0, FILE.1, etc., next to the
+ * checkpoint file FILE. A segment is written under a temporary name, synced,
+ * and renamed when complete, after which the checkpoint file, which records how
+ * far each input was processed, is replaced atomically. The output of some
+ * input is thus either in a committed segment and accounted for in the
+ * checkpoint, or in neither: a restarted run discards the segment that was
+ * being written, and resumes after the last checkpoint.
+ *
+ * Inputs are identified by their path, as given on the command-line or found
+ * in directories, so a run must be resumed from the same directory.
+ */
+struct checkpoint;
+
+/* Position in an input after which processing can resume. */
+struct progress {
+   uint64_t offset;           /* Bytes consumed, or records in record mode. */
+   uint64_t text_pos;         /* Length of the normalized text before offset. */
+   uint64_t sentences;        /* Number of sentences before offset. */
+   uint64_t lines;            /* Number of lines before offset. */
+   bool done;                 /* Whether the input was processed entirely. */
+};
+
+/* Opens a checkpoint file, or creates it if it doesn't exist. Dies on
+ * failure.
+ */
+struct checkpoint *checkpoint_open(const char *path, enum format);
+
+/* Returns the position from which an input must be processed, which is zero if
+ * it wasn't processed yet.
+ */
+struct progress checkpoint_get(const struct checkpoint *, const char *input);
+
+/* Writes the output of a part of an input, and records the position it ends
+ * at. Parts of an input must be written in order. Segments are committed every
+ * so often, after a call to this. Dies on failure.
+ */
+void checkpoint_write(struct checkpoint *, const char *input,
+                      const struct progress *, const char *data, size_t len);
+
+/* Commits the pending output and releases resources. Dies on failure. */
+void checkpoint_close(struct checkpoint *);
+
+#endif
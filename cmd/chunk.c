@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cmd.h"
+#include "chunk.h"
+#include "input.h"
+#include "../src/vec.h"
+
+#define READ_SIZE (1 << 20)
+
+void chunker_init(struct chunker *c, struct input *in, size_t size, const char *sep)
+{
+   *c = (struct chunker){
+      .in = in,
+      .size = size ? size : 1,
+      .sep = sep,
+      .buf = GN_VEC_INIT,
+   };
+}
+
+void chunker_fini(struct chunker *c)
+{
+   gn_vec_free(c->buf);
+}
+
+/* Returns the offset of the end of a blank line, starting the search at the
+ * given offset, or 0 if there is none.
+ */
+static size_t find_blank_line(const char *s, size_t pos, size_t len)
+{
+   while (pos < len) {
+      const char *nl = memchr(&s[pos], '\n', len - pos);
+      if (!nl)
+         break;
+      pos = nl - s + 1;
+      size_t i = pos;
+      while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r'))
+         i++;
+      if (i < len && s[i] == '\n')
+         return i + 1;
+   }
+   return 0;
+}
+
+size_t find_paragraph_break(const char *s, size_t pos, size_t len,
+                            const char *sep)
+{
+   if (!sep)
+      return find_blank_line(s, pos, len);
+
+   size_t sep_len = strlen(sep);
+   while (pos + sep_len <= len) {
+      const char *p = memchr(&s[pos], *sep, len - pos - sep_len + 1);
+      if (!p)
+         break;
+      pos = p - s;
+      if (!memcmp(p, sep, sep_len))
+         return pos + sep_len;
+      pos++;
+   }
+   return 0;
+}
+
+static size_t find_sep(const struct chunker *c, size_t pos)
+{
+   return find_paragraph_break(c->buf, pos, gn_vec_len(c->buf), c->sep);
+}
+
+/* Reads more data. Returns -1 on error. */
+static int fill(struct chunker *c)
+{
+   gn_vec_grow(c->buf, READ_SIZE);
+   size_t len = input_read(c->in, &c->buf[gn_vec_len(c->buf)], READ_SIZE);
+   gn_vec_len(c->buf) += len;
+   if (len < READ_SIZE) {
+      if (input_error(c->in))
+         return -1;
+      c->eof = true;
+   }
+   return 0;
+}
+
+/* Returns where to start searching for a separator that may straddle the
+ * given offset of the buffer: at most strlen(sep) - 1 bytes before it, or, for
+ * a blank line, at the newline before the white space that precedes it.
+ */
+static size_t search_start(const struct chunker *c, size_t pos)
+{
+   if (c->sep) {
+      size_t back = strlen(c->sep) - 1;
+      return pos > back ? pos - back : 0;
+   }
+   while (pos && (c->buf[pos - 1] == ' ' || c->buf[pos - 1] == '\t'
+               || c->buf[pos - 1] == '\r'))
+      pos--;
+   return pos && c->buf[pos - 1] == '\n' ? pos - 1 : pos;
+}
+
+int chunker_next(struct chunker *c, char **chunk)
+{
+   while (!c->eof && gn_vec_len(c->buf) < c->size)
+      if (fill(c))
+         return -1;
+
+   /* Look for a boundary near the target size. The search restarts before
+    * the end of the previous read, so that we don't miss a separator that
+    * straddles two reads.
+    */
+   size_t len = gn_vec_len(c->buf);
+   size_t pos = search_start(c, c->size < len ? c->size : len);
+   size_t cut;
+   while (!(cut = find_sep(c, pos))) {
+      if (c->eof) {
+         cut = gn_vec_len(c->buf);
+         break;
+      }
+      pos = search_start(c, gn_vec_len(c->buf));
+      if (fill(c))
+         return -1;
+   }
+   if (!cut)
+      return 0;
+
+   size_t rest = gn_vec_len(c->buf) - cut;
+   char *next = GN_VEC_INIT;
+   gn_vec_grow(next, rest + READ_SIZE);
+   memcpy(next, &c->buf[cut], rest);
+   gn_vec_len(next) = rest;
+
+   gn_vec_len(c->buf) = cut;
+   *chunk = c->buf;
+   c->buf = next;
+   return 1;
+}
+
+char *chunker_unescape(const char *sep)
+{
+   char *copy = malloc(strlen(sep) + 1);
+   if (!copy)
+      die("out of memory");
+
+   const char *p = sep;
+   char *q = copy;
+
+   while (*p) {
+      if (*p != '\\' || !p[1]) {
+         *q++ = *p++;
+         continue;
+      }
+      switch (*++p) {
+      case 'n': *q++ = '\n'; break;
+      case 'r': *q++ = '\r'; break;
+      case 't': *q++ = '\t'; break;
+      case 'f': *q++ = '\f'; break;
+      default: *q++ = *p; break;
+      }
+      p++;
+   }
+   *q = '\0';
+   return copy;
+}
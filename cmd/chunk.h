@@ -0,0 +1,46 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdbool.h>
+
+struct input;
+
+/* Splits an input stream into chunks that can be processed independently.
+ *
+ * Chunks end at a paragraph boundary, after the first separator found once the
+ * chunk reaches the target size. Since acronym definitions never span
+ * paragraphs, and NFC normalization doesn't cross line boundaries, chunks can
+ * be normalized and processed separately, and the results concatenated.
+ */
+struct chunker {
+   struct input *in;
+   size_t size;               /* Target chunk size. */
+   const char *sep;           /* Separator, or NULL for a blank line. */
+   char *buf;                 /* Data read but not returned yet. */
+   bool eof;
+};
+
+/* The separator string is not copied. */
+void chunker_init(struct chunker *, struct input *, size_t size, const char *sep);
+void chunker_fini(struct chunker *);
+
+/* Reads the next chunk. On success, makes the provided pointer point to a byte
+ * vector (see src/vec.h) that must be released by the caller, and returns 1.
+ * Returns 0 at the end of the stream, -1 on read error, in which case a message
+ * was displayed.
+ */
+int chunker_next(struct chunker *, char **chunk);
+
+/* Returns the offset of the end of the first paragraph separator found in a
+ * string from the given offset, or 0 if there is none. A NULL separator stands
+ * for a blank line, as for chunkers.
+ */
+size_t find_paragraph_break(const char *s, size_t pos, size_t len,
+                            const char *sep);
+
+/* Translates the escape sequences \n, \r, \t, \f and \\ in a separator string.
+ * Returns a copy that must be released with free(). Dies on failure.
+ */
+char *chunker_unescape(const char *sep);
+
+#endif
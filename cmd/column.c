@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "column.h"
+#include "../src/vec.h"
+
+#define HEADER_SIZE 16
+#define BLOCK_HEADER_SIZE 16
+
+static void append(char **out, const void *data, size_t len)
+{
+   char *vec = *out;
+   gn_vec_grow(vec, len);
+   memcpy(&vec[gn_vec_len(vec)], data, len);
+   gn_vec_len(vec) += len;
+   *out = vec;
+}
+
+static void append_u32(char **out, uint32_t n)
+{
+   append(out, &n, sizeof n);
+}
+
+static void append_u64(char **out, uint64_t n)
+{
+   append(out, &n, sizeof n);
+}
+
+static size_t pad8(size_t n)
+{
+   return (n + 7) & ~(size_t)7;
+}
+
+void gnc_init(struct gnc_writer *w)
+{
+   *w = (struct gnc_writer){.heap = GN_VEC_INIT};
+   for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++)
+      w->col64[i] = GN_VEC_INIT;
+   for (size_t i = 0; i < GNC_NUM_COLUMNS32; i++)
+      w->col32[i] = GN_VEC_INIT;
+}
+
+void gnc_fini(struct gnc_writer *w)
+{
+   for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++)
+      gn_vec_free(w->col64[i]);
+   for (size_t i = 0; i < GNC_NUM_COLUMNS32; i++)
+      gn_vec_free(w->col32[i]);
+   gn_vec_free(w->heap);
+}
+
+void gnc_header(char **out)
+{
+   append(out, GNC_MAGIC, 8);
+   append_u32(out, GNC_VERSION);
+   append_u32(out, 0);
+}
+
+void gnc_trailer(char **out)
+{
+   append_u64(out, 0);
+}
+
+static uint32_t add_string(struct gnc_writer *w, const char *str, uint32_t *len)
+{
+   size_t off = gn_vec_len(w->heap);
+   *len = strlen(str);
+   append(&w->heap, str, *len + 1);
+   return off;
+}
+
+void gnc_add(struct gnc_writer *w, const struct gnc_row *row, char **out)
+{
+   struct gnc_row r = *row;
+
+   r.col32[GNC_ACRONYM_OFF] = add_string(w, r.acronym, &r.col32[GNC_ACRONYM_LEN]);
+   r.col32[GNC_EXPANSION_OFF] = add_string(w, r.expansion, &r.col32[GNC_EXPANSION_LEN]);
+
+   /* Rows of the same document are usually adjacent, so we only check the last
+    * name that was stored.
+    */
+   size_t name_len = strlen(r.name);
+   if (!w->has_name || strcmp(&w->heap[w->name_off], r.name)) {
+      uint32_t len;
+      w->name_off = add_string(w, r.name, &len);
+      w->has_name = true;
+   }
+   r.col32[GNC_NAME_OFF] = w->name_off;
+   r.col32[GNC_NAME_LEN] = name_len;
+
+   for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++)
+      gn_vec_push(w->col64[i], r.col64[i]);
+   for (size_t i = 0; i < GNC_NUM_COLUMNS32; i++)
+      gn_vec_push(w->col32[i], r.col32[i]);
+
+   /* Keep heap offsets representable. */
+   if (gn_vec_len(w->col32[0]) == GNC_MAX_ROWS || gn_vec_len(w->heap) > UINT32_MAX / 2)
+      gnc_flush(w, out);
+}
+
+void gnc_flush(struct gnc_writer *w, char **out)
+{
+   size_t rows = gn_vec_len(w->col32[0]);
+   if (!rows)
+      return;
+
+   size_t heap_size = gn_vec_len(w->heap);
+   size_t size = BLOCK_HEADER_SIZE
+               + rows * (GNC_NUM_COLUMNS64 * 8 + GNC_NUM_COLUMNS32 * 4)
+               + heap_size;
+   size_t padded = pad8(size);
+
+   append_u64(out, padded);
+   append_u32(out, rows);
+   append_u32(out, heap_size);
+   for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++) {
+      append(out, w->col64[i], rows * sizeof *w->col64[i]);
+      gn_vec_clear(w->col64[i]);
+   }
+   for (size_t i = 0; i < GNC_NUM_COLUMNS32; i++) {
+      append(out, w->col32[i], rows * sizeof *w->col32[i]);
+      gn_vec_clear(w->col32[i]);
+   }
+   append(out, w->heap, heap_size);
+   append(out, "\0\0\0\0\0\0\0", padded - size);
+
+   gn_vec_clear(w->heap);
+   w->has_name = false;
+}
+
+void gnc_relocate(char *blocks, size_t len, uint64_t bytes, uint32_t sentences)
+{
+   for (size_t pos = 0; pos < len; ) {
+      uint64_t size;
+      uint32_t rows;
+      memcpy(&size, &blocks[pos], sizeof size);
+      memcpy(&rows, &blocks[pos + 8], sizeof rows);
+
+      char *p = &blocks[pos + BLOCK_HEADER_SIZE];
+      for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++) {
+         for (size_t j = 0; j < rows; j++, p += sizeof(uint64_t)) {
+            uint64_t n;
+            memcpy(&n, p, sizeof n);
+            n += bytes;
+            memcpy(p, &n, sizeof n);
+         }
+      }
+      p += GNC_SENTENCE * rows * sizeof(uint32_t);
+      for (size_t j = 0; j < rows; j++, p += sizeof(uint32_t)) {
+         uint32_t n;
+         memcpy(&n, p, sizeof n);
+         n += sentences;
+         memcpy(p, &n, sizeof n);
+      }
+      pos += size;
+   }
+}
+
+void gnc_renumber(char *blocks, size_t len, uint32_t docs)
+{
+   for (size_t pos = 0; pos < len; ) {
+      uint64_t size;
+      uint32_t rows;
+      memcpy(&size, &blocks[pos], sizeof size);
+      memcpy(&rows, &blocks[pos + 8], sizeof rows);
+
+      char *p = &blocks[pos + BLOCK_HEADER_SIZE];
+      p += GNC_NUM_COLUMNS64 * rows * sizeof(uint64_t);
+      p += GNC_DOC * rows * sizeof(uint32_t);
+      for (size_t j = 0; j < rows; j++, p += sizeof(uint32_t)) {
+         uint32_t n;
+         memcpy(&n, p, sizeof n);
+         n += docs;
+         memcpy(p, &n, sizeof n);
+      }
+      pos += size;
+   }
+}
+
+int gnc_open(struct gnc_file *f, const char *path)
+{
+   *f = (struct gnc_file){0};
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return -1;
+
+   struct stat st;
+   if (fstat(fd, &st)) {
+      close(fd);
+      return -1;
+   }
+   if ((size_t)st.st_size < HEADER_SIZE) {
+      close(fd);
+      errno = 0;
+      return -1;
+   }
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return -1;
+   posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+   f->map = map;
+   f->size = st.st_size;
+   f->pos = HEADER_SIZE;
+
+   uint32_t version;
+   memcpy(&version, &f->map[8], sizeof version);
+   if (memcmp(f->map, GNC_MAGIC, 8) || version != GNC_VERSION) {
+      gnc_close(f);
+      errno = 0;
+      return -1;
+   }
+   return 0;
+}
+
+void gnc_close(struct gnc_file *f)
+{
+   if (f->map)
+      munmap((void *)f->map, f->size);
+   *f = (struct gnc_file){0};
+}
+
+int gnc_next(struct gnc_file *f, struct gnc_block *blk)
+{
+   if (f->size - f->pos < 8)
+      return -1;
+
+   uint64_t size;
+   memcpy(&size, &f->map[f->pos], sizeof size);
+   if (!size)
+      return 0;
+   if (size < BLOCK_HEADER_SIZE || size % 8 || size > f->size - f->pos)
+      return -1;
+
+   const uint8_t *base = &f->map[f->pos];
+   uint32_t rows, heap_size;
+   memcpy(&rows, &base[8], sizeof rows);
+   memcpy(&heap_size, &base[12], sizeof heap_size);
+
+   uint64_t need = BLOCK_HEADER_SIZE
+                 + (uint64_t)rows * (GNC_NUM_COLUMNS64 * 8 + GNC_NUM_COLUMNS32 * 4)
+                 + heap_size;
+   if (pad8(need) != size)
+      return -1;
+
+   const uint8_t *p = &base[BLOCK_HEADER_SIZE];
+   for (size_t i = 0; i < GNC_NUM_COLUMNS64; i++) {
+      blk->col64[i] = (const uint64_t *)p;
+      p += rows * sizeof(uint64_t);
+   }
+   for (size_t i = 0; i < GNC_NUM_COLUMNS32; i++) {
+      blk->col32[i] = (const uint32_t *)p;
+      p += rows * sizeof(uint32_t);
+   }
+   blk->rows = rows;
+   blk->heap = (const char *)p;
+   blk->heap_size = heap_size;
+
+   f->pos += size;
+   return 1;
+}
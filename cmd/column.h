@@ -0,0 +1,170 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+/* Binary columnar output format.
+ *
+ * A file is made of a 16 bytes header followed by a sequence of blocks. The
+ * header is the 8 bytes signature GNC_MAGIC, followed by the format version as
+ * a 32 bits integer, followed by 4 zero bytes. All integers are little-endian,
+ * and all blocks start on an 8 bytes boundary, so that a file can be mapped in
+ * memory and its columns used directly as C arrays.
+ *
+ * A block has the layout:
+ *
+ *    u64 size                   Size of the block in bytes, this field included.
+ *                               Always a multiple of 8. Zero marks the end of
+ *                               the file.
+ *    u32 rows                   Number of rows in the block.
+ *    u32 heap_size              Size of the string heap in bytes.
+ *    u64 column[rows]           For each 64 bits column, in the order of
+ *                               enum gnc_column64.
+ *    u32 column[rows]           For each 32 bits column, in the order of
+ *                               enum gnc_column32.
+ *    char heap[heap_size]       String heap.
+ *    padding                    Up to the next multiple of 8.
+ *
+ * Strings are stored in the heap of the block that references them, and are
+ * referenced by their offset and length in bytes. Each string in the heap is
+ * followed by a nul byte that isn't included in its length. Blocks are
+ * self-contained, so that the concatenation of blocks produced independently
+ * is valid.
+ *
+ * Byte offsets are counted from the start of the document, after its
+ * normalization to NFC. Token offsets are counted from the start of the
+ * sentence, and end offsets point past the last byte or token. Documents are
+ * numbered from zero, in the order they are given to the program.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the columnar format reader and writer require a little-endian host"
+#endif
+
+#define GNC_MAGIC "gncol\0\r\n"
+#define GNC_VERSION 1
+
+enum gnc_column64 {
+   GNC_ACRONYM_BYTE_START,
+   GNC_ACRONYM_BYTE_END,
+   GNC_EXPANSION_BYTE_START,
+   GNC_EXPANSION_BYTE_END,
+   GNC_NUM_COLUMNS64
+};
+
+enum gnc_column32 {
+   GNC_DOC,
+   GNC_SENTENCE,
+   GNC_ACRONYM_START,
+   GNC_ACRONYM_END,
+   GNC_EXPANSION_START,
+   GNC_EXPANSION_END,
+   GNC_ACRONYM_OFF,
+   GNC_ACRONYM_LEN,
+   GNC_EXPANSION_OFF,
+   GNC_EXPANSION_LEN,
+   GNC_NAME_OFF,              /* Document name (file path or record id). */
+   GNC_NAME_LEN,
+   GNC_NUM_COLUMNS32
+};
+
+/* A single row. */
+struct gnc_row {
+   uint64_t col64[GNC_NUM_COLUMNS64];
+   uint32_t col32[GNC_NUM_COLUMNS32];
+   const char *acronym, *expansion, *name;
+};
+
+/* Maximum number of rows per block. */
+#define GNC_MAX_ROWS 65536
+
+/* Block writer. Rows are accumulated in memory until the block is full or
+ * explicitly flushed, at which point the encoded block is appended to a byte
+ * vector (see src/vec.h).
+ */
+struct gnc_writer {
+   uint64_t *col64[GNC_NUM_COLUMNS64];
+   uint32_t *col32[GNC_NUM_COLUMNS32];
+   char *heap;
+
+   /* Offset of the name of the last document added to the heap, to avoid
+    * storing it once per row.
+    */
+   uint32_t name_off;
+   bool has_name;
+};
+
+void gnc_init(struct gnc_writer *);
+void gnc_fini(struct gnc_writer *);
+
+/* Writes the file header to a byte vector. */
+void gnc_header(char **out);
+
+/* Adds a row, flushes the current block to the provided byte vector if it is
+ * full.
+ */
+void gnc_add(struct gnc_writer *, const struct gnc_row *, char **out);
+
+/* Appends the current block to a byte vector, if it is not empty. */
+void gnc_flush(struct gnc_writer *, char **out);
+
+/* Appends the end of file marker to a byte vector. */
+void gnc_trailer(char **out);
+
+/* Adds constants to the byte offsets and sentence numbers of a sequence of
+ * blocks produced by a writer. This is used when a document is processed in
+ * several parts.
+ */
+void gnc_relocate(char *blocks, size_t len, uint64_t bytes, uint32_t sentences);
+
+/* Adds a constant, modulo 2^32, to the document numbers of a sequence of
+ * blocks. This is used when output is reused in another run.
+ */
+void gnc_renumber(char *blocks, size_t len, uint32_t docs);
+
+/* Memory-mapped reader. */
+struct gnc_file {
+   const uint8_t *map;
+   size_t size;
+   size_t pos;
+};
+
+/* A block, as seen by a reader. Pointers refer to the mapped file. */
+struct gnc_block {
+   size_t rows;
+   const uint64_t *col64[GNC_NUM_COLUMNS64];
+   const uint32_t *col32[GNC_NUM_COLUMNS32];
+   const char *heap;
+   size_t heap_size;
+};
+
+/* Opens a file and checks its header. Returns 0 on success, -1 on failure,
+ * with errno set if the failure is caused by a system error, or cleared if the
+ * file is invalid.
+ */
+int gnc_open(struct gnc_file *, const char *path);
+void gnc_close(struct gnc_file *);
+
+/* Fetches the next block. Returns 1 if there is one, 0 at the end of the file,
+ * -1 if the file is truncated or corrupt.
+ */
+int gnc_next(struct gnc_file *, struct gnc_block *);
+
+/* Returns a string stored in a block heap. */
+static inline const char *gnc_str(const struct gnc_block *blk, uint32_t off)
+{
+   return &blk->heap[off];
+}
+
+/* Checks that a string referenced by a block lies within its heap and is
+ * followed by a nul byte, as it is in a valid file.
+ */
+static inline bool gnc_str_valid(const struct gnc_block *blk, uint32_t off,
+                                 uint32_t len)
+{
+   return (uint64_t)off + len < blk->heap_size && !blk->heap[off + len];
+}
+
+#endif
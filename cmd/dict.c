@@ -0,0 +1,304 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cmd.h"
+#include "dict.h"
+#include "extract.h"
+#include "input.h"
+#include "../gourgandine.h"
+#include "../src/dict.h"
+#include "../src/vec.h"
+
+void dict_load(struct dict_file *f, const char *path)
+{
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      die("cannot open '%s':", path);
+   struct stat st;
+   if (fstat(fd, &st))
+      die("cannot open '%s':", path);
+   f->size = st.st_size;
+   f->map = NULL;
+   if (f->size) {
+      f->map = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (f->map == MAP_FAILED)
+         die("cannot map '%s':", path);
+      /* Lookups jump around. */
+      posix_madvise(f->map, f->size, POSIX_MADV_RANDOM);
+   }
+   close(fd);
+   f->dict = f->map ? gn_dict_open(f->map, f->size) : NULL;
+   if (!f->dict)
+      die("'%s' is not a compiled dictionary", path);
+}
+
+void dict_unload(struct dict_file *f)
+{
+   gn_dict_close(f->dict);
+   munmap(f->map, f->size);
+}
+
+/* A pair of the source dictionary. Strings are offsets into the text, which
+ * is normalized in place.
+ */
+struct pair {
+   size_t acronym, acronym_len;
+   size_t expansion, expansion_len;
+   size_t line;
+};
+
+static const char *text;
+
+static int compare_strings(size_t a, size_t a_len, size_t b, size_t b_len)
+{
+   int ret = memcmp(&text[a], &text[b], a_len < b_len ? a_len : b_len);
+   if (ret)
+      return ret;
+   return a_len < b_len ? -1 : a_len > b_len;
+}
+
+/* Orders pairs by acronym, then expansion, then line, for finding
+ * duplicates.
+ */
+static int compare_pairs(const void *a, const void *b)
+{
+   const struct pair *x = a, *y = b;
+   int ret = compare_strings(x->acronym, x->acronym_len, y->acronym, y->acronym_len);
+   if (!ret)
+      ret = compare_strings(x->expansion, x->expansion_len, y->expansion,
+                            y->expansion_len);
+   if (!ret)
+      ret = x->line < y->line ? -1 : x->line > y->line;
+   return ret;
+}
+
+/* Orders pairs by acronym, then line. */
+static int compare_lines(const void *a, const void *b)
+{
+   const struct pair *x = a, *y = b;
+   int ret = compare_strings(x->acronym, x->acronym_len, y->acronym, y->acronym_len);
+   if (!ret)
+      ret = x->line < y->line ? -1 : x->line > y->line;
+   return ret;
+}
+
+/* Normalizes a field in place: periods are removed from acronyms, while double
+ * quotes are removed and white space is trimmed and collapsed in expansions.
+ * Returns the new length.
+ */
+static size_t normalize_field(char *str, size_t len, bool acronym)
+{
+   size_t n = 0;
+   for (size_t i = 0; i < len; i++) {
+      char c = str[i];
+      if (acronym ? c == '.' : c == '"')
+         continue;
+      if (!acronym && (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f')) {
+         if (n && str[n - 1] != ' ')
+            str[n++] = ' ';
+         continue;
+      }
+      str[n++] = c;
+   }
+   while (n && str[n - 1] == ' ')
+      n--;
+   return n;
+}
+
+static struct pair *parse(char *str, size_t len, const char *path)
+{
+   struct pair *pairs = GN_VEC_INIT;
+   size_t line = 0;
+   for (char *p = str, *end = str + len; p < end; ) {
+      char *nl = memchr(p, '\n', end - p);
+      size_t line_len = (nl ? nl : end) - p;
+      line++;
+      char *tab = memchr(p, '\t', line_len);
+      if (!tab) {
+         if (line_len && !(line_len == 1 && *p == '\r'))
+            die("%s:%zu: missing tab", path, line);
+         p += line_len + 1;
+         continue;
+      }
+      /* Columns after the expansion are ignored. */
+      char *exp = tab + 1;
+      char *exp_end = memchr(exp, '\t', p + line_len - exp);
+      if (!exp_end)
+         exp_end = p + line_len;
+      struct pair pair = {
+         .acronym = p - str,
+         .acronym_len = normalize_field(p, tab - p, true),
+         .expansion = exp - str,
+         .expansion_len = normalize_field(exp, exp_end - exp, false),
+         .line = line,
+      };
+      if (pair.acronym_len && pair.expansion_len)
+         gn_vec_push(pairs, pair);
+      p += line_len + 1;
+   }
+   return pairs;
+}
+
+static void append(char **out, const void *data, size_t len)
+{
+   char *buf = *out;
+   gn_vec_grow(buf, len);
+   memcpy(&buf[gn_vec_len(buf)], data, len);
+   gn_vec_len(buf) += len;
+   *out = buf;
+}
+
+static uint64_t add_string(char **heap, size_t off, size_t len)
+{
+   uint64_t pos = gn_vec_len(*heap);
+   append(heap, &text[off], len);
+   append(heap, "", 1);
+   return pos;
+}
+
+/* Writes the dictionary, once pairs are sorted by acronym, then line. */
+static void write_dict(const struct pair *pairs, size_t nr, const char *path)
+{
+   char *heap = GN_VEC_INIT;
+   struct gn_dict_acronym *acronyms = GN_VEC_INIT;
+   struct gn_dict_expansion *expansions = GN_VEC_INIT;
+   uint32_t max_len = 0;
+
+   for (size_t i = 0; i < nr; ) {
+      const struct pair *p = &pairs[i];
+      if (p->acronym_len > UINT32_MAX)
+         die("acronym too long at line %zu", p->line);
+      struct gn_dict_acronym a = {
+         .str = add_string(&heap, p->acronym, p->acronym_len),
+         .len = p->acronym_len,
+         .first = gn_vec_len(expansions),
+      };
+      for (; i < nr && !compare_strings(pairs[i].acronym, pairs[i].acronym_len,
+                                        p->acronym, p->acronym_len); i++) {
+         struct gn_dict_expansion e = {
+            .str = add_string(&heap, pairs[i].expansion, pairs[i].expansion_len),
+            .len = pairs[i].expansion_len,
+         };
+         gn_vec_push(expansions, e);
+         a.count++;
+      }
+      if (a.len > max_len)
+         max_len = a.len;
+      gn_vec_push(acronyms, a);
+   }
+
+   size_t nr_acronyms = gn_vec_len(acronyms);
+   if (nr_acronyms >= UINT32_MAX / 2)
+      die("too many acronyms");
+   size_t nr_slots = 8;
+   while (nr_slots * 3 / 4 <= nr_acronyms)
+      nr_slots *= 2;
+   uint32_t *slots = calloc(nr_slots, sizeof *slots);
+   if (!slots)
+      die("out of memory");
+   for (size_t i = 0; i < nr_acronyms; i++) {
+      size_t pos = gn_dict_hash(&heap[acronyms[i].str], acronyms[i].len) & (nr_slots - 1);
+      while (slots[pos])
+         pos = (pos + 1) & (nr_slots - 1);
+      slots[pos] = i + 1;
+   }
+
+   char *header = GN_VEC_INIT;
+   append(&header, GN_DICT_MAGIC, 8);
+   uint32_t hdr[4] = {GN_DICT_VERSION, GN_DICT_BYTE_ORDER, max_len, 0};
+   append(&header, hdr, sizeof hdr);
+   uint64_t counts[4] = {nr_slots, nr_acronyms, gn_vec_len(expansions),
+                         gn_vec_len(heap)};
+   append(&header, counts, sizeof counts);
+   while (gn_vec_len(heap) % 8)
+      append(&heap, "", 1);
+
+   FILE *fp = fopen(path, "wb");
+   if (!fp)
+      die("cannot open '%s':", path);
+   const struct {
+      const void *data;
+      size_t len;
+   } parts[] = {
+      {header, gn_vec_len(header)},
+      {acronyms, nr_acronyms * sizeof *acronyms},
+      {expansions, gn_vec_len(expansions) * sizeof *expansions},
+      {slots, nr_slots * sizeof *slots},
+      {heap, gn_vec_len(heap)},
+   };
+   for (size_t i = 0; i < sizeof parts / sizeof *parts; i++)
+      if (fwrite(parts[i].data, 1, parts[i].len, fp) != parts[i].len)
+         die("cannot write '%s':", path);
+   if (fclose(fp))
+      die("cannot write '%s':", path);
+
+   free(slots);
+   gn_vec_free(header);
+   gn_vec_free(heap);
+   gn_vec_free(acronyms);
+   gn_vec_free(expansions);
+}
+
+void cmd_dict(int argc, char **argv)
+{
+   struct option opts[] = {
+      {0},
+   };
+   const char help[] =
+      #include "dict.ih"
+   ;
+   parse_options(opts, help, &argc, &argv);
+   if (argc != 2)
+      die("a source dictionary and an output file must be given");
+
+   const char *path = strcmp(argv[0], "-") ? argv[0] : NULL;
+   struct input *in = input_open(path);
+   if (!in)
+      exit(EXIT_FAILURE);
+   char *buf = GN_VEC_INIT;
+   size_t len;
+   gn_vec_grow(buf, BUFSIZ);
+   while ((len = input_read(in, &buf[gn_vec_len(buf)], BUFSIZ))) {
+      gn_vec_len(buf) += len;
+      gn_vec_grow(buf, BUFSIZ);
+   }
+   if (input_error(in))
+      exit(EXIT_FAILURE);
+   input_close(in);
+
+   /* Text is normalized to NFC, so dictionary entries must be too. */
+   if (!path)
+      path = "<stdin>";
+   char *str = normalize(path, (uint8_t *)buf, gn_vec_len(buf), &len);
+   gn_vec_free(buf);
+   if (!str)
+      exit(EXIT_FAILURE);
+
+   struct pair *pairs = parse(str, len, path);
+   size_t nr = gn_vec_len(pairs);
+   text = str;
+
+   /* Keep the first occurrence of each pair, then restore the source order. */
+   qsort(pairs, nr, sizeof *pairs, compare_pairs);
+   size_t uniq = 0;
+   for (size_t i = 0; i < nr; i++) {
+      if (uniq && !compare_strings(pairs[i].acronym, pairs[i].acronym_len,
+                                   pairs[uniq - 1].acronym, pairs[uniq - 1].acronym_len)
+       && !compare_strings(pairs[i].expansion, pairs[i].expansion_len,
+                           pairs[uniq - 1].expansion, pairs[uniq - 1].expansion_len))
+         continue;
+      pairs[uniq++] = pairs[i];
+   }
+   qsort(pairs, uniq, sizeof *pairs, compare_lines);
+
+   write_dict(pairs, uniq, argv[1]);
+   gn_vec_free(pairs);
+   free(str);
+   exit(EXIT_SUCCESS);
+}
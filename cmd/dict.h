@@ -0,0 +1,17 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <stddef.h>
+
+/* A compiled dictionary of known acronyms, mapped in memory. */
+struct dict_file {
+   void *map;
+   size_t size;
+   struct gn_dict *dict;
+};
+
+/* Maps a dictionary compiled with the "dict" command. Dies on failure. */
+void dict_load(struct dict_file *, const char *path);
+void dict_unload(struct dict_file *);
+
+#endif
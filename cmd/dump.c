@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <errno.h>
+#include "cmd.h"
+#include "column.h"
+
+static int dump_block(const struct gnc_block *blk)
+{
+   const uint32_t *const *c = blk->col32;
+   const uint64_t *const *b = blk->col64;
+
+   for (size_t i = 0; i < blk->rows; i++) {
+      if (!gnc_str_valid(blk, c[GNC_ACRONYM_OFF][i], c[GNC_ACRONYM_LEN][i])
+       || !gnc_str_valid(blk, c[GNC_EXPANSION_OFF][i], c[GNC_EXPANSION_LEN][i])
+       || !gnc_str_valid(blk, c[GNC_NAME_OFF][i], c[GNC_NAME_LEN][i]))
+         return -1;
+
+      printf("%"PRIu32"\t%s\t%"PRIu32"\t%s\t%s\t"
+             "%"PRIu32"\t%"PRIu32"\t%"PRIu32"\t%"PRIu32"\t"
+             "%"PRIu64"\t%"PRIu64"\t%"PRIu64"\t%"PRIu64"\n",
+             c[GNC_DOC][i],
+             gnc_str(blk, c[GNC_NAME_OFF][i]),
+             c[GNC_SENTENCE][i],
+             gnc_str(blk, c[GNC_ACRONYM_OFF][i]),
+             gnc_str(blk, c[GNC_EXPANSION_OFF][i]),
+             c[GNC_ACRONYM_START][i], c[GNC_ACRONYM_END][i],
+             c[GNC_EXPANSION_START][i], c[GNC_EXPANSION_END][i],
+             b[GNC_ACRONYM_BYTE_START][i], b[GNC_ACRONYM_BYTE_END][i],
+             b[GNC_EXPANSION_BYTE_START][i], b[GNC_EXPANSION_BYTE_END][i]);
+   }
+   return 0;
+}
+
+static int dump_file(const char *path)
+{
+   struct gnc_file f;
+   if (gnc_open(&f, path)) {
+      if (errno)
+         complain("cannot open '%s':", path);
+      else
+         complain("'%s' is not a binary output file", path);
+      return -1;
+   }
+
+   struct gnc_block blk;
+   int ret;
+   while ((ret = gnc_next(&f, &blk)) > 0) {
+      if (dump_block(&blk)) {
+         ret = -1;
+         break;
+      }
+   }
+   gnc_close(&f);
+
+   if (ret) {
+      complain("file '%s' is truncated or corrupt", path);
+      return -1;
+   }
+   return 0;
+}
+
+void cmd_dump(int argc, char **argv)
+{
+   const char help[] =
+      #include "dump.ih"
+   ;
+   parse_options(NULL, help, &argc, &argv);
+   if (!argc)
+      die("no input file given");
+
+   int ret = EXIT_SUCCESS;
+   while (*argv)
+      if (dump_file(*argv++))
+         ret = EXIT_FAILURE;
+   exit(ret);
+}
@@ -0,0 +1,775 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "cmd.h"
+#include "extract.h"
+#include "input.h"
+#include "chunk.h"
+
+#define local static
+#include "../gourgandine.h"
+#include "../src/vec.h"
+#include "../src/lib/mascara.h"
+#include "../src/lib/utf8proc.h"
+
+/* In streaming modes, output is written when at least that much is
+ * available.
+ */
+#define FLUSH_SIZE (1 << 20)
+
+/* Size of the blocks searched for brackets. */
+#define BRACKET_BLOCK_SIZE 4096
+
+/* Maximum number of bytes by which the window around a paragraph that contains
+ * a bracket is widened on each side in lazy mode. Past it, a window is cut
+ * short, and definitions in sentences longer than that can be missed.
+ */
+#define LAZY_MAX_WIDENING (1 << 16)
+
+/* Maximum number of tokens of a segment in paragraph mode, as for the
+ * sentences of the tokenizer.
+ */
+#define MAX_SEGMENT_LEN 1000
+
+void *normalize(const char *name, const uint8_t *buf, size_t len, size_t *size)
+{
+   uint8_t *nrm;
+   ssize_t ret = utf8proc_map(buf, len, &nrm, UTF8PROC_STABLE | UTF8PROC_COMPOSE);
+   if (ret < 0) {
+      complain("cannot process file '%s': %s", name, utf8proc_errmsg(ret));
+      return NULL;
+   }
+   *size = ret;
+   return nrm;
+}
+
+void *read_file(const char *path, size_t *size)
+{
+   struct input *in = input_open(path);
+   if (!in)
+      return NULL;
+   if (!path)
+      path = "<stdin>";
+
+   uint8_t *buf = GN_VEC_INIT;
+   size_t len = 0;
+
+   gn_vec_grow(buf, BUFSIZ);
+   while ((len = input_read(in, &buf[gn_vec_len(buf)], BUFSIZ))) {
+      gn_vec_len(buf) += len;
+      if (gn_vec_len(buf) > MAX_FILE_SIZE) {
+         complain("input file '%s' too large (limit is %d)", path, MAX_FILE_SIZE);
+         goto fail;
+      }
+      gn_vec_grow(buf, BUFSIZ);
+   }
+   if (input_error(in))
+      goto fail;
+
+   uint8_t *nrm = normalize(path, buf, gn_vec_len(buf), size);
+   if (!nrm)
+      goto fail;
+
+   gn_vec_free(buf);
+   input_close(in);
+   return nrm;
+
+fail:
+   gn_vec_free(buf);
+   input_close(in);
+   return NULL;
+}
+
+static size_t lang_count(void)
+{
+   size_t n = 0;
+   for (const char *const *lang = mr_langs(); *lang; lang++)
+      n++;
+   return n;
+}
+
+void extractor_init(struct extractor *ex, const struct config *cfg)
+{
+   /* Sentences are lines in line mode, which we tokenize ourselves, and
+    * likewise for segments in paragraph mode.
+    */
+   bool sentences = !cfg->lines && !cfg->paragraphs;
+   int ret = mr_alloc(&ex->mr, cfg->lang, sentences ? MR_SENTENCE : MR_TOKEN);
+   if (ret)
+      die("cannot create tokenizer: %s", mr_strerror(ret));
+   ex->gn = gn_alloc();
+   gn_set_dict(ex->gn, cfg->dict);
+   ex->cfg = cfg;
+   ex->tokens = GN_VEC_INIT;
+   ex->langs = NULL;
+   if (cfg->langs) {
+      ex->langs = calloc(lang_count() + 1, sizeof *ex->langs);
+      if (!ex->langs)
+         die("out of memory");
+   }
+   output_init(&ex->out, cfg->format);
+   ex->out.names = cfg->records != RECORDS_NONE || cfg->lines;
+   ex->out.line_numbers = cfg->lines;
+   ex->out.sources = cfg->dict != NULL;
+   ex->counts = cfg->count && !cfg->top ? gn_counter_alloc() : NULL;
+   ex->top = cfg->top ? gn_topk_alloc(cfg->top) : NULL;
+   ex->glossary = NULL;
+   if (cfg->uses) {
+      ex->glossary = gn_glossary_alloc();
+      gn_glossary_set_dict(ex->glossary, cfg->dict);
+   }
+   ex->cache = cfg->cache_size ? gn_cache_alloc(cfg->cache_size) : NULL;
+   ex->runs = NULL;
+   ex->memory = cfg->memory;
+   if (cfg->count && (cfg->memory || cfg->counts_file))
+      ex->runs = runs_new(cfg->temp_dir, cfg->memory);
+   ex->parts = NULL;
+   if (cfg->shards && cfg->shard_by == SHARD_BY_ACRONYM) {
+      ex->parts = malloc(cfg->shards * sizeof *ex->parts);
+      if (!ex->parts)
+         die("out of memory");
+      for (size_t i = 0; i < cfg->shards; i++) {
+         output_init(&ex->parts[i], cfg->format);
+         ex->parts[i].names = ex->out.names;
+         ex->parts[i].line_numbers = ex->out.line_numbers;
+         ex->parts[i].sources = ex->out.sources;
+      }
+   }
+}
+
+void extractor_fini(struct extractor *ex)
+{
+   output_fini(&ex->out);
+   if (ex->parts) {
+      for (size_t i = 0; i < ex->cfg->shards; i++)
+         output_fini(&ex->parts[i]);
+      free(ex->parts);
+   }
+   if (ex->counts)
+      gn_counter_dealloc(ex->counts);
+   if (ex->runs)
+      runs_free(ex->runs);
+   if (ex->top)
+      gn_topk_dealloc(ex->top);
+   if (ex->glossary)
+      gn_glossary_dealloc(ex->glossary);
+   if (ex->cache)
+      gn_cache_dealloc(ex->cache);
+   gn_vec_free(ex->tokens);
+   if (ex->langs)
+      tokenizers_free(ex->langs);
+   mr_dealloc(ex->mr);
+   gn_dealloc(ex->gn);
+}
+
+void report_caches(struct gn_cache **caches, size_t nr)
+{
+   size_t hits = 0, misses = 0;
+   bool used = false;
+   for (size_t i = 0; i < nr; i++) {
+      if (!caches[i])
+         continue;
+      size_t h, m;
+      gn_cache_stats(caches[i], &h, &m);
+      hits += h;
+      misses += m;
+      gn_cache_dealloc(caches[i]);
+      used = true;
+   }
+   if (used)
+      complain("sentence cache: %zu hits, %zu misses", hits, misses);
+}
+
+struct mascara **tokenizers_alloc(const char *lang, bool sentences)
+{
+   /* Keep the sentence boundary detector part, if any. */
+   const char *sbd = strchr(lang, ' ');
+   if (!sbd)
+      sbd = "";
+
+   size_t n = lang_count();
+   struct mascara **mrs = calloc(n + 1, sizeof *mrs);
+   if (!mrs)
+      die("out of memory");
+   for (size_t i = 0; i < n; i++) {
+      char cfg[64];
+      snprintf(cfg, sizeof cfg, "%s%s", mr_langs()[i], sbd);
+      int ret = mr_alloc(&mrs[i], cfg, sentences ? MR_SENTENCE : MR_TOKEN);
+      if (ret)
+         die("cannot create tokenizer for '%s': %s", mr_langs()[i], mr_strerror(ret));
+   }
+   return mrs;
+}
+
+void tokenizers_free(struct mascara **mrs)
+{
+   for (size_t i = 0; mr_langs()[i]; i++)
+      if (mrs[i])
+         mr_dealloc(mrs[i]);
+   free(mrs);
+}
+
+int lang_index(const char *tag)
+{
+   static const char *const codes[][2] = {
+      {"deu", "de"}, {"ger", "de"},
+      {"eng", "en"},
+      {"fra", "fr"}, {"fre", "fr"},
+      {"ita", "it"},
+   };
+
+   char code[4];
+   size_t len = 0;
+   while (len < 4 && isalpha((unsigned char)tag[len])) {
+      code[len] = tolower((unsigned char)tag[len]);
+      len++;
+   }
+   if (len == 3) {
+      code[3] = '\0';
+      for (size_t i = 0; i < sizeof codes / sizeof *codes; i++)
+         if (!strcmp(code, codes[i][0]))
+            memcpy(code, codes[i][1], 3);
+   } else if (len == 2) {
+      code[2] = '\0';
+   } else {
+      return -1;
+   }
+
+   const char *const *langs = mr_langs();
+   for (int i = 0; langs[i]; i++)
+      if (!strcmp(langs[i], code))
+         return i;
+   return -1;
+}
+
+/* Returns the tokenizer to use for a language. Tokenizers are cloned on first
+ * use, so that a worker pays only for the languages it sees.
+ */
+static struct mascara *tokenizer(struct extractor *ex, int lang)
+{
+   if (lang < 0 || !ex->langs)
+      return ex->mr;
+   if (!ex->langs[lang])
+      mr_clone(&ex->langs[lang], ex->cfg->langs[lang]);
+   return ex->langs[lang];
+}
+
+/* Returns the output an acronym goes to. */
+static struct output *output_of(struct extractor *ex, const char *acronym,
+                                size_t len)
+{
+   if (ex->parts)
+      return &ex->parts[shard_of(acronym, len, ex->cfg->shards)];
+   return &ex->out;
+}
+
+/* Adds a definition to the output, or to the output of its shard, or counts
+ * it. When writing uses, only records it.
+ */
+static void add_definition(struct extractor *ex, const struct document *doc,
+                           size_t sent_no, const struct mr_token *sent,
+                           const struct gn_acronym *def)
+{
+   if (ex->glossary) {
+      gn_glossary_add(ex->glossary, def);
+      return;
+   }
+   if (ex->top) {
+      gn_topk_add(ex->top, def);
+      return;
+   }
+   if (ex->counts) {
+      gn_counter_add(ex->counts, def, doc->id);
+      if (ex->runs && ex->memory && gn_counter_memory(ex->counts) > ex->memory)
+         runs_spill(ex->runs, ex->counts);
+      return;
+   }
+   output_add(output_of(ex, def->acronym, def->acronym_len), doc, sent_no, sent,
+              def);
+}
+
+/* Adds the uses of acronyms defined so far in a sentence to the output, once
+ * its definitions are added.
+ */
+static void add_uses(struct extractor *ex, const struct document *doc,
+                     size_t sent_no, const struct mr_token *sent, size_t len)
+{
+   struct gn_use use = {0};
+   while (gn_glossary_search(ex->glossary, sent, len, &use))
+      output_use(output_of(ex, use.acronym, use.acronym_len), doc, sent_no,
+                 sent, &use);
+}
+
+/* Adds the definitions of a sentence, found in the sentence cache if there is
+ * one, and then the uses of acronyms it contains.
+ */
+static void search_sentence(struct extractor *ex, const struct document *doc,
+                            size_t sent_no, const struct mr_token *sent,
+                            size_t len)
+{
+   if (ex->cache) {
+      const struct gn_acronym *defs;
+      size_t nr = gn_cache_search(ex->cache, ex->gn, sent, len, &defs);
+      for (size_t i = 0; i < nr; i++)
+         add_definition(ex, doc, sent_no, sent, &defs[i]);
+   } else {
+      struct gn_acronym def = {0};
+      while (gn_search(ex->gn, sent, len, &def))
+         add_definition(ex, doc, sent_no, sent, &def);
+   }
+   if (ex->glossary)
+      add_uses(ex, doc, sent_no, sent, len);
+}
+
+/* Whether a token is a punctuation mark that ends sentences. */
+static bool is_final_punct(const struct mr_token *tk)
+{
+   static const char *const puncts[] = {
+      ".", "!", "?", "...", "\u2026", "\u3002", "\uff01", "\uff1f",
+   };
+
+   if (tk->type != MR_SYM)
+      return false;
+   for (size_t i = 0; i < sizeof puncts / sizeof *puncts; i++)
+      if (tk->len == strlen(puncts[i]) && !memcmp(tk->str, puncts[i], tk->len))
+         return true;
+   return false;
+}
+
+/* Searches the segment of a paragraph accumulated so far, if any. */
+static size_t flush_segment(struct extractor *ex, const struct document *doc,
+                            size_t sent_no)
+{
+   size_t len = gn_vec_len(ex->tokens);
+   if (!len)
+      return sent_no;
+   search_sentence(ex, doc, sent_no, ex->tokens, len);
+   gn_vec_clear(ex->tokens);
+   return sent_no + 1;
+}
+
+/* Whether a period can be reattached to the token that precedes it, as the
+ * sentencizer does for abbreviations: the two must be adjacent, and the token
+ * must be a word or a number.
+ */
+static bool can_reattach_period(const struct mr_token *lhs,
+                                const struct mr_token *period)
+{
+   if (period->len != 1 || *period->str != '.'
+    || lhs->str + lhs->len != period->str)
+      return false;
+
+   switch (lhs->type) {
+   case MR_ABBR:
+   case MR_LATIN:
+   case MR_SUFFIX:
+   case MR_NUM:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/* In paragraph mode, texts are not split into sentences. Since gn_search()
+ * only looks back to the previous ";" or ":", and caps expansions to 100
+ * tokens, it is enough to search segments of the token stream that end at
+ * paragraph breaks and at final punctuation outside of brackets.
+ *
+ * Periods are reattached to abbreviations as the sentencizer does, but only
+ * where we can tell without its word lists: after the tokens of type MR_ABBR
+ * ("U.S.", "e.g."), which never end a segment, and before an opening bracket,
+ * which doesn't either, as in:
+ *
+ *    Foo Bar Inc. (FBI)
+ *
+ * A period after another word ends the segment, so definitions whose expansion
+ * holds an abbreviation such as "Mr." can be missed.
+ *
+ * Segments are treated as sentences, and numbered as such.
+ */
+static size_t search_segments(struct extractor *ex, struct mascara *mr,
+                              const struct document *doc, const char *str,
+                              size_t len, size_t sent_no)
+{
+   mr_set_text(mr, str, len);
+   gn_vec_clear(ex->tokens);
+
+   const char *prev = str;
+   int depth = 0;
+   bool at_end = false;       /* After final punctuation? */
+   struct mr_token *tk;
+   while (mr_next(mr, &tk)) {
+      size_t nr = gn_vec_len(ex->tokens);
+      struct mr_token *last = nr ? &ex->tokens[nr - 1] : NULL;
+      bool opening = tk->len == 1 && memchr("([{", *tk->str, 3);
+      if (last && can_reattach_period(last, tk) && last->type == MR_ABBR) {
+         last->len += tk->len;
+         prev = tk->str + tk->len;
+         continue;
+      }
+      if (at_end && opening && nr >= 2
+       && can_reattach_period(&ex->tokens[nr - 2], last)) {
+         ex->tokens[nr - 2].len += last->len;
+         gn_vec_len(ex->tokens)--;
+      }
+      if ((at_end && !opening) || gn_vec_len(ex->tokens) == MAX_SEGMENT_LEN
+       || find_paragraph_break(prev, 0, tk->str - prev, ex->cfg->separator)) {
+         sent_no = flush_segment(ex, doc, sent_no);
+         depth = 0;
+      }
+      at_end = false;
+      gn_vec_push(ex->tokens, *tk);
+      prev = tk->str + tk->len;
+
+      if (opening)
+         depth++;
+      else if (tk->len == 1 && memchr(")]}", *tk->str, 3) && depth)
+         depth--;
+      else if (!depth && is_final_punct(tk))
+         at_end = true;
+   }
+   return flush_segment(ex, doc, sent_no);
+}
+
+/* Searches the sentences of a text, numbering them from sent_no. Returns the
+ * number of the sentence that follows the last one.
+ */
+static size_t search_text(struct extractor *ex, struct mascara *mr,
+                          const struct document *doc, const char *str,
+                          size_t len, size_t sent_no)
+{
+   if (ex->cfg->paragraphs)
+      return search_segments(ex, mr, doc, str, len, sent_no);
+
+   mr_set_text(mr, str, len);
+
+   struct mr_token *sent;
+   while ((len = mr_next(mr, &sent)))
+      search_sentence(ex, doc, sent_no++, sent, len);
+   return sent_no;
+}
+
+/* Returns the first opening bracket of a string, or NULL if there is none.
+ * The string is searched in blocks, with memchr() for each kind of bracket,
+ * which is much faster than looking at each byte in turn.
+ */
+static const char *find_bracket(const char *str, size_t len)
+{
+   for (size_t pos = 0; pos < len; pos += BRACKET_BLOCK_SIZE) {
+      size_t size = len - pos < BRACKET_BLOCK_SIZE ? len - pos : BRACKET_BLOCK_SIZE;
+      const char *found = NULL;
+      for (const char *b = "([{"; *b; b++) {
+         const char *p = memchr(&str[pos], *b, found ? (size_t)(found - &str[pos]) : size);
+         if (p)
+            found = p;
+      }
+      if (found)
+         return found;
+   }
+   return NULL;
+}
+
+/* Whether the text before a paragraph break ends with final punctuation,
+ * possibly followed by closing quotes or brackets, once the break is skipped.
+ */
+static bool ends_with_final_punct(const char *str, size_t pos, const char *sep)
+{
+   static const char *const closing[] = {
+      "\"", "'", ")", "]", "}", "\u2019", "\u201d", "\u00bb",
+   };
+
+   if (sep) {
+      size_t sep_len = strlen(sep);
+      if (pos >= sep_len && !memcmp(&str[pos - sep_len], sep, sep_len))
+         pos -= sep_len;
+   }
+   while (pos && memchr(" \t\r\n", str[pos - 1], 4))
+      pos--;
+   for (size_t i = 0; i < sizeof closing / sizeof *closing; ) {
+      size_t len = strlen(closing[i]);
+      if (pos >= len && !memcmp(&str[pos - len], closing[i], len)) {
+         pos -= len;
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+   if (pos >= 3 && !memcmp(&str[pos - 3], "\u2026", 3))
+      return true;
+   return pos && memchr(".!?", str[pos - 1], 3);
+}
+
+/* Whether the text after a paragraph break might not start with an uppercase
+ * letter or a digit, once white space and opening quotes or brackets are
+ * skipped. Non-ASCII letters are not told apart.
+ */
+static bool may_start_lowercase(const char *str, size_t pos, size_t len)
+{
+   static const char *const opening[] = {
+      "\"", "'", "(", "[", "{", "\u2018", "\u201c", "\u00ab",
+   };
+
+   for (size_t i = 0; i < sizeof opening / sizeof *opening; ) {
+      size_t olen = strlen(opening[i]);
+      if (pos < len && memchr(" \t\r\n", str[pos], 4)) {
+         pos++;
+         i = 0;
+      } else if (len - pos >= olen && !memcmp(&str[pos], opening[i], olen)) {
+         pos += olen;
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+   if (pos == len)
+      return false;
+   unsigned char c = str[pos];
+   return !((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'));
+}
+
+/* Whether a sentence might go on past a paragraph break. The sentencizer ends
+ * sentences at such breaks, unless they come after final punctuation that is
+ * followed by a word that doesn't look like the start of a sentence, as in:
+ *
+ *    the World Health Abs.
+ *
+ *    organization (WHO)
+ */
+static bool may_span_break(const char *str, size_t brk, size_t len,
+                           const char *sep)
+{
+   return ends_with_final_punct(str, brk, sep)
+       && may_start_lowercase(str, brk, len);
+}
+
+/* Whether a paragraph break ends at "pos", beginning no earlier than "from". */
+static bool is_break_end(const char *str, size_t from, size_t pos,
+                         const char *sep)
+{
+   if (sep) {
+      size_t sep_len = strlen(sep);
+      return pos - from >= sep_len && str[pos - 1] == sep[sep_len - 1]
+          && !memcmp(&str[pos - sep_len], sep, sep_len);
+   }
+   if (str[pos - 1] != '\n')
+      return false;
+   pos--;
+   while (pos > from && memchr(" \t\r", str[pos - 1], 3))
+      pos--;
+   return pos > from && str[pos - 1] == '\n';
+}
+
+/* Returns the start of the paragraph before the one at "start", looking no
+ * further back than "from", which is returned if there is none. The text is
+ * scanned backwards from "start", so that widening a window over several
+ * paragraphs takes a single pass.
+ */
+static size_t previous_paragraph(const char *str, size_t from, size_t start,
+                                 const char *sep)
+{
+   for (size_t pos = start - 1; pos > from; pos--)
+      if (is_break_end(str, from, pos, sep))
+         return pos;
+   return from;
+}
+
+bool next_lazy_window(const char *str, size_t len, const char *sep,
+                      size_t *start, size_t *end)
+{
+   size_t done = *end;
+   const char *bracket = find_bracket(&str[done], len - done);
+   if (!bracket)
+      return false;
+
+   /* The paragraph that holds the bracket. */
+   size_t pos = bracket - str, brk;
+   *start = done;
+   while ((brk = find_paragraph_break(str, *start, pos, sep)))
+      *start = brk;
+   brk = find_paragraph_break(str, pos, len, sep);
+   *end = brk ? brk : len;
+
+   /* The paragraphs around it that might be part of the same sentences. */
+   size_t lo = *start - done > LAZY_MAX_WIDENING
+             ? *start - LAZY_MAX_WIDENING : done;
+   while (*start > lo && may_span_break(str, *start, len, sep)) {
+      size_t prev = previous_paragraph(str, lo, *start, sep);
+      if (prev == lo && lo != done)
+         break;
+      *start = prev;
+   }
+   size_t hi = len - *end > LAZY_MAX_WIDENING
+             ? *end + LAZY_MAX_WIDENING : len;
+   while (*end < len && may_span_break(str, *end, len, sep)) {
+      brk = find_paragraph_break(str, *end, hi, sep);
+      if (!brk && hi != len)
+         break;
+      *end = brk ? brk : len;
+   }
+   return true;
+}
+
+/* Acronym definitions don't span sentences, and sentences seldom span
+ * paragraphs, so in lazy mode we only tokenize the paragraphs that contain a
+ * bracket, along with the paragraphs around them that might be part of the
+ * same sentences. Sentences are then numbered as if the other paragraphs had
+ * none.
+ */
+static size_t search_sentences(struct extractor *ex, struct mascara *mr,
+                               const struct document *doc, const char *str,
+                               size_t len)
+{
+   if (ex->glossary)
+      gn_glossary_clear(ex->glossary);
+   if (!ex->cfg->lazy)
+      return search_text(ex, mr, doc, str, len, 0);
+
+   size_t start, end = 0, sent_no = 0;
+   while (next_lazy_window(str, len, ex->cfg->separator, &start, &end))
+      sent_no = search_text(ex, mr, doc, &str[start], end - start, sent_no);
+   return sent_no;
+}
+
+size_t process_text(struct extractor *ex, const struct document *doc,
+                    const char *str, size_t len)
+{
+   return search_sentences(ex, ex->mr, doc, str, len);
+}
+
+int process(struct extractor *ex, const struct document *doc, const char *path)
+{
+   size_t len;
+   char *str = read_file(path, &len);
+   if (!str)
+      return -1;
+
+   if (ex->cfg->lines)
+      process_lines(ex, doc, str, len, 0, 0);
+   else
+      process_text(ex, doc, str, len);
+   free(str);
+   return 0;
+}
+
+static void process_line(struct extractor *ex, const struct document *doc,
+                         size_t line_no, const char *str, size_t len,
+                         uint64_t offset)
+{
+   /* Acronym definitions are always introduced by a bracket, so we don't need
+    * to tokenize lines that have none.
+    */
+   if (!ex->glossary && !find_bracket(str, len))
+      return;
+
+   mr_set_text(ex->mr, str, len);
+   gn_vec_clear(ex->tokens);
+   struct mr_token *tk;
+   while (mr_next(ex->mr, &tk)) {
+      gn_vec_push(ex->tokens, *tk);
+      ex->tokens[gn_vec_len(ex->tokens) - 1].offset += offset;
+   }
+
+   search_sentence(ex, doc, line_no, ex->tokens, gn_vec_len(ex->tokens));
+}
+
+size_t process_lines(struct extractor *ex, const struct document *doc,
+                     const char *str, size_t len, size_t first_line,
+                     uint64_t offset)
+{
+   size_t line_no = first_line;
+   const char *p = str, *end = str + len;
+
+   /* Files are not split when writing uses, so a document starts at its first
+    * line.
+    */
+   if (ex->glossary && !first_line)
+      gn_glossary_clear(ex->glossary);
+
+   while (p < end) {
+      const char *nl = memchr(p, '\n', end - p);
+      size_t line_len = (nl ? nl : end) - p;
+      process_line(ex, doc, line_no++, p, line_len, offset + (p - str));
+      p += line_len + (nl != NULL);
+   }
+   return line_no - first_line;
+}
+
+/* Size of the blocks read in line mode. */
+#define LINES_BLOCK_SIZE (1 << 20)
+
+int process_file_lines(struct extractor *ex, const struct document *doc,
+                       const char *path, FILE *fp)
+{
+   struct input *in = input_open(path);
+   if (!in)
+      return -1;
+
+   struct chunker chk;
+   chunker_init(&chk, in, LINES_BLOCK_SIZE, "\n");
+
+   int ret;
+   char *block;
+   size_t line_no = 0;
+   uint64_t offset = 0;
+   while ((ret = chunker_next(&chk, &block)) > 0) {
+      size_t len;
+      char *str = normalize(doc->name, (uint8_t *)block, gn_vec_len(block), &len);
+      gn_vec_free(block);
+      if (!str) {
+         ret = -1;
+         break;
+      }
+      line_no += process_lines(ex, doc, str, len, line_no, offset);
+      offset += len;
+      free(str);
+      if (gn_vec_len(ex->out.buf) >= FLUSH_SIZE && output_drain(&ex->out, fp))
+         die("cannot write output:");
+   }
+   chunker_fini(&chk);
+   input_close(in);
+   return ret;
+}
+
+int process_raw(struct extractor *ex, const struct document *doc, int lang,
+                const char *str, size_t len)
+{
+   char *nrm = normalize(doc->name, (const uint8_t *)str, len, &len);
+   if (!nrm)
+      return -1;
+
+   search_sentences(ex, tokenizer(ex, lang), doc, nrm, len);
+   free(nrm);
+   return 0;
+}
+
+int process_records(struct extractor *ex, size_t *doc_id, const char *path,
+                    FILE *fp)
+{
+   struct input *in = input_open(path);
+   if (!in)
+      return -1;
+
+   const struct config *cfg = ex->cfg;
+   struct record_reader rd;
+   record_reader_init(&rd, cfg->records, in, path ? path : "<stdin>",
+                      cfg->text_field, cfg->id_field, cfg->lang_field);
+
+   int ret, status = 0;
+   struct record rec;
+   while ((ret = record_next(&rd, &rec)) > 0) {
+      struct document doc = {.id = (*doc_id)++, .name = rec.id};
+      int lang = rec.lang ? lang_index(rec.lang) : -1;
+      if (process_raw(ex, &doc, lang, rec.text, rec.len))
+         status = -1;
+      if (gn_vec_len(ex->out.buf) >= FLUSH_SIZE && output_drain(&ex->out, fp))
+         die("cannot write output:");
+   }
+   if (ret < 0 || rd.failed)
+      status = -1;
+
+   record_reader_fini(&rd);
+   input_close(in);
+   return status;
+}
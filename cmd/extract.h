@@ -0,0 +1,159 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "output.h"
+#include "record.h"
+#include "shard.h"
+#include "runs.h"
+
+#define MAX_FILE_SIZE (50 * 1024 * 1024)
+
+struct config {
+   const char *lang;
+   enum format format;
+   size_t chunk_size;         /* 0 if files must not be split. */
+   const char *separator;     /* NULL for a blank line. */
+   bool uring;                /* Whether to read files with io_uring. */
+   enum record_format records;
+   bool lines;                /* Whether each line is a separate sentence. */
+   const char *text_field;    /* JSON fields holding the text and the id. */
+   const char *id_field;
+   const char *lang_field;    /* Field holding the language of records. */
+   char **include;            /* Glob patterns filtering files found in */
+   char **exclude;            /* directories, or NULL. */
+   struct checkpoint *checkpoint;   /* Where output goes, if not NULL. */
+   struct manifest *manifest;       /* Output of previous runs, or NULL. */
+   size_t shards;             /* Number of output shards, 0 for none. */
+   enum shard_key shard_by;
+   const char *shard_prefix;
+   bool count;                /* Whether to count definitions instead. */
+   bool doc_freq;             /* Whether to count documents too. */
+   size_t memory;             /* Memory budget of counts, 0 for none. */
+   const char *temp_dir;      /* Where counts are spilled. */
+   const char *counts_file;   /* Where counts are saved as a run, or NULL. */
+   size_t top;                /* Number of definitions tracked approximately,
+                               * or 0 for exact counts. */
+   bool uses;                 /* Whether to write uses of acronyms instead. */
+   const struct gn_dict *dict;   /* Dictionary of known acronyms, or NULL. */
+   size_t cache_size;         /* Number of sentences cached by each worker,
+                               * or 0 for none. */
+   bool lazy;                 /* Whether to only process paragraphs that
+                               * contain an opening bracket. */
+   bool paragraphs;           /* Whether to search segments of paragraphs
+                               * instead of sentences. */
+
+   /* Tokenizers for each of the languages of mr_langs(), cloned by workers
+    * when routing records by language, or NULL.
+    */
+   struct mascara **langs;
+};
+
+/* Per-thread processing state. */
+struct extractor {
+   const struct config *cfg;
+   struct mascara *mr;
+   struct gourgandine *gn;
+   struct output out;
+   struct mr_token *tokens;   /* Tokens of the current line, in line mode,
+                               * or segment, in paragraph mode. */
+   struct mascara **langs;    /* Tokenizer of each language, once used. */
+   struct output *parts;      /* Output of each shard, when partitioning by
+                               * acronym, or NULL. */
+   struct gn_counter *counts; /* Where definitions go in count mode, or NULL. */
+   struct runs *runs;         /* Where counts are spilled, or NULL. */
+   size_t memory;             /* Size of counts above which they are spilled. */
+   struct gn_topk *top;       /* Approximate counts, or NULL. */
+   struct gn_glossary *glossary; /* Acronyms defined in the current document,
+                                  * when writing their uses, or NULL. */
+   struct gn_cache *cache;    /* Definitions of recent sentences, or NULL. */
+};
+
+/* Dies on failure. */
+void extractor_init(struct extractor *, const struct config *);
+void extractor_fini(struct extractor *);
+
+/* Displays on the standard error the sentence cache statistics summed over
+ * several extractors, or does nothing if caches are not used. Caches are
+ * released.
+ */
+void report_caches(struct gn_cache **, size_t nr);
+
+/* Allocates a tokenizer for each of the languages of mr_langs(), with the
+ * sentence boundary detector given in a language configuration string, as
+ * for mr_alloc(). Tokenizers iterate over sentences if "sentences" is true,
+ * over tokens otherwise. Dies on failure.
+ */
+struct mascara **tokenizers_alloc(const char *lang, bool sentences);
+void tokenizers_free(struct mascara **);
+
+/* Finds the index of a language tag in mr_langs(). Region subtags ("en-US")
+ * and three letters codes ("eng") are recognized. Returns -1 if there is no
+ * tokenizer for it.
+ */
+int lang_index(const char *tag);
+
+/* Normalizes a text to NFC. Returns a string that must be released with
+ * free(), or NULL on error, after displaying a message.
+ */
+void *normalize(const char *name, const uint8_t *buf, size_t len, size_t *size);
+
+/* Reads, decompresses if needed, and normalizes a file, or the standard input
+ * if path is NULL. Returns NULL on error, after displaying a message.
+ */
+void *read_file(const char *path, size_t *size);
+
+/* Finds the next part of a text to tokenize in lazy mode: a paragraph that
+ * contains an opening bracket, along with the paragraphs around it that might
+ * be part of the same sentences, so that sentences are the same as when the
+ * whole text is tokenized. Paragraphs are delimited as for splitting files into
+ * chunks. The search starts at *end, which must be 0 at first. On success,
+ * stores the bounds of the part in *start and *end, and returns true.
+ */
+bool next_lazy_window(const char *str, size_t len, const char *sep,
+                      size_t *start, size_t *end);
+
+/* Extracts acronyms from a normalized text, adding them to the extractor
+ * output. Returns the number of sentences in the text.
+ */
+size_t process_text(struct extractor *, const struct document *,
+                    const char *str, size_t len);
+
+/* Same as process_text(), in line mode, where each line of the text is a
+ * sentence. Lines are numbered from first_line, and byte offsets start at the
+ * given offset. Returns the number of lines in the text.
+ */
+size_t process_lines(struct extractor *, const struct document *,
+                     const char *str, size_t len, size_t first_line,
+                     uint64_t offset);
+
+/* Same as process_lines(), for a file, or the standard input if path is
+ * NULL. The file is read in blocks, and output is written to the given file as
+ * it becomes available. Returns -1 on error.
+ */
+int process_file_lines(struct extractor *, const struct document *,
+                       const char *path, FILE *);
+
+/* Same as process_text(), for a text that isn't normalized yet, in the language
+ * which index in mr_langs() is given, or in the default language if it is -1
+ * or records are not routed by language. Returns -1 on error.
+ */
+int process_raw(struct extractor *, const struct document *, int lang,
+                const char *str, size_t len);
+
+/* Same as process_text() or process_lines(), depending on the configuration,
+ * for a file. Returns -1 on error.
+ */
+int process(struct extractor *, const struct document *, const char *path);
+
+/* Processes the records of a file, or of the standard input if path is NULL.
+ * Records are numbered from *doc_id, which is updated. Output is written to
+ * the given file as it becomes available. Returns -1 if some records could not
+ * be processed.
+ */
+int process_records(struct extractor *, size_t *doc_id, const char *path,
+                    FILE *);
+
+#endif
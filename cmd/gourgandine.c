@@ -1,92 +1,842 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "cmd.h"
+#include "output.h"
+#include "pool.h"
+#include "chunk.h"
+#include "input.h"
+#include "record.h"
+#include "extract.h"
+#include "pipeline.h"
+#include "uring.h"
+#include "dict.h"
+#include "walk.h"
+#include "checkpoint.h"
+#include "manifest.h"
+#include "hash.h"
 
 #define local static
 #include "../gourgandine.h"
 #include "../src/vec.h"
 #include "../src/lib/mascara.h"
-#include "../src/lib/utf8proc.h"
 
-#define MAX_FILE_SIZE (50 * 1024 * 1024)
+noreturn static void version(void)
+{
+   const char *msg =
+   "Gourgandine version "GN_VERSION"\n"
+   "Copyright (c) 2016 Michaël Meyer"
+   ;
+   puts(msg);
+   exit(EXIT_SUCCESS);
+}
+
+/* A record of a batch, as offsets into the batch data. */
+struct batch_record {
+   size_t id, text, len;
+   int lang;                  /* Index in mr_langs(), or -1. */
+};
+
+/* A file, a part of a file, or a batch of records to process in parallel
+ * mode.
+ */
+struct job {
+   struct document doc;
+   const char *path;          /* Input file, read by the worker if chunk is NULL. */
+   char *chunk;               /* Part of a file, or batch data, as a byte vector. */
+   struct batch_record *records;    /* Records in the batch, if not NULL. */
+   bool first;                /* Whether this is the first part of the input. */
+   size_t first_line;         /* Number of the first line, in line mode. */
+
+   /* Set after processing. Used to adjust the offsets of the next parts. */
+   size_t text_len;
+   size_t sentences;
+   bool failed;
+
+   /* For checkpoints. Position at which the input was resumed, and position
+    * after this part, which tells whether this is the last part.
+    */
+   struct progress from;
+   struct progress to;
+
+   /* For manifests. Whole files are hashed and looked up by workers, other
+    * inputs when they are submitted. Unchanged inputs have their entry set.
+    */
+   uint64_t hash;
+   bool check;                /* Whether the worker must hash the input. */
+   const struct manifest_entry *reuse;
+   size_t end_doc;            /* Number of the document after this part. */
+
+   /* For sharded output. Shard of the job output, or output of each shard
+    * when partitioning by acronym.
+    */
+   size_t shard;
+   char **parts;
+
+   /* In count mode, with document frequencies, counts of a part of a file,
+    * which are merged in order when the job is emitted, since the parts of a
+    * file may be processed by several workers.
+    */
+   struct gn_counter *counts;
+};
+
+struct parallel {
+   const struct config *cfg;
+   struct shards *shards;     /* Where output goes, if not NULL. */
+
+   /* In count mode, counts of file parts, and counts of each worker, which
+    * are merged at the end, along with the runs they were spilled to, if any.
+    */
+   struct gn_counter *counts;
+   struct gn_counter **worker_counts;
+   struct runs *runs;
+   struct runs **worker_runs;
+   size_t memory;             /* Budget of each of these counters. */
+
+   /* Approximate counts of each worker, when tracking the top definitions. */
+   struct gn_topk **worker_tops;
+
+   /* Sentence cache of each worker, for reporting statistics. */
+   struct gn_cache **worker_caches;
+
+   /* Position, in the document being written, of the next part to write. */
+   uint64_t text_pos;
+   size_t sentence_pos;
+
+   /* Whether a part of the input being written failed, after which its
+    * checkpoint must stay where it is, so that the failed part is done again
+    * when the run is resumed.
+    */
+   bool failed;
+};
+
+/* The extractor must come first. */
+struct worker {
+   struct extractor ex;
+   size_t no;
+   struct parallel *par;
+};
 
-static void *read_file(const char *path, size_t *size)
+static void *worker_init(void *arg, size_t worker_no)
 {
-   FILE *fp = stdin;
-   if (path) {
-      fp = fopen(path, "r");
-      if (!fp) {
-         complain("cannot open '%s':", path);
-         return NULL;
+   struct parallel *par = arg;
+   struct worker *w = malloc(sizeof *w);
+   if (!w)
+      die("out of memory");
+   extractor_init(&w->ex, par->cfg);
+   w->ex.memory = par->memory;
+   w->no = worker_no;
+   w->par = par;
+   return w;
+}
+
+/* Counts are handed over to be merged once all workers are done, and likewise
+ * for cache statistics.
+ */
+static void worker_fini(void *arg)
+{
+   struct worker *w = arg;
+   if (w->ex.counts) {
+      w->par->worker_counts[w->no] = w->ex.counts;
+      w->par->worker_runs[w->no] = w->ex.runs;
+      w->ex.counts = NULL;
+      w->ex.runs = NULL;
+   }
+   if (w->ex.top) {
+      w->par->worker_tops[w->no] = w->ex.top;
+      w->ex.top = NULL;
+   }
+   w->par->worker_caches[w->no] = w->ex.cache;
+   w->ex.cache = NULL;
+   extractor_fini(&w->ex);
+   free(w);
+}
+
+static int worker_run(void *arg, void *job_arg, char **out)
+{
+   struct extractor *ex = arg;
+   struct job *job = job_arg;
+
+   /* The output of unchanged inputs is reused when the job is emitted. */
+   if (job->check) {
+      if (job->chunk)
+         job->hash = hash64(job->chunk, gn_vec_len(job->chunk), 0);
+      else if (manifest_hash_file(job->path, &job->hash)) {
+         job->failed = true;
+         return -1;
       }
+      job->reuse = manifest_find(ex->cfg->manifest, job->path, job->hash);
+   }
+   if (job->reuse) {
+      if (job->chunk)
+         gn_vec_free(job->chunk);
+      job->chunk = NULL;
+      return 0;
+   }
+
+   /* A record that cannot be processed is reported, but doesn't fail its
+    * batch: it would fail again if the batch was done again.
+    */
+   int ret = 0;
+   bool failed = false;
+   if (job->records) {
+      for (size_t i = 0; i < gn_vec_len(job->records); i++) {
+         const struct batch_record *rec = &job->records[i];
+         struct document doc = {.id = job->doc.id + i, .name = &job->chunk[rec->id]};
+         if (process_raw(ex, &doc, rec->lang, &job->chunk[rec->text], rec->len))
+            ret = -1;
+      }
+      gn_vec_free(job->records);
+      gn_vec_free(job->chunk);
+      job->chunk = NULL;
+   } else if (!job->chunk) {
+      ret = process(ex, &job->doc, job->path);
+      failed = ret != 0;
    } else {
-      path = "<stdin>";
+      struct gn_counter *counts = ex->counts;
+      struct runs *runs = ex->runs;
+      if (ex->cfg->doc_freq && !(job->first && job->to.done)) {
+         ex->counts = job->counts = gn_counter_alloc();
+         ex->runs = NULL;
+      }
+      char *str = normalize(job->doc.name, (uint8_t *)job->chunk,
+                            gn_vec_len(job->chunk), &job->text_len);
+      gn_vec_free(job->chunk);
+      job->chunk = NULL;
+      /* In line mode, line numbers are known beforehand, there is no need to
+       * adjust them.
+       */
+      if (str && ex->cfg->lines) {
+         process_lines(ex, &job->doc, str, job->text_len, job->first_line, 0);
+         free(str);
+      } else if (str) {
+         job->sentences = process_text(ex, &job->doc, str, job->text_len);
+         free(str);
+      } else {
+         ret = -1;
+         failed = true;
+      }
+      ex->counts = counts;
+      ex->runs = runs;
    }
+   gn_vec_free(*out);
+   *out = output_take(&ex->out);
+   job->failed = failed;
+   if (ex->parts) {
+      job->parts = malloc(ex->cfg->shards * sizeof *job->parts);
+      if (!job->parts)
+         die("out of memory");
+      for (size_t i = 0; i < ex->cfg->shards; i++)
+         job->parts[i] = output_take(&ex->parts[i]);
+   } else if (ex->cfg->shards) {
+      job->shard = ((struct worker *)arg)->no % ex->cfg->shards;
+   }
+   return ret;
+}
 
-   uint8_t *buf = GN_VEC_INIT;
-   size_t len = 0;
+/* Makes the offsets of a file part relative to the start of the file. Jobs
+ * are emitted in order, so the parts of a file are seen one after the other.
+ */
+static void worker_emit(void *arg, void *job_arg, char **out)
+{
+   struct parallel *par = arg;
+   struct job *job = job_arg;
 
-   gn_vec_grow(buf, BUFSIZ);
-   while ((len = fread(&buf[gn_vec_len(buf)], 1, BUFSIZ, fp))) {
-      gn_vec_len(buf) += len;
-      if (gn_vec_len(buf) > MAX_FILE_SIZE) {
-         complain("input file '%s' too large (limit is %d)", path, MAX_FILE_SIZE);
-         goto fail;
-      }
-      gn_vec_grow(buf, BUFSIZ);
+   if (job->first) {
+      par->text_pos = job->from.text_pos;
+      par->sentence_pos = job->from.sentences;
+      par->failed = false;
    }
-   if (ferror(fp)) {
-      complain("cannot read '%s':", path);
-      goto fail;
+   if (job->failed)
+      par->failed = true;
+   if (par->cfg->format == FORMAT_BINARY && (par->text_pos || par->sentence_pos)) {
+      gnc_relocate(*out, gn_vec_len(*out), par->text_pos, par->sentence_pos);
+      for (size_t i = 0; job->parts && i < par->cfg->shards; i++)
+         gnc_relocate(job->parts[i], gn_vec_len(job->parts[i]), par->text_pos,
+                      par->sentence_pos);
    }
+   par->text_pos += job->text_len;
+   par->sentence_pos += job->sentences;
 
-   uint8_t *nrm;
-   ssize_t ret = utf8proc_map(buf, gn_vec_len(buf), &nrm, UTF8PROC_STABLE | UTF8PROC_COMPOSE);
-   if (ret < 0) {
-      complain("cannot process file '%s': %s", path, utf8proc_errmsg(ret));
-      goto fail;
+   if (job->counts) {
+      gn_counter_merge(par->counts, job->counts);
+      gn_counter_dealloc(job->counts);
+      if (par->runs && par->memory && gn_counter_memory(par->counts) > par->memory)
+         runs_spill(par->runs, par->counts);
    }
 
-   gn_vec_free(buf);
-   *size = ret;
-   return nrm;
+   if (par->shards && job->parts) {
+      for (size_t i = 0; i < par->cfg->shards; i++)
+         shards_write(par->shards, i, job->parts[i]);
+      free(job->parts);
+   } else if (par->shards) {
+      shards_write(par->shards, job->shard, *out);
+      *out = GN_VEC_INIT;
+   }
+
+   const struct config *cfg = par->cfg;
+   if (cfg->manifest && job->reuse) {
+      manifest_reuse(cfg->manifest, job->reuse, job->doc.id, out);
+   } else if (cfg->manifest) {
+      manifest_write(cfg->manifest, job->path, job->hash, job->doc.id,
+                     job->end_doc, *out, gn_vec_len(*out), job->to.done,
+                     job->failed);
+   }
 
-fail:
-   gn_vec_free(buf);
-   fclose(fp);
-   return NULL;
+   /* The output of a job that failed is dropped, and so is the output of the
+    * next parts of the same input, so that the job is done again when the run
+    * is resumed.
+    */
+   if (par->cfg->checkpoint) {
+      if (!par->failed) {
+         job->to.text_pos = par->text_pos;
+         job->to.sentences = par->sentence_pos;
+         checkpoint_write(par->cfg->checkpoint, job->path, &job->to, *out,
+                          gn_vec_len(*out));
+      }
+      gn_vec_clear(*out);
+   }
+   free(job);
 }
 
-noreturn static void version(void)
+static struct job *new_job(const struct document *doc, const char *path,
+                           char *chunk, bool first)
 {
-   const char *msg =
-   "Gourgandine version "GN_VERSION"\n"
-   "Copyright (c) 2016 Michaël Meyer"
-   ;
-   puts(msg);
-   exit(EXIT_SUCCESS);
+   struct job *job = malloc(sizeof *job);
+   if (!job)
+      die("out of memory");
+   *job = (struct job){
+      .doc = *doc,
+      .path = path,
+      .chunk = chunk,
+      .first = first,
+      .end_doc = doc->id + 1,
+   };
+   return job;
 }
 
-static int process(struct mascara *mr, struct gourgandine *gn, const char *path)
+/* Counts lines the way process_lines() does. */
+static size_t count_lines(const char *str, size_t len)
 {
-   size_t len;
-   char *str = read_file(path, &len);
-   if (!str)
+   size_t n = 0;
+   const char *p = str, *end = str + len;
+
+   while ((p = memchr(p, '\n', end - p))) {
+      p++;
+      n++;
+   }
+   return n + (len && str[len - 1] != '\n');
+}
+
+/* Submits the parts of a file that must be split, or of the standard input if
+ * path is NULL, from a given position. Parts are submitted one step behind, so
+ * that the last one can be marked as such. The hash is used with a manifest.
+ */
+static int submit_chunks(struct pool *pool, const struct config *cfg,
+                         const struct document *doc, const char *path,
+                         const struct progress *from, uint64_t hash)
+{
+   struct input *in = input_open(path);
+   if (!in)
       return -1;
+   if (from->offset && input_skip(in, from->offset) < from->offset) {
+      if (!input_error(in))
+         complain("'%s' is shorter than when it was checkpointed", path);
+      input_close(in);
+      return -1;
+   }
 
-   mr_set_text(mr, str, len);
+   struct chunker chk;
+   chunker_init(&chk, in, cfg->chunk_size, cfg->lines ? "\n" : cfg->separator);
 
-   struct mr_token *sent;
-   while ((len = mr_next(mr, &sent))) {
-      struct gn_acronym def = {0};
-      while (gn_search(gn, sent, len, &def))
-         printf("%s\t%s\n", def.acronym, def.expansion);
+   int ret;
+   char *chunk;
+   struct job *job = NULL;
+   struct progress pos = *from;
+   while ((ret = chunker_next(&chk, &chunk)) > 0) {
+      if (job)
+         pool_submit(pool, job);
+      job = new_job(doc, path, chunk, !job);
+      job->hash = hash;
+      job->from = *from;
+      job->first_line = pos.lines;
+      pos.offset += gn_vec_len(chunk);
+      if (cfg->lines)
+         pos.lines += count_lines(chunk, gn_vec_len(chunk));
+      job->to = pos;
+   }
+   if (job) {
+      job->to.done = !ret;
+      pool_submit(pool, job);
+   }
+   chunker_fini(&chk);
+   input_close(in);
+   return ret;
+}
+
+/* Submits a whole file, or its parts if it is large. Compressed files are
+ * always split, since their size says little about the size of their contents.
+ */
+static int submit_file(struct pool *pool, const struct config *cfg,
+                       const struct document *doc, const char *path)
+{
+   struct progress from = {0};
+   if (cfg->checkpoint) {
+      from = checkpoint_get(cfg->checkpoint, path);
+      if (from.done)
+         return 0;
+      if (from.offset)
+         return submit_chunks(pool, cfg, doc, path, &from, 0);
    }
-   free(str);
+   if (!cfg->chunk_size)
+      goto whole;
+
+   struct stat st;
+   if (stat(path, &st) || !S_ISREG(st.st_mode))
+      goto whole;
+   if ((size_t)st.st_size <= cfg->chunk_size && !input_sniff(path))
+      goto whole;
+
+   /* Large files are hashed here, since they are split right after. */
+   uint64_t hash = 0;
+   if (cfg->manifest) {
+      if (manifest_hash_file(path, &hash))
+         return -1;
+      const struct manifest_entry *e = manifest_find(cfg->manifest, path, hash);
+      if (e) {
+         struct job *job = new_job(doc, path, NULL, true);
+         job->reuse = e;
+         job->to.done = true;
+         pool_submit(pool, job);
+         return 0;
+      }
+   }
+   return submit_chunks(pool, cfg, doc, path, &from, hash);
+
+whole:;
+   struct job *job = new_job(doc, path, NULL, true);
+   job->check = cfg->manifest != NULL;
+   job->to.done = true;
+   pool_submit(pool, job);
    return 0;
 }
 
+/* Records are handed over in batches, since they are often small. */
+#define BATCH_SIZE (1 << 20)
+#define BATCH_RECORDS 1024
+
+/* Submits the records of a file, or of the standard input if path is NULL.
+ * Records are numbered from *doc_id, which is updated.
+ */
+static int submit_records(struct pool *pool, const struct config *cfg,
+                          size_t *doc_id, const char *path)
+{
+   struct progress pos = {0};
+   if (cfg->checkpoint) {
+      pos = checkpoint_get(cfg->checkpoint, path);
+      if (pos.done)
+         return 0;
+   }
+   uint64_t hash = 0;
+   if (cfg->manifest) {
+      if (manifest_hash_file(path, &hash))
+         return -1;
+      const struct manifest_entry *e = manifest_find(cfg->manifest, path, hash);
+      if (e) {
+         struct document doc = {.id = *doc_id};
+         struct job *job = new_job(&doc, path, NULL, true);
+         job->reuse = e;
+         job->to.done = true;
+         *doc_id += manifest_docs(e);
+         pool_submit(pool, job);
+         return 0;
+      }
+   }
+
+   struct input *in = input_open(path);
+   if (!in)
+      return -1;
+
+   struct record_reader rd;
+   record_reader_init(&rd, cfg->records, in, path ? path : "<stdin>",
+                      cfg->text_field, cfg->id_field, cfg->lang_field);
+
+   /* Records are skipped rather than the bytes holding them, so that they are
+    * numbered as before.
+    */
+   int ret = 1;
+   struct record rec;
+   uint64_t skipped = 0;
+   while (skipped < pos.offset && (ret = record_next(&rd, &rec)) > 0)
+      skipped++;
+   *doc_id += skipped;
+   if (skipped < pos.offset) {
+      if (!ret)
+         complain("'%s' is shorter than when it was checkpointed", path);
+      ret = -1;
+   }
+
+   struct job *job = NULL, *full = NULL;
+   bool first = true;
+   while (ret > 0 && (ret = record_next(&rd, &rec)) > 0) {
+      if (full) {
+         pool_submit(pool, full);
+         full = NULL;
+      }
+      if (!job) {
+         struct document doc = {.id = *doc_id};
+         job = new_job(&doc, path, GN_VEC_INIT, first);
+         first = false;
+         job->records = GN_VEC_INIT;
+         job->hash = hash;
+      }
+      size_t id_len = strlen(rec.id) + 1;
+      struct batch_record br = {
+         .id = gn_vec_len(job->chunk),
+         .text = gn_vec_len(job->chunk) + id_len,
+         .len = rec.len,
+         .lang = rec.lang ? lang_index(rec.lang) : -1,
+      };
+      gn_vec_grow(job->chunk, id_len + rec.len);
+      memcpy(&job->chunk[br.id], rec.id, id_len);
+      memcpy(&job->chunk[br.text], rec.text, rec.len);
+      gn_vec_len(job->chunk) += id_len + rec.len;
+      gn_vec_push(job->records, br);
+      job->end_doc = ++*doc_id;
+      job->to.offset = ++pos.offset;
+
+      if (gn_vec_len(job->chunk) >= BATCH_SIZE || gn_vec_len(job->records) == BATCH_RECORDS) {
+         full = job;
+         job = NULL;
+      }
+   }
+   if (!job) {
+      job = full;
+      full = NULL;
+   }
+   if (job) {
+      job->to.done = !ret;
+      pool_submit(pool, job);
+   }
+   if (rd.failed)
+      ret = -1;
+
+   record_reader_fini(&rd);
+   input_close(in);
+   return ret;
+}
+
+/* Parameters of the io_uring reader. Files that don't fit in a buffer are read
+ * the usual way. Our documents are mostly a few kilobytes long.
+ */
+#define URING_DEPTH 64
+#define URING_BUF_SIZE (64 * 1024)
+
+struct uring_arg {
+   struct pool *pool;
+   const struct config *cfg;
+   char **paths;
+   size_t *ids;               /* Document number of each path, if not NULL. */
+   int ret;
+};
+
+static void uring_too_large(void *arg, size_t i)
+{
+   struct uring_arg *ua = arg;
+   struct document doc = {.id = ua->ids ? ua->ids[i] : i, .name = ua->paths[i]};
+   if (submit_file(ua->pool, ua->cfg, &doc, ua->paths[i]))
+      ua->ret = -1;
+}
+
+/* Compressed files are read again the usual way, to be decompressed as they
+ * are read.
+ */
+static void uring_done(void *arg, size_t i, char *data)
+{
+   struct uring_arg *ua = arg;
+
+   if (input_compression(data, gn_vec_len(data))) {
+      gn_vec_free(data);
+      uring_too_large(arg, i);
+      return;
+   }
+   struct document doc = {.id = ua->ids ? ua->ids[i] : i, .name = ua->paths[i]};
+   struct job *job = new_job(&doc, ua->paths[i], data, true);
+   job->check = ua->cfg->manifest != NULL;
+   job->to.done = true;
+   pool_submit(ua->pool, job);
+}
+
+/* Removes the files that were processed entirely from a list of paths. The
+ * position of the remaining ones in the list, which is their document number,
+ * is stored in "ids".
+ */
+static char **unfinished_files(const struct checkpoint *ck, char **paths,
+                               size_t **ids)
+{
+   char **todo = GN_VEC_INIT;
+   size_t *nos = GN_VEC_INIT;
+   for (size_t i = 0; paths[i]; i++) {
+      if (!checkpoint_get(ck, paths[i]).done) {
+         gn_vec_push(todo, paths[i]);
+         gn_vec_push(nos, i);
+      }
+   }
+   gn_vec_push(todo, NULL);
+   *ids = nos;
+   return todo;
+}
+
+/* Submits files given on the command-line, and files found in directories.
+ * Returns -1 if some could not be read.
+ */
+static int submit_files(struct pool *pool, const struct config *cfg,
+                        char **paths, struct walk *w)
+{
+   if (cfg->uring) {
+      struct uring_arg ua = {
+         .pool = pool,
+         .cfg = cfg,
+         .paths = paths,
+      };
+      if (cfg->checkpoint)
+         ua.paths = unfinished_files(cfg->checkpoint, paths, &ua.ids);
+      const struct uring_ops ops = {
+         .done = uring_done,
+         .too_large = uring_too_large,
+         .arg = &ua,
+      };
+      long failures = uring_read(ua.paths, URING_DEPTH, URING_BUF_SIZE, &ops);
+      if (cfg->checkpoint) {
+         gn_vec_free(ua.paths);
+         gn_vec_free(ua.ids);
+      }
+      if (failures >= 0)
+         return failures || ua.ret ? -1 : 0;
+      /* Not available, fall back to the usual method. */
+   }
+
+   /* Files are submitted as directories are walked, the pool ensures that we
+    * don't get too far ahead of workers.
+    */
+   int ret = 0;
+   size_t doc_id = 0;
+   const char *path;
+   for (size_t i = 0; (path = walk_next(w)); i++) {
+      struct document doc = {.id = i, .name = path};
+      if (cfg->records) {
+         if (submit_records(pool, cfg, &doc_id, path))
+            ret = -1;
+      } else if (submit_file(pool, cfg, &doc, path)) {
+         ret = -1;
+      }
+   }
+   return ret;
+}
+
+/* Writes counts, merged with the runs they were spilled to, if any. */
+static void write_counts(const struct config *cfg, struct gn_counter *counts,
+                         struct runs *runs)
+{
+   if (!runs) {
+      size_t nr;
+      const struct gn_count *c = gn_counter_sort(counts, &nr);
+      if (output_counts(c, nr, cfg->doc_freq, stdout))
+         die("cannot write output:");
+      return;
+   }
+   runs_spill(runs, counts);
+   if (!cfg->counts_file) {
+      runs_write(runs, true, cfg->doc_freq, stdout);
+      return;
+   }
+   FILE *fp = fopen(cfg->counts_file, "w");
+   if (!fp)
+      die("cannot open '%s':", cfg->counts_file);
+   runs_save(runs, true, fp);
+   if (fclose(fp))
+      die("cannot write '%s':", cfg->counts_file);
+}
+
+static void write_top(struct gn_topk *top)
+{
+   size_t nr;
+   const struct gn_count *c = gn_topk_sort(top, &nr);
+   if (output_top(c, nr, stdout))
+      die("cannot write output:");
+}
+
+static int process_parallel(const struct config *cfg, size_t workers,
+                            bool ordered, char **paths)
+{
+   struct parallel par = {.cfg = cfg};
+   par.worker_caches = calloc(workers, sizeof *par.worker_caches);
+   if (!par.worker_caches)
+      die("out of memory");
+   if (cfg->shards)
+      par.shards = shards_open(cfg->shard_prefix, cfg->shards, cfg->format);
+   if (cfg->top) {
+      par.worker_tops = calloc(workers, sizeof *par.worker_tops);
+      if (!par.worker_tops)
+         die("out of memory");
+   } else if (cfg->count) {
+      par.counts = gn_counter_alloc();
+      par.worker_counts = calloc(workers, sizeof *par.worker_counts);
+      par.worker_runs = calloc(workers, sizeof *par.worker_runs);
+      if (!par.worker_counts || !par.worker_runs)
+         die("out of memory");
+      /* File parts have a counter of their own. */
+      par.memory = cfg->memory / (workers + 1);
+      if (cfg->memory || cfg->counts_file)
+         par.runs = runs_new(cfg->temp_dir, cfg->memory);
+   }
+   struct pool_config pcfg = {
+      .workers = workers,
+      .ordered = ordered,
+      .fp = stdout,
+      .worker_init = worker_init,
+      .worker_fini = worker_fini,
+      .run = worker_run,
+      .emit = worker_emit,
+      .arg = &par,
+   };
+   struct pool *pool = pool_start(&pcfg);
+
+   int ret = 0;
+   if (!*paths) {
+      struct document doc = {.name = "<stdin>"};
+      size_t doc_id = 0;
+      if (cfg->records ? submit_records(pool, cfg, &doc_id, NULL)
+                       : submit_chunks(pool, cfg, &doc, NULL, &(struct progress){0}, 0))
+         ret = -1;
+   }
+   /* Paths must outlive the jobs referring to them. */
+   struct walk *w = walk_start(paths, cfg->include, cfg->exclude);
+   if (submit_files(pool, cfg, paths, w))
+      ret = -1;
+   if (pool_finish(pool))
+      ret = -1;
+   if (walk_finish(w))
+      ret = -1;
+   if (par.shards)
+      shards_close(par.shards);
+   report_caches(par.worker_caches, workers);
+   free(par.worker_caches);
+   if (cfg->top) {
+      for (size_t i = 1; i < workers; i++) {
+         gn_topk_merge(par.worker_tops[0], par.worker_tops[i]);
+         gn_topk_dealloc(par.worker_tops[i]);
+      }
+      write_top(par.worker_tops[0]);
+      gn_topk_dealloc(par.worker_tops[0]);
+      free(par.worker_tops);
+   } else if (cfg->count) {
+      /* Runs of the same counter must follow each other. */
+      if (par.runs)
+         runs_spill(par.runs, par.counts);
+      for (size_t i = 0; i < workers; i++) {
+         if (par.runs) {
+            runs_spill(par.worker_runs[i], par.worker_counts[i]);
+            runs_append(par.runs, par.worker_runs[i]);
+         } else {
+            gn_counter_merge(par.counts, par.worker_counts[i]);
+         }
+         gn_counter_dealloc(par.worker_counts[i]);
+      }
+      write_counts(cfg, par.counts, par.runs);
+      gn_counter_dealloc(par.counts);
+      if (par.runs)
+         runs_free(par.runs);
+      free(par.worker_counts);
+      free(par.worker_runs);
+   }
+   return ret;
+}
+
+static int process_input(struct extractor *ex, const struct document *doc,
+                         size_t *doc_id, const char *path)
+{
+   if (ex->cfg->records)
+      return process_records(ex, doc_id, path, stdout);
+   if (ex->cfg->lines)
+      return process_file_lines(ex, doc, path, stdout);
+   return process(ex, doc, path);
+}
+
+static int process_serial(const struct config *cfg, char **paths)
+{
+   struct extractor ex;
+   extractor_init(&ex, cfg);
+
+   int ret = 0;
+   size_t doc_id = 0;
+   if (!*paths) {
+      struct document doc = {.name = "<stdin>"};
+      if (process_input(&ex, &doc, &doc_id, NULL))
+         ret = -1;
+      if (output_flush(&ex.out, stdout))
+         die("cannot write output:");
+   }
+   struct walk *w = walk_start(paths, cfg->include, cfg->exclude);
+   const char *path;
+   for (size_t i = 0; (path = walk_next(w)); i++) {
+      struct document doc = {.id = i, .name = path};
+      if (process_input(&ex, &doc, &doc_id, path))
+         ret = -1;
+      if (output_flush(&ex.out, stdout))
+         die("cannot write output:");
+   }
+   if (walk_finish(w))
+      ret = -1;
+   if (ex.top)
+      write_top(ex.top);
+   else if (ex.counts)
+      write_counts(cfg, ex.counts, ex.runs);
+   report_caches(&ex.cache, 1);
+   ex.cache = NULL;
+   extractor_fini(&ex);
+   return ret;
+}
+
+static bool has_directories(char **paths)
+{
+   struct stat st;
+   for (size_t i = 0; paths[i]; i++)
+      if (!stat(paths[i], &st) && S_ISDIR(st.st_mode))
+         return true;
+   return false;
+}
+
+/* Hashes the options that affect the output, and the dictionary, if any, for
+ * detecting that the output stored in a manifest is stale.
+ */
+static uint64_t options_hash(const struct config *cfg, const struct dict_file *dict)
+{
+   const char *opts[] = {
+      cfg->lang,
+      cfg->records ? "records" : "",
+      cfg->lines ? "lines" : "",
+      cfg->paragraphs ? "paragraphs" : "",
+      cfg->text_field,
+      cfg->id_field,
+      cfg->lang_field ? cfg->lang_field : "",
+      cfg->uses ? "uses" : "",
+      cfg->separator ? cfg->separator : "",
+      GN_VERSION,
+   };
+   struct hash h;
+   hash_init(&h, cfg->records);
+   for (size_t i = 0; i < sizeof opts / sizeof *opts; i++)
+      hash_update(&h, opts[i], strlen(opts[i]) + 1);
+   uint64_t chunk_size = cfg->chunk_size;
+   hash_update(&h, &chunk_size, sizeof chunk_size);
+   if (dict)
+      hash_update(&h, dict->map, dict->size);
+   return hash_final(&h);
+}
+
 static void display_langs(void)
 {
    const char *const *langs = mr_langs();
@@ -94,13 +844,112 @@ static void display_langs(void)
       puts(*langs++);
 }
 
+void cmd_bench(int argc, char **argv);
+void cmd_dict(int argc, char **argv);
+void cmd_dump(int argc, char **argv);
+void cmd_index(int argc, char **argv);
+void cmd_lookup(int argc, char **argv);
+void cmd_merge(int argc, char **argv);
+
+static struct command commands[] = {
+   {"bench", cmd_bench},
+   {"dict", cmd_dict},
+   {"dump", cmd_dump},
+   {"index", cmd_index},
+   {"lookup", cmd_lookup},
+   {"merge", cmd_merge},
+   {0},
+};
+
+/* Subcommands must be given as first argument. They are called with the
+ * program name as first argument, so that they can parse their options with
+ * parse_options().
+ */
+static void run_command(int argc, char **argv)
+{
+   if (argc < 2)
+      return;
+   for (struct command *cmd = commands; cmd->name; cmd++) {
+      if (!strcmp(cmd->name, argv[1])) {
+         argv[1] = argv[0];
+         cmd->func(argc - 1, argv + 1);
+         exit(EXIT_SUCCESS);
+      }
+   }
+}
+
 int main(int argc, char **argv)
 {
+   const char *home = getenv("MR_HOME");
+   mr_home = home ? home : MR_HOME;
+
+   run_command(argc, argv);
+
    const char *lang = "en";
+   const char *format_name = "tsv";
+   size_t jobs = 1;
+   bool unordered = false;
+   bool pipeline = false;
+   bool uring = false;
+   size_t chunk_size = 16 * 1024 * 1024;
+   const char *separator = NULL;
+   const char *records_name = NULL;
+   const char *text_field = "text";
+   const char *id_field = "id";
+   const char *lang_field = NULL;
+   bool lines = false;
+   const char *include = NULL;
+   const char *exclude = NULL;
+   const char *checkpoint = NULL;
+   const char *manifest = NULL;
+   size_t shards = 0;
+   const char *shard_by = "worker";
+   const char *shard_prefix = "shard";
+   bool count = false;
+   bool doc_freq = false;
+   size_t memory = 0;
+   const char *temp_dir = getenv("TMPDIR");
+   const char *counts_file = NULL;
+   size_t top = 0;
+   bool uses = false;
+   const char *dict_path = NULL;
+   size_t cache_size = 0;
+   bool lazy = false;
+   bool paragraphs = false;
    bool list = false;
    struct option opts[] = {
       {'l', "lang", OPT_STR(lang)},
       {'L', "list", OPT_BOOL(list)},
+      {'f', "format", OPT_STR(format_name)},
+      {'j', "jobs", OPT_SIZE_T(jobs)},
+      {'u', "unordered", OPT_BOOL(unordered)},
+      {'p', "pipeline", OPT_BOOL(pipeline)},
+      {'\0', "io-uring", OPT_BOOL(uring)},
+      {'c', "chunk-size", OPT_SIZE_T(chunk_size)},
+      {'\0', "separator", OPT_STR(separator)},
+      {'r', "records", OPT_STR(records_name)},
+      {'\0', "lines", OPT_BOOL(lines)},
+      {'i', "include", OPT_STR(include)},
+      {'x', "exclude", OPT_STR(exclude)},
+      {'\0', "checkpoint", OPT_STR(checkpoint)},
+      {'\0', "manifest", OPT_STR(manifest)},
+      {'\0', "shards", OPT_SIZE_T(shards)},
+      {'\0', "shard-by", OPT_STR(shard_by)},
+      {'\0', "shard-prefix", OPT_STR(shard_prefix)},
+      {'\0', "count", OPT_BOOL(count)},
+      {'\0', "doc-freq", OPT_BOOL(doc_freq)},
+      {'\0', "memory", OPT_SIZE_T(memory)},
+      {'\0', "temp-dir", OPT_STR(temp_dir)},
+      {'\0', "save-counts", OPT_STR(counts_file)},
+      {'\0', "top", OPT_SIZE_T(top)},
+      {'\0', "uses", OPT_BOOL(uses)},
+      {'\0', "dict", OPT_STR(dict_path)},
+      {'\0', "sentence-cache", OPT_SIZE_T(cache_size)},
+      {'\0', "lazy", OPT_BOOL(lazy)},
+      {'\0', "paragraphs", OPT_BOOL(paragraphs)},
+      {'\0', "text-field", OPT_STR(text_field)},
+      {'\0', "id-field", OPT_STR(id_field)},
+      {'\0', "lang-field", OPT_STR(lang_field)},
       {'\0', "version", OPT_FUNC(version)},
       {0},
    };
@@ -113,26 +962,140 @@ int main(int argc, char **argv)
       display_langs();
       return EXIT_SUCCESS;
    }
-   
-   const char *home = getenv("MR_HOME");
-   mr_home = home ? home : MR_HOME;
 
+   int format = output_format(format_name);
+   if (format < 0)
+      die("unknown output format: '%s'", format_name);
+
+   int key = shard_key(shard_by);
+   if (key < 0)
+      die("unknown shard key: '%s'", shard_by);
+
+   int records = RECORDS_NONE;
+   if (records_name && (records = record_format(records_name)) < 0)
+      die("unknown record format: '%s'", records_name);
+
+   /* Check the tokenizer configuration upfront, rather than in each worker. */
    struct mascara *mr;
-   int ret = mr_alloc(&mr, lang, MR_SENTENCE);
+   int ret = mr_alloc(&mr, lang, paragraphs ? MR_TOKEN : MR_SENTENCE);
    if (ret)
       die("cannot create tokenizer: %s", mr_strerror(ret));
+   mr_dealloc(mr);
 
-   struct gourgandine *gn = gn_alloc();
-   ret = EXIT_SUCCESS;
-   if (!argc) {
-      if (process(mr, gn, NULL))
-         ret = EXIT_FAILURE;
-   } else {
-      while (*argv)
-         if (process(mr, gn, *argv++))
-            ret = EXIT_FAILURE;
+   char *sep = separator ? chunker_unescape(separator) : NULL;
+   struct config cfg = {
+      .lang = lang,
+      .format = format,
+      .chunk_size = chunk_size,
+      .separator = sep,
+      .uring = uring,
+      .records = records,
+      .lines = lines,
+      .text_field = text_field,
+      .id_field = id_field,
+      .lang_field = lang_field,
+      .include = include ? walk_patterns(include) : NULL,
+      .exclude = exclude ? walk_patterns(exclude) : NULL,
+      .shards = shards,
+      .shard_by = key,
+      .shard_prefix = shard_prefix,
+      .count = count,
+      .doc_freq = doc_freq,
+      .memory = memory,
+      .temp_dir = temp_dir && *temp_dir ? temp_dir : "/tmp",
+      .counts_file = counts_file,
+      .top = top,
+      .uses = uses,
+      .cache_size = cache_size,
+      .lazy = lazy,
+      .paragraphs = paragraphs,
+   };
+   if (separator && !*separator)
+      die("the paragraph separator cannot be empty");
+
+   /* Offsets of file parts can only be adjusted if they are written in
+    * order, and likewise for the document counts of file parts.
+    */
+   if ((format == FORMAT_BINARY && chunk_size) || checkpoint || manifest || doc_freq)
+      unordered = false;
+
+   /* With checkpoints, output goes to segments that have their own header, and
+    * likewise for shards. Counts are always written as TSV.
+    */
+   if (!checkpoint && !shards && !count)
+      output_header(format, stdout);
+   jobs = pool_workers(jobs);
+   if (pipeline && (jobs > 1 || uring))
+      die("--pipeline cannot be combined with several jobs or --io-uring");
+   if (records && (pipeline || uring))
+      die("--records cannot be combined with --pipeline or --io-uring");
+   if (lines && (pipeline || records))
+      die("--lines cannot be combined with --pipeline or --records");
+   if (lang_field && !records)
+      die("--lang-field requires --records");
+   if (uring && has_directories(argv))
+      die("--io-uring cannot be used with directories");
+   if (checkpoint && (pipeline || !*argv))
+      die("--checkpoint requires input files, and cannot be combined with --pipeline");
+   if (manifest && (pipeline || checkpoint || !*argv))
+      die("--manifest requires input files, and cannot be combined with --pipeline or --checkpoint");
+   if (shards && (pipeline || checkpoint || manifest))
+      die("--shards cannot be combined with --pipeline, --checkpoint or --manifest");
+   if (count && (pipeline || checkpoint || manifest || shards))
+      die("--count cannot be combined with --pipeline, --checkpoint, --manifest or --shards");
+   if (count && format == FORMAT_BINARY)
+      die("--count cannot be combined with binary output");
+   if ((doc_freq || memory || counts_file || top) && !count)
+      die("--doc-freq, --memory, --save-counts and --top require --count");
+   if (top && (doc_freq || memory || counts_file))
+      die("--top cannot be combined with --doc-freq, --memory or --save-counts");
+   if (uses && (pipeline || count || format == FORMAT_BINARY))
+      die("--uses cannot be combined with --pipeline, --count or binary output");
+   if (lazy && (uses || lines || format == FORMAT_BINARY))
+      die("--lazy cannot be combined with --uses, --lines or binary output");
+   if (paragraphs && (pipeline || lines))
+      die("--paragraphs cannot be combined with --pipeline or --lines");
+
+   /* Uses are only found after their definition in the same document. */
+   if (uses)
+      cfg.chunk_size = 0;
+
+   /* The dictionary is shared by all workers. */
+   struct dict_file dict;
+   if (dict_path) {
+      dict_load(&dict, dict_path);
+      cfg.dict = dict.dict;
    }
-   mr_dealloc(mr);
-   gn_dealloc(gn);
-   return ret;
+   /* Models are loaded once, workers clone these tokenizers as needed. */
+   if (lang_field)
+      cfg.langs = tokenizers_alloc(lang, !paragraphs);
+   /* Checkpointed runs go through the pool even with a single job, since
+    * progress is recorded as the output of each part of a file is written.
+    * Likewise, output is dispatched to shards as it is written.
+    */
+   if (checkpoint)
+      cfg.checkpoint = checkpoint_open(checkpoint, format);
+   if (manifest)
+      cfg.manifest = manifest_open(manifest, format,
+                                   options_hash(&cfg, dict_path ? &dict : NULL));
+   if (pipeline)
+      ret = pipeline_run(&cfg, argv, stdout);
+   else if (uring || checkpoint || manifest || shards || (jobs > 1 && (argc > 1 || chunk_size || records)))
+      ret = process_parallel(&cfg, jobs, !unordered, argv);
+   else
+      ret = process_serial(&cfg, argv);
+   if (cfg.manifest)
+      manifest_close(cfg.manifest);
+   if (cfg.checkpoint)
+      checkpoint_close(cfg.checkpoint);
+   else if (!shards && !count)
+      output_trailer(format, stdout);
+   if (cfg.langs)
+      tokenizers_free(cfg.langs);
+   if (dict_path)
+      dict_unload(&dict);
+   free(sep);
+   free(cfg.include);
+   free(cfg.exclude);
+   return ret ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,123 @@
+#include <string.h>
+#include "hash.h"
+
+#define P1 UINT64_C(0x9E3779B185EBCA87)
+#define P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define P3 UINT64_C(0x165667B19E3779F9)
+#define P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define P5 UINT64_C(0x27D4EB2F165667C5)
+
+static uint64_t rotl(uint64_t x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+/* Little-endian loads. */
+static uint64_t read64(const unsigned char *p)
+{
+   uint64_t x = 0;
+   for (int i = 7; i >= 0; i--)
+      x = x << 8 | p[i];
+   return x;
+}
+
+static uint32_t read32(const unsigned char *p)
+{
+   return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+        | (uint32_t)p[3] << 24;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input)
+{
+   acc += input * P2;
+   acc = rotl(acc, 31);
+   return acc * P1;
+}
+
+static uint64_t merge(uint64_t acc, uint64_t val)
+{
+   acc ^= round64(0, val);
+   return acc * P1 + P4;
+}
+
+void hash_init(struct hash *h, uint64_t seed)
+{
+   *h = (struct hash){
+      .v = {seed + P1 + P2, seed + P2, seed, seed - P1},
+   };
+}
+
+static void stripe(struct hash *h, const unsigned char *p)
+{
+   for (int i = 0; i < 4; i++)
+      h->v[i] = round64(h->v[i], read64(&p[i * 8]));
+}
+
+void hash_update(struct hash *h, const void *data, size_t len)
+{
+   const unsigned char *p = data, *end = p + len;
+
+   h->total += len;
+   if (h->buf_len) {
+      size_t n = sizeof h->buf - h->buf_len;
+      if (n > len)
+         n = len;
+      memcpy(&h->buf[h->buf_len], p, n);
+      h->buf_len += n;
+      p += n;
+      if (h->buf_len < sizeof h->buf)
+         return;
+      stripe(h, h->buf);
+      h->buf_len = 0;
+   }
+   while (end - p >= 32) {
+      stripe(h, p);
+      p += 32;
+   }
+   memcpy(h->buf, p, end - p);
+   h->buf_len = end - p;
+}
+
+uint64_t hash_final(const struct hash *h)
+{
+   uint64_t x;
+
+   if (h->total >= 32) {
+      x = rotl(h->v[0], 1) + rotl(h->v[1], 7) + rotl(h->v[2], 12) + rotl(h->v[3], 18);
+      for (int i = 0; i < 4; i++)
+         x = merge(x, h->v[i]);
+   } else {
+      x = h->v[2] + P5;
+   }
+   x += h->total;
+
+   const unsigned char *p = h->buf, *end = p + h->buf_len;
+   for (; end - p >= 8; p += 8) {
+      x ^= round64(0, read64(p));
+      x = rotl(x, 27) * P1 + P4;
+   }
+   if (end - p >= 4) {
+      x ^= read32(p) * P1;
+      x = rotl(x, 23) * P2 + P3;
+      p += 4;
+   }
+   for (; p < end; p++) {
+      x ^= *p * P5;
+      x = rotl(x, 11) * P1;
+   }
+
+   x ^= x >> 33;
+   x *= P2;
+   x ^= x >> 29;
+   x *= P3;
+   x ^= x >> 32;
+   return x;
+}
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed)
+{
+   struct hash h;
+   hash_init(&h, seed);
+   hash_update(&h, data, len);
+   return hash_final(&h);
+}
@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* XXH64 hash function, computed incrementally. This is not a cryptographic
+ * hash, but it is fast and good enough for detecting changes.
+ */
+struct hash {
+   uint64_t v[4];
+   uint64_t total;
+   unsigned char buf[32];
+   size_t buf_len;
+};
+
+void hash_init(struct hash *, uint64_t seed);
+void hash_update(struct hash *, const void *data, size_t len);
+uint64_t hash_final(const struct hash *);
+
+/* Hashes a whole buffer. */
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+
+#endif
@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cmd.h"
+#include "index.h"
+#include "../src/vec.h"
+
+#define HEADER_SIZE 56
+
+/* A definition read from binary output. Strings are first stored as offsets
+ * into the arena, which moves while it grows.
+ */
+struct entry {
+   size_t acronym_off, expansion_off;
+   const char *acronym, *expansion;
+   uint32_t doc;
+   uint32_t expansion_id;
+   uint64_t offset;
+};
+
+struct builder {
+   struct entry *entries;
+   char *arena;
+   size_t *names;             /* Arena offset of each document name. */
+};
+
+#define NO_NAME SIZE_MAX
+
+static size_t intern(struct builder *b, const char *str, size_t len)
+{
+   size_t off = gn_vec_len(b->arena);
+   gn_vec_grow(b->arena, len + 1);
+   memcpy(&b->arena[off], str, len);
+   b->arena[off + len] = '\0';
+   gn_vec_len(b->arena) += len + 1;
+   return off;
+}
+
+/* Reads the definitions of a binary output file. Its documents are numbered
+ * from "base".
+ */
+static int read_output(struct builder *b, const char *path, uint64_t base)
+{
+   struct gnc_file f;
+   if (gnc_open(&f, path)) {
+      if (errno)
+         complain("cannot open '%s':", path);
+      else
+         complain("'%s' is not a binary output file", path);
+      return -1;
+   }
+
+   struct gnc_block blk;
+   int ret;
+   while ((ret = gnc_next(&f, &blk)) > 0) {
+      const uint32_t *const *c = blk.col32;
+      for (size_t i = 0; i < blk.rows; i++) {
+         if (!gnc_str_valid(&blk, c[GNC_ACRONYM_OFF][i], c[GNC_ACRONYM_LEN][i])
+          || !gnc_str_valid(&blk, c[GNC_EXPANSION_OFF][i], c[GNC_EXPANSION_LEN][i])
+          || !gnc_str_valid(&blk, c[GNC_NAME_OFF][i], c[GNC_NAME_LEN][i])) {
+            ret = -1;
+            goto end;
+         }
+         uint64_t doc = base + c[GNC_DOC][i];
+         if (doc > UINT32_MAX)
+            die("too many documents");
+         struct entry e = {
+            .acronym_off = intern(b, gnc_str(&blk, c[GNC_ACRONYM_OFF][i]),
+                                  c[GNC_ACRONYM_LEN][i]),
+            .expansion_off = intern(b, gnc_str(&blk, c[GNC_EXPANSION_OFF][i]),
+                                    c[GNC_EXPANSION_LEN][i]),
+            .doc = doc,
+            .offset = blk.col64[GNC_ACRONYM_BYTE_START][i],
+         };
+         gn_vec_push(b->entries, e);
+         while (gn_vec_len(b->names) <= doc)
+            gn_vec_push(b->names, NO_NAME);
+         if (b->names[doc] == NO_NAME)
+            b->names[doc] = intern(b, gnc_str(&blk, c[GNC_NAME_OFF][i]),
+                                   c[GNC_NAME_LEN][i]);
+      }
+   }
+end:
+   gnc_close(&f);
+   if (ret) {
+      complain("file '%s' is truncated or corrupt", path);
+      return -1;
+   }
+   return 0;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+   const struct entry *x = a, *y = b;
+   int ret = strcmp(x->acronym, y->acronym);
+   if (ret)
+      return ret;
+   if (x->doc != y->doc)
+      return x->doc < y->doc ? -1 : 1;
+   if (x->offset != y->offset)
+      return x->offset < y->offset ? -1 : 1;
+   return 0;
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+   return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void append(char **out, const void *data, size_t len)
+{
+   char *buf = *out;
+   gn_vec_grow(buf, len);
+   memcpy(&buf[gn_vec_len(buf)], data, len);
+   gn_vec_len(buf) += len;
+   *out = buf;
+}
+
+static void append_u64(char **out, uint64_t n)
+{
+   append(out, &n, sizeof n);
+}
+
+static uint64_t add_string(char **heap, const char *str)
+{
+   uint64_t off = gn_vec_len(*heap);
+   append(heap, str, strlen(str) + 1);
+   return off;
+}
+
+/* Writes the index, once entries are sorted and numbered. */
+static void write_index(const struct builder *b, const char **exps,
+                        const char *path)
+{
+   char *heap = GN_VEC_INIT;
+   char *acronyms = GN_VEC_INIT;
+   char *postings = GN_VEC_INIT;
+   uint64_t nr_acronyms = 0;
+
+   size_t nr = gn_vec_len(b->entries);
+   for (size_t i = 0; i < nr; ) {
+      const char *acr = b->entries[i].acronym;
+      struct gni_acronym a = {.str = add_string(&heap, acr), .first = i};
+      for (; i < nr && !strcmp(b->entries[i].acronym, acr); i++) {
+         struct gni_posting p = {
+            .doc = b->entries[i].doc,
+            .expansion = b->entries[i].expansion_id,
+            .offset = b->entries[i].offset,
+         };
+         append(&postings, &p, sizeof p);
+      }
+      a.count = i - a.first;
+      append(&acronyms, &a, sizeof a);
+      nr_acronyms++;
+   }
+
+   char *expansions = GN_VEC_INIT;
+   for (size_t i = 0; i < gn_vec_len(exps); i++)
+      append_u64(&expansions, add_string(&heap, exps[i]));
+   char *docs = GN_VEC_INIT;
+   for (size_t i = 0; i < gn_vec_len(b->names); i++) {
+      const char *name = b->names[i] == NO_NAME ? "" : &b->arena[b->names[i]];
+      append_u64(&docs, add_string(&heap, name));
+   }
+
+   char *header = GN_VEC_INIT;
+   append(&header, GNI_MAGIC, 8);
+   uint32_t version[2] = {GNI_VERSION, 0};
+   append(&header, version, sizeof version);
+   append_u64(&header, nr_acronyms);
+   append_u64(&header, gn_vec_len(exps));
+   append_u64(&header, gn_vec_len(b->names));
+   append_u64(&header, nr);
+   append_u64(&header, gn_vec_len(heap));
+   while (gn_vec_len(heap) % 8)
+      append(&heap, "", 1);
+
+   FILE *fp = fopen(path, "wb");
+   if (!fp)
+      die("cannot open '%s':", path);
+   char *parts[] = {header, acronyms, expansions, docs, postings, heap};
+   for (size_t i = 0; i < sizeof parts / sizeof *parts; i++) {
+      size_t len = gn_vec_len(parts[i]);
+      if (fwrite(parts[i], 1, len, fp) != len)
+         die("cannot write '%s':", path);
+      gn_vec_free(parts[i]);
+   }
+   if (fclose(fp))
+      die("cannot write '%s':", path);
+}
+
+int gni_build(const char *path, char **inputs)
+{
+   struct builder b = {
+      .entries = GN_VEC_INIT,
+      .arena = GN_VEC_INIT,
+      .names = GN_VEC_INIT,
+   };
+   for (size_t i = 0; inputs[i]; i++)
+      if (read_output(&b, inputs[i], gn_vec_len(b.names)))
+         return -1;
+
+   size_t nr = gn_vec_len(b.entries);
+   const char **exps = GN_VEC_INIT;
+   gn_vec_grow(exps, nr);
+   for (size_t i = 0; i < nr; i++) {
+      b.entries[i].acronym = &b.arena[b.entries[i].acronym_off];
+      b.entries[i].expansion = &b.arena[b.entries[i].expansion_off];
+      exps[i] = b.entries[i].expansion;
+   }
+   qsort(b.entries, nr, sizeof *b.entries, compare_entries);
+
+   /* Expansions are numbered in byte order. */
+   qsort(exps, nr, sizeof *exps, compare_strings);
+   size_t uniq = 0;
+   for (size_t i = 0; i < nr; i++)
+      if (!uniq || strcmp(exps[uniq - 1], exps[i]))
+         exps[uniq++] = exps[i];
+   gn_vec_len(exps) = uniq;
+   for (size_t i = 0; i < nr; i++) {
+      const char **e = bsearch(&b.entries[i].expansion, exps, uniq, sizeof *exps,
+                               compare_strings);
+      b.entries[i].expansion_id = e - exps;
+   }
+
+   write_index(&b, exps, path);
+   gn_vec_free(exps);
+   gn_vec_free(b.entries);
+   gn_vec_free(b.arena);
+   gn_vec_free(b.names);
+   return 0;
+}
+
+/* Checks that a table of "nr" items of the given size fits at "pos". */
+static bool fits(const struct gni_file *f, size_t *pos, uint64_t nr, size_t size)
+{
+   if (nr > (f->size - *pos) / size)
+      return false;
+   *pos += nr * size;
+   return true;
+}
+
+int gni_open(struct gni_file *f, const char *path)
+{
+   *f = (struct gni_file){0};
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return -1;
+
+   struct stat st;
+   if (fstat(fd, &st)) {
+      close(fd);
+      return -1;
+   }
+   if ((size_t)st.st_size < HEADER_SIZE) {
+      close(fd);
+      errno = 0;
+      return -1;
+   }
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return -1;
+   /* Lookups jump around. */
+   posix_madvise(map, st.st_size, POSIX_MADV_RANDOM);
+
+   f->map = map;
+   f->size = st.st_size;
+
+   uint32_t version;
+   uint64_t counts[5];
+   memcpy(&version, &f->map[8], sizeof version);
+   memcpy(counts, &f->map[16], sizeof counts);
+   f->nr_acronyms = counts[0];
+   f->nr_expansions = counts[1];
+   f->nr_docs = counts[2];
+   f->nr_postings = counts[3];
+   f->strings_size = counts[4];
+
+   size_t pos = HEADER_SIZE;
+   f->acronyms = (const struct gni_acronym *)&f->map[pos];
+   bool ok = fits(f, &pos, f->nr_acronyms, sizeof *f->acronyms);
+   f->expansions = (const uint64_t *)&f->map[pos];
+   ok = ok && fits(f, &pos, f->nr_expansions, sizeof *f->expansions);
+   f->docs = (const uint64_t *)&f->map[pos];
+   ok = ok && fits(f, &pos, f->nr_docs, sizeof *f->docs);
+   f->postings = (const struct gni_posting *)&f->map[pos];
+   ok = ok && fits(f, &pos, f->nr_postings, sizeof *f->postings);
+   f->strings = (const char *)&f->map[pos];
+   ok = ok && fits(f, &pos, f->strings_size, 1);
+
+   if (memcmp(f->map, GNI_MAGIC, 8) || version != GNI_VERSION || !ok
+    || (f->strings_size && f->strings[f->strings_size - 1])) {
+      gni_close(f);
+      errno = 0;
+      return -1;
+   }
+   return 0;
+}
+
+void gni_close(struct gni_file *f)
+{
+   if (f->map)
+      munmap((void *)f->map, f->size);
+   *f = (struct gni_file){0};
+}
+
+static const char *string_at(const struct gni_file *f, uint64_t off)
+{
+   return off < f->strings_size ? &f->strings[off] : NULL;
+}
+
+long gni_find(const struct gni_file *f, const char *acronym,
+              const struct gni_posting **postings)
+{
+   size_t lo = 0, hi = f->nr_acronyms;
+   while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      const struct gni_acronym *a = &f->acronyms[mid];
+      const char *str = string_at(f, a->str);
+      if (!str)
+         return -1;
+      int ret = strcmp(acronym, str);
+      if (ret < 0) {
+         hi = mid;
+      } else if (ret > 0) {
+         lo = mid + 1;
+      } else {
+         if (a->first > f->nr_postings || a->count > f->nr_postings - a->first)
+            return -1;
+         *postings = &f->postings[a->first];
+         return a->count;
+      }
+   }
+   return 0;
+}
+
+const char *gni_expansion(const struct gni_file *f, uint32_t expansion)
+{
+   if (expansion >= f->nr_expansions)
+      return NULL;
+   return string_at(f, f->expansions[expansion]);
+}
+
+const char *gni_doc_name(const struct gni_file *f, uint32_t doc)
+{
+   if (doc >= f->nr_docs)
+      return NULL;
+   return string_at(f, f->docs[doc]);
+}
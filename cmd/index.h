@@ -0,0 +1,95 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+/* Acronym index.
+ *
+ * An index maps normalized acronyms to the places where they are defined. It
+ * is meant to be mapped in memory, so that a lookup only touches the few pages
+ * it needs: acronyms are found by binary search in a sorted table. As in the
+ * columnar format, all integers are little-endian, and all tables start on an
+ * 8 bytes boundary.
+ *
+ * A file starts with a 56 bytes header:
+ *
+ *    char magic[8]              GNI_MAGIC.
+ *    u32 version                GNI_VERSION.
+ *    u32 zero
+ *    u64 acronyms               Number of entries of each of the tables below.
+ *    u64 expansions
+ *    u64 docs
+ *    u64 postings
+ *    u64 strings_size           Size of the string heap, in bytes.
+ *
+ * followed by:
+ *
+ *    struct gni_acronym acronyms[acronyms]
+ *                               Sorted by acronym, in byte order.
+ *    u64 expansions[expansions] Heap offset of each expansion, by number.
+ *    u64 docs[docs]             Heap offset of the name of each document.
+ *    struct gni_posting postings[postings]
+ *                               The postings of each acronym follow each other,
+ *                               sorted by document, then by offset.
+ *    char strings[strings_size] String heap. Strings are nul-terminated.
+ *    padding                    Up to the next multiple of 8.
+ *
+ * Documents are numbered as in the binary output files the index is built
+ * from. When there are several such files, the documents of each file are
+ * numbered after those of the previous one.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "column.h"
+
+#define GNI_MAGIC "gnidx\0\r\n"
+#define GNI_VERSION 1
+
+struct gni_acronym {
+   uint64_t str;              /* Heap offset of the acronym. */
+   uint64_t first;            /* Number of its first posting. */
+   uint64_t count;            /* Number of postings. */
+};
+
+/* A definition of an acronym. */
+struct gni_posting {
+   uint32_t doc;
+   uint32_t expansion;        /* Number of the expansion. */
+   uint64_t offset;           /* Byte offset of the acronym in the document. */
+};
+
+/* Builds an index from binary output files. Returns -1 on error, after
+ * displaying a message.
+ */
+int gni_build(const char *path, char **inputs);
+
+/* Memory-mapped reader. */
+struct gni_file {
+   const uint8_t *map;
+   size_t size;
+   const struct gni_acronym *acronyms;
+   const uint64_t *expansions;
+   const uint64_t *docs;
+   const struct gni_posting *postings;
+   const char *strings;
+   uint64_t nr_acronyms, nr_expansions, nr_docs, nr_postings;
+   uint64_t strings_size;
+};
+
+/* Opens an index and checks its header. Returns 0 on success, -1 on failure,
+ * with errno set if the failure is caused by a system error, or cleared if the
+ * file is invalid.
+ */
+int gni_open(struct gni_file *, const char *path);
+void gni_close(struct gni_file *);
+
+/* Finds the postings of a normalized acronym. Returns their number, which is
+ * zero if the acronym is not in the index, or -1 if the index is corrupt.
+ */
+long gni_find(const struct gni_file *, const char *acronym,
+              const struct gni_posting **);
+
+/* Returns an expansion or a document name, or NULL if the index is corrupt. */
+const char *gni_expansion(const struct gni_file *, uint32_t expansion);
+const char *gni_doc_name(const struct gni_file *, uint32_t doc);
+
+#endif
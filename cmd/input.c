@@ -0,0 +1,494 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#include "cmd.h"
+#include "ring.h"
+#include "input.h"
+#include "../src/vec.h"
+
+/* Amount of compressed data read at once, and size of the decompressed blocks
+ * handed over to the reader.
+ */
+#define READ_SIZE (256 * 1024)
+#define BLOCK_SIZE (1 << 20)
+
+/* Number of blocks a decompression thread can produce ahead of the reader. */
+#define RING_SIZE 4
+
+/* Maximum number of threads decompressing Zstandard frames. */
+#define MAX_FRAME_THREADS 4
+
+/* A decompression thread. */
+struct decoder {
+   struct input *in;
+   thrd_t thread;
+   struct ring blocks;        /* Byte vectors, then NULL once finished. */
+   size_t first;              /* First frame to decompress. */
+   bool done;                 /* Whether the reader got NULL. */
+};
+
+struct input {
+   FILE *fp;
+   const char *name;
+
+   /* First bytes of the file, read for identifying its compression method.
+    * They must be returned before the rest.
+    */
+   unsigned char magic[4];
+   size_t magic_len, magic_pos;
+
+   /* Decompression threads, none if the input isn't compressed. With a
+    * single thread, all blocks are taken from it. With several, thread i
+    * decompresses frames i, i + n, i + 2n, etc., and frames are taken from
+    * each thread in turn, until the empty block that ends them.
+    */
+   struct decoder *decoders;
+   size_t nr_decoders;
+   size_t next;               /* Number of frames taken so far. */
+   char *block;               /* Block being read. */
+   size_t block_pos;
+   bool eof;
+
+   /* Mapped file, and offsets of its Zstandard frames, plus the file size. */
+   const uint8_t *map;
+   size_t map_size;
+   size_t *frames;
+   size_t nr_frames;
+
+   atomic_bool stop;
+   atomic_bool failed;
+};
+
+enum compression input_compression(const void *data, size_t len)
+{
+   const unsigned char *p = data;
+
+   if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+      return COMPRESSION_GZIP;
+   if (len >= 4 && !memcmp(p, "\x28\xb5\x2f\xfd", 4))
+      return COMPRESSION_ZSTD;
+   return COMPRESSION_NONE;
+}
+
+enum compression input_sniff(const char *path)
+{
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+      return COMPRESSION_NONE;
+
+   unsigned char magic[4];
+   ssize_t len = read(fd, magic, sizeof magic);
+   close(fd);
+   return len > 0 ? input_compression(magic, len) : COMPRESSION_NONE;
+}
+
+/* Reads data from the file, as is. */
+static size_t raw_read(struct input *in, void *buf, size_t len)
+{
+   size_t n = 0;
+
+   if (in->magic_pos < in->magic_len) {
+      n = in->magic_len - in->magic_pos;
+      if (n > len)
+         n = len;
+      memcpy(buf, &in->magic[in->magic_pos], n);
+      in->magic_pos += n;
+   }
+   if (n < len && !atomic_load(&in->failed)) {
+      n += fread((char *)buf + n, 1, len - n, in->fp);
+      if (n < len && ferror(in->fp)) {
+         complain("cannot read '%s':", in->name);
+         atomic_store(&in->failed, true);
+      }
+   }
+   return n;
+}
+
+static void fail(struct input *in, const char *msg)
+{
+   complain("cannot decompress '%s': %s", in->name, msg);
+   atomic_store(&in->failed, true);
+}
+
+static bool stopped(struct input *in)
+{
+   return atomic_load_explicit(&in->stop, memory_order_relaxed);
+}
+
+static char *new_block(void)
+{
+   char *block = GN_VEC_INIT;
+   gn_vec_grow(block, BLOCK_SIZE);
+   return block;
+}
+
+/* Hands over the last block, if not empty, and signals the end of the data. */
+static void finish(struct decoder *dec, char *block)
+{
+   if (gn_vec_len(block))
+      ring_push(&dec->blocks, block);
+   else
+      gn_vec_free(block);
+   ring_push(&dec->blocks, NULL);
+}
+
+static int gzip_main(void *arg)
+{
+   struct decoder *dec = arg;
+   struct input *in = dec->in;
+
+   z_stream zs = {0};
+   if (inflateInit2(&zs, 15 + 16) != Z_OK)
+      die("cannot initialize zlib");
+   unsigned char *src = malloc(READ_SIZE);
+   if (!src)
+      die("out of memory");
+
+   char *out = new_block();
+   int ret = Z_STREAM_END;
+   bool eof = false, full = false;
+   while (!stopped(in)) {
+      if (!zs.avail_in && !eof) {
+         zs.next_in = src;
+         zs.avail_in = raw_read(in, src, READ_SIZE);
+         eof = zs.avail_in < READ_SIZE;
+      }
+      /* A file can hold several members, one after the other. Pending output
+       * must be retrieved even if there is no more input.
+       */
+      if (ret == Z_STREAM_END) {
+         if (!zs.avail_in)
+            break;
+         inflateReset(&zs);
+      } else if (!zs.avail_in && !full) {
+         break;
+      }
+      zs.next_out = (Bytef *)&out[gn_vec_len(out)];
+      zs.avail_out = BLOCK_SIZE - gn_vec_len(out);
+      ret = inflate(&zs, Z_NO_FLUSH);
+      gn_vec_len(out) = BLOCK_SIZE - zs.avail_out;
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+         fail(in, zs.msg ? zs.msg : "invalid data");
+         break;
+      }
+      if ((full = !zs.avail_out)) {
+         ring_push(&dec->blocks, out);
+         out = new_block();
+      }
+   }
+   if (ret != Z_STREAM_END && !stopped(in) && !atomic_load(&in->failed))
+      fail(in, "unexpected end of data");
+
+   finish(dec, out);
+   inflateEnd(&zs);
+   free(src);
+   return 0;
+}
+
+#ifdef WITH_ZSTD
+
+/* Decompresses a Zstandard stream sequentially. */
+static int zstd_main(void *arg)
+{
+   struct decoder *dec = arg;
+   struct input *in = dec->in;
+
+   ZSTD_DStream *zs = ZSTD_createDStream();
+   unsigned char *src = malloc(READ_SIZE);
+   if (!zs || !src)
+      die("out of memory");
+   ZSTD_initDStream(zs);
+
+   char *out = new_block();
+   ZSTD_inBuffer inb = {src, 0, 0};
+   size_t ret = 0;
+   bool eof = false, full = false;
+   while (!stopped(in)) {
+      if (inb.pos == inb.size && !eof) {
+         inb.size = raw_read(in, src, READ_SIZE);
+         inb.pos = 0;
+         eof = inb.size < READ_SIZE;
+      }
+      /* Zero means we are between frames. */
+      if (inb.pos == inb.size && (!ret || !full))
+         break;
+      ZSTD_outBuffer outb = {out, BLOCK_SIZE, gn_vec_len(out)};
+      ret = ZSTD_decompressStream(zs, &outb, &inb);
+      gn_vec_len(out) = outb.pos;
+      if (ZSTD_isError(ret)) {
+         fail(in, ZSTD_getErrorName(ret));
+         break;
+      }
+      if ((full = outb.pos == BLOCK_SIZE)) {
+         ring_push(&dec->blocks, out);
+         out = new_block();
+      }
+   }
+   if (ret && !ZSTD_isError(ret) && !stopped(in) && !atomic_load(&in->failed))
+      fail(in, "unexpected end of data");
+
+   finish(dec, out);
+   ZSTD_freeDStream(zs);
+   free(src);
+   return 0;
+}
+
+/* Decompresses every nth frame of a mapped file. Frames are handed over in
+ * blocks, as for streams, followed by an empty block that marks their end.
+ */
+static int frames_main(void *arg)
+{
+   struct decoder *dec = arg;
+   struct input *in = dec->in;
+
+   ZSTD_DCtx *zs = ZSTD_createDCtx();
+   if (!zs)
+      die("out of memory");
+
+   for (size_t i = dec->first; i < in->nr_frames && !stopped(in); i += in->nr_decoders) {
+      ZSTD_inBuffer inb = {
+         .src = &in->map[in->frames[i]],
+         .size = in->frames[i + 1] - in->frames[i],
+      };
+      char *out = new_block();
+      size_t ret;
+      bool full;
+      do {
+         ZSTD_outBuffer outb = {out, BLOCK_SIZE, gn_vec_len(out)};
+         ret = ZSTD_decompressStream(zs, &outb, &inb);
+         gn_vec_len(out) = outb.pos;
+         if (ZSTD_isError(ret)) {
+            fail(in, ZSTD_getErrorName(ret));
+            break;
+         }
+         if ((full = outb.pos == BLOCK_SIZE)) {
+            ring_push(&dec->blocks, out);
+            out = new_block();
+         }
+      } while (ret && (inb.pos < inb.size || full) && !stopped(in));
+
+      if (ret && !ZSTD_isError(ret) && !stopped(in))
+         fail(in, "unexpected end of data");
+      if (atomic_load(&in->failed) || stopped(in)) {
+         gn_vec_free(out);
+         break;
+      }
+      if (gn_vec_len(out))
+         ring_push(&dec->blocks, out);
+      else
+         gn_vec_free(out);
+      ring_push(&dec->blocks, GN_VEC_INIT);
+   }
+   ring_push(&dec->blocks, NULL);
+   ZSTD_freeDCtx(zs);
+   return 0;
+}
+
+/* Maps a Zstandard file in memory and locates its frames. Returns whether the
+ * file can be decompressed in parallel.
+ */
+static bool map_frames(struct input *in)
+{
+   struct stat st;
+   if (in->fp == stdin || fstat(fileno(in->fp), &st) || !S_ISREG(st.st_mode))
+      return false;
+
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(in->fp), 0);
+   if (map == MAP_FAILED)
+      return false;
+   in->map = map;
+   in->map_size = st.st_size;
+
+   /* Frame headers are small, so this doesn't touch much of the file. The
+    * stream decoder reports errors if the frames are not valid.
+    */
+   size_t *frames = GN_VEC_INIT;
+   size_t pos = 0;
+   while (pos < in->map_size) {
+      size_t len = ZSTD_findFrameCompressedSize(&in->map[pos], in->map_size - pos);
+      if (ZSTD_isError(len))
+         break;
+      gn_vec_push(frames, pos);
+      pos += len;
+   }
+   gn_vec_push(frames, pos);
+
+   if (pos < in->map_size || gn_vec_len(frames) < 3) {
+      gn_vec_free(frames);
+      munmap(map, in->map_size);
+      in->map = NULL;
+      return false;
+   }
+   posix_madvise(map, in->map_size, POSIX_MADV_WILLNEED);
+   in->frames = frames;
+   in->nr_frames = gn_vec_len(frames) - 1;
+   return true;
+}
+
+#endif
+
+static void start_decoders(struct input *in, size_t n, thrd_start_t func)
+{
+   in->decoders = calloc(n, sizeof *in->decoders);
+   if (!in->decoders)
+      die("out of memory");
+   in->nr_decoders = n;
+
+   for (size_t i = 0; i < n; i++) {
+      struct decoder *dec = &in->decoders[i];
+      dec->in = in;
+      dec->first = i;
+      ring_init(&dec->blocks, RING_SIZE);
+      if (thrd_create(&dec->thread, func, dec) != thrd_success)
+         die("cannot create thread");
+   }
+}
+
+struct input *input_open(const char *path)
+{
+   struct input *in = calloc(1, sizeof *in);
+   if (!in)
+      die("out of memory");
+   in->fp = stdin;
+   in->name = "<stdin>";
+   in->block = GN_VEC_INIT;
+   atomic_init(&in->stop, false);
+   atomic_init(&in->failed, false);
+
+   if (path) {
+      in->name = path;
+      in->fp = fopen(path, "r");
+      if (!in->fp) {
+         complain("cannot open '%s':", path);
+         free(in);
+         return NULL;
+      }
+   }
+
+   in->magic_len = fread(in->magic, 1, sizeof in->magic, in->fp);
+   if (ferror(in->fp)) {
+      complain("cannot read '%s':", in->name);
+      input_close(in);
+      return NULL;
+   }
+
+   switch (input_compression(in->magic, in->magic_len)) {
+   case COMPRESSION_NONE:
+      break;
+   case COMPRESSION_GZIP:
+      start_decoders(in, 1, gzip_main);
+      break;
+   case COMPRESSION_ZSTD:
+#ifdef WITH_ZSTD
+      if (map_frames(in))
+         start_decoders(in, in->nr_frames < MAX_FRAME_THREADS ?
+                        in->nr_frames : MAX_FRAME_THREADS, frames_main);
+      else
+         start_decoders(in, 1, zstd_main);
+      break;
+#else
+      complain("cannot read '%s': Zstandard support is not compiled in", in->name);
+      input_close(in);
+      return NULL;
+#endif
+   }
+   return in;
+}
+
+size_t input_read(struct input *in, void *buf, size_t len)
+{
+   if (!in->nr_decoders)
+      return raw_read(in, buf, len);
+
+   size_t n = 0;
+   while (n < len && !in->eof) {
+      size_t avail = gn_vec_len(in->block) - in->block_pos;
+      if (!avail) {
+         struct decoder *dec = &in->decoders[in->next % in->nr_decoders];
+         gn_vec_free(in->block);
+         in->block = ring_pop(&dec->blocks);
+         in->block_pos = 0;
+         if (!in->block) {
+            in->block = GN_VEC_INIT;
+            dec->done = in->eof = true;
+         } else if (!gn_vec_len(in->block)) {
+            in->next++;
+         }
+         continue;
+      }
+      if (avail > len - n)
+         avail = len - n;
+      memcpy((char *)buf + n, &in->block[in->block_pos], avail);
+      in->block_pos += avail;
+      n += avail;
+   }
+   return n;
+}
+
+uint64_t input_skip(struct input *in, uint64_t len)
+{
+   char buf[64 * 1024];
+   uint64_t n = 0;
+
+   /* Seek past the data of regular uncompressed files, when it is there. */
+   struct stat st;
+   if (!in->nr_decoders && !fstat(fileno(in->fp), &st) && S_ISREG(st.st_mode)) {
+      n = in->magic_len - in->magic_pos;
+      if (n > len)
+         n = len;
+      in->magic_pos += n;
+      off_t pos = ftello(in->fp);
+      if (pos >= 0 && (uint64_t)(st.st_size - pos) >= len - n
+          && !fseeko(in->fp, len - n, SEEK_CUR))
+         return len;
+   }
+   while (n < len) {
+      size_t want = len - n < sizeof buf ? len - n : sizeof buf;
+      size_t got = input_read(in, buf, want);
+      n += got;
+      if (got < want)
+         break;
+   }
+   return n;
+}
+
+bool input_error(const struct input *in)
+{
+   return atomic_load(&((struct input *)in)->failed);
+}
+
+void input_close(struct input *in)
+{
+   /* Threads might be waiting for room to hand over blocks. */
+   atomic_store(&in->stop, true);
+   for (size_t i = 0; i < in->nr_decoders; i++) {
+      struct decoder *dec = &in->decoders[i];
+      char *block;
+      while (!dec->done && (block = ring_pop(&dec->blocks)))
+         gn_vec_free(block);
+      thrd_join(dec->thread, NULL);
+      ring_fini(&dec->blocks);
+   }
+   free(in->decoders);
+   gn_vec_free(in->block);
+
+   if (in->map) {
+      munmap((void *)in->map, in->map_size);
+      gn_vec_free(in->frames);
+   }
+   if (in->fp != stdin)
+      fclose(in->fp);
+   free(in);
+}
@@ -0,0 +1,50 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Input files, transparently decompressed.
+ *
+ * Compressed files are recognized from their first bytes, whatever their name.
+ * They are decompressed on a separate thread, ahead of the reader, so that
+ * decompression overlaps with processing. Zstandard files made of several
+ * frames, as produced by pzstd or the seekable format, have their frames
+ * decompressed in parallel when they are regular files.
+ */
+enum compression {
+   COMPRESSION_NONE,
+   COMPRESSION_GZIP,
+   COMPRESSION_ZSTD,
+};
+
+/* Identifies the compression method of some data from its first bytes. */
+enum compression input_compression(const void *data, size_t len);
+
+/* Same, for a file. Returns COMPRESSION_NONE if the file can't be read. */
+enum compression input_sniff(const char *path);
+
+struct input;
+
+/* Opens a file, or the standard input if path is NULL. Returns NULL on error,
+ * after displaying a message.
+ */
+struct input *input_open(const char *path);
+
+/* Reads decompressed data. Returns the number of bytes read, which is less
+ * than requested only at the end of the input, or on error.
+ */
+size_t input_read(struct input *, void *buf, size_t len);
+
+/* Skips data. Returns the number of bytes skipped, which is less than
+ * requested only at the end of the input, or on error.
+ */
+uint64_t input_skip(struct input *, uint64_t len);
+
+/* Whether a read error occurred. A message is displayed when it does. */
+bool input_error(const struct input *);
+
+void input_close(struct input *);
+
+#endif
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include "cmd.h"
+#include "index.h"
+#include "../src/vec.h"
+
+void cmd_index(int argc, char **argv)
+{
+   struct option opts[] = {
+      {0},
+   };
+   const char help[] =
+      #include "index.ih"
+   ;
+   parse_options(opts, help, &argc, &argv);
+   if (argc < 2)
+      die("no index or no input file given");
+
+   if (gni_build(argv[0], &argv[1]))
+      exit(EXIT_FAILURE);
+   exit(EXIT_SUCCESS);
+}
+
+/* Removes periods, as is done for acronyms found in text. */
+static void normalize(char *acronym)
+{
+   char *out = acronym;
+   for (const char *in = acronym; *in; in++)
+      if (*in != '.')
+         *out++ = *in;
+   *out = '\0';
+}
+
+struct expansion_count {
+   uint32_t expansion;
+   size_t count;
+};
+
+static int compare_counts(const void *a, const void *b)
+{
+   const struct expansion_count *x = a, *y = b;
+   if (x->count != y->count)
+      return x->count > y->count ? -1 : 1;
+   return x->expansion < y->expansion ? -1 : x->expansion > y->expansion;
+}
+
+static int display_postings(const struct gni_file *f, const char *acronym,
+                            const struct gni_posting *p, size_t nr)
+{
+   for (size_t i = 0; i < nr; i++) {
+      const char *exp = gni_expansion(f, p[i].expansion);
+      const char *name = gni_doc_name(f, p[i].doc);
+      if (!exp || !name)
+         return -1;
+      printf("%s\t%s\t%s\t%"PRIu64"\n", acronym, exp, name, p[i].offset);
+   }
+   return 0;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+   uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+   return x < y ? -1 : x > y;
+}
+
+static int display_expansions(const struct gni_file *f, const char *acronym,
+                              const struct gni_posting *p, size_t nr)
+{
+   /* Expansion numbers are sorted, so that those of each expansion follow
+    * each other.
+    */
+   uint32_t *ids = malloc(nr * sizeof *ids);
+   if (!ids)
+      die("out of memory");
+   for (size_t i = 0; i < nr; i++)
+      ids[i] = p[i].expansion;
+   qsort(ids, nr, sizeof *ids, compare_ids);
+
+   struct expansion_count *counts = GN_VEC_INIT;
+   for (size_t i = 0, j; i < nr; i = j) {
+      for (j = i + 1; j < nr && ids[j] == ids[i]; j++)
+         ;
+      gn_vec_push(counts, ((struct expansion_count){ids[i], j - i}));
+   }
+   free(ids);
+   qsort(counts, gn_vec_len(counts), sizeof *counts, compare_counts);
+
+   int ret = 0;
+   for (size_t i = 0; i < gn_vec_len(counts); i++) {
+      const char *exp = gni_expansion(f, counts[i].expansion);
+      if (!exp) {
+         ret = -1;
+         break;
+      }
+      printf("%zu\t%s\t%s\n", counts[i].count, acronym, exp);
+   }
+   gn_vec_free(counts);
+   return ret;
+}
+
+void cmd_lookup(int argc, char **argv)
+{
+   bool expansions = false;
+   struct option opts[] = {
+      {'e', "expansions", OPT_BOOL(expansions)},
+      {0},
+   };
+   const char help[] =
+      #include "lookup.ih"
+   ;
+   parse_options(opts, help, &argc, &argv);
+   if (argc < 2)
+      die("no index or no acronym given");
+
+   struct gni_file f;
+   if (gni_open(&f, argv[0])) {
+      if (errno)
+         die("cannot open '%s':", argv[0]);
+      die("'%s' is not an index", argv[0]);
+   }
+
+   int ret = EXIT_SUCCESS;
+   for (int i = 1; i < argc; i++) {
+      char *acronym = argv[i];
+      normalize(acronym);
+
+      const struct gni_posting *p;
+      long nr = gni_find(&f, acronym, &p);
+      if (nr > 0) {
+         if (expansions)
+            nr = display_expansions(&f, acronym, p, nr);
+         else
+            nr = display_postings(&f, acronym, p, nr);
+      }
+      if (nr < 0) {
+         complain("index '%s' is corrupt", argv[0]);
+         ret = EXIT_FAILURE;
+         break;
+      }
+   }
+   gni_close(&f);
+   exit(ret);
+}
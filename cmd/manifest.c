@@ -0,0 +1,282 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cmd.h"
+#include "hash.h"
+#include "manifest.h"
+#include "store.h"
+#include "../src/vec.h"
+
+#define SIGNATURE "gourgandine-manifest"
+
+struct manifest_entry {
+   char *input;
+   uint64_t hash;
+   size_t segment;
+   uint64_t offset, len;      /* Location of the output in the segment. */
+   size_t first_doc, docs;    /* Document numbers in the stored output. */
+};
+
+struct manifest {
+   char *path;
+   enum format format;
+   uint64_t options;
+   struct manifest_entry *prev;     /* Entries of the previous run, sorted. */
+   struct manifest_entry *cur;      /* Entries of this run. */
+
+   /* Segment of this run, opened when something is written. */
+   size_t segment;
+   FILE *fp;
+   uint64_t written;
+
+   /* Input being written. */
+   struct manifest_entry part;
+   bool partial;
+   bool failed;
+
+   /* Segment being read, for reusing output. */
+   int read_fd;
+   size_t read_segment;
+};
+
+/* Parses a line of the manifest, without its newline. */
+static int parse_line(void *arg, char *line, size_t line_no)
+{
+   struct manifest *m = arg;
+   if (line_no == 1) {
+      char fmt[16];
+      uint64_t options;
+      if (sscanf(line, SIGNATURE " %15s %" SCNx64 " %zu", fmt, &options,
+                 &m->segment) != 3)
+         die("'%s' is not a manifest", m->path);
+      if ((int)m->format != output_format(fmt) || options != m->options) {
+         complain("'%s' was made with other options, all inputs will be processed", m->path);
+         return 1;
+      }
+      return 0;
+   }
+
+   uint64_t hash, f[5];
+   char *p = parse_fields(line, &hash, 1, 16);
+   char *input = p ? parse_fields(p, f, 5, 10) : NULL;
+   if (!input || f[0] >= m->segment)
+      return -1;
+   struct manifest_entry e = {
+      .input = strdup(input),
+      .hash = hash,
+      .segment = f[0],
+      .offset = f[1],
+      .len = f[2],
+      .first_doc = f[3],
+      .docs = f[4],
+   };
+   if (!e.input)
+      die("out of memory");
+   gn_vec_push(m->prev, e);
+   return 0;
+}
+
+struct manifest *manifest_open(const char *path, enum format fmt, uint64_t options)
+{
+   struct manifest *m = calloc(1, sizeof *m);
+   if (!m)
+      die("out of memory");
+   m->path = strdup(path);
+   if (!m->path)
+      die("out of memory");
+   m->format = fmt;
+   m->options = options;
+   m->prev = GN_VEC_INIT;
+   m->cur = GN_VEC_INIT;
+   m->read_fd = -1;
+
+   FILE *fp = fopen(path, "r");
+   if (fp) {
+      read_index(path, fp, parse_line, m);
+      qsort(m->prev, gn_vec_len(m->prev), sizeof *m->prev, compare_inputs);
+      fclose(fp);
+   } else if (errno != ENOENT) {
+      die("cannot open '%s':", path);
+   }
+   return m;
+}
+
+int manifest_hash_file(const char *path, uint64_t *hash)
+{
+   FILE *fp = fopen(path, "rb");
+   if (!fp) {
+      complain("cannot open '%s':", path);
+      return -1;
+   }
+   size_t size = 256 * 1024;
+   char *buf = malloc(size);
+   if (!buf)
+      die("out of memory");
+   struct hash h;
+   hash_init(&h, 0);
+   size_t len;
+   while ((len = fread(buf, 1, size, fp)))
+      hash_update(&h, buf, len);
+   int ret = 0;
+   if (ferror(fp)) {
+      complain("cannot read '%s':", path);
+      ret = -1;
+   }
+   fclose(fp);
+   free(buf);
+   *hash = hash_final(&h);
+   return ret;
+}
+
+const struct manifest_entry *manifest_find(const struct manifest *m,
+                                           const char *input, uint64_t hash)
+{
+   struct manifest_entry key = {.input = (char *)input};
+   const struct manifest_entry *e = bsearch(&key, m->prev, gn_vec_len(m->prev),
+                                            sizeof key, compare_inputs);
+   return e && e->hash == hash ? e : NULL;
+}
+
+size_t manifest_docs(const struct manifest_entry *e)
+{
+   return e->docs;
+}
+
+static void add_entry(struct manifest *m, const struct manifest_entry *e)
+{
+   if (strchr(e->input, '\n'))
+      die("cannot add '%s' to the manifest: its name contains a newline", e->input);
+   struct manifest_entry copy = *e;
+   if (!(copy.input = strdup(e->input)))
+      die("out of memory");
+   gn_vec_push(m->cur, copy);
+}
+
+void manifest_reuse(struct manifest *m, const struct manifest_entry *e,
+                    size_t first_doc, char **out)
+{
+   if (m->read_fd < 0 || m->read_segment != e->segment) {
+      if (m->read_fd >= 0)
+         close(m->read_fd);
+      char *path = segment_path(m->path, e->segment, false);
+      if ((m->read_fd = open(path, O_RDONLY)) < 0)
+         die("cannot open '%s':", path);
+      free(path);
+      m->read_segment = e->segment;
+   }
+
+   char *buf = *out;
+   size_t start = gn_vec_len(buf);
+   gn_vec_grow(buf, e->len);
+   for (uint64_t n = 0; n < e->len; ) {
+      ssize_t r = pread(m->read_fd, &buf[start + n], e->len - n, e->offset + n);
+      if (r <= 0)
+         die("cannot read segment %zu of '%s'%s", e->segment, m->path,
+             r ? ":" : ": unexpected end of file");
+      n += r;
+   }
+   gn_vec_len(buf) += e->len;
+   if (m->format == FORMAT_BINARY && first_doc != e->first_doc)
+      gnc_renumber(&buf[start], e->len, (uint32_t)(first_doc - e->first_doc));
+   *out = buf;
+   add_entry(m, e);
+}
+
+void manifest_write(struct manifest *m, const char *input, uint64_t hash,
+                    size_t first_doc, size_t end_doc, const char *data,
+                    size_t len, bool last, bool failed)
+{
+   /* The previous input was interrupted by an error. */
+   if (m->partial && strcmp(m->part.input, input))
+      m->partial = false;
+   if (!m->partial) {
+      m->part = (struct manifest_entry){
+         .input = (char *)input,
+         .hash = hash,
+         .segment = m->segment,
+         .offset = m->written,
+         .first_doc = first_doc,
+      };
+      m->partial = true;
+      m->failed = false;
+   }
+
+   if (len) {
+      if (!m->fp) {
+         char *tmp = segment_path(m->path, m->segment, true);
+         if (!(m->fp = fopen(tmp, "w")))
+            die("cannot open '%s':", tmp);
+         free(tmp);
+      }
+      if (fwrite(data, 1, len, m->fp) != len)
+         die("cannot write segment %zu of '%s':", m->segment, m->path);
+      m->written += len;
+   }
+   m->failed |= failed;
+
+   if (last) {
+      m->part.len = m->written - m->part.offset;
+      m->part.docs = end_doc - m->part.first_doc;
+      if (!m->failed)
+         add_entry(m, &m->part);
+      m->partial = false;
+   }
+}
+
+void manifest_close(struct manifest *m)
+{
+   /* Segments are committed before the manifest that refers to them. */
+   if (m->fp) {
+      char *tmp = segment_path(m->path, m->segment, true);
+      char *path = segment_path(m->path, m->segment, false);
+      commit_file(m->fp, tmp, path);
+      free(tmp);
+      free(path);
+   }
+   if (m->read_fd >= 0)
+      close(m->read_fd);
+
+   char *tmp = format_path("%s.tmp", m->path);
+   FILE *fp = fopen(tmp, "w");
+   if (!fp)
+      die("cannot open '%s':", tmp);
+   fprintf(fp, SIGNATURE " %s %016" PRIx64 " %zu\n",
+           m->format == FORMAT_BINARY ? "binary" : "tsv", m->options,
+           m->segment + 1);
+   bool *used = calloc(m->segment + 1, sizeof *used);
+   if (!used)
+      die("out of memory");
+   for (size_t i = 0; i < gn_vec_len(m->cur); i++) {
+      const struct manifest_entry *e = &m->cur[i];
+      fprintf(fp, "%016" PRIx64 " %zu %" PRIu64 " %" PRIu64 " %zu %zu %s\n",
+              e->hash, e->segment, e->offset, e->len, e->first_doc, e->docs,
+              e->input);
+      used[e->segment] = true;
+   }
+   commit_file(fp, tmp, m->path);
+   free(tmp);
+
+   for (size_t i = 0; i <= m->segment; i++) {
+      if (used[i])
+         continue;
+      char *path = segment_path(m->path, i, false);
+      if (unlink(path) && errno != ENOENT)
+         complain("cannot remove '%s':", path);
+      free(path);
+   }
+   free(used);
+
+   for (size_t i = 0; i < gn_vec_len(m->prev); i++)
+      free(m->prev[i].input);
+   for (size_t i = 0; i < gn_vec_len(m->cur); i++)
+      free(m->cur[i].input);
+   gn_vec_free(m->prev);
+   gn_vec_free(m->cur);
+   free(m->path);
+   free(m);
+}
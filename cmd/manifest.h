@@ -0,0 +1,66 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "output.h"
+
+/* Manifests, for incremental runs.
+ *
+ * A manifest FILE records, for each input, a hash of its contents, and where
+ * its output is stored. Each run stores the output of the inputs it processes
+ * in a new segment FILE.N. The output of inputs that didn't change since the
+ * previous run is read back from the segment that holds it instead of being
+ * computed again. Segments that are no longer referenced are removed when the
+ * manifest is updated, at the end of the run.
+ *
+ * As with checkpoints, inputs are identified by their path, so successive runs
+ * must be made from the same directory.
+ */
+struct manifest;
+struct manifest_entry;
+
+/* Opens a manifest, or creates it if it doesn't exist. The output format and
+ * a hash of the options that affect the output must be provided: if they
+ * changed since the previous run, all inputs are processed again. Dies on
+ * failure.
+ */
+struct manifest *manifest_open(const char *path, enum format, uint64_t options);
+
+/* Hashes the contents of a file. Returns -1 on error, after displaying a
+ * message.
+ */
+int manifest_hash_file(const char *path, uint64_t *hash);
+
+/* Returns the entry of an input if it has the provided hash, NULL otherwise.
+ * Can be called from any thread.
+ */
+const struct manifest_entry *manifest_find(const struct manifest *,
+                                           const char *input, uint64_t hash);
+
+/* Number of documents (files or records) in an input. */
+size_t manifest_docs(const struct manifest_entry *);
+
+/* Appends the stored output of an unchanged input to a byte vector, with its
+ * documents numbered from "first_doc", and carries its entry over to the new
+ * manifest. Dies on failure.
+ */
+void manifest_reuse(struct manifest *, const struct manifest_entry *,
+                    size_t first_doc, char **out);
+
+/* Stores the output of a part of an input, holding the documents "first_doc"
+ * to "end_doc", excluded. Parts of an input must be stored in order. The input
+ * is added to the manifest with its last part, unless some part failed, in
+ * which case it will be processed again on the next run. Dies on failure.
+ */
+void manifest_write(struct manifest *, const char *input, uint64_t hash,
+                    size_t first_doc, size_t end_doc, const char *data,
+                    size_t len, bool last, bool failed);
+
+/* Commits the new segment, updates the manifest, removes unused segments, and
+ * releases resources. Dies on failure.
+ */
+void manifest_close(struct manifest *);
+
+#endif
@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "cmd.h"
+#include "runs.h"
+
+void cmd_merge(int argc, char **argv)
+{
+   bool doc_freq = false;
+   size_t memory = 0;
+   const char *temp_dir = getenv("TMPDIR");
+   const char *output = NULL;
+   struct option opts[] = {
+      {'\0', "doc-freq", OPT_BOOL(doc_freq)},
+      {'\0', "memory", OPT_SIZE_T(memory)},
+      {'\0', "temp-dir", OPT_STR(temp_dir)},
+      {'o', "output", OPT_STR(output)},
+      {0},
+   };
+   const char help[] =
+      #include "merge.ih"
+   ;
+   parse_options(opts, help, &argc, &argv);
+   if (!argc)
+      die("no input file given");
+
+   struct runs *runs = runs_new(temp_dir && *temp_dir ? temp_dir : "/tmp", memory);
+   while (*argv)
+      runs_add(runs, *argv++);
+
+   /* Counts made separately are about distinct documents. */
+   if (output) {
+      FILE *fp = fopen(output, "w");
+      if (!fp)
+         die("cannot open '%s':", output);
+      runs_save(runs, false, fp);
+      if (fclose(fp))
+         die("cannot write '%s':", output);
+   } else {
+      runs_write(runs, false, doc_freq, stdout);
+   }
+   runs_free(runs);
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,185 @@
+#include <string.h>
+#include "output.h"
+#include "../gourgandine.h"
+#include "../src/vec.h"
+#include "../src/lib/mascara.h"
+
+int output_format(const char *name)
+{
+   if (!strcmp(name, "tsv"))
+      return FORMAT_TSV;
+   if (!strcmp(name, "binary"))
+      return FORMAT_BINARY;
+   return -1;
+}
+
+void output_init(struct output *out, enum format fmt)
+{
+   *out = (struct output){
+      .format = fmt,
+      .buf = GN_VEC_INIT,
+   };
+   if (fmt == FORMAT_BINARY)
+      gnc_init(&out->gnc);
+}
+
+void output_fini(struct output *out)
+{
+   if (out->format == FORMAT_BINARY)
+      gnc_fini(&out->gnc);
+   gn_vec_free(out->buf);
+}
+
+void output_header(enum format fmt, FILE *fp)
+{
+   if (fmt != FORMAT_BINARY)
+      return;
+   char *buf = GN_VEC_INIT;
+   gnc_header(&buf);
+   fwrite(buf, 1, gn_vec_len(buf), fp);
+   gn_vec_free(buf);
+}
+
+void output_trailer(enum format fmt, FILE *fp)
+{
+   if (fmt != FORMAT_BINARY)
+      return;
+   char *buf = GN_VEC_INIT;
+   gnc_trailer(&buf);
+   fwrite(buf, 1, gn_vec_len(buf), fp);
+   gn_vec_free(buf);
+}
+
+static void append(char **vec, const char *str, size_t len)
+{
+   char *buf = *vec;
+   gn_vec_grow(buf, len);
+   memcpy(&buf[gn_vec_len(buf)], str, len);
+   gn_vec_len(buf) += len;
+   *vec = buf;
+}
+
+static void add_prefix(struct output *out, const struct document *doc,
+                       size_t sent_no)
+{
+   if (out->names) {
+      append(&out->buf, doc->name, strlen(doc->name));
+      append(&out->buf, "\t", 1);
+   }
+   if (out->line_numbers) {
+      char num[32];
+      int len = snprintf(num, sizeof num, "%zu\t", sent_no + 1);
+      append(&out->buf, num, len);
+   }
+}
+
+static void add_tsv(struct output *out, const struct document *doc,
+                    size_t sent_no, const struct gn_acronym *def)
+{
+   add_prefix(out, doc, sent_no);
+   append(&out->buf, def->acronym, def->acronym_len);
+   append(&out->buf, "\t", 1);
+   append(&out->buf, def->expansion, def->expansion_len);
+   append(&out->buf, "\n", 1);
+}
+
+static void add_binary(struct output *out, const struct document *doc,
+                       size_t sent_no, const struct mr_token *sent,
+                       const struct gn_acronym *def)
+{
+   const struct mr_token *acr_last = &sent[def->acronym_end - 1];
+   const struct mr_token *exp_last = &sent[def->expansion_end - 1];
+
+   struct gnc_row row = {
+      .col64 = {
+         [GNC_ACRONYM_BYTE_START] = sent[def->acronym_start].offset,
+         [GNC_ACRONYM_BYTE_END] = acr_last->offset + acr_last->len,
+         [GNC_EXPANSION_BYTE_START] = sent[def->expansion_start].offset,
+         [GNC_EXPANSION_BYTE_END] = exp_last->offset + exp_last->len,
+      },
+      .col32 = {
+         [GNC_DOC] = doc->id,
+         [GNC_SENTENCE] = sent_no,
+         [GNC_ACRONYM_START] = def->acronym_start,
+         [GNC_ACRONYM_END] = def->acronym_end,
+         [GNC_EXPANSION_START] = def->expansion_start,
+         [GNC_EXPANSION_END] = def->expansion_end,
+      },
+      .acronym = def->acronym,
+      .expansion = def->expansion,
+      .name = doc->name,
+   };
+   gnc_add(&out->gnc, &row, &out->buf);
+}
+
+void output_add(struct output *out, const struct document *doc, size_t sent_no,
+                const struct mr_token *sent, const struct gn_acronym *def)
+{
+   switch (out->format) {
+   case FORMAT_TSV:
+      add_tsv(out, doc, sent_no, def);
+      break;
+   case FORMAT_BINARY:
+      add_binary(out, doc, sent_no, sent, def);
+      break;
+   }
+}
+
+void output_use(struct output *out, const struct document *doc, size_t sent_no,
+                const struct mr_token *sent, const struct gn_use *use)
+{
+   add_prefix(out, doc, sent_no);
+   append(&out->buf, use->acronym, use->acronym_len);
+   append(&out->buf, "\t", 1);
+   append(&out->buf, use->expansion, use->expansion_len);
+   char num[32];
+   int len = snprintf(num, sizeof num, "\t%zu", sent[use->start].offset);
+   append(&out->buf, num, len);
+   if (out->sources)
+      append(&out->buf, use->known ? "\tdict" : "\ttext", 5);
+   append(&out->buf, "\n", 1);
+}
+
+int output_drain(struct output *out, FILE *fp)
+{
+   size_t len = gn_vec_len(out->buf);
+   gn_vec_clear(out->buf);
+   return fwrite(out->buf, 1, len, fp) == len ? 0 : -1;
+}
+
+int output_flush(struct output *out, FILE *fp)
+{
+   if (out->format == FORMAT_BINARY)
+      gnc_flush(&out->gnc, &out->buf);
+   return output_drain(out, fp);
+}
+
+char *output_take(struct output *out)
+{
+   if (out->format == FORMAT_BINARY)
+      gnc_flush(&out->gnc, &out->buf);
+
+   char *buf = out->buf;
+   out->buf = GN_VEC_INIT;
+   return buf;
+}
+
+int output_counts(const struct gn_count *c, size_t nr, bool docs, FILE *fp)
+{
+   for (size_t i = 0; i < nr; i++) {
+      if (docs)
+         fprintf(fp, "%zu\t%zu\t%s\t%s\n", c[i].freq, c[i].docs, c[i].acronym,
+                 c[i].expansion);
+      else
+         fprintf(fp, "%zu\t%s\t%s\n", c[i].freq, c[i].acronym, c[i].expansion);
+   }
+   return ferror(fp) ? -1 : 0;
+}
+
+int output_top(const struct gn_count *c, size_t nr, FILE *fp)
+{
+   for (size_t i = 0; i < nr; i++)
+      fprintf(fp, "%zu\t%zu\t%s\t%s\n", c[i].freq, c[i].error, c[i].acronym,
+              c[i].expansion);
+   return ferror(fp) ? -1 : 0;
+}
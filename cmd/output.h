@@ -0,0 +1,83 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "column.h"
+
+struct mr_token;
+struct gn_acronym;
+struct gn_count;
+struct gn_use;
+
+enum format {
+   FORMAT_TSV,       /* acronym TAB expansion */
+   FORMAT_BINARY,    /* See column.h. */
+};
+
+/* Parses a format name. Returns -1 if the name is invalid. */
+int output_format(const char *name);
+
+/* Formatted output, accumulated in memory. */
+struct output {
+   enum format format;
+   bool names;                /* Whether TSV rows start with the document name. */
+   bool line_numbers;         /* Whether they then hold the sentence number,
+                               * from 1, which is a line number in line mode. */
+   bool sources;              /* Whether rows of uses end with the source of
+                               * the expansion. */
+   char *buf;                 /* Byte vector. */
+   struct gnc_writer gnc;
+};
+
+/* A document being processed. */
+struct document {
+   size_t id;
+   const char *name;
+};
+
+void output_init(struct output *, enum format);
+void output_fini(struct output *);
+
+/* Writes what must precede or follow the output of all documents. */
+void output_header(enum format, FILE *);
+void output_trailer(enum format, FILE *);
+
+/* Adds an acronym definition found in the sentence number "sent_no" of a
+ * document.
+ */
+void output_add(struct output *, const struct document *, size_t sent_no,
+                const struct mr_token *sent, const struct gn_acronym *);
+
+/* Adds a use of an acronym defined earlier in a document, as a TSV row of the
+ * form: acronym TAB expansion TAB byte offset, preceded by the document name
+ * and the sentence number, as for definitions, and followed by "text" or
+ * "dict", depending on where the expansion comes from, if sources are written.
+ * Binary output is not supported.
+ */
+void output_use(struct output *, const struct document *, size_t sent_no,
+                const struct mr_token *sent, const struct gn_use *);
+
+/* Completes any pending data and moves the output buffer to a file. */
+int output_flush(struct output *, FILE *);
+
+/* Writes the data that is complete to a file, keeping pending rows. */
+int output_drain(struct output *, FILE *);
+
+/* Completes any pending data and returns the output buffer, which must then be
+ * released with gn_vec_free(). A new buffer is used for subsequent output.
+ */
+char *output_take(struct output *);
+
+/* Writes counted definitions, as sorted by gn_counter_sort(), as TSV rows:
+ * frequency [TAB documents] TAB acronym TAB expansion.
+ */
+int output_counts(const struct gn_count *, size_t nr, bool docs, FILE *);
+
+/* Writes approximate counts, as sorted by gn_topk_sort(), as TSV rows:
+ * frequency TAB error TAB acronym TAB expansion. The frequency is an upper
+ * bound, and the frequency minus the error a lower bound.
+ */
+int output_top(const struct gn_count *, size_t nr, FILE *);
+
+#endif
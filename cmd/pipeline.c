@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include "cmd.h"
+#include "ring.h"
+#include "chunk.h"
+#include "input.h"
+#include "extract.h"
+#include "pipeline.h"
+#include "walk.h"
+
+#define local static
+#include "../gourgandine.h"
+#include "../src/vec.h"
+#include "../src/lib/mascara.h"
+
+/* Size of the parts documents are cut into, and number of parts that can be
+ * in flight between two stages.
+ */
+#define PIECE_SIZE (1 << 20)
+#define RING_SIZE 8
+
+/* A normalized part of a document, and the sentences found in it. */
+struct piece {
+   struct document doc;
+   bool first;                /* Whether this is the first part of the file. */
+   char *text;
+   size_t len;
+   struct mr_token *tokens;   /* Tokens of all sentences, back to back. */
+   size_t *ends;              /* End of each sentence in the token array. */
+};
+
+struct pipeline {
+   const struct config *cfg;
+   char **paths;
+   struct walk *walk;         /* Owns the document names. */
+   struct ring texts;         /* Reader -> tokenizer. */
+   struct ring sentences;     /* Tokenizer -> matcher. */
+   atomic_bool failed;
+};
+
+static void free_piece(struct piece *p)
+{
+   free(p->text);
+   gn_vec_free(p->tokens);
+   gn_vec_free(p->ends);
+   free(p);
+}
+
+static int read_stream(struct pipeline *pl, const struct document *doc,
+                       const char *path)
+{
+   struct input *in = input_open(path);
+   if (!in)
+      return -1;
+
+   struct chunker chk;
+   chunker_init(&chk, in, PIECE_SIZE, pl->cfg->separator);
+
+   int ret;
+   char *chunk;
+   bool first = true;
+   while ((ret = chunker_next(&chk, &chunk)) > 0) {
+      size_t len;
+      char *text = normalize(doc->name, (uint8_t *)chunk, gn_vec_len(chunk), &len);
+      gn_vec_free(chunk);
+      if (!text) {
+         ret = -1;
+         break;
+      }
+      struct piece *p = malloc(sizeof *p);
+      if (!p)
+         die("out of memory");
+      *p = (struct piece){
+         .doc = *doc,
+         .first = first,
+         .text = text,
+         .len = len,
+         .tokens = GN_VEC_INIT,
+         .ends = GN_VEC_INIT,
+      };
+      ring_push(&pl->texts, p);
+      first = false;
+   }
+   chunker_fini(&chk);
+   input_close(in);
+   return ret;
+}
+
+static int reader_main(void *arg)
+{
+   struct pipeline *pl = arg;
+
+   if (!*pl->paths) {
+      struct document doc = {.name = "<stdin>"};
+      if (read_stream(pl, &doc, NULL))
+         atomic_store(&pl->failed, true);
+   }
+   const char *path;
+   for (size_t i = 0; (path = walk_next(pl->walk)); i++) {
+      struct document doc = {.id = i, .name = path};
+      if (read_stream(pl, &doc, path))
+         atomic_store(&pl->failed, true);
+   }
+   ring_push(&pl->texts, NULL);
+   return 0;
+}
+
+/* Adds the sentences of a part of a piece to it. */
+static void tokenize(struct mascara *mr, struct piece *p, const char *str,
+                     size_t len)
+{
+   mr_set_text(mr, str, len);
+   struct mr_token *sent;
+   while ((len = mr_next(mr, &sent))) {
+      gn_vec_grow(p->tokens, len);
+      memcpy(&p->tokens[gn_vec_len(p->tokens)], sent, len * sizeof *sent);
+      gn_vec_len(p->tokens) += len;
+      gn_vec_push(p->ends, gn_vec_len(p->tokens));
+   }
+}
+
+static int tokenizer_main(void *arg)
+{
+   struct pipeline *pl = arg;
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, pl->cfg->lang, MR_SENTENCE);
+   if (ret)
+      die("cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct piece *p;
+   while ((p = ring_pop(&pl->texts))) {
+      if (!pl->cfg->lazy) {
+         tokenize(mr, p, p->text, p->len);
+      } else {
+         size_t start, end = 0;
+         while (next_lazy_window(p->text, p->len, pl->cfg->separator,
+                                 &start, &end))
+            tokenize(mr, p, &p->text[start], end - start);
+      }
+      ring_push(&pl->sentences, p);
+   }
+   ring_push(&pl->sentences, NULL);
+   mr_dealloc(mr);
+   return 0;
+}
+
+static void match(struct pipeline *pl, FILE *fp)
+{
+   struct gourgandine *gn = gn_alloc();
+   gn_set_dict(gn, pl->cfg->dict);
+   struct gn_cache *cache = NULL;
+   if (pl->cfg->cache_size)
+      cache = gn_cache_alloc(pl->cfg->cache_size);
+   struct output out;
+   output_init(&out, pl->cfg->format);
+
+   /* Position of the current piece in its document. */
+   uint64_t text_pos = 0;
+   size_t sentence_pos = 0;
+
+   struct piece *p;
+   while ((p = ring_pop(&pl->sentences))) {
+      if (p->first)
+         text_pos = sentence_pos = 0;
+
+      size_t nr = gn_vec_len(p->ends);
+      for (size_t i = 0, start = 0; i < nr; start = p->ends[i++]) {
+         const struct mr_token *sent = &p->tokens[start];
+         size_t len = p->ends[i] - start;
+         if (cache) {
+            const struct gn_acronym *defs;
+            size_t n = gn_cache_search(cache, gn, sent, len, &defs);
+            for (size_t j = 0; j < n; j++)
+               output_add(&out, &p->doc, i, sent, &defs[j]);
+         } else {
+            struct gn_acronym def = {0};
+            while (gn_search(gn, sent, len, &def))
+               output_add(&out, &p->doc, i, sent, &def);
+         }
+      }
+
+      char *buf = output_take(&out);
+      if (pl->cfg->format == FORMAT_BINARY && (text_pos || sentence_pos))
+         gnc_relocate(buf, gn_vec_len(buf), text_pos, sentence_pos);
+      if (fwrite(buf, 1, gn_vec_len(buf), fp) != gn_vec_len(buf))
+         die("cannot write output:");
+      gn_vec_free(buf);
+
+      text_pos += p->len;
+      sentence_pos += nr;
+      free_piece(p);
+   }
+   output_fini(&out);
+   report_caches(&cache, 1);
+   gn_dealloc(gn);
+}
+
+int pipeline_run(const struct config *cfg, char **paths, FILE *fp)
+{
+   struct pipeline pl = {
+      .cfg = cfg,
+      .paths = paths,
+      .walk = walk_start(paths, cfg->include, cfg->exclude),
+   };
+   atomic_init(&pl.failed, false);
+   ring_init(&pl.texts, RING_SIZE);
+   ring_init(&pl.sentences, RING_SIZE);
+
+   thrd_t reader, tokenizer;
+   if (thrd_create(&reader, reader_main, &pl) != thrd_success
+    || thrd_create(&tokenizer, tokenizer_main, &pl) != thrd_success)
+      die("cannot create thread");
+
+   match(&pl, fp);
+
+   thrd_join(reader, NULL);
+   thrd_join(tokenizer, NULL);
+   ring_fini(&pl.texts);
+   ring_fini(&pl.sentences);
+   int ret = atomic_load(&pl.failed) ? -1 : 0;
+   if (walk_finish(pl.walk))
+      ret = -1;
+   return ret;
+}
@@ -0,0 +1,16 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+
+struct config;
+
+/* Processes files one after another, with the reading and normalization,
+ * tokenization, and extraction stages running on separate threads. Stages
+ * exchange batches of sentences through bounded ring buffers. The standard
+ * input is processed if no path is given. Returns -1 if some file could not be
+ * processed.
+ */
+int pipeline_run(const struct config *, char **paths, FILE *out);
+
+#endif
@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <threads.h>
+#include <unistd.h>
+#include "pool.h"
+#include "cmd.h"
+#include "../src/vec.h"
+
+/* A job, tagged with its submission number. */
+struct slot {
+   size_t seq;
+   void *job;
+};
+
+/* Per-worker job queue. This is a FIFO, because, in ordered mode, we want
+ * older jobs to be processed first, whether they are taken by the queue owner
+ * or stolen.
+ */
+struct queue {
+   mtx_t lock;
+   struct slot *slots;        /* Circular buffer. */
+   size_t head, len, cap;
+};
+
+struct result {
+   void *job;
+   char *buf;
+   bool ready;
+};
+
+struct worker {
+   struct pool *pool;
+   size_t no;
+   thrd_t thread;
+};
+
+struct pool {
+   struct pool_config cfg;
+   struct worker *workers;
+   struct queue *queues;
+   thrd_t writer;
+
+   /* The following are protected by the pool lock. */
+   mtx_t lock;
+   cnd_t work;                /* Signaled when a job is added. */
+   cnd_t space;               /* Signaled when a job output is written. */
+   cnd_t done;                /* Signaled when a job is processed. */
+   size_t submitted;          /* Number of jobs submitted. */
+   size_t pending;            /* Number of jobs that are not taken yet. */
+   size_t written;            /* Number of jobs which output was written. */
+   bool closing;              /* Whether no more jobs will be submitted. */
+   bool failed;               /* Whether a job failed. */
+
+   /* Output of processed jobs that are not written yet, indexed by their
+    * submission number modulo the window size. Only used in ordered mode.
+    */
+   struct result *results;
+   size_t window;
+};
+
+static void queue_init(struct queue *q)
+{
+   if (mtx_init(&q->lock, mtx_plain) != thrd_success)
+      die("cannot create mutex");
+}
+
+static void queue_fini(struct queue *q)
+{
+   mtx_destroy(&q->lock);
+   free(q->slots);
+}
+
+static void queue_push(struct queue *q, struct slot slot)
+{
+   mtx_lock(&q->lock);
+   if (q->len == q->cap) {
+      size_t cap = q->cap ? q->cap * 2 : 16;
+      struct slot *slots = malloc(cap * sizeof *slots);
+      if (!slots)
+         die("out of memory");
+      for (size_t i = 0; i < q->len; i++)
+         slots[i] = q->slots[(q->head + i) % q->cap];
+      free(q->slots);
+      q->slots = slots;
+      q->head = 0;
+      q->cap = cap;
+   }
+   q->slots[(q->head + q->len++) % q->cap] = slot;
+   mtx_unlock(&q->lock);
+}
+
+static bool queue_pop(struct queue *q, struct slot *slot)
+{
+   bool found = false;
+
+   mtx_lock(&q->lock);
+   if (q->len) {
+      *slot = q->slots[q->head];
+      q->head = (q->head + 1) % q->cap;
+      q->len--;
+      found = true;
+   }
+   mtx_unlock(&q->lock);
+   return found;
+}
+
+/* Takes a job from our own queue if possible, otherwise steals one from
+ * another worker. The caller must have reserved a job beforehand, so that we're
+ * sure there is one to take.
+ */
+static struct slot take_job(struct worker *w)
+{
+   struct pool *pool = w->pool;
+   size_t n = pool->cfg.workers;
+   struct slot slot;
+
+   for (;;) {
+      for (size_t i = 0; i < n; i++)
+         if (queue_pop(&pool->queues[(w->no + i) % n], &slot))
+            return slot;
+   }
+}
+
+static void write_output(struct pool *pool, char *buf)
+{
+   size_t len = gn_vec_len(buf);
+   if (fwrite(buf, 1, len, pool->cfg.fp) != len)
+      die("cannot write output:");
+   gn_vec_free(buf);
+}
+
+static void deliver(struct pool *pool, struct slot slot, char *buf, int ret)
+{
+   if (!pool->cfg.ordered) {
+      if (pool->cfg.emit) {
+         mtx_lock(&pool->lock);
+         pool->cfg.emit(pool->cfg.arg, slot.job, &buf);
+         mtx_unlock(&pool->lock);
+      }
+      write_output(pool, buf);
+      mtx_lock(&pool->lock);
+      pool->written++;
+      if (ret)
+         pool->failed = true;
+      cnd_broadcast(&pool->space);
+      mtx_unlock(&pool->lock);
+      return;
+   }
+
+   mtx_lock(&pool->lock);
+   pool->results[slot.seq % pool->window] = (struct result){slot.job, buf, true};
+   if (ret)
+      pool->failed = true;
+   cnd_signal(&pool->done);
+   mtx_unlock(&pool->lock);
+}
+
+static int worker_main(void *arg)
+{
+   struct worker *w = arg;
+   struct pool *pool = w->pool;
+   void *state = pool->cfg.worker_init(pool->cfg.arg, w->no);
+
+   for (;;) {
+      mtx_lock(&pool->lock);
+      while (!pool->pending && !pool->closing)
+         cnd_wait(&pool->work, &pool->lock);
+      if (!pool->pending) {
+         mtx_unlock(&pool->lock);
+         break;
+      }
+      pool->pending--;
+      mtx_unlock(&pool->lock);
+
+      struct slot slot = take_job(w);
+      char *buf = GN_VEC_INIT;
+      int ret = pool->cfg.run(state, slot.job, &buf);
+      deliver(pool, slot, buf, ret);
+   }
+
+   pool->cfg.worker_fini(state);
+   return 0;
+}
+
+static int writer_main(void *arg)
+{
+   struct pool *pool = arg;
+
+   mtx_lock(&pool->lock);
+   for (;;) {
+      struct result *res = &pool->results[pool->written % pool->window];
+      while (!res->ready && !(pool->closing && pool->written == pool->submitted))
+         cnd_wait(&pool->done, &pool->lock);
+      if (!res->ready)
+         break;
+
+      void *job = res->job;
+      char *buf = res->buf;
+      *res = (struct result){0};
+      mtx_unlock(&pool->lock);
+
+      if (pool->cfg.emit)
+         pool->cfg.emit(pool->cfg.arg, job, &buf);
+      write_output(pool, buf);
+
+      mtx_lock(&pool->lock);
+      pool->written++;
+      cnd_broadcast(&pool->space);
+   }
+   mtx_unlock(&pool->lock);
+   return 0;
+}
+
+struct pool *pool_start(const struct pool_config *cfg)
+{
+   struct pool *pool = calloc(1, sizeof *pool);
+   if (!pool)
+      die("out of memory");
+   pool->cfg = *cfg;
+   if (!pool->cfg.workers)
+      pool->cfg.workers = 1;
+
+   if (mtx_init(&pool->lock, mtx_plain) != thrd_success
+    || cnd_init(&pool->work) != thrd_success
+    || cnd_init(&pool->space) != thrd_success
+    || cnd_init(&pool->done) != thrd_success)
+      die("cannot create synchronization primitives");
+
+   size_t n = pool->cfg.workers;
+   pool->window = 16 * n;
+   pool->results = calloc(pool->window, sizeof *pool->results);
+   pool->queues = calloc(n, sizeof *pool->queues);
+   pool->workers = calloc(n, sizeof *pool->workers);
+   if (!pool->results || !pool->queues || !pool->workers)
+      die("out of memory");
+
+   for (size_t i = 0; i < n; i++)
+      queue_init(&pool->queues[i]);
+   for (size_t i = 0; i < n; i++) {
+      struct worker *w = &pool->workers[i];
+      w->pool = pool;
+      w->no = i;
+      if (thrd_create(&w->thread, worker_main, w) != thrd_success)
+         die("cannot create thread");
+   }
+   if (pool->cfg.ordered && thrd_create(&pool->writer, writer_main, pool) != thrd_success)
+      die("cannot create thread");
+   return pool;
+}
+
+void pool_submit(struct pool *pool, void *job)
+{
+   mtx_lock(&pool->lock);
+   while (pool->submitted - pool->written >= pool->window)
+      cnd_wait(&pool->space, &pool->lock);
+   size_t seq = pool->submitted++;
+   mtx_unlock(&pool->lock);
+
+   queue_push(&pool->queues[seq % pool->cfg.workers], (struct slot){seq, job});
+
+   mtx_lock(&pool->lock);
+   pool->pending++;
+   cnd_signal(&pool->work);
+   mtx_unlock(&pool->lock);
+}
+
+int pool_finish(struct pool *pool)
+{
+   mtx_lock(&pool->lock);
+   pool->closing = true;
+   cnd_broadcast(&pool->work);
+   cnd_broadcast(&pool->done);
+   mtx_unlock(&pool->lock);
+
+   for (size_t i = 0; i < pool->cfg.workers; i++)
+      thrd_join(pool->workers[i].thread, NULL);
+   if (pool->cfg.ordered)
+      thrd_join(pool->writer, NULL);
+
+   int ret = pool->failed ? -1 : 0;
+
+   for (size_t i = 0; i < pool->cfg.workers; i++)
+      queue_fini(&pool->queues[i]);
+   cnd_destroy(&pool->work);
+   cnd_destroy(&pool->space);
+   cnd_destroy(&pool->done);
+   mtx_destroy(&pool->lock);
+   free(pool->queues);
+   free(pool->workers);
+   free(pool->results);
+   free(pool);
+   return ret;
+}
+
+size_t pool_workers(size_t requested)
+{
+   if (requested)
+      return requested;
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? n : 1;
+}
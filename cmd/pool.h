@@ -0,0 +1,66 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Worker pool.
+ *
+ * Jobs are distributed round-robin among per-worker queues. A worker takes
+ * jobs from its own queue first, and steals jobs from the other queues when
+ * its own is empty, so that a few large inputs don't leave the other workers
+ * idle.
+ *
+ * Each job produces an output buffer. In ordered mode, buffers are written in
+ * the order the jobs were submitted, by a dedicated writer thread. The number
+ * of jobs that are processed but not written yet is bounded, so that a slow job
+ * doesn't make memory usage grow without limit. In unordered mode, workers
+ * write their output as soon as a job is done.
+ */
+
+struct pool_config {
+   size_t workers;            /* Number of worker threads. */
+   bool ordered;              /* Whether to preserve the jobs order. */
+   FILE *fp;                  /* Output file. */
+
+   /* Allocates and releases the state of a worker. */
+   void *(*worker_init)(void *arg, size_t worker_no);
+   void (*worker_fini)(void *worker);
+
+   /* Processes a job. Output data must be appended to the provided byte vector
+    * (see src/vec.h), which is initially empty. Must return 0 on success, -1
+    * on failure. Whatever the outcome, the job must be deallocated here,
+    * unless emit() is set.
+    */
+   int (*run)(void *worker, void *job, char **out);
+
+   /* Optional. Called just before the output of a job is written, with the
+    * pool argument, the job and its output, which can be modified. Calls are
+    * serialized, and, in ordered mode, made in the jobs submission order. The
+    * job must be deallocated here.
+    */
+   void (*emit)(void *arg, void *job, char **out);
+
+   void *arg;                 /* Passed to worker_init() and emit(). */
+};
+
+struct pool;
+
+/* Starts the worker threads. Dies on failure. */
+struct pool *pool_start(const struct pool_config *);
+
+/* Submits a job. This blocks if too many jobs are pending. */
+void pool_submit(struct pool *, void *job);
+
+/* Waits until all submitted jobs are processed and their output written, then
+ * stops the workers and deallocates the pool. Returns 0 if all jobs were
+ * successful, -1 otherwise.
+ */
+int pool_finish(struct pool *);
+
+/* Parses the number of jobs given on the command-line. 0 means one job per
+ * available processor.
+ */
+size_t pool_workers(size_t requested);
+
+#endif
@@ -0,0 +1,743 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include "cmd.h"
+#include "input.h"
+#include "record.h"
+#include "extract.h"
+#include "../src/vec.h"
+
+#define READ_SIZE (1 << 20)
+
+/* Records are buffered whole, so their size must be bounded. */
+#define MAX_RECORD_SIZE MAX_FILE_SIZE
+
+/* Search results, besides offsets. */
+#define NOT_FOUND SIZE_MAX
+#define FAILED (SIZE_MAX - 1)
+
+int record_format(const char *name)
+{
+   if (!strcmp(name, "jsonl"))
+      return RECORDS_JSONL;
+   if (!strcmp(name, "warc"))
+      return RECORDS_WARC;
+   if (!strcmp(name, "wiki"))
+      return RECORDS_WIKI;
+   return -1;
+}
+
+void record_reader_init(struct record_reader *r, enum record_format fmt,
+                        struct input *in, const char *name,
+                        const char *text_field, const char *id_field,
+                        const char *lang_field)
+{
+   *r = (struct record_reader){
+      .format = fmt,
+      .in = in,
+      .name = name,
+      .text_field = text_field,
+      .id_field = id_field,
+      .lang_field = lang_field,
+      .buf = GN_VEC_INIT,
+      .id = GN_VEC_INIT,
+      .lang = GN_VEC_INIT,
+   };
+}
+
+void record_reader_fini(struct record_reader *r)
+{
+   gn_vec_free(r->buf);
+   gn_vec_free(r->id);
+   gn_vec_free(r->lang);
+}
+
+/* Reads more data. Returns -1 on error. */
+static int fill(struct record_reader *r)
+{
+   gn_vec_grow(r->buf, READ_SIZE);
+   size_t len = input_read(r->in, &r->buf[gn_vec_len(r->buf)], READ_SIZE);
+   gn_vec_len(r->buf) += len;
+   if (len < READ_SIZE) {
+      if (input_error(r->in))
+         return -1;
+      r->eof = true;
+   }
+   return 0;
+}
+
+/* Drops the data consumed so far. Offsets into the buffer change. */
+static void compact(struct record_reader *r)
+{
+   size_t len = gn_vec_len(r->buf) - r->pos;
+   memmove(r->buf, &r->buf[r->pos], len);
+   gn_vec_len(r->buf) = len;
+   r->pos = 0;
+}
+
+static size_t search(const char *buf, size_t pos, size_t len,
+                     const char *str, size_t str_len)
+{
+   while (pos + str_len <= len) {
+      const char *p = memchr(&buf[pos], *str, len - pos - str_len + 1);
+      if (!p)
+         break;
+      pos = p - buf;
+      if (!memcmp(p, str, str_len))
+         return pos;
+      pos++;
+   }
+   return NOT_FOUND;
+}
+
+/* Finds a string in the buffer, starting at the given offset, and reading more
+ * data as needed. Returns its offset, NOT_FOUND at the end of the input, or
+ * FAILED on error, after displaying a message.
+ */
+static size_t find(struct record_reader *r, size_t pos, const char *str)
+{
+   size_t str_len = strlen(str);
+
+   for (;;) {
+      size_t len = gn_vec_len(r->buf);
+      size_t found = search(r->buf, pos, len, str, str_len);
+      if (found != NOT_FOUND)
+         return found;
+      if (r->eof)
+         return NOT_FOUND;
+      if (len - r->pos > MAX_RECORD_SIZE) {
+         complain("record too large in '%s' (limit is %d)", r->name, MAX_RECORD_SIZE);
+         return FAILED;
+      }
+      if (len - pos >= str_len)
+         pos = len - str_len + 1;
+      if (fill(r))
+         return FAILED;
+   }
+}
+
+/* Reads data up to the given offset. Returns -1 on error, or if the input is
+ * too short, after displaying a message.
+ */
+static int ensure(struct record_reader *r, size_t end)
+{
+   while (gn_vec_len(r->buf) < end && !r->eof)
+      if (fill(r))
+         return -1;
+   if (gn_vec_len(r->buf) < end) {
+      complain("truncated record in '%s'", r->name);
+      return -1;
+   }
+   return 0;
+}
+
+/* Stores a nul-terminated copy of a string in a byte vector. */
+static void set_str(char **vec, const char *str, size_t len)
+{
+   gn_vec_clear(*vec);
+   gn_vec_grow(*vec, len + 1);
+   memcpy(*vec, str, len);
+   (*vec)[len] = '\0';
+   gn_vec_len(*vec) = len;
+}
+
+static void set_id(struct record_reader *r, const char *id, size_t len)
+{
+   set_str(&r->id, id, len);
+}
+
+/* Language of the record, for callers. */
+static const char *get_lang(const struct record_reader *r)
+{
+   return gn_vec_len(r->lang) ? r->lang : NULL;
+}
+
+/* Used for records that have no id. */
+static void set_default_id(struct record_reader *r, size_t no)
+{
+   char tmp[32];
+   int len = snprintf(tmp, sizeof tmp, ":%zu", no);
+   size_t name_len = strlen(r->name);
+
+   set_id(r, r->name, name_len);
+   gn_vec_grow(r->id, len + 1);
+   memcpy(&r->id[name_len], tmp, len + 1);
+   gn_vec_len(r->id) += len;
+}
+
+static size_t encode_utf8(char *s, uint32_t c)
+{
+   unsigned char *p = (unsigned char *)s;
+
+   if (c < 0x80) {
+      p[0] = c;
+      return 1;
+   }
+   if (c < 0x800) {
+      p[0] = 0xC0 | c >> 6;
+      p[1] = 0x80 | (c & 0x3F);
+      return 2;
+   }
+   if (c < 0x10000) {
+      p[0] = 0xE0 | c >> 12;
+      p[1] = 0x80 | (c >> 6 & 0x3F);
+      p[2] = 0x80 | (c & 0x3F);
+      return 3;
+   }
+   p[0] = 0xF0 | c >> 18;
+   p[1] = 0x80 | (c >> 12 & 0x3F);
+   p[2] = 0x80 | (c >> 6 & 0x3F);
+   p[3] = 0x80 | (c & 0x3F);
+   return 4;
+}
+
+/* Substitutes the replacement character for code points that can't be
+ * encoded.
+ */
+static uint32_t check_code_point(uint32_t c)
+{
+   if (c > 0x10FFFF || (c >= 0xD800 && c < 0xE000))
+      return 0xFFFD;
+   return c;
+}
+
+/*****************************************************************************
+ * JSONL
+ *****************************************************************************/
+
+struct json {
+   char *p, *end;
+};
+
+static void json_space(struct json *j)
+{
+   while (j->p < j->end && (*j->p == ' ' || *j->p == '\t' || *j->p == '\r' || *j->p == '\n'))
+      j->p++;
+}
+
+static bool hex4(const char *p, const char *end, uint32_t *c)
+{
+   if (end - p < 4)
+      return false;
+   *c = 0;
+   for (int i = 0; i < 4; i++) {
+      int d;
+      if (p[i] >= '0' && p[i] <= '9')
+         d = p[i] - '0';
+      else if ((p[i] | 0x20) >= 'a' && (p[i] | 0x20) <= 'f')
+         d = (p[i] | 0x20) - 'a' + 10;
+      else
+         return false;
+      *c = *c << 4 | d;
+   }
+   return true;
+}
+
+/* Decodes a string in place. The current position must be on the opening
+ * quote. Escape sequences are never shorter than what they stand for, so the
+ * decoded string fits.
+ */
+static bool json_string(struct json *j, char **str, size_t *len)
+{
+   char *p = j->p + 1, *q = p;
+
+   *str = p;
+   while (p < j->end && *p != '"') {
+      if (*p != '\\') {
+         *q++ = *p++;
+         continue;
+      }
+      if (++p == j->end)
+         return false;
+      uint32_t c;
+      switch (*p++) {
+      case '"': *q++ = '"'; break;
+      case '\\': *q++ = '\\'; break;
+      case '/': *q++ = '/'; break;
+      case 'b': *q++ = '\b'; break;
+      case 'f': *q++ = '\f'; break;
+      case 'n': *q++ = '\n'; break;
+      case 'r': *q++ = '\r'; break;
+      case 't': *q++ = '\t'; break;
+      case 'u':
+         if (!hex4(p, j->end, &c))
+            return false;
+         p += 4;
+         if (c >= 0xD800 && c < 0xDC00 && j->end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+            uint32_t low;
+            if (hex4(&p[2], j->end, &low) && low >= 0xDC00 && low < 0xE000) {
+               c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+               p += 6;
+            }
+         }
+         q += encode_utf8(q, check_code_point(c));
+         break;
+      default:
+         return false;
+      }
+   }
+   if (p == j->end)
+      return false;
+   *len = q - *str;
+   j->p = p + 1;
+   return true;
+}
+
+/* Skips a value. This is lenient, we only care about finding where it ends. */
+static bool json_skip(struct json *j)
+{
+   size_t depth = 0;
+   char *str;
+   size_t len;
+
+   do {
+      json_space(j);
+      if (j->p == j->end)
+         return false;
+      switch (*j->p) {
+      case '"':
+         if (!json_string(j, &str, &len))
+            return false;
+         break;
+      case '{': case '[':
+         depth++;
+         j->p++;
+         break;
+      case '}': case ']':
+         if (!depth--)
+            return false;
+         j->p++;
+         break;
+      case ',': case ':':
+         if (!depth)
+            return false;
+         j->p++;
+         break;
+      default:
+         while (j->p < j->end && !strchr(",:{}[]\" \t\r\n", *j->p))
+            j->p++;
+      }
+   } while (depth);
+   return true;
+}
+
+static bool is_field(const char *key, size_t len, const char *name)
+{
+   return strlen(name) == len && !memcmp(key, name, len);
+}
+
+/* Returns 1 if the line holds a record, 0 if it must be skipped, -1 if it is
+ * not valid.
+ */
+static int parse_json(struct record_reader *r, char *line, size_t len,
+                      struct record *rec)
+{
+   struct json j = {line, line + len};
+   bool has_text = false;
+
+   json_space(&j);
+   if (j.p == j.end)
+      return 0;
+   if (*j.p++ != '{')
+      return -1;
+   gn_vec_clear(r->id);
+   gn_vec_clear(r->lang);
+
+   json_space(&j);
+   if (j.p < j.end && *j.p == '}')
+      return 0;
+   for (;;) {
+      char *key, *str;
+      size_t key_len, str_len;
+
+      json_space(&j);
+      if (j.p == j.end || *j.p != '"' || !json_string(&j, &key, &key_len))
+         return -1;
+      json_space(&j);
+      if (j.p == j.end || *j.p++ != ':')
+         return -1;
+      json_space(&j);
+      if (j.p == j.end)
+         return -1;
+
+      if (is_field(key, key_len, r->text_field) && *j.p == '"') {
+         if (!json_string(&j, &rec->text, &rec->len))
+            return -1;
+         has_text = true;
+      } else if (is_field(key, key_len, r->id_field) && *j.p == '"') {
+         if (!json_string(&j, &str, &str_len))
+            return -1;
+         set_id(r, str, str_len);
+      } else if (r->lang_field && is_field(key, key_len, r->lang_field) && *j.p == '"') {
+         if (!json_string(&j, &str, &str_len))
+            return -1;
+         set_str(&r->lang, str, str_len);
+      } else if (is_field(key, key_len, r->id_field)) {
+         str = j.p;
+         if (!json_skip(&j))
+            return -1;
+         set_id(r, str, j.p - str);
+      } else if (!json_skip(&j)) {
+         return -1;
+      }
+
+      json_space(&j);
+      if (j.p == j.end)
+         return -1;
+      if (*j.p == '}')
+         break;
+      if (*j.p++ != ',')
+         return -1;
+   }
+   if (!has_text)
+      return 0;
+   if (!gn_vec_len(r->id))
+      set_default_id(r, r->line);
+   return 1;
+}
+
+static int next_jsonl(struct record_reader *r, struct record *rec)
+{
+   for (;;) {
+      size_t end = find(r, r->pos, "\n");
+      if (end == FAILED)
+         return -1;
+      if (end == NOT_FOUND) {
+         end = gn_vec_len(r->buf);
+         if (end == r->pos)
+            return 0;
+      }
+      char *line = &r->buf[r->pos];
+      size_t len = end - r->pos;
+      r->pos = end < gn_vec_len(r->buf) ? end + 1 : end;
+      r->line++;
+
+      int ret = parse_json(r, line, len, rec);
+      if (ret > 0)
+         break;
+      if (ret < 0) {
+         complain("invalid JSON record at line %zu of '%s'", r->line, r->name);
+         r->failed = true;
+      }
+   }
+   rec->id = r->id;
+   rec->lang = get_lang(r);
+   return 1;
+}
+
+/*****************************************************************************
+ * WARC
+ *****************************************************************************/
+
+/* Compares a header field name, which is case-insensitive. */
+static bool is_header(const char *line, size_t len, const char *name, const char **value)
+{
+   size_t name_len = strlen(name);
+   if (len <= name_len || line[name_len] != ':' || strncasecmp(line, name, name_len))
+      return false;
+   *value = &line[name_len + 1];
+   while (**value == ' ' || **value == '\t')
+      (*value)++;
+   return true;
+}
+
+/* Returns the types of records which contents we process, and whether they
+ * are HTTP messages.
+ */
+enum warc_type { WARC_SKIP, WARC_TEXT, WARC_HTTP };
+
+static enum warc_type warc_type(const char *type, size_t type_len, bool http)
+{
+   if (type_len == 10 && !strncasecmp(type, "conversion", 10))
+      return WARC_TEXT;
+   if (type_len == 8 && !strncasecmp(type, "resource", 8))
+      return WARC_TEXT;
+   if (type_len == 8 && !strncasecmp(type, "response", 8))
+      return http ? WARC_HTTP : WARC_TEXT;
+   return WARC_SKIP;
+}
+
+/* Consumes the contents of a record that is too large to be buffered. */
+static int skip_contents(struct record_reader *r, size_t len)
+{
+   for (;;) {
+      size_t avail = gn_vec_len(r->buf) - r->pos;
+      if (avail >= len) {
+         r->pos += len;
+         return 0;
+      }
+      len -= avail;
+      r->pos += avail;
+      compact(r);
+      if (r->eof) {
+         complain("truncated record in '%s'", r->name);
+         return -1;
+      }
+      if (fill(r))
+         return -1;
+   }
+}
+
+static int next_warc(struct record_reader *r, struct record *rec)
+{
+   for (;;) {
+      /* Records are followed by two CRLF. */
+      for (;;) {
+         size_t len = gn_vec_len(r->buf);
+         while (r->pos < len && (r->buf[r->pos] == '\r' || r->buf[r->pos] == '\n'))
+            r->pos++;
+         if (r->pos < len)
+            break;
+         if (r->eof)
+            return 0;
+         if (fill(r))
+            return -1;
+      }
+
+      size_t header_end = find(r, r->pos, "\r\n\r\n");
+      if (header_end == FAILED)
+         return -1;
+      if (header_end == NOT_FOUND || strncmp(&r->buf[r->pos], "WARC/", 5)) {
+         complain("invalid WARC record in '%s'", r->name);
+         return -1;
+      }
+
+      const char *type = "", *value;
+      size_t type_len = 0;
+      unsigned long long length = 0;
+      bool has_length = false, http = false;
+      gn_vec_clear(r->id);
+      gn_vec_clear(r->lang);
+
+      size_t pos = r->pos;
+      while (pos < header_end) {
+         size_t eol = search(r->buf, pos, header_end + 2, "\r\n", 2);
+         const char *line = &r->buf[pos];
+         size_t len = eol - pos;
+         if (is_header(line, len, "Content-Length", &value)) {
+            length = strtoull(value, NULL, 10);
+            has_length = true;
+         } else if (is_header(line, len, "WARC-Type", &value)) {
+            type = value;
+            type_len = &line[len] - value;
+         } else if (is_header(line, len, "WARC-Record-ID", &value)) {
+            set_id(r, value, &line[len] - value);
+         } else if (is_header(line, len, "Content-Type", &value)) {
+            http = !strncasecmp(value, "application/http", 16);
+         } else if (r->lang_field && is_header(line, len, r->lang_field, &value)) {
+            set_str(&r->lang, value, &line[len] - value);
+         }
+         pos = eol + 2;
+      }
+      if (!has_length) {
+         complain("invalid WARC record in '%s'", r->name);
+         return -1;
+      }
+      enum warc_type kind = warc_type(type, type_len, http);
+
+      size_t start = header_end + 4;
+      r->pos = start;
+      if (length > MAX_RECORD_SIZE) {
+         if (kind != WARC_SKIP) {
+            complain("record too large in '%s' (limit is %d)", r->name, MAX_RECORD_SIZE);
+            r->failed = true;
+         }
+         if (skip_contents(r, length))
+            return -1;
+         continue;
+      }
+      if (ensure(r, start + length))
+         return -1;
+      r->pos = start + length;
+      if (kind == WARC_SKIP)
+         continue;
+
+      rec->text = &r->buf[start];
+      rec->len = length;
+      if (kind == WARC_HTTP) {
+         /* Skip the HTTP headers. */
+         size_t body = search(r->buf, start, start + length, "\r\n\r\n", 4);
+         if (body == NOT_FOUND)
+            continue;
+         rec->text = &r->buf[body + 4];
+         rec->len = start + length - body - 4;
+      }
+      break;
+   }
+   r->line++;
+   if (!gn_vec_len(r->id))
+      set_default_id(r, r->line);
+   rec->id = r->id;
+   rec->lang = get_lang(r);
+   return 1;
+}
+
+/*****************************************************************************
+ * MediaWiki XML
+ *****************************************************************************/
+
+/* Decodes character references in place, returns the new length. */
+static size_t xml_unescape(char *s, size_t len)
+{
+   char *p = s, *q = s, *end = s + len;
+
+   while (p < end) {
+      if (*p != '&') {
+         *q++ = *p++;
+         continue;
+      }
+      char *semi = memchr(p, ';', end - p < 12 ? end - p : 12);
+      if (!semi) {
+         *q++ = *p++;
+         continue;
+      }
+      const char *ent = p + 1;
+      size_t ent_len = semi - ent;
+      if (ent_len == 2 && !memcmp(ent, "lt", 2)) {
+         *q++ = '<';
+      } else if (ent_len == 2 && !memcmp(ent, "gt", 2)) {
+         *q++ = '>';
+      } else if (ent_len == 3 && !memcmp(ent, "amp", 3)) {
+         *q++ = '&';
+      } else if (ent_len == 4 && !memcmp(ent, "quot", 4)) {
+         *q++ = '"';
+      } else if (ent_len == 4 && !memcmp(ent, "apos", 4)) {
+         *q++ = '\'';
+      } else if (ent_len >= 2 && *ent == '#') {
+         char *num_end;
+         unsigned long c = ent[1] == 'x' || ent[1] == 'X'
+                         ? strtoul(&ent[2], &num_end, 16)
+                         : strtoul(&ent[1], &num_end, 10);
+         if (num_end != semi) {
+            *q++ = *p++;
+            continue;
+         }
+         q += encode_utf8(q, check_code_point(c));
+      } else {
+         *q++ = *p++;
+         continue;
+      }
+      p = semi + 1;
+   }
+   return q - s;
+}
+
+/* Finds the contents of the first element with the given tag name, in a page.
+ * Returns NULL if there is none.
+ */
+static char *element(char *page, size_t len, const char *tag, size_t *content_len)
+{
+   char open[32], close[32];
+   int open_len = snprintf(open, sizeof open, "<%s>", tag);
+   int close_len = snprintf(close, sizeof close, "</%s>", tag);
+
+   size_t start = search(page, 0, len, open, open_len);
+   if (start == NOT_FOUND)
+      return NULL;
+   start += open_len;
+   size_t end = search(page, start, len, close, close_len);
+   if (end == NOT_FOUND)
+      return NULL;
+   *content_len = end - start;
+   return &page[start];
+}
+
+/* Finds the text of the last revision. The text element has attributes, and
+ * is empty for deleted revisions. Since text is escaped, there is no markup
+ * inside.
+ */
+static char *page_text(char *page, size_t len, size_t *text_len)
+{
+   size_t tag = NOT_FOUND;
+   for (size_t pos = 0; (pos = search(page, pos, len, "<text", 5)) != NOT_FOUND; pos++)
+      tag = pos;
+   if (tag == NOT_FOUND)
+      return NULL;
+
+   const char *gt = memchr(&page[tag], '>', len - tag);
+   if (!gt || gt[-1] == '/')
+      return NULL;
+   size_t start = gt - page + 1;
+   size_t end = search(page, start, len, "</text>", 7);
+   if (end == NOT_FOUND)
+      return NULL;
+   *text_len = end - start;
+   return &page[start];
+}
+
+/* The language of a dump is given by the root element, which precedes the
+ * first page.
+ */
+static void dump_lang(struct record_reader *r, size_t end)
+{
+   size_t pos = search(r->buf, r->pos, end, "xml:lang=\"", 10);
+   if (pos == NOT_FOUND)
+      return;
+   pos += 10;
+   const char *quote = memchr(&r->buf[pos], '"', end - pos);
+   if (quote)
+      set_str(&r->lang, &r->buf[pos], quote - &r->buf[pos]);
+}
+
+static int next_wiki(struct record_reader *r, struct record *rec)
+{
+   for (;;) {
+      size_t start = find(r, r->pos, "<page>");
+      if (start == FAILED)
+         return -1;
+      if (start == NOT_FOUND) {
+         r->pos = gn_vec_len(r->buf);
+         return 0;
+      }
+      if (r->lang_field && !r->line)
+         dump_lang(r, start);
+      r->pos = start;
+      size_t end = find(r, start, "</page>");
+      if (end == FAILED)
+         return -1;
+      if (end == NOT_FOUND) {
+         complain("truncated record in '%s'", r->name);
+         return -1;
+      }
+      r->pos = end + 7;
+
+      char *page = &r->buf[start];
+      size_t len = end - start, id_len = 0;
+      char *id = element(page, len, "id", &id_len);
+      rec->text = page_text(page, len, &rec->len);
+      if (!rec->text)
+         continue;
+      rec->len = xml_unescape(rec->text, rec->len);
+
+      r->line++;
+      if (id)
+         set_id(r, id, id_len);
+      else
+         set_default_id(r, r->line);
+      break;
+   }
+   rec->id = r->id;
+   rec->lang = get_lang(r);
+   return 1;
+}
+
+int record_next(struct record_reader *r, struct record *rec)
+{
+   /* Moving the remaining data costs less than what was consumed. */
+   if (r->pos > gn_vec_len(r->buf) / 2)
+      compact(r);
+
+   switch (r->format) {
+   case RECORDS_JSONL:
+      return next_jsonl(r, rec);
+   case RECORDS_WARC:
+      return next_warc(r, rec);
+   case RECORDS_WIKI:
+      return next_wiki(r, rec);
+   default:
+      return 0;
+   }
+}
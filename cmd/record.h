@@ -0,0 +1,68 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct input;
+
+/* Readers for files made of several documents, or records.
+ *
+ * Record texts are unescaped in place, in the reader buffer, so that they
+ * don't need to be copied. Markup inside texts (HTML in WARC responses,
+ * wikitext in MediaWiki dumps) is left as is.
+ */
+enum record_format {
+   RECORDS_NONE,
+   RECORDS_JSONL,    /* One JSON object per line. */
+   RECORDS_WARC,     /* Web archive, text of conversion, resource and response records. */
+   RECORDS_WIKI,     /* MediaWiki XML dump, text of the last revision of each page. */
+};
+
+/* Parses a record format name. Returns -1 if the name is invalid. */
+int record_format(const char *name);
+
+/* A record. Strings point into the reader buffer and are valid until the next
+ * call to record_next().
+ */
+struct record {
+   const char *id;            /* Nul-terminated. */
+   const char *lang;          /* Language tag, or NULL if unknown. */
+   char *text;                /* Not nul-terminated. */
+   size_t len;
+};
+
+struct record_reader {
+   enum record_format format;
+   struct input *in;
+   const char *name;          /* Input name, for error messages. */
+   const char *text_field;    /* JSON fields holding the text and the id. */
+   const char *id_field;
+   const char *lang_field;    /* JSON field or WARC header holding the
+                               * language, or NULL. */
+
+   char *buf;                 /* Byte vector. */
+   size_t pos;                /* Start of the data not consumed yet. */
+   bool eof;
+   size_t line;               /* Line number of the current record for JSONL,
+                               * record number otherwise. */
+   char *id;                  /* Current record id, as a byte vector. */
+   char *lang;                /* Current record language, as a byte vector,
+                               * or the dump language for MediaWiki. */
+   bool failed;               /* Whether some records were invalid. */
+};
+
+/* Field names are not copied. */
+void record_reader_init(struct record_reader *, enum record_format,
+                        struct input *, const char *name,
+                        const char *text_field, const char *id_field,
+                        const char *lang_field);
+void record_reader_fini(struct record_reader *);
+
+/* Reads the next record. Returns 1 on success, 0 at the end of the input, -1
+ * if the input can't be read or is truncated. Invalid records are reported and
+ * skipped, and the failed flag is set.
+ */
+int record_next(struct record_reader *, struct record *);
+
+#endif
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <threads.h>
+#include "ring.h"
+#include "cmd.h"
+
+void ring_init(struct ring *r, size_t capacity)
+{
+   size_t cap = 1;
+   while (cap < capacity)
+      cap <<= 1;
+
+   r->slots = malloc(cap * sizeof *r->slots);
+   if (!r->slots)
+      die("out of memory");
+   r->mask = cap - 1;
+   atomic_init(&r->head, 0);
+   atomic_init(&r->tail, 0);
+}
+
+void ring_fini(struct ring *r)
+{
+   free(r->slots);
+}
+
+/* Waits for the other side. Stages usually block for a while when they do, so
+ * we don't spin for long.
+ */
+static void backoff(unsigned *n)
+{
+   if (*n < 64) {
+      (*n)++;
+   } else if (*n < 128) {
+      (*n)++;
+      thrd_yield();
+   } else {
+      thrd_sleep(&(struct timespec){.tv_nsec = 50000}, NULL);
+   }
+}
+
+void ring_push(struct ring *r, void *item)
+{
+   size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+   unsigned n = 0;
+
+   while (tail - atomic_load_explicit(&r->head, memory_order_acquire) > r->mask)
+      backoff(&n);
+   r->slots[tail & r->mask] = item;
+   atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+void *ring_pop(struct ring *r)
+{
+   size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+   unsigned n = 0;
+
+   while (atomic_load_explicit(&r->tail, memory_order_acquire) == head)
+      backoff(&n);
+   void *item = r->slots[head & r->mask];
+   atomic_store_explicit(&r->head, head + 1, memory_order_release);
+   return item;
+}
@@ -0,0 +1,32 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+/* Lock-free single-producer, single-consumer ring buffer of pointers.
+ *
+ * Pushing to a full ring or popping from an empty one blocks until the other
+ * side makes progress, which bounds the amount of data in flight between two
+ * pipeline stages.
+ */
+struct ring {
+   void **slots;
+   size_t mask;
+
+   /* Kept on separate cache lines, since they are written by different
+    * threads.
+    */
+   alignas(64) atomic_size_t head;     /* Next slot to read. */
+   alignas(64) atomic_size_t tail;     /* Next slot to write. */
+};
+
+/* The capacity is rounded up to a power of 2. Dies on failure. */
+void ring_init(struct ring *, size_t capacity);
+void ring_fini(struct ring *);
+
+void ring_push(struct ring *, void *);
+void *ring_pop(struct ring *);
+
+#endif
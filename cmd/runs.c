@@ -0,0 +1,471 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "cmd.h"
+#include "runs.h"
+
+#define local static
+#include "../gourgandine.h"
+#include "../src/vec.h"
+
+#define SIGNATURE "gourgandine-counts 1"
+
+/* Maximum number of runs merged at once. When there are more, runs are first
+ * merged in groups of that size, which keeps the number of open files low.
+ */
+#define MERGE_WIDTH 64
+
+struct row {
+   const char *acronym;
+   const char *expansion;
+   size_t freq, docs;
+   size_t first_doc, last_doc;
+};
+
+struct run {
+   FILE *fp;
+   char *name;                /* For error messages. */
+};
+
+struct runs {
+   char *dir;
+   size_t memory;
+   struct run *list;
+};
+
+enum combine {
+   COMBINE_NONE,              /* Rows are kept as they are. */
+   COMBINE_SAME_DOCS,
+   COMBINE_DISTINCT_DOCS,
+};
+
+typedef int row_cmp(const struct row *, const struct row *);
+
+static int compare_keys(const struct row *x, const struct row *y)
+{
+   int ret = strcmp(x->acronym, y->acronym);
+   return ret ? ret : strcmp(x->expansion, y->expansion);
+}
+
+static int compare_counts(const struct row *x, const struct row *y)
+{
+   if (x->freq != y->freq)
+      return x->freq < y->freq ? 1 : -1;
+   return compare_keys(x, y);
+}
+
+struct runs *runs_new(const char *dir, size_t memory)
+{
+   struct runs *r = malloc(sizeof *r);
+   if (!r)
+      die("out of memory");
+   *r = (struct runs){
+      .dir = strdup(dir),
+      .memory = memory,
+      .list = GN_VEC_INIT,
+   };
+   if (!r->dir)
+      die("out of memory");
+   return r;
+}
+
+static void close_run(struct run *run)
+{
+   fclose(run->fp);
+   free(run->name);
+}
+
+void runs_free(struct runs *r)
+{
+   for (size_t i = 0; i < gn_vec_len(r->list); i++)
+      close_run(&r->list[i]);
+   gn_vec_free(r->list);
+   free(r->dir);
+   free(r);
+}
+
+void runs_append(struct runs *dst, struct runs *src)
+{
+   for (size_t i = 0; i < gn_vec_len(src->list); i++)
+      gn_vec_push(dst->list, src->list[i]);
+   gn_vec_clear(src->list);
+   runs_free(src);
+}
+
+/* Creates a temporary file, which is removed right away, so that it vanishes
+ * when closed. Temporary runs have no signature line.
+ */
+static FILE *temp_file(const struct runs *r)
+{
+   size_t len = strlen(r->dir) + sizeof "/gourgandine-XXXXXX";
+   char *path = malloc(len);
+   if (!path)
+      die("out of memory");
+   snprintf(path, len, "%s/gourgandine-XXXXXX", r->dir);
+   int fd = mkstemp(path);
+   if (fd < 0)
+      die("cannot create a temporary file in '%s':", r->dir);
+   unlink(path);
+   free(path);
+   FILE *fp = fdopen(fd, "w+");
+   if (!fp)
+      die("cannot open temporary file:");
+   return fp;
+}
+
+static void write_row(FILE *fp, const struct row *row)
+{
+   fprintf(fp, "%s\t%s\t%zu\t%zu\t%zu\t%zu\n", row->acronym, row->expansion,
+           row->freq, row->docs, row->first_doc, row->last_doc);
+}
+
+/* Adds a temporary file, once written, to the list of runs. */
+static void add_temp(struct runs *r, FILE *fp, size_t at)
+{
+   if (fflush(fp) || ferror(fp) || fseeko(fp, 0, SEEK_SET))
+      die("cannot write temporary file:");
+   struct run run = {.fp = fp, .name = strdup("temporary file")};
+   if (!run.name)
+      die("out of memory");
+   gn_vec_grow(r->list, 1);
+   memmove(&r->list[at + 1], &r->list[at],
+           (gn_vec_len(r->list) - at) * sizeof *r->list);
+   r->list[at] = run;
+   gn_vec_len(r->list)++;
+}
+
+void runs_spill(struct runs *r, struct gn_counter *counts)
+{
+   size_t nr;
+   const struct gn_count *c = gn_counter_list(counts, &nr);
+   if (!nr)
+      return;
+   FILE *fp = temp_file(r);
+   for (size_t i = 0; i < nr; i++) {
+      struct row row = {
+         .acronym = c[i].acronym,
+         .expansion = c[i].expansion,
+         .freq = c[i].freq,
+         .docs = c[i].docs,
+         .first_doc = c[i].first_doc,
+         .last_doc = c[i].last_doc,
+      };
+      write_row(fp, &row);
+   }
+   add_temp(r, fp, gn_vec_len(r->list));
+   gn_counter_clear(counts);
+}
+
+void runs_add(struct runs *r, const char *path)
+{
+   struct run run = {.fp = fopen(path, "r"), .name = strdup(path)};
+   if (!run.fp)
+      die("cannot open '%s':", path);
+   if (!run.name)
+      die("out of memory");
+   char sig[sizeof SIGNATURE + 1];
+   if (!fgets(sig, sizeof sig, run.fp) || strcmp(sig, SIGNATURE "\n"))
+      die("'%s' is not a counts file", path);
+   gn_vec_push(r->list, run);
+}
+
+/* Reads the rows of a run. Two lines are kept, so that a row can be checked
+ * against the previous one.
+ */
+struct reader {
+   struct run *run;
+   row_cmp *cmp;              /* Order of the rows. */
+   char *lines[2];
+   size_t sizes[2];
+   int cur;
+   size_t line_no;
+   struct row row;
+   bool has_row;
+};
+
+static int parse_row(char *line, struct row *row)
+{
+   char *tab = strchr(line, '\t');
+   if (!tab)
+      return -1;
+   *tab = '\0';
+   row->acronym = line;
+   line = tab + 1;
+   if (!(tab = strchr(line, '\t')))
+      return -1;
+   *tab = '\0';
+   row->expansion = line;
+   line = tab + 1;
+
+   size_t *fields[] = {&row->freq, &row->docs, &row->first_doc, &row->last_doc};
+   for (size_t i = 0; i < sizeof fields / sizeof *fields; i++) {
+      char *end;
+      errno = 0;
+      *fields[i] = strtoull(line, &end, 10);
+      if (errno || end == line || *end != (i == 3 ? '\n' : '\t'))
+         return -1;
+      line = end + 1;
+   }
+   return *line ? -1 : 0;
+}
+
+/* Reads the next row. Returns 0 at the end of the run. */
+static int read_row(struct reader *rd)
+{
+   int next = !rd->cur;
+   ssize_t len = getline(&rd->lines[next], &rd->sizes[next], rd->run->fp);
+   if (len < 0) {
+      if (ferror(rd->run->fp))
+         die("cannot read '%s':", rd->run->name);
+      return 0;
+   }
+   rd->line_no++;
+   struct row row;
+   if (parse_row(rd->lines[next], &row))
+      die("%s:%zu: invalid row", rd->run->name, rd->line_no + 1);
+   if (rd->has_row && rd->cmp(&rd->row, &row) >= 0)
+      die("%s:%zu: rows are not sorted", rd->run->name, rd->line_no + 1);
+   rd->row = row;
+   rd->has_row = true;
+   rd->cur = next;
+   return 1;
+}
+
+/* Readers of the runs being merged, in a binary heap. Rows that compare equal
+ * come out in the order of the runs.
+ */
+struct merge {
+   struct reader *readers;
+   size_t *heap;
+   size_t len;
+   row_cmp *cmp;
+};
+
+static bool before(const struct merge *m, size_t a, size_t b)
+{
+   int ret = m->cmp(&m->readers[a].row, &m->readers[b].row);
+   return ret ? ret < 0 : a < b;
+}
+
+static void sift_down(struct merge *m, size_t i)
+{
+   for (;;) {
+      size_t min = i, l = 2 * i + 1, r = l + 1;
+      if (l < m->len && before(m, m->heap[l], m->heap[min]))
+         min = l;
+      if (r < m->len && before(m, m->heap[r], m->heap[min]))
+         min = r;
+      if (min == i)
+         return;
+      size_t tmp = m->heap[i];
+      m->heap[i] = m->heap[min];
+      m->heap[min] = tmp;
+      i = min;
+   }
+}
+
+/* Moves the top reader to its next row, or removes it if it has none. */
+static void advance(struct merge *m)
+{
+   if (!read_row(&m->readers[m->heap[0]]))
+      m->heap[0] = m->heap[--m->len];
+   sift_down(m, 0);
+}
+
+static void combine(struct row *acc, const struct row *row, enum combine how)
+{
+   acc->freq += row->freq;
+   acc->docs += row->docs;
+   if (how == COMBINE_SAME_DOCS && acc->last_doc == row->first_doc)
+      acc->docs--;
+   acc->last_doc = row->last_doc;
+}
+
+/* Merges runs, and passes the resulting rows, in order, to a function. */
+static void merge(struct run *runs, size_t nr, row_cmp *cmp, enum combine how,
+                  void (*emit)(void *, const struct row *), void *arg)
+{
+   struct merge m = {
+      .readers = calloc(nr, sizeof *m.readers),
+      .heap = malloc(nr * sizeof *m.heap),
+      .cmp = cmp,
+   };
+   if (!m.readers || !m.heap)
+      die("out of memory");
+   for (size_t i = 0; i < nr; i++) {
+      m.readers[i].run = &runs[i];
+      m.readers[i].cmp = cmp;
+      if (read_row(&m.readers[i]))
+         m.heap[m.len++] = i;
+   }
+   for (size_t i = m.len / 2; i-- > 0; )
+      sift_down(&m, i);
+
+   char *key = GN_VEC_INIT;
+   while (m.len) {
+      const struct row *top = &m.readers[m.heap[0]].row;
+      if (how == COMBINE_NONE) {
+         emit(arg, top);
+         advance(&m);
+         continue;
+      }
+      /* The row is copied, since the reader buffer is reused. */
+      size_t acr_len = strlen(top->acronym), exp_len = strlen(top->expansion);
+      gn_vec_clear(key);
+      gn_vec_grow(key, acr_len + exp_len + 2);
+      memcpy(key, top->acronym, acr_len + 1);
+      memcpy(&key[acr_len + 1], top->expansion, exp_len + 1);
+      struct row acc = *top;
+      acc.acronym = key;
+      acc.expansion = &key[acr_len + 1];
+      advance(&m);
+      while (m.len && !compare_keys(&m.readers[m.heap[0]].row, &acc)) {
+         combine(&acc, &m.readers[m.heap[0]].row, how);
+         advance(&m);
+      }
+      emit(arg, &acc);
+   }
+   gn_vec_free(key);
+
+   for (size_t i = 0; i < nr; i++) {
+      free(m.readers[i].lines[0]);
+      free(m.readers[i].lines[1]);
+   }
+   free(m.readers);
+   free(m.heap);
+}
+
+static void emit_run(void *fp, const struct row *row)
+{
+   write_row(fp, row);
+}
+
+/* Merges consecutive runs until there are few enough of them to be merged at
+ * once. Merging consecutive runs preserves their order.
+ */
+static void reduce(struct runs *r, row_cmp *cmp, enum combine how)
+{
+   while (gn_vec_len(r->list) > MERGE_WIDTH) {
+      size_t at = 0;
+      while (at < gn_vec_len(r->list)) {
+         size_t nr = gn_vec_len(r->list) - at;
+         if (nr > MERGE_WIDTH)
+            nr = MERGE_WIDTH;
+         if (nr == 1)
+            break;
+         FILE *fp = temp_file(r);
+         merge(&r->list[at], nr, cmp, how, emit_run, fp);
+         for (size_t i = 0; i < nr; i++)
+            close_run(&r->list[at + i]);
+         memmove(&r->list[at], &r->list[at + nr],
+                 (gn_vec_len(r->list) - at - nr) * sizeof *r->list);
+         gn_vec_len(r->list) -= nr;
+         add_temp(r, fp, at);
+         at++;
+      }
+   }
+}
+
+void runs_save(struct runs *r, bool same_docs, FILE *fp)
+{
+   enum combine how = same_docs ? COMBINE_SAME_DOCS : COMBINE_DISTINCT_DOCS;
+   reduce(r, compare_keys, how);
+   fputs(SIGNATURE "\n", fp);
+   merge(r->list, gn_vec_len(r->list), compare_keys, how, emit_run, fp);
+   if (fflush(fp) || ferror(fp))
+      die("cannot write output:");
+}
+
+/* Sorts merged rows by count, in memory while they fit in the budget, and in
+ * runs otherwise.
+ */
+struct sorter {
+   struct runs *runs;
+   struct row *rows;
+   size_t used;               /* Bytes used by rows. */
+   bool docs;
+   FILE *fp;
+};
+
+static int compare_rows(const void *a, const void *b)
+{
+   return compare_counts(a, b);
+}
+
+static void free_rows(struct sorter *s)
+{
+   for (size_t i = 0; i < gn_vec_len(s->rows); i++)
+      free((char *)s->rows[i].acronym);
+   gn_vec_clear(s->rows);
+   s->used = 0;
+}
+
+static void spill_rows(struct sorter *s)
+{
+   qsort(s->rows, gn_vec_len(s->rows), sizeof *s->rows, compare_rows);
+   FILE *fp = temp_file(s->runs);
+   for (size_t i = 0; i < gn_vec_len(s->rows); i++)
+      write_row(fp, &s->rows[i]);
+   add_temp(s->runs, fp, gn_vec_len(s->runs->list));
+   free_rows(s);
+}
+
+static void sort_row(void *arg, const struct row *row)
+{
+   struct sorter *s = arg;
+   size_t acr_len = strlen(row->acronym), exp_len = strlen(row->expansion);
+   char *key = malloc(acr_len + exp_len + 2);
+   if (!key)
+      die("out of memory");
+   memcpy(key, row->acronym, acr_len + 1);
+   memcpy(&key[acr_len + 1], row->expansion, exp_len + 1);
+   struct row copy = *row;
+   copy.acronym = key;
+   copy.expansion = &key[acr_len + 1];
+   gn_vec_push(s->rows, copy);
+   s->used += sizeof copy + acr_len + exp_len + 2;
+   if (s->runs->memory && s->used > s->runs->memory)
+      spill_rows(s);
+}
+
+static void print_row(void *arg, const struct row *row)
+{
+   const struct sorter *s = arg;
+   if (s->docs)
+      fprintf(s->fp, "%zu\t%zu\t%s\t%s\n", row->freq, row->docs, row->acronym,
+              row->expansion);
+   else
+      fprintf(s->fp, "%zu\t%s\t%s\n", row->freq, row->acronym, row->expansion);
+}
+
+void runs_write(struct runs *r, bool same_docs, bool docs, FILE *fp)
+{
+   enum combine how = same_docs ? COMBINE_SAME_DOCS : COMBINE_DISTINCT_DOCS;
+   reduce(r, compare_keys, how);
+
+   struct sorter s = {
+      .runs = runs_new(r->dir, r->memory),
+      .rows = GN_VEC_INIT,
+      .docs = docs,
+      .fp = fp,
+   };
+   merge(r->list, gn_vec_len(r->list), compare_keys, how, sort_row, &s);
+   if (gn_vec_len(s.runs->list)) {
+      spill_rows(&s);
+      reduce(s.runs, compare_counts, COMBINE_NONE);
+      merge(s.runs->list, gn_vec_len(s.runs->list), compare_counts,
+            COMBINE_NONE, print_row, &s);
+   } else {
+      qsort(s.rows, gn_vec_len(s.rows), sizeof *s.rows, compare_rows);
+      for (size_t i = 0; i < gn_vec_len(s.rows); i++)
+         print_row(&s, &s.rows[i]);
+      free_rows(&s);
+   }
+   gn_vec_free(s.rows);
+   runs_free(s.runs);
+   if (fflush(fp) || ferror(fp))
+      die("cannot write output:");
+}
@@ -0,0 +1,55 @@
+#ifndef RUNS_H
+#define RUNS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct gn_counter;
+
+/* Sorted runs of definition counts, for counting with bounded memory.
+ *
+ * When a counter grows too large, its contents are written to a run, a
+ * temporary file in which definitions are sorted, and the counter is cleared.
+ * Runs are merged at the end, combining the counts of identical definitions.
+ *
+ * Run files start with the line "gourgandine-counts 1", followed by one line
+ * per definition:
+ *
+ *    acronym TAB expansion TAB count TAB documents TAB first_doc TAB last_doc
+ *
+ * sorted by acronym, then by expansion, in byte order. The last two fields are
+ * the numbers of the first and last documents the definition was counted in.
+ * Counts can thus be saved as a run file on separate machines, and merged
+ * afterwards.
+ */
+struct runs;
+
+/* Creates an empty list of runs, which temporary files are created in "dir".
+ * When merging runs, at most about "memory" bytes are used for sorting
+ * definitions by count, or an unlimited amount if it is 0.
+ */
+struct runs *runs_new(const char *dir, size_t memory);
+void runs_free(struct runs *);
+
+/* Writes the contents of a counter to a new run, and clears it. Dies on
+ * failure.
+ */
+void runs_spill(struct runs *, struct gn_counter *);
+
+/* Moves the runs of "src" after those of "dst", and frees "src". */
+void runs_append(struct runs *dst, struct runs *src);
+
+/* Adds a run file written by runs_save(). Dies if it cannot be read. */
+void runs_add(struct runs *, const char *path);
+
+/* Merges the runs, and writes the result as a run file, or as TSV rows by
+ * decreasing count, as output_counts() does. If "same_docs" is set, runs hold
+ * counts for the same numbered documents, and a document that is the last one
+ * of a definition in a run and the first one in the next run of the list is
+ * counted once. Otherwise, the runs are assumed to be about distinct
+ * documents. Dies on failure.
+ */
+void runs_save(struct runs *, bool same_docs, FILE *);
+void runs_write(struct runs *, bool same_docs, bool docs, FILE *);
+
+#endif
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+#include "cmd.h"
+#include "ring.h"
+#include "hash.h"
+#include "shard.h"
+#include "../src/vec.h"
+
+/* Buffers a writer can lag behind, and size of its stdio buffer, so that small
+ * outputs are written in large blocks.
+ */
+#define RING_SIZE 64
+#define WRITE_SIZE (4 << 20)
+
+struct shard {
+   struct shards *shards;
+   char *path;
+   FILE *fp;
+   struct ring bufs;          /* NULL marks the end. */
+   thrd_t thread;
+};
+
+struct shards {
+   enum format format;
+   struct shard *shards;
+   size_t nr;
+};
+
+int shard_key(const char *name)
+{
+   if (!strcmp(name, "worker"))
+      return SHARD_BY_WORKER;
+   if (!strcmp(name, "acronym"))
+      return SHARD_BY_ACRONYM;
+   return -1;
+}
+
+size_t shard_of(const char *acronym, size_t len, size_t nr_shards)
+{
+   return hash64(acronym, len, 0) % nr_shards;
+}
+
+static int writer_main(void *arg)
+{
+   struct shard *s = arg;
+   char *buf;
+
+   while ((buf = ring_pop(&s->bufs))) {
+      size_t len = gn_vec_len(buf);
+      if (fwrite(buf, 1, len, s->fp) != len)
+         die("cannot write '%s':", s->path);
+      gn_vec_free(buf);
+   }
+   output_trailer(s->shards->format, s->fp);
+   if (fclose(s->fp))
+      die("cannot write '%s':", s->path);
+   return 0;
+}
+
+struct shards *shards_open(const char *prefix, size_t nr, enum format fmt)
+{
+   struct shards *sh = malloc(sizeof *sh);
+   if (!sh)
+      die("out of memory");
+   *sh = (struct shards){
+      .format = fmt,
+      .shards = calloc(nr, sizeof *sh->shards),
+      .nr = nr,
+   };
+   if (!sh->shards)
+      die("out of memory");
+
+   for (size_t i = 0; i < nr; i++) {
+      struct shard *s = &sh->shards[i];
+      s->shards = sh;
+      int len = snprintf(NULL, 0, "%s.%zu", prefix, i);
+      if (!(s->path = malloc(len + 1)))
+         die("out of memory");
+      snprintf(s->path, len + 1, "%s.%zu", prefix, i);
+      if (!(s->fp = fopen(s->path, "w")))
+         die("cannot open '%s':", s->path);
+      setvbuf(s->fp, NULL, _IOFBF, WRITE_SIZE);
+      output_header(fmt, s->fp);
+      ring_init(&s->bufs, RING_SIZE);
+      if (thrd_create(&s->thread, writer_main, s) != thrd_success)
+         die("cannot create thread");
+   }
+   return sh;
+}
+
+void shards_write(struct shards *sh, size_t shard, char *buf)
+{
+   if (!gn_vec_len(buf)) {
+      gn_vec_free(buf);
+      return;
+   }
+   ring_push(&sh->shards[shard].bufs, buf);
+}
+
+void shards_close(struct shards *sh)
+{
+   for (size_t i = 0; i < sh->nr; i++)
+      ring_push(&sh->shards[i].bufs, NULL);
+   for (size_t i = 0; i < sh->nr; i++) {
+      struct shard *s = &sh->shards[i];
+      thrd_join(s->thread, NULL);
+      ring_fini(&s->bufs);
+      free(s->path);
+   }
+   free(sh->shards);
+   free(sh);
+}
@@ -0,0 +1,40 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include "output.h"
+
+/* Sharded output.
+ *
+ * Output is split among several files PREFIX.0, PREFIX.1, etc., each written
+ * by its own thread, so that writing doesn't serialize workers. Each shard is
+ * a complete output file, with its own header and trailer in binary format.
+ */
+enum shard_key {
+   SHARD_BY_WORKER,           /* Output of a worker goes to the same shard. */
+   SHARD_BY_ACRONYM,          /* Definitions of an acronym go to the same
+                               * shard. */
+};
+
+/* Parses a partitioning key name. Returns -1 if the name is invalid. */
+int shard_key(const char *name);
+
+/* Shard of a normalized acronym: its XXH64 hash, with seed 0, modulo the
+ * number of shards.
+ */
+size_t shard_of(const char *acronym, size_t len, size_t nr_shards);
+
+struct shards;
+
+/* Creates the shard files and starts their writers. Dies on failure. */
+struct shards *shards_open(const char *prefix, size_t nr, enum format);
+
+/* Hands over a byte vector to the writer of a shard, which releases it. Calls
+ * must be serialized. This blocks if the writer is too far behind.
+ */
+void shards_write(struct shards *, size_t shard, char *buf);
+
+/* Writes pending data and closes the files. Dies on failure. */
+void shards_close(struct shards *);
+
+#endif
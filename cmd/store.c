@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cmd.h"
+#include "store.h"
+
+char *format_path(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   int len = vsnprintf(NULL, 0, fmt, ap);
+   va_end(ap);
+   char *path = malloc(len + 1);
+   if (!path)
+      die("out of memory");
+   va_start(ap, fmt);
+   vsnprintf(path, len + 1, fmt, ap);
+   va_end(ap);
+   return path;
+}
+
+char *segment_path(const char *index, size_t segment, bool tmp)
+{
+   return format_path(tmp ? "%s.%zu.tmp" : "%s.%zu", index, segment);
+}
+
+void sync_file(FILE *fp, const char *path)
+{
+   if (fflush(fp) || fsync(fileno(fp)) || ferror(fp))
+      die("cannot write '%s':", path);
+   if (fclose(fp))
+      die("cannot write '%s':", path);
+}
+
+void sync_dir(const char *path)
+{
+   const char *slash = strrchr(path, '/');
+   char *dir = slash ? strndup(path, slash - path + 1) : strdup(".");
+   if (!dir)
+      die("out of memory");
+   int fd = open(dir, O_RDONLY);
+   if (fd < 0 || fsync(fd))
+      die("cannot sync '%s':", dir);
+   close(fd);
+   free(dir);
+}
+
+void commit_file(FILE *fp, const char *tmp, const char *path)
+{
+   sync_file(fp, tmp);
+   if (rename(tmp, path))
+      die("cannot rename '%s':", tmp);
+   sync_dir(path);
+}
+
+void read_index(const char *path, FILE *fp,
+                int (*parse)(void *arg, char *line, size_t line_no), void *arg)
+{
+   char *line = NULL;
+   size_t size = 0;
+   ssize_t len;
+   size_t line_no = 0;
+   while ((len = getline(&line, &size, fp)) > 0) {
+      line_no++;
+      if (line[len - 1] != '\n')
+         die("%s:%zu: truncated line", path, line_no);
+      line[len - 1] = '\0';
+      int ret = parse(arg, line, line_no);
+      if (ret < 0)
+         die("%s:%zu: invalid entry", path, line_no);
+      if (ret)
+         break;
+   }
+   if (ferror(fp))
+      die("cannot read '%s':", path);
+   if (!line_no)
+      die("'%s' is empty", path);
+   free(line);
+}
+
+char *parse_fields(char *line, uint64_t *fields, size_t nr, int base)
+{
+   char *p = line, *end;
+   for (size_t i = 0; i < nr; i++) {
+      errno = 0;
+      fields[i] = strtoull(p, &end, base);
+      if (errno || end == p || *end != ' ')
+         return NULL;
+      p = end + 1;
+   }
+   return *p ? p : NULL;
+}
+
+int compare_inputs(const void *a, const void *b)
+{
+   const char *const *x = a, *const *y = b;
+   return strcmp(*x, *y);
+}
@@ -0,0 +1,49 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Helpers shared by checkpoints and manifests, which are index files FILE,
+ * holding a header line and an entry per input, that refer to segments FILE.0,
+ * FILE.1, etc. All of them are written under a temporary name and renamed when
+ * complete. Functions die on failure.
+ */
+
+/* Formats a path with printf() conventions. The result must be released with
+ * free().
+ */
+char *format_path(const char *fmt, ...);
+
+/* Path of a segment of an index file, or its temporary name. */
+char *segment_path(const char *index, size_t segment, bool tmp);
+
+/* Flushes a file to disk, and closes it. */
+void sync_file(FILE *, const char *path);
+
+/* Syncs the directory holding a file, so that renames in it are durable. */
+void sync_dir(const char *path);
+
+/* Syncs and closes a file written under a temporary name, and renames it. */
+void commit_file(FILE *, const char *tmp, const char *path);
+
+/* Reads an index file, calling "parse" on each of its lines, without their
+ * newline, the first one being the header. This returns -1 if the line is
+ * invalid, 1 to stop reading, 0 otherwise.
+ */
+void read_index(const char *path, FILE *,
+                int (*parse)(void *arg, char *line, size_t line_no), void *arg);
+
+/* Parses "nr" numbers followed by a space at the start of an entry, in the
+ * given base. Returns what follows, which must not be empty, or NULL if the
+ * entry is invalid.
+ */
+char *parse_fields(char *line, uint64_t *fields, size_t nr, int base);
+
+/* Compares entries by input name, for qsort() and bsearch(). Entries must
+ * start with a "char *" member holding the name.
+ */
+int compare_inputs(const void *, const void *);
+
+#endif
@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "uring.h"
+#include "cmd.h"
+#include "../src/vec.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* We don't depend on liburing, the little we need is implemented here. */
+struct uring {
+   int fd;
+   unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+   unsigned *cq_head, *cq_tail, *cq_mask;
+   struct io_uring_sqe *sqes;
+   struct io_uring_cqe *cqes;
+   unsigned to_submit;
+
+   void *sq_map, *cq_map;
+   size_t sq_map_len, cq_map_len, sqes_len;
+};
+
+/* Each slot holds a file being read, and owns a registered buffer. */
+struct slot {
+   enum { SLOT_FREE, SLOT_OPEN, SLOT_READ, SLOT_CLOSE, SLOT_DONE } state;
+   size_t file;
+   int fd;
+   size_t len;                /* Amount of data read so far. */
+   bool failed;
+};
+
+static int uring_setup(struct uring *r, unsigned entries)
+{
+   struct io_uring_params p = {0};
+
+   r->fd = syscall(__NR_io_uring_setup, entries, &p);
+   if (r->fd < 0)
+      return -1;
+
+   r->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   r->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+   if (single) {
+      if (r->cq_map_len > r->sq_map_len)
+         r->sq_map_len = r->cq_map_len;
+      r->cq_map_len = r->sq_map_len;
+   }
+
+   r->sq_map = mmap(NULL, r->sq_map_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+   if (r->sq_map == MAP_FAILED)
+      goto fail_fd;
+   r->cq_map = r->sq_map;
+   if (!single) {
+      r->cq_map = mmap(NULL, r->cq_map_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+      if (r->cq_map == MAP_FAILED)
+         goto fail_sq;
+   }
+   r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+   r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+   if (r->sqes == MAP_FAILED)
+      goto fail_cq;
+
+   char *sq = r->sq_map, *cq = r->cq_map;
+   r->sq_head = (unsigned *)(sq + p.sq_off.head);
+   r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+   r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+   r->sq_array = (unsigned *)(sq + p.sq_off.array);
+   r->cq_head = (unsigned *)(cq + p.cq_off.head);
+   r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+   r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+   r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+   r->to_submit = 0;
+   return 0;
+
+fail_cq:
+   if (!single)
+      munmap(r->cq_map, r->cq_map_len);
+fail_sq:
+   munmap(r->sq_map, r->sq_map_len);
+fail_fd:
+   close(r->fd);
+   return -1;
+}
+
+static void uring_fini(struct uring *r)
+{
+   munmap(r->sqes, r->sqes_len);
+   if (r->cq_map != r->sq_map)
+      munmap(r->cq_map, r->cq_map_len);
+   munmap(r->sq_map, r->sq_map_len);
+   close(r->fd);
+}
+
+/* Checks that the kernel supports the operations we need. */
+static bool uring_probe(struct uring *r)
+{
+   const size_t nr_ops = 256;
+   struct io_uring_probe *probe = calloc(1, sizeof *probe + nr_ops * sizeof probe->ops[0]);
+   if (!probe)
+      die("out of memory");
+
+   bool ok = false;
+   if (!syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PROBE, probe, nr_ops)) {
+      const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_CLOSE};
+      ok = true;
+      for (size_t i = 0; i < sizeof ops / sizeof *ops; i++)
+         if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            ok = false;
+   }
+   free(probe);
+   return ok;
+}
+
+/* There is always room, since each slot has at most one request in flight,
+ * and the ring has at least as many entries as there are slots.
+ */
+static struct io_uring_sqe *uring_sqe(struct uring *r, size_t slot)
+{
+   unsigned tail = *r->sq_tail;
+   unsigned idx = tail & *r->sq_mask;
+   struct io_uring_sqe *sqe = &r->sqes[idx];
+
+   memset(sqe, 0, sizeof *sqe);
+   sqe->user_data = slot;
+   r->sq_array[idx] = idx;
+   __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   r->to_submit++;
+   return sqe;
+}
+
+static void uring_submit_and_wait(struct uring *r)
+{
+   for (;;) {
+      int ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit, 1,
+                        IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret >= 0) {
+         r->to_submit -= ret;
+         return;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+         die("io_uring_enter() failed:");
+   }
+}
+
+struct reader {
+   struct uring ring;
+   struct slot *slots;
+   char *bufs;
+   size_t depth, buf_size;
+   char **paths;
+   size_t next;               /* Next file to open. */
+   size_t delivered;          /* Number of files handed over. */
+   size_t *slot_of;           /* Slot of a file, indexed by file % depth. */
+   size_t active;             /* Number of busy slots. */
+   long failures;
+   const struct uring_ops *ops;
+};
+
+static void submit_open(struct reader *rd, size_t i)
+{
+   struct slot *s = &rd->slots[i];
+   *s = (struct slot){.state = SLOT_OPEN, .file = rd->next++};
+   rd->slot_of[s->file % rd->depth] = i;
+
+   struct io_uring_sqe *sqe = uring_sqe(&rd->ring, i);
+   sqe->opcode = IORING_OP_OPENAT;
+   sqe->fd = AT_FDCWD;
+   sqe->addr = (uintptr_t)rd->paths[s->file];
+   sqe->open_flags = O_RDONLY | O_CLOEXEC;
+   rd->active++;
+}
+
+static void submit_read(struct reader *rd, size_t i)
+{
+   struct slot *s = &rd->slots[i];
+   s->state = SLOT_READ;
+
+   struct io_uring_sqe *sqe = uring_sqe(&rd->ring, i);
+   sqe->opcode = IORING_OP_READ_FIXED;
+   sqe->fd = s->fd;
+   sqe->addr = (uintptr_t)&rd->bufs[i * rd->buf_size + s->len];
+   sqe->len = rd->buf_size - s->len;
+   sqe->off = s->len;
+   sqe->buf_index = i;
+}
+
+static void submit_close(struct reader *rd, size_t i)
+{
+   struct slot *s = &rd->slots[i];
+   s->state = SLOT_CLOSE;
+
+   struct io_uring_sqe *sqe = uring_sqe(&rd->ring, i);
+   sqe->opcode = IORING_OP_CLOSE;
+   sqe->fd = s->fd;
+}
+
+/* Hands over a file to the caller. */
+static void deliver(struct reader *rd, size_t i)
+{
+   struct slot *s = &rd->slots[i];
+
+   if (s->failed) {
+      rd->failures++;
+   } else if (s->len == rd->buf_size) {
+      rd->ops->too_large(rd->ops->arg, s->file);
+   } else {
+      char *data = GN_VEC_INIT;
+      gn_vec_grow(data, s->len ? s->len : 1);
+      memcpy(data, &rd->bufs[i * rd->buf_size], s->len);
+      gn_vec_len(data) = s->len;
+      rd->ops->done(rd->ops->arg, s->file, data);
+   }
+}
+
+/* Files are handed over in order. A slot stays busy until all the files that
+ * precede its own are handed over, which also bounds the number of files that
+ * are read ahead.
+ */
+static void flush(struct reader *rd)
+{
+   while (rd->delivered < rd->next) {
+      size_t i = rd->slot_of[rd->delivered % rd->depth];
+      if (rd->slots[i].state != SLOT_DONE)
+         break;
+      deliver(rd, i);
+      rd->delivered++;
+      rd->slots[i].state = SLOT_FREE;
+      rd->active--;
+      if (rd->paths[rd->next])
+         submit_open(rd, i);
+   }
+}
+
+static void complete(struct reader *rd, const struct io_uring_cqe *cqe)
+{
+   size_t i = cqe->user_data;
+   struct slot *s = &rd->slots[i];
+   const char *path = rd->paths[s->file];
+
+   switch (s->state) {
+   case SLOT_OPEN:
+      if (cqe->res < 0) {
+         errno = -cqe->res;
+         complain("cannot open '%s':", path);
+         s->failed = true;
+         s->state = SLOT_DONE;
+         break;
+      }
+      s->fd = cqe->res;
+      submit_read(rd, i);
+      break;
+   case SLOT_READ:
+      /* The file is read completely when we reach its end before filling
+       * the buffer.
+       */
+      if (cqe->res < 0) {
+         errno = -cqe->res;
+         complain("cannot read '%s':", path);
+         s->failed = true;
+      } else if (cqe->res > 0 && (s->len += cqe->res) < rd->buf_size) {
+         submit_read(rd, i);
+         break;
+      }
+      submit_close(rd, i);
+      break;
+   case SLOT_CLOSE:
+      s->state = SLOT_DONE;
+      break;
+   default:
+      die("unexpected io_uring completion");
+   }
+}
+
+long uring_read(char **paths, size_t depth, size_t buf_size,
+                const struct uring_ops *ops)
+{
+   struct reader rd = {
+      .depth = depth,
+      .buf_size = buf_size,
+      .paths = paths,
+      .ops = ops,
+   };
+   if (uring_setup(&rd.ring, depth))
+      return -1;
+   if (!uring_probe(&rd.ring)) {
+      uring_fini(&rd.ring);
+      return -1;
+   }
+
+   rd.slots = calloc(depth, sizeof *rd.slots);
+   rd.slot_of = calloc(depth, sizeof *rd.slot_of);
+   struct iovec *iov = calloc(depth, sizeof *iov);
+   if (posix_memalign((void **)&rd.bufs, 4096, depth * buf_size)
+    || !rd.slots || !rd.slot_of || !iov)
+      die("out of memory");
+   for (size_t i = 0; i < depth; i++)
+      iov[i] = (struct iovec){&rd.bufs[i * buf_size], buf_size};
+   int ret = syscall(__NR_io_uring_register, rd.ring.fd, IORING_REGISTER_BUFFERS, iov, depth);
+   free(iov);
+   if (ret) {
+      free(rd.slots);
+      free(rd.slot_of);
+      free(rd.bufs);
+      uring_fini(&rd.ring);
+      return -1;
+   }
+
+   for (size_t i = 0; i < depth && paths[rd.next]; i++)
+      submit_open(&rd, i);
+
+   struct uring *r = &rd.ring;
+   while (rd.active) {
+      uring_submit_and_wait(r);
+
+      unsigned head = *r->cq_head;
+      unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+      for ( ; head != tail; head++) {
+         struct io_uring_cqe cqe = r->cqes[head & *r->cq_mask];
+         __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+         complete(&rd, &cqe);
+      }
+      flush(&rd);
+   }
+
+   free(rd.slots);
+   free(rd.slot_of);
+   free(rd.bufs);
+   uring_fini(&rd.ring);
+   return rd.failures;
+}
+
+#else
+
+long uring_read(char **paths, size_t depth, size_t buf_size,
+                const struct uring_ops *ops)
+{
+   (void)paths;
+   (void)depth;
+   (void)buf_size;
+   (void)ops;
+   return -1;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+
+/* Batched file reader based on io_uring, for collections of small files.
+ *
+ * Files are opened, read into registered buffers and closed asynchronously,
+ * with many files in flight at once, which saves most of the system calls and
+ * waiting time of reading them one at a time. Files are handed over in the
+ * order they are given.
+ */
+struct uring_ops {
+   /* Called with the index of a file in the paths array and its contents, as
+    * a byte vector (see src/vec.h) that must be released by the callee.
+    */
+   void (*done)(void *arg, size_t i, char *data);
+
+   /* Called for files that are too large to fit in a buffer. They must be
+    * read by other means.
+    */
+   void (*too_large)(void *arg, size_t i);
+
+   void *arg;
+};
+
+/* Reads the files which paths are given in a NULL-terminated array, keeping
+ * up to "depth" reads in flight, using buffers of "buf_size" bytes. Returns -1
+ * if io_uring is not available on the system, in which case nothing is done.
+ * Otherwise, returns the number of files that could not be read, after
+ * displaying an error message for each.
+ */
+long uring_read(char **paths, size_t depth, size_t buf_size,
+                const struct uring_ops *);
+
+#endif
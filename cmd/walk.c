@@ -0,0 +1,344 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <threads.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "cmd.h"
+#include "walk.h"
+#include "../src/vec.h"
+
+/* Number of threads reading directories. Traversal is bound by the latency of
+ * file system calls rather than by the CPU, so this doesn't depend on the
+ * number of workers.
+ */
+#define WALK_THREADS 4
+
+/* A directory, once read, holds its files and subdirectories sorted by name.
+ * Files are handed over in the order of a depth-first traversal of this tree,
+ * whichever thread reads each directory.
+ */
+struct dir {
+   char *path;
+   char **files;
+   struct dir **subdirs;
+   bool done;                 /* Whether the above are known. */
+};
+
+/* Position of the traversal in a directory. */
+struct frame {
+   struct dir *dir;
+   size_t file, subdir;       /* Next entries to visit. */
+};
+
+struct walk {
+   char **paths;              /* Command-line arguments. */
+   size_t next_arg;
+   char **include, **exclude;
+   bool walking;              /* Whether a directory is being walked. */
+
+   mtx_t lock;
+   cnd_t dirs_cond;           /* Signaled when a directory is queued. */
+   cnd_t done_cond;           /* Signaled when a directory has been read. */
+   struct dir **dirs;         /* Stack of directories to read. */
+   struct dir **all;          /* All directories, released at the end. */
+   struct frame *frames;      /* Path from the root to the current directory. */
+   bool stop;
+   bool failed;
+
+   thrd_t threads[WALK_THREADS];
+   size_t nr_threads;
+};
+
+static bool matches(char **patterns, const char *name, const char *path)
+{
+   for (size_t i = 0; patterns[i]; i++) {
+      if (strchr(patterns[i], '/')) {
+         if (!fnmatch(patterns[i], path, FNM_PATHNAME))
+            return true;
+      } else if (!fnmatch(patterns[i], name, 0)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+static char *join(const char *dir, const char *name)
+{
+   size_t dlen = strlen(dir), nlen = strlen(name);
+   while (dlen > 1 && dir[dlen - 1] == '/')
+      dlen--;
+   char *path = malloc(dlen + 1 + nlen + 1);
+   if (!path)
+      die("out of memory");
+   memcpy(path, dir, dlen);
+   path[dlen] = '/';
+   memcpy(&path[dlen + 1], name, nlen + 1);
+   return path;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+   return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Allocates a directory that has yet to be read. */
+static struct dir *new_dir(char *path)
+{
+   struct dir *d = malloc(sizeof *d);
+   if (!d)
+      die("out of memory");
+   *d = (struct dir){
+      .path = path,
+      .files = GN_VEC_INIT,
+      .subdirs = GN_VEC_INIT,
+   };
+   return d;
+}
+
+/* Queues a directory to be read. Called with the lock held. */
+static void queue_dir(struct walk *w, struct dir *d)
+{
+   gn_vec_push(w->dirs, d);
+   gn_vec_push(w->all, d);
+   cnd_signal(&w->dirs_cond);
+}
+
+/* Reads a directory, queues its subdirectories, and publishes its files. */
+static void read_dir(struct walk *w, struct dir *d)
+{
+   const char *dir = d->path;
+   char **files = GN_VEC_INIT, **subdirs = GN_VEC_INIT;
+   bool failed = false;
+
+   DIR *dp = opendir(dir);
+   if (!dp) {
+      complain("cannot open directory '%s':", dir);
+      failed = true;
+      goto publish;
+   }
+   struct dirent *e;
+   while ((errno = 0, e = readdir(dp))) {
+      const char *name = e->d_name;
+      if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+         continue;
+      char *path = join(dir, name);
+      unsigned char type = e->d_type;
+      if (type == DT_UNKNOWN || type == DT_LNK) {
+         struct stat st;
+         int ret = lstat(path, &st);
+         bool link = !ret && S_ISLNK(st.st_mode);
+         if (link)
+            ret = stat(path, &st);
+         if (ret) {
+            complain("cannot stat '%s':", path);
+            free(path);
+            continue;
+         }
+         if (S_ISREG(st.st_mode))
+            type = DT_REG;
+         else if (S_ISDIR(st.st_mode) && !link)
+            type = DT_DIR;
+         else
+            type = DT_UNKNOWN;
+      }
+      if (w->exclude && matches(w->exclude, name, path)) {
+         free(path);
+      } else if (type == DT_DIR) {
+         gn_vec_push(subdirs, path);
+      } else if (type == DT_REG && (!w->include || matches(w->include, name, path))) {
+         gn_vec_push(files, path);
+      } else {
+         free(path);
+      }
+   }
+   if (errno) {
+      complain("cannot read directory '%s':", dir);
+      failed = true;
+   }
+   closedir(dp);
+
+publish:
+   qsort(files, gn_vec_len(files), sizeof *files, compare_paths);
+   qsort(subdirs, gn_vec_len(subdirs), sizeof *subdirs, compare_paths);
+   mtx_lock(&w->lock);
+   d->files = files;
+   for (size_t i = 0; i < gn_vec_len(subdirs); i++)
+      gn_vec_push(d->subdirs, new_dir(subdirs[i]));
+   /* Stacked in reverse order, so that the first subdirectory, which is the
+    * next one to be traversed, is read first.
+    */
+   for (size_t i = gn_vec_len(d->subdirs); i--; )
+      queue_dir(w, d->subdirs[i]);
+   d->done = true;
+   if (failed)
+      w->failed = true;
+   cnd_signal(&w->done_cond);
+   mtx_unlock(&w->lock);
+   gn_vec_free(subdirs);
+}
+
+static int walker_main(void *arg)
+{
+   struct walk *w = arg;
+
+   mtx_lock(&w->lock);
+   for (;;) {
+      while (!gn_vec_len(w->dirs) && !w->stop)
+         cnd_wait(&w->dirs_cond, &w->lock);
+      if (w->stop)
+         break;
+      struct dir *d = w->dirs[--gn_vec_len(w->dirs)];
+      mtx_unlock(&w->lock);
+
+      read_dir(w, d);
+
+      mtx_lock(&w->lock);
+   }
+   mtx_unlock(&w->lock);
+   return 0;
+}
+
+static void start_walk(struct walk *w, const char *root)
+{
+   if (!w->nr_threads) {
+      for (size_t i = 0; i < WALK_THREADS; i++) {
+         if (thrd_create(&w->threads[i], walker_main, w) != thrd_success)
+            die("cannot create thread");
+         w->nr_threads++;
+      }
+   }
+   char *path = strdup(root);
+   if (!path)
+      die("out of memory");
+   struct dir *d = new_dir(path);
+   struct frame f = {.dir = d};
+   mtx_lock(&w->lock);
+   gn_vec_push(w->frames, f);
+   queue_dir(w, d);
+   mtx_unlock(&w->lock);
+   w->walking = true;
+}
+
+/* Returns the next file of the directory being walked, in traversal order,
+ * waiting for directories to be read as needed, or NULL at the end of the walk.
+ */
+static const char *next_file(struct walk *w)
+{
+   const char *path = NULL;
+   mtx_lock(&w->lock);
+   while (gn_vec_len(w->frames)) {
+      struct frame *f = &w->frames[gn_vec_len(w->frames) - 1];
+      struct dir *d = f->dir;
+      while (!d->done)
+         cnd_wait(&w->done_cond, &w->lock);
+      if (f->file < gn_vec_len(d->files)) {
+         path = d->files[f->file++];
+         break;
+      }
+      if (f->subdir < gn_vec_len(d->subdirs)) {
+         struct frame sub = {.dir = d->subdirs[f->subdir++]};
+         gn_vec_push(w->frames, sub);
+      } else {
+         gn_vec_len(w->frames)--;
+      }
+   }
+   mtx_unlock(&w->lock);
+   return path;
+}
+
+struct walk *walk_start(char **paths, char **include, char **exclude)
+{
+   struct walk *w = calloc(1, sizeof *w);
+   if (!w)
+      die("out of memory");
+   w->paths = paths;
+   w->include = include;
+   w->exclude = exclude;
+   w->dirs = GN_VEC_INIT;
+   w->all = GN_VEC_INIT;
+   w->frames = GN_VEC_INIT;
+   if (mtx_init(&w->lock, mtx_plain) != thrd_success
+      || cnd_init(&w->dirs_cond) != thrd_success
+      || cnd_init(&w->done_cond) != thrd_success)
+      die("cannot initialize walker");
+   return w;
+}
+
+const char *walk_next(struct walk *w)
+{
+   for (;;) {
+      if (w->walking) {
+         const char *path = next_file(w);
+         if (path)
+            return path;
+         w->walking = false;
+      }
+      const char *path = w->paths[w->next_arg];
+      if (!path)
+         return NULL;
+      w->next_arg++;
+      struct stat st;
+      if (!stat(path, &st) && S_ISDIR(st.st_mode))
+         start_walk(w, path);
+      else
+         return path;
+   }
+}
+
+int walk_finish(struct walk *w)
+{
+   mtx_lock(&w->lock);
+   w->stop = true;
+   cnd_broadcast(&w->dirs_cond);
+   mtx_unlock(&w->lock);
+   for (size_t i = 0; i < w->nr_threads; i++)
+      thrd_join(w->threads[i], NULL);
+
+   int ret = w->failed ? -1 : 0;
+   for (size_t i = 0; i < gn_vec_len(w->all); i++) {
+      struct dir *d = w->all[i];
+      for (size_t j = 0; j < gn_vec_len(d->files); j++)
+         free(d->files[j]);
+      gn_vec_free(d->files);
+      gn_vec_free(d->subdirs);
+      free(d->path);
+      free(d);
+   }
+   gn_vec_free(w->dirs);
+   gn_vec_free(w->all);
+   gn_vec_free(w->frames);
+   cnd_destroy(&w->dirs_cond);
+   cnd_destroy(&w->done_cond);
+   mtx_destroy(&w->lock);
+   free(w);
+   return ret;
+}
+
+char **walk_patterns(const char *list)
+{
+   /* The array and a copy of the list are allocated together, so that they
+    * are released with a single call to free().
+    */
+   size_t nr = 1, len = strlen(list);
+   for (const char *p = list; (p = strchr(p, ',')); p++)
+      nr++;
+   char **patterns = malloc((nr + 1) * sizeof *patterns + len + 1);
+   if (!patterns)
+      die("out of memory");
+   char *copy = memcpy(&patterns[nr + 1], list, len + 1);
+
+   nr = 0;
+   for (char *p = copy; *p; ) {
+      size_t plen = strcspn(p, ",");
+      if (plen)
+         patterns[nr++] = p;
+      p += plen;
+      if (*p)
+         *p++ = '\0';
+   }
+   patterns[nr] = NULL;
+   return patterns;
+}
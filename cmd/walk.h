@@ -0,0 +1,41 @@
+#ifndef WALK_H
+#define WALK_H
+
+/* Iteration over the files given on the command-line.
+ *
+ * Directories are walked recursively by several threads, and files are handed
+ * over in the order of a depth-first traversal, as soon as the directories that
+ * come before them have been read, so that processing can start before the
+ * traversal is over. The files of a directory come in lexicographic order,
+ * followed by those of each of its subdirectories, in the same order, whatever
+ * the thread timing, so that document numbers, checkpoints and manifests are
+ * stable from one run to the next on the same tree. Within directories,
+ * symbolic links to files are followed, but symbolic links to directories are
+ * not, so that the traversal can't loop. Paths given on the command-line are
+ * always followed.
+ */
+struct walk;
+
+/* Starts iterating over a NULL-terminated array of paths. Files found in
+ * directories are filtered with NULL-terminated arrays of glob patterns, which
+ * can be NULL. A file is kept if its name matches one of the "include"
+ * patterns, if any, and none of the "exclude" patterns, which also apply to
+ * directories. Patterns containing a slash are matched against the whole path
+ * instead of the name.
+ */
+struct walk *walk_start(char **paths, char **include, char **exclude);
+
+/* Returns the next file, or NULL when there are no more. */
+const char *walk_next(struct walk *);
+
+/* Releases resources. Returns -1 if some directories could not be read. Paths
+ * returned by walk_next() are valid until this is called.
+ */
+int walk_finish(struct walk *);
+
+/* Splits a comma-separated list of glob patterns. Returns a NULL-terminated
+ * array to be released with free(). The list is not modified.
+ */
+char **walk_patterns(const char *list);
+
+#endif
@@ -1,711 +1,392 @@
-#line 1 "encode.c"
-#include <assert.h>
-#line 1 "utf8proc.h"
-/*
- * Copyright (c) 2015 Steven G. Johnson, Jiahao Chen, Peter Colberg, Tony Kelman, Scott P. Jones, and other contributors.
- * Copyright (c) 2009 Public Software Group e. V., Berlin, Germany
- *
- * Permission is hereby granted, free of charge, to any person obtaining a
- * copy of this software and associated documentation files (the "Software"),
- * to deal in the Software without restriction, including without limitation
- * the rights to use, copy, modify, merge, publish, distribute, sublicense,
- * and/or sell copies of the Software, and to permit persons to whom the
- * Software is furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
- * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
- * DEALINGS IN THE SOFTWARE.
- */
+#line 1 "cache.c"
+#include <string.h>
+#line 1 "mascara.h"
+#ifndef MASCARA_H
+#define MASCARA_H
 
+#define MR_VERSION "0.10"
 
-/**
- * @mainpage
- *
- * utf8proc is a free/open-source (MIT/expat licensed) C library
- * providing Unicode normalization, case-folding, and other operations
- * for strings in the UTF-8 encoding, supporting Unicode version
- * 8.0.0.  See the utf8proc home page (http://julialang.org/utf8proc/)
- * for downloads and other information, or the source code on github
- * (https://github.com/JuliaLang/utf8proc).
- *
- * For the utf8proc API documentation, see: @ref utf8proc.h
- *
- * The features of utf8proc include:
- *
- * - Transformation of strings (@ref utf8proc_map) to:
- *    - decompose (@ref UTF8PROC_DECOMPOSE) or compose (@ref UTF8PROC_COMPOSE) Unicode combining characters (http://en.wikipedia.org/wiki/Combining_character)
- *    - canonicalize Unicode compatibility characters (@ref UTF8PROC_COMPAT)
- *    - strip "ignorable" (@ref UTF8PROC_IGNORE) characters, control characters (@ref UTF8PROC_STRIPCC), or combining characters such as accents (@ref UTF8PROC_STRIPMARK)
- *    - case-folding (@ref UTF8PROC_CASEFOLD)
- * - Unicode normalization: @ref utf8proc_NFD, @ref utf8proc_NFC, @ref utf8proc_NFKD, @ref utf8proc_NFKC
- * - Detecting grapheme boundaries (@ref utf8proc_grapheme_break and @ref UTF8PROC_CHARBOUND)
- * - Character-width computation: @ref utf8proc_charwidth
- * - Classification of characters by Unicode category: @ref utf8proc_category and @ref utf8proc_category_string
- * - Encode (@ref utf8proc_encode_char) and decode (@ref utf8proc_iterate) Unicode codepoints to/from UTF-8.
+#include <stddef.h>
+
+/* Location of the directory that contains model files. Should be set at
+ * startup and not changed afterwards. Defaults to "models".
  */
+extern const char *mr_home;
 
-/** @file */
+enum {
+   MR_OK,      /* No error. */
+   MR_EHOME,   /* Cannot find models directory. */
+   MR_EOPEN,   /* Cannot open model file. */
+   MR_EMAGIC,  /* Model file signature mismatch. */
+   MR_EMODEL,  /* Model file is corrupt. */
+   MR_EIO,     /* Cannot read model file. */
+};
 
-#ifndef UTF8PROC_H
-#define UTF8PROC_H
+/* Returns a string describing an error code. */
+const char *mr_strerror(int err);
 
-/** @name API version
- *
- * The utf8proc API version MAJOR.MINOR.PATCH, following
- * semantic-versioning rules (http://semver.org) based on API
- * compatibility.
- *
- * This is also returned at runtime by @ref utf8proc_version; however, the
- * runtime version may append a string like "-dev" to the version number
- * for prerelease versions.
- *
- * @note The shared-library version number in the Makefile may be different,
- *       being based on ABI compatibility rather than API compatibility.
- */
-/** @{ */
-/** The MAJOR version number (increased when backwards API compatibility is broken). */
-#define UTF8PROC_VERSION_MAJOR 1
-/** The MINOR version number (increased when new functionality is added in a backwards-compatible manner). */
-#define UTF8PROC_VERSION_MINOR 3
-/** The PATCH version (increased for fixes that do not change the API). */
-#define UTF8PROC_VERSION_PATCH 0
-/** @} */
+/* Installs a handler for fatal errors. */
+void mr_on_error(void (*handler)(const char *msg));
 
-#include <stdlib.h>
-#include <sys/types.h>
-#ifdef _MSC_VER
-typedef signed char utf8proc_int8_t;
-typedef unsigned char utf8proc_uint8_t;
-typedef short utf8proc_int16_t;
-typedef unsigned short utf8proc_uint16_t;
-typedef int utf8proc_int32_t;
-typedef unsigned int utf8proc_uint32_t;
-#  ifdef _WIN64
-typedef __int64 utf8proc_ssize_t;
-typedef unsigned __int64 utf8proc_size_t;
-#  else
-typedef int utf8proc_ssize_t;
-typedef unsigned int utf8proc_size_t;
-#  endif
-#  ifndef __cplusplus
-typedef unsigned char utf8proc_bool;
-enum {false, true};
-#  else
-typedef bool utf8proc_bool;
-#  endif
-#else
-#  include <stdbool.h>
-#  include <inttypes.h>
-typedef int8_t utf8proc_int8_t;
-typedef uint8_t utf8proc_uint8_t;
-typedef int16_t utf8proc_int16_t;
-typedef uint16_t utf8proc_uint16_t;
-typedef int32_t utf8proc_int32_t;
-typedef uint32_t utf8proc_uint32_t;
-typedef size_t utf8proc_size_t;
-typedef ssize_t utf8proc_ssize_t;
-typedef bool utf8proc_bool;
-#endif
-#include <limits.h>
+/* Token types. See the readme file for informations about these. */
+enum mr_type {
+   MR_UNK,
+   MR_LATIN,
+   MR_PREFIX,
+   MR_SUFFIX,
+   MR_SYM,
+   MR_NUM,
+   MR_ABBR,
+   MR_EMAIL,
+   MR_URI,
+   MR_PATH,
+};
 
-#ifdef _WIN32
-#  ifdef UTF8PROC_EXPORTS
-#    define UTF8PROC_DLLEXPORT __declspec(dllexport)
-#  else
-#    define UTF8PROC_DLLEXPORT __declspec(dllimport)
-#  endif
-#elif __GNUC__ >= 4
-#  define UTF8PROC_DLLEXPORT __attribute__ ((visibility("default")))
-#else
-#  define UTF8PROC_DLLEXPORT
-#endif
+/* String representation of a token type. */
+const char *mr_type_name(enum mr_type);
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+struct mascara;
 
-#ifndef SSIZE_MAX
-#define SSIZE_MAX ((size_t)SIZE_MAX/2)
-#endif
+/* Tokenization modes. */
+enum mr_mode {
+   MR_TOKEN,      /* Iterate over tokens. */
+   MR_SENTENCE,   /* Iterate over sentences (arrays of tokens). */
+};
 
-#ifndef UINT16_MAX
-#  define UINT16_MAX ~(utf8proc_uint16_t)0
-#endif
+/* Returns an array containing the names of the supported languages.
+ * The array is NULL-terminated and lexicographically sorted.
+ */
+const char *const *mr_langs(void);
 
-/**
- * Option flags used by several functions in the library.
+/* Allocates a new tokenizer.
+ * If there is no specific support for the provided language name, chooses a
+ * generic tokenizer.
+ * On success, makes the provided structure pointer point to an allocated
+ * tokenizer, and returns MR_OK. Otherwise, makes it point to NULL, and returns
+ * an error code.
  */
-typedef enum {
-  /** The given UTF-8 input is NULL terminated. */
-  UTF8PROC_NULLTERM  = (1<<0),
-  /** Unicode Versioning Stability has to be respected. */
-  UTF8PROC_STABLE    = (1<<1),
-  /** Compatibility decomposition (i.e. formatting information is lost). */
-  UTF8PROC_COMPAT    = (1<<2),
-  /** Return a result with decomposed characters. */
-  UTF8PROC_COMPOSE   = (1<<3),
-  /** Return a result with decomposed characters. */
-  UTF8PROC_DECOMPOSE = (1<<4),
-  /** Strip "default ignorable characters" such as SOFT-HYPHEN or ZERO-WIDTH-SPACE. */
-  UTF8PROC_IGNORE    = (1<<5),
-  /** Return an error, if the input contains unassigned codepoints. */
-  UTF8PROC_REJECTNA  = (1<<6),
-  /**
-   * Indicating that NLF-sequences (LF, CRLF, CR, NEL) are representing a
-   * line break, and should be converted to the codepoint for line
-   * separation (LS).
-   */
-  UTF8PROC_NLF2LS    = (1<<7),
-  /**
-   * Indicating that NLF-sequences are representing a paragraph break, and
-   * should be converted to the codepoint for paragraph separation
-   * (PS).
-   */
-  UTF8PROC_NLF2PS    = (1<<8),
-  /** Indicating that the meaning of NLF-sequences is unknown. */
-  UTF8PROC_NLF2LF    = (UTF8PROC_NLF2LS | UTF8PROC_NLF2PS),
-  /** Strips and/or convers control characters.
-   *
-   * NLF-sequences are transformed into space, except if one of the
-   * NLF2LS/PS/LF options is given. HorizontalTab (HT) and FormFeed (FF)
-   * are treated as a NLF-sequence in this case.  All other control
-   * characters are simply removed.
-   */
-  UTF8PROC_STRIPCC   = (1<<9),
-  /**
-   * Performs unicode case folding, to be able to do a case-insensitive
-   * string comparison.
-   */
-  UTF8PROC_CASEFOLD  = (1<<10),
-  /**
-   * Inserts 0xFF bytes at the beginning of each sequence which is
-   * representing a single grapheme cluster (see UAX#29).
-   */
-  UTF8PROC_CHARBOUND = (1<<11),
-  /** Lumps certain characters together.
-   *
-   * E.g. HYPHEN U+2010 and MINUS U+2212 to ASCII "-". See lump.md for details.
-   *
-   * If NLF2LF is set, this includes a transformation of paragraph and
-   * line separators to ASCII line-feed (LF).
-   */
-  UTF8PROC_LUMP      = (1<<12),
-  /** Strips all character markings.
-   *
-   * This includes non-spacing, spacing and enclosing (i.e. accents).
-   * @note This option works only with @ref UTF8PROC_COMPOSE or
-   *       @ref UTF8PROC_DECOMPOSE
-   */
-  UTF8PROC_STRIPMARK = (1<<13),
-} utf8proc_option_t;
+int mr_alloc(struct mascara **, const char *lang, enum mr_mode);
 
-/** @name Error codes
- * Error codes being returned by almost all functions.
+/* Destructor. */
+void mr_dealloc(struct mascara *);
+
+/* Allocates a new tokenizer with the same configuration as an existing one.
+ * Models are shared instead of being loaded again, which makes this much
+ * cheaper than mr_alloc(). The copy can be used from another thread, and can
+ * outlive the original.
  */
-/** @{ */
-/** Memory could not be allocated. */
-#define UTF8PROC_ERROR_NOMEM -1
-/** The given string is too long to be processed. */
-#define UTF8PROC_ERROR_OVERFLOW -2
-/** The given string is not a legal UTF-8 string. */
-#define UTF8PROC_ERROR_INVALIDUTF8 -3
-/** The @ref UTF8PROC_REJECTNA flag was set and an unassigned codepoint was found. */
-#define UTF8PROC_ERROR_NOTASSIGNED -4
-/** Invalid options have been used. */
-#define UTF8PROC_ERROR_INVALIDOPTS -5
-/** @} */
+int mr_clone(struct mascara **, const struct mascara *);
 
-/* @name Types */
+/* Returns the chosen tokenization mode. */
+enum mr_mode mr_mode(const struct mascara *);
 
-/** Holds the value of a property. */
-typedef utf8proc_int16_t utf8proc_propval_t;
+/* Sets the text to tokenize.
+ * The input string must be valid UTF-8 and normalized to NFC. No internal check
+ * is made to ensure that this is the case. If this isn't, the result is
+ * undefined. The input string is not copied internally, and should then not be
+ * deallocated until this function is called with a new string.
+ */
+void mr_set_text(struct mascara *, const char *str, size_t len);
 
-/** Struct containing information about a codepoint. */
-typedef struct utf8proc_property_struct {
-  /**
-   * Unicode category.
-   * @see utf8proc_category_t.
-   */
-  utf8proc_propval_t category;
-  utf8proc_propval_t combining_class;
-  /**
-   * Bidirectional class.
-   * @see utf8proc_bidi_class_t.
-   */
-  utf8proc_propval_t bidi_class;
-  /**
-   * @anchor Decomposition type.
-   * @see utf8proc_decomp_type_t.
-   */
-  utf8proc_propval_t decomp_type;
-  utf8proc_uint16_t decomp_mapping;
-  utf8proc_uint16_t casefold_mapping;
-  utf8proc_int32_t uppercase_mapping;
-  utf8proc_int32_t lowercase_mapping;
-  utf8proc_int32_t titlecase_mapping;
-  utf8proc_int32_t comb1st_index;
-  utf8proc_int32_t comb2nd_index;
-  unsigned bidi_mirrored:1;
-  unsigned comp_exclusion:1;
-  /**
-   * Can this codepoint be ignored?
-   *
-   * Used by @ref utf8proc_decompose_char when @ref UTF8PROC_IGNORE is
-   * passed as an option.
-   */
-  unsigned ignorable:1;
-  unsigned control_boundary:1;
-  /**
-   * Boundclass.
-   * @see utf8proc_boundclass_t.
-   */
-  unsigned boundclass:4;
-  /** The width of the codepoint. */
-  unsigned charwidth:2;
-} utf8proc_property_t;
+struct mr_token {
+   const char *str;           /* Not nul-terminated! */
+   size_t len;                /* Length, in bytes. */
+   size_t offset;             /* Offset from the start of the text, in bytes. */
+   enum mr_type type;
+};
 
-/** Unicode categories. */
-typedef enum {
-  UTF8PROC_CATEGORY_CN  = 0, /**< Other, not assigned */
-  UTF8PROC_CATEGORY_LU  = 1, /**< Letter, uppercase */
-  UTF8PROC_CATEGORY_LL  = 2, /**< Letter, lowercase */
-  UTF8PROC_CATEGORY_LT  = 3, /**< Letter, titlecase */
-  UTF8PROC_CATEGORY_LM  = 4, /**< Letter, modifier */
-  UTF8PROC_CATEGORY_LO  = 5, /**< Letter, other */
-  UTF8PROC_CATEGORY_MN  = 6, /**< Mark, nonspacing */
-  UTF8PROC_CATEGORY_MC  = 7, /**< Mark, spacing combining */
-  UTF8PROC_CATEGORY_ME  = 8, /**< Mark, enclosing */
-  UTF8PROC_CATEGORY_ND  = 9, /**< Number, decimal digit */
-  UTF8PROC_CATEGORY_NL = 10, /**< Number, letter */
-  UTF8PROC_CATEGORY_NO = 11, /**< Number, other */
-  UTF8PROC_CATEGORY_PC = 12, /**< Punctuation, connector */
-  UTF8PROC_CATEGORY_PD = 13, /**< Punctuation, dash */
-  UTF8PROC_CATEGORY_PS = 14, /**< Punctuation, open */
-  UTF8PROC_CATEGORY_PE = 15, /**< Punctuation, close */
-  UTF8PROC_CATEGORY_PI = 16, /**< Punctuation, initial quote */
-  UTF8PROC_CATEGORY_PF = 17, /**< Punctuation, final quote */
-  UTF8PROC_CATEGORY_PO = 18, /**< Punctuation, other */
-  UTF8PROC_CATEGORY_SM = 19, /**< Symbol, math */
-  UTF8PROC_CATEGORY_SC = 20, /**< Symbol, currency */
-  UTF8PROC_CATEGORY_SK = 21, /**< Symbol, modifier */
-  UTF8PROC_CATEGORY_SO = 22, /**< Symbol, other */
-  UTF8PROC_CATEGORY_ZS = 23, /**< Separator, space */
-  UTF8PROC_CATEGORY_ZL = 24, /**< Separator, line */
-  UTF8PROC_CATEGORY_ZP = 25, /**< Separator, paragraph */
-  UTF8PROC_CATEGORY_CC = 26, /**< Other, control */
-  UTF8PROC_CATEGORY_CF = 27, /**< Other, format */
-  UTF8PROC_CATEGORY_CS = 28, /**< Other, surrogate */
-  UTF8PROC_CATEGORY_CO = 29, /**< Other, private use */
-} utf8proc_category_t;
+/* Fetch the next token or sentence.
+ * Must be called after mr_set_text().
+ * The behaviour of this function depends on the chosen tokenization mode:
+ * - If it is MR_TOKEN, looks for the next token in the input text. If there is
+ *   one, makes the provided token pointer point to a structure filled with
+ *   informations about it, and returns 1.
+ * - If it is MR_SENTENCE, looks for the next sentence in the input text. If
+ *   there is one, makes the provided token pointer point to an array of token
+ *   structures, and returns the number of tokens in the sentence.
+ * If at the end of the text, makes the provided token pointer point to NULL,
+ * and returns 0.
+ */
+size_t mr_next(struct mascara *, struct mr_token **);
 
-/** Bidirectional character classes. */
-typedef enum {
-  UTF8PROC_BIDI_CLASS_L     = 1, /**< Left-to-Right */
-  UTF8PROC_BIDI_CLASS_LRE   = 2, /**< Left-to-Right Embedding */
-  UTF8PROC_BIDI_CLASS_LRO   = 3, /**< Left-to-Right Override */
-  UTF8PROC_BIDI_CLASS_R     = 4, /**< Right-to-Left */
-  UTF8PROC_BIDI_CLASS_AL    = 5, /**< Right-to-Left Arabic */
-  UTF8PROC_BIDI_CLASS_RLE   = 6, /**< Right-to-Left Embedding */
-  UTF8PROC_BIDI_CLASS_RLO   = 7, /**< Right-to-Left Override */
-  UTF8PROC_BIDI_CLASS_PDF   = 8, /**< Pop Directional Format */
-  UTF8PROC_BIDI_CLASS_EN    = 9, /**< European Number */
-  UTF8PROC_BIDI_CLASS_ES   = 10, /**< European Separator */
-  UTF8PROC_BIDI_CLASS_ET   = 11, /**< European Number Terminator */
-  UTF8PROC_BIDI_CLASS_AN   = 12, /**< Arabic Number */
-  UTF8PROC_BIDI_CLASS_CS   = 13, /**< Common Number Separator */
-  UTF8PROC_BIDI_CLASS_NSM  = 14, /**< Nonspacing Mark */
-  UTF8PROC_BIDI_CLASS_BN   = 15, /**< Boundary Neutral */
-  UTF8PROC_BIDI_CLASS_B    = 16, /**< Paragraph Separator */
-  UTF8PROC_BIDI_CLASS_S    = 17, /**< Segment Separator */
-  UTF8PROC_BIDI_CLASS_WS   = 18, /**< Whitespace */
-  UTF8PROC_BIDI_CLASS_ON   = 19, /**< Other Neutrals */
-  UTF8PROC_BIDI_CLASS_LRI  = 20, /**< Left-to-Right Isolate */
-  UTF8PROC_BIDI_CLASS_RLI  = 21, /**< Right-to-Left Isolate */
-  UTF8PROC_BIDI_CLASS_FSI  = 22, /**< First Strong Isolate */
-  UTF8PROC_BIDI_CLASS_PDI  = 23, /**< Pop Directional Isolate */
-} utf8proc_bidi_class_t;
+#endif
+#line 3 "cache.c"
+#line 1 "api.h"
+#ifndef GOURGANDINE_H
+#define GOURGANDINE_H
 
-/** Decomposition type. */
-typedef enum {
-  UTF8PROC_DECOMP_TYPE_FONT      = 1, /**< Font */
-  UTF8PROC_DECOMP_TYPE_NOBREAK   = 2, /**< Nobreak */
-  UTF8PROC_DECOMP_TYPE_INITIAL   = 3, /**< Initial */
-  UTF8PROC_DECOMP_TYPE_MEDIAL    = 4, /**< Medial */
-  UTF8PROC_DECOMP_TYPE_FINAL     = 5, /**< Final */
-  UTF8PROC_DECOMP_TYPE_ISOLATED  = 6, /**< Isolated */
-  UTF8PROC_DECOMP_TYPE_CIRCLE    = 7, /**< Circle */
-  UTF8PROC_DECOMP_TYPE_SUPER     = 8, /**< Super */
-  UTF8PROC_DECOMP_TYPE_SUB       = 9, /**< Sub */
-  UTF8PROC_DECOMP_TYPE_VERTICAL = 10, /**< Vertical */
-  UTF8PROC_DECOMP_TYPE_WIDE     = 11, /**< Wide */
-  UTF8PROC_DECOMP_TYPE_NARROW   = 12, /**< Narrow */
-  UTF8PROC_DECOMP_TYPE_SMALL    = 13, /**< Small */
-  UTF8PROC_DECOMP_TYPE_SQUARE   = 14, /**< Square */
-  UTF8PROC_DECOMP_TYPE_FRACTION = 15, /**< Fraction */
-  UTF8PROC_DECOMP_TYPE_COMPAT   = 16, /**< Compat */
-} utf8proc_decomp_type_t;
+#define GN_VERSION "0.3"
 
-/** Boundclass property. */
-typedef enum {
-  UTF8PROC_BOUNDCLASS_START              =  0, /**< Start */
-  UTF8PROC_BOUNDCLASS_OTHER              =  1, /**< Other */
-  UTF8PROC_BOUNDCLASS_CR                 =  2, /**< Cr */
-  UTF8PROC_BOUNDCLASS_LF                 =  3, /**< Lf */
-  UTF8PROC_BOUNDCLASS_CONTROL            =  4, /**< Control */
-  UTF8PROC_BOUNDCLASS_EXTEND             =  5, /**< Extend */
-  UTF8PROC_BOUNDCLASS_L                  =  6, /**< L */
-  UTF8PROC_BOUNDCLASS_V                  =  7, /**< V */
-  UTF8PROC_BOUNDCLASS_T                  =  8, /**< T */
-  UTF8PROC_BOUNDCLASS_LV                 =  9, /**< Lv */
-  UTF8PROC_BOUNDCLASS_LVT                = 10, /**< Lvt */
-  UTF8PROC_BOUNDCLASS_REGIONAL_INDICATOR = 11, /**< Regional indicator */
-  UTF8PROC_BOUNDCLASS_SPACINGMARK        = 12, /**< Spacingmark */
-} utf8proc_boundclass_t;
+#include <stddef.h>
 
-/**
- * Array containing the byte lengths of a UTF-8 encoded codepoint based
- * on the first byte.
- */
-UTF8PROC_DLLEXPORT extern const utf8proc_int8_t utf8proc_utf8class[256];
+struct gourgandine *gn_alloc(void);
+void gn_dealloc(struct gourgandine *);
 
-/**
- * Returns the utf8proc API version as a string MAJOR.MINOR.PATCH
- * (http://semver.org format), possibly with a "-dev" suffix for
- * development versions.
- */
-UTF8PROC_DLLEXPORT const char *utf8proc_version(void);
+/* An acronym definition. */
+struct gn_acronym {
 
-/**
- * Returns an informative error string for the given utf8proc error code
- * (e.g. the error codes returned by @ref utf8proc_map).
+   /* The acronym and its expansion, normalized: periods are removed in the
+    * acronym, while double quotes and excessive white space are trimmed in the
+    * corresponding expansion. These strings do not point into the source
+    * text. They are nul-terminated.
+    */
+   const char *acronym;
+   size_t acronym_len;
+   const char *expansion;
+   size_t expansion_len;
+
+   /* Start and end offset, in the input sentence, of the acronym and its
+    * expansion. We count in tokens. The end offset of the expansion is the
+    * offset of the token that follows its last word in the input sentence,
+    * such that substracting the expansion start offset from it gives the
+    * length, in tokens, of the expansion. The same applies to the abbreviation.
+    */
+   size_t acronym_start;
+   size_t acronym_end;
+   size_t expansion_start;
+   size_t expansion_end;
+};
+
+/* Token structure. Declared in my tokenization library
+ * (https://github.com/michaelnmmeyer/mascara), which can be used for
+ * preprocessing.
  */
-UTF8PROC_DLLEXPORT const char *utf8proc_errmsg(utf8proc_ssize_t errcode);
+struct mr_token;
 
-/**
- * Reads a single codepoint from the UTF-8 sequence being pointed to by `str`.
- * The maximum number of bytes read is `strlen`, unless `strlen` is
- * negative (in which case up to 4 bytes are read).
+/* Finds acronym definitions in a sentence.
  *
- * If a valid codepoint could be read, it is stored in the variable
- * pointed to by `codepoint_ref`, otherwise that variable will be set to -1.
- * In case of success, the number of bytes read is returned; otherwise, a
- * negative error code is returned.
+ * If an acronym definition is found in the provided sentence, fills the
+ * provided acronym structure with informations about it, and returns 1.
+ * Otherwise, leaves the acronym structure untouched, and returns 0.
+ *
+ * This must be called several times in a loop to obtain all acronyms in a
+ * sentence. Before the first call, the acronym structure must be zeroed.
+ * Afterwards, the same structure must be passed again, untouched: the offsets
+ * it contains are used to determine where to restart on each call.
+ *
+ * The provided sentence must be valid UTF-8. Otherwise, the result is
+ * undefined.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_iterate(const utf8proc_uint8_t *str, utf8proc_ssize_t strlen, utf8proc_int32_t *codepoint_ref);
+int gn_search(struct gourgandine *, const struct mr_token *sent, size_t sent_len,
+              struct gn_acronym *);
 
-/**
- * Check if a codepoint is valid (regardless of whether it has been
- * assigned a value by the current Unicode standard).
+/* Dictionary of known acronyms and their expansions, compiled from a TSV file
+ * with the "dict" command of the command-line tool. A compiled dictionary is
+ * meant to be mapped in memory: it is read in place, and lookups don't
+ * allocate. Its layout is documented in "src/dict.h".
  *
- * @return 1 if the given `codepoint` is valid and otherwise return 0.
+ * Returns a dictionary reading the given data, which must be aligned on an 8
+ * bytes boundary and stay valid until the dictionary is closed, or NULL if it
+ * is not a compiled dictionary.
  */
-UTF8PROC_DLLEXPORT utf8proc_bool utf8proc_codepoint_valid(utf8proc_int32_t codepoint);
+struct gn_dict *gn_dict_open(const void *data, size_t size);
+void gn_dict_close(struct gn_dict *);
 
-/**
- * Encodes the codepoint as an UTF-8 string in the byte array pointed
- * to by `dst`. This array must be at least 4 bytes long.
- *
- * In case of success the number of bytes written is returned, and
- * otherwise 0 is returned.
- *
- * This function does not check whether `codepoint` is valid Unicode.
+/* Returns the expansion number "i" of an acronym, in the order of the source
+ * dictionary, and stores its length in "exp_len". Periods in the acronym are
+ * ignored. Returns NULL if there is no such expansion.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_encode_char(utf8proc_int32_t codepoint, utf8proc_uint8_t *dst);
+const char *gn_dict_expansion(const struct gn_dict *, const char *acronym,
+                              size_t len, size_t i, size_t *exp_len);
 
-/**
- * Look up the properties for a given codepoint.
+/* Makes gn_search() consult a dictionary, or stop doing so if it is NULL.
+ * Definitions whose expansion doesn't match the acronym by the usual rules are
+ * then accepted if the expansion is one the dictionary gives for it, e.g.:
  *
- * @param codepoint The Unicode codepoint.
+ *    Maritime Forces Atlantic (MARLANT)
  *
- * @returns
- * A pointer to a (constant) struct containing information about
- * the codepoint.
- * @par
- * If the codepoint is unassigned or invalid, a pointer to a special struct is
- * returned in which `category` is 0 (@ref UTF8PROC_CATEGORY_CN).
+ * A dictionary can be shared by several threads.
  */
-UTF8PROC_DLLEXPORT const utf8proc_property_t *utf8proc_get_property(utf8proc_int32_t codepoint);
-
-/** Decompose a codepoint into an array of codepoints.
- *
- * @param codepoint the codepoint.
- * @param dst the destination buffer.
- * @param bufsize the size of the destination buffer.
- * @param options one or more of the following flags:
- * - @ref UTF8PROC_REJECTNA  - return an error `codepoint` is unassigned
- * - @ref UTF8PROC_IGNORE    - strip "default ignorable" codepoints
- * - @ref UTF8PROC_CASEFOLD  - apply Unicode casefolding
- * - @ref UTF8PROC_COMPAT    - replace certain codepoints with their
- *                             compatibility decomposition
- * - @ref UTF8PROC_CHARBOUND - insert 0xFF bytes before each grapheme cluster
- * - @ref UTF8PROC_LUMP      - lump certain different codepoints together
- * - @ref UTF8PROC_STRIPMARK - remove all character marks
- * @param last_boundclass
- * Pointer to an integer variable containing
- * the previous codepoint's boundary class if the @ref UTF8PROC_CHARBOUND
- * option is used.  Otherwise, this parameter is ignored.
- *
- * @return
- * In case of success, the number of codepoints written is returned; in case
- * of an error, a negative error code is returned (@ref utf8proc_errmsg).
- * @par
- * If the number of written codepoints would be bigger than `bufsize`, the
- * required buffer size is returned, while the buffer will be overwritten with
- * undefined data.
+void gn_set_dict(struct gourgandine *, const struct gn_dict *);
+
+/* Cache of the definitions found in the last "size" distinct sentences, for
+ * corpora where the same sentences occur again and again (boilerplate,
+ * disclaimers, navigation text). Sentences are keyed by their bytes, from the
+ * start of their first token to the end of their last one, and the least
+ * recently used one is evicted when the cache is full. A cache is not
+ * thread-safe, and must always be used with the same gourgandine structure,
+ * as cached results depend on its settings.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_decompose_char(
-  utf8proc_int32_t codepoint, utf8proc_int32_t *dst, utf8proc_ssize_t bufsize,
-  utf8proc_option_t options, int *last_boundclass
-);
+struct gn_cache *gn_cache_alloc(size_t size);
+void gn_cache_dealloc(struct gn_cache *);
 
-/**
- * The same as @ref utf8proc_decompose_char, but acts on a whole UTF-8
- * string and orders the decomposed sequences correctly.
- *
- * If the @ref UTF8PROC_NULLTERM flag in `options` is set, processing
- * will be stopped, when a NULL byte is encounted, otherwise `strlen`
- * bytes are processed.  The result (in the form of 32-bit unicode
- * codepoints) is written into the buffer being pointed to by
- * `buffer` (which must contain at least `bufsize` entries).  In case of
- * success, the number of codepoints written is returned; in case of an
- * error, a negative error code is returned (@ref utf8proc_errmsg).
- *
- * If the number of written codepoints would be bigger than `bufsize`, the
- * required buffer size is returned, while the buffer will be overwritten with
- * undefined data.
+/* Finds all acronym definitions in a sentence, as calling gn_search() in a
+ * loop would, and returns their number. Definitions are stored in "defs", and
+ * are valid until the next call. Sentences without an opening bracket, which
+ * can't hold definitions, bypass the cache.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_decompose(
-  const utf8proc_uint8_t *str, utf8proc_ssize_t strlen,
-  utf8proc_int32_t *buffer, utf8proc_ssize_t bufsize, utf8proc_option_t options
-);
+size_t gn_cache_search(struct gn_cache *, struct gourgandine *,
+                       const struct mr_token *sent, size_t sent_len,
+                       const struct gn_acronym **defs);
 
-/**
- * Reencodes the sequence of `length` codepoints pointed to by `buffer`
- * UTF-8 data in-place (i.e., the result is also stored in `buffer`).
- *
- * @param buffer the (native-endian UTF-32) unicode codepoints to re-encode.
- * @param length the length (in codepoints) of the buffer.
- * @param options a bitwise or (`|`) of one or more of the following flags:
- * - @ref UTF8PROC_NLF2LS  - convert LF, CRLF, CR and NEL into LS
- * - @ref UTF8PROC_NLF2PS  - convert LF, CRLF, CR and NEL into PS
- * - @ref UTF8PROC_NLF2LF  - convert LF, CRLF, CR and NEL into LF
- * - @ref UTF8PROC_STRIPCC - strip or convert all non-affected control characters
- * - @ref UTF8PROC_COMPOSE - try to combine decomposed codepoints into composite
- *                           codepoints
- * - @ref UTF8PROC_STABLE  - prohibit combining characters that would violate
- *                           the unicode versioning stability
- *
- * @return
- * In case of success, the length (in bytes) of the resulting UTF-8 string is
- * returned; otherwise, a negative error code is returned (@ref utf8proc_errmsg).
- *
- * @warning The amount of free space pointed to by `buffer` must
- *          exceed the amount of the input data by one byte, and the
- *          entries of the array pointed to by `str` have to be in the
- *          range `0x0000` to `0x10FFFF`. Otherwise, the program might crash!
+/* Number of sentences looked up that were found in the cache, and that were
+ * not.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_reencode(utf8proc_int32_t *buffer, utf8proc_ssize_t length, utf8proc_option_t options);
+void gn_cache_stats(const struct gn_cache *, size_t *hits, size_t *misses);
 
-/**
- * Given a pair of consecutive codepoints, return whether a grapheme break is
- * permitted between them (as defined by the extended grapheme clusters in UAX#29).
+/* Counts of acronym definitions, by normalized acronym and expansion. A
+ * counter is not thread-safe, but counters filled on separate threads can be
+ * merged afterwards.
  */
-UTF8PROC_DLLEXPORT utf8proc_bool utf8proc_grapheme_break(utf8proc_int32_t codepoint1, utf8proc_int32_t codepoint2);
+struct gn_counter *gn_counter_alloc(void);
+void gn_counter_dealloc(struct gn_counter *);
 
-
-/**
- * Given a codepoint `c`, return the codepoint of the corresponding
- * lower-case character, if any; otherwise (if there is no lower-case
- * variant, or if `c` is not a valid codepoint) return `c`.
+/* Counts a definition found in the document numbered "doc". The number of
+ * documents a definition occurs in is only exact if the definitions of a
+ * document are added one after the other.
  */
-UTF8PROC_DLLEXPORT utf8proc_int32_t utf8proc_tolower(utf8proc_int32_t c);
+void gn_counter_add(struct gn_counter *, const struct gn_acronym *, size_t doc);
 
-/**
- * Given a codepoint `c`, return the codepoint of the corresponding
- * upper-case character, if any; otherwise (if there is no upper-case
- * variant, or if `c` is not a valid codepoint) return `c`.
+/* Adds the counts of a counter to another one. A document seen by both
+ * counters is counted twice, unless it is the last document of a definition in
+ * the destination counter and the first one in the source counter, as happens
+ * when merging, in order, the counts of consecutive parts of a document.
  */
-UTF8PROC_DLLEXPORT utf8proc_int32_t utf8proc_toupper(utf8proc_int32_t c);
+void gn_counter_merge(struct gn_counter *dst, const struct gn_counter *src);
 
-/**
- * Given a codepoint, return a character width analogous to `wcwidth(codepoint)`,
- * except that a width of 0 is returned for non-printable codepoints
- * instead of -1 as in `wcwidth`.
- *
- * @note
- * If you want to check for particular types of non-printable characters,
- * (analogous to `isprint` or `iscntrl`), use @ref utf8proc_category. */
-UTF8PROC_DLLEXPORT int utf8proc_charwidth(utf8proc_int32_t codepoint);
+/* A counted definition. Strings are nul-terminated. */
+struct gn_count {
+   const char *acronym;
+   size_t acronym_len;
+   const char *expansion;
+   size_t expansion_len;
+   size_t freq;               /* Number of occurrences. */
+   size_t docs;               /* Number of documents it occurs in. */
+   size_t first_doc;          /* Numbers of the first and last of these */
+   size_t last_doc;           /* documents, in the order they were added. */
+   size_t error;              /* For approximate counts, by how much freq
+                               * may be overestimated. */
+};
 
-/**
- * Return the Unicode category for the codepoint (one of the
- * @ref utf8proc_category_t constants.)
+/* Returns the counted definitions by decreasing frequency, then by acronym
+ * and expansion, and stores their number in "nr". The returned array is valid
+ * until the counter is modified.
  */
-UTF8PROC_DLLEXPORT utf8proc_category_t utf8proc_category(utf8proc_int32_t codepoint);
+const struct gn_count *gn_counter_sort(struct gn_counter *, size_t *nr);
 
-/**
- * Return the two-letter (nul-terminated) Unicode category string for
- * the codepoint (e.g. `"Lu"` or `"Co"`).
+/* Same as gn_counter_sort(), but sorts definitions by acronym, then by
+ * expansion, in byte order, for merging counts with other sorted lists.
  */
-UTF8PROC_DLLEXPORT const char *utf8proc_category_string(utf8proc_int32_t codepoint);
+const struct gn_count *gn_counter_list(struct gn_counter *, size_t *nr);
 
-/**
- * Maps the given UTF-8 string pointed to by `str` to a new UTF-8
- * string, allocated dynamically by `malloc` and returned via `dstptr`.
- *
- * If the @ref UTF8PROC_NULLTERM flag in the `options` field is set,
- * the length is determined by a NULL terminator, otherwise the
- * parameter `strlen` is evaluated to determine the string length, but
- * in any case the result will be NULL terminated (though it might
- * contain NULL characters with the string if `str` contained NULL
- * characters). Other flags in the `options` field are passed to the
- * functions defined above, and regarded as described.
- *
- * In case of success the length of the new string is returned,
- * otherwise a negative error code is returned.
- *
- * @note The memory of the new UTF-8 string will have been allocated
- * with `malloc`, and should therefore be deallocated with `free`.
+/* Number of bytes allocated by the counter, for keeping its size bounded. */
+size_t gn_counter_memory(const struct gn_counter *);
+
+/* Removes all counted definitions, and releases the memory they used. */
+void gn_counter_clear(struct gn_counter *);
+
+/* Approximate counts of the most frequent acronym definitions, with the
+ * Space-Saving algorithm, in fixed memory. Only "k" definitions are tracked.
+ * When a definition that is not tracked is added, it replaces the one with the
+ * lowest count, and inherits its count as error. Counts are thus upper bounds,
+ * and any definition that occurs more than N/k times, N being the total number
+ * of definitions added, is guaranteed to be tracked. As for counters, sketches
+ * filled on separate threads can be merged.
  */
-UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_map(
-  const utf8proc_uint8_t *str, utf8proc_ssize_t strlen, utf8proc_uint8_t **dstptr, utf8proc_option_t options
-);
+struct gn_topk *gn_topk_alloc(size_t k);
+void gn_topk_dealloc(struct gn_topk *);
 
-/** @name Unicode normalization
- *
- * Returns a pointer to newly allocated memory of a NFD, NFC, NFKD or NFKC
- * normalized version of the null-terminated string `str`.  These
- * are shortcuts to calling @ref utf8proc_map with @ref UTF8PROC_NULLTERM
- * combined with @ref UTF8PROC_STABLE and flags indicating the normalization.
+void gn_topk_add(struct gn_topk *, const struct gn_acronym *);
+
+/* Adds the counts of a sketch to another one, which then tracks the "k"
+ * definitions with the highest combined counts.
  */
-/** @{ */
-/** NFD normalization (@ref UTF8PROC_DECOMPOSE). */
-UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFD(const utf8proc_uint8_t *str);
-/** NFC normalization (@ref UTF8PROC_COMPOSE). */
-UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFC(const utf8proc_uint8_t *str);
-/** NFD normalization (@ref UTF8PROC_DECOMPOSE and @ref UTF8PROC_COMPAT). */
-UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFKD(const utf8proc_uint8_t *str);
-/** NFD normalization (@ref UTF8PROC_COMPOSE and @ref UTF8PROC_COMPAT). */
-UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFKC(const utf8proc_uint8_t *str);
-/** @} */
+void gn_topk_merge(struct gn_topk *dst, const struct gn_topk *src);
 
-#ifdef __cplusplus
-}
-#endif
+/* Same as gn_counter_sort(). Document counts are not available. */
+const struct gn_count *gn_topk_sort(struct gn_topk *, size_t *nr);
 
-#endif
-#line 3 "encode.c"
-#line 1 "mascara.h"
-#ifndef MASCARA_H
-#define MASCARA_H
+/* Acronyms defined in a document, for finding where they are used afterwards,
+ * in the same pass over its sentences. Uses are tokens that are equal to a
+ * defined acronym once normalized, and are looked up in a hash table. Only the
+ * first definition of an acronym in a document is kept.
+ */
+struct gn_glossary *gn_glossary_alloc(void);
+void gn_glossary_dealloc(struct gn_glossary *);
 
-#define MR_VERSION "0.10"
+/* Forgets all definitions, before processing a new document. */
+void gn_glossary_clear(struct gn_glossary *);
 
-#include <stddef.h>
+/* Adds a definition found by gn_search() in the current sentence. */
+void gn_glossary_add(struct gn_glossary *, const struct gn_acronym *);
 
-/* Location of the directory that contains model files. Should be set at
- * startup and not changed afterwards. Defaults to "models".
+/* A use of a defined acronym. Strings are nul-terminated, and valid until the
+ * glossary is modified.
  */
-extern const char *mr_home;
-
-enum {
-   MR_OK,      /* No error. */
-   MR_EHOME,   /* Cannot find models directory. */
-   MR_EOPEN,   /* Cannot open model file. */
-   MR_EMAGIC,  /* Model file signature mismatch. */
-   MR_EMODEL,  /* Model file is corrupt. */
-   MR_EIO,     /* Cannot read model file. */
+struct gn_use {
+   const char *acronym;
+   size_t acronym_len;
+   const char *expansion;     /* Expansion of the acronym where it is */
+   size_t expansion_len;      /* defined. */
+   size_t start;              /* Token offsets of the use in the sentence. */
+   size_t end;
+   int known;                 /* Whether the acronym isn't defined in the
+                               * document, and the expansion is the first one
+                               * the dictionary gives. */
 };
 
-/* Returns a string describing an error code. */
-const char *mr_strerror(int err);
+/* Makes gn_glossary_search() also report uses of the acronyms of a dictionary
+ * that are not defined in the document, or stop doing so if it is NULL.
+ */
+void gn_glossary_set_dict(struct gn_glossary *, const struct gn_dict *);
 
-/* Installs a handler for fatal errors. */
-void mr_on_error(void (*handler)(const char *msg));
+/* Finds uses of the defined acronyms in a sentence, after the place they are
+ * defined at. This works as gn_search(): it must be called in a loop, with a
+ * zeroed structure, once the definitions of the sentence have been added.
+ * When it returns 0, the sentence is considered complete: the next call is
+ * about the next sentence of the document.
+ */
+int gn_glossary_search(struct gn_glossary *, const struct mr_token *sent,
+                       size_t sent_len, struct gn_use *);
 
-/* Token types. See the readme file for informations about these. */
-enum mr_type {
-   MR_UNK,
-   MR_LATIN,
-   MR_PREFIX,
-   MR_SUFFIX,
-   MR_SYM,
-   MR_NUM,
-   MR_ABBR,
-   MR_EMAIL,
-   MR_URI,
-   MR_PATH,
-};
+#endif
+#line 4 "cache.c"
+#line 1 "vec.h"
+#ifndef GN_VEC_H
+#define GN_VEC_H
 
-/* String representation of a token type. */
-const char *mr_type_name(enum mr_type);
+#include <stdlib.h>
 
-struct mascara;
+extern size_t gn_vec_void[2];
 
-/* Tokenization modes. */
-enum mr_mode {
-   MR_TOKEN,      /* Iterate over tokens. */
-   MR_SENTENCE,   /* Iterate over sentences (arrays of tokens). */
-};
+#define GN_VEC_INIT (void *)&gn_vec_void[2]
 
-/* Returns an array containing the names of the supported languages.
- * The array is NULL-terminated and lexicographically sorted.
- */
-const char *const *mr_langs(void);
+#define gn_vec_header(vec) ((size_t *)((char *)(vec) - sizeof gn_vec_void))
 
-/* Allocates a new tokenizer.
- * If there is no specific support for the provided language name, chooses a
- * generic tokenizer.
- * On success, makes the provided structure pointer point to an allocated
- * tokenizer, and returns MR_OK. Otherwise, makes it point to NULL, and returns
- * an error code.
- */
-int mr_alloc(struct mascara **, const char *lang, enum mr_mode);
+#define gn_vec_len(vec)  gn_vec_header(vec)[0]
+#define gn_vec_capacity(vec) gn_vec_header(vec)[1]
+#define gn_vec_free(vec) gn_vec_free(gn_vec_header(vec))
 
-/* Destructor. */
-void mr_dealloc(struct mascara *);
+#define gn_vec_grow(vec, nr) do {                                              \
+   vec = gn_vec_grow(gn_vec_header(vec), nr, sizeof *(vec));                   \
+} while (0)
 
-/* Returns the chosen tokenization mode. */
-enum mr_mode mr_mode(const struct mascara *);
+#define gn_vec_clear(vec) do {                                                 \
+   gn_vec_len(vec) = 0;                                                        \
+} while (0)
 
-/* Sets the text to tokenize.
- * The input string must be valid UTF-8 and normalized to NFC. No internal check
- * is made to ensure that this is the case. If this isn't, the result is
- * undefined. The input string is not copied internally, and should then not be
- * deallocated until this function is called with a new string.
- */
-void mr_set_text(struct mascara *, const char *str, size_t len);
+#define gn_vec_push(vec, x) do {                                               \
+   gn_vec_grow(vec, 1);                                                        \
+   vec[gn_vec_len(vec)++] = x;                                                 \
+} while (0)
 
-struct mr_token {
-   const char *str;           /* Not nul-terminated! */
-   size_t len;                /* Length, in bytes. */
-   size_t offset;             /* Offset from the start of the text, in bytes. */
-   enum mr_type type;
-};
+void *(gn_vec_grow)(size_t *vec, size_t incr, size_t elt_size);
 
-/* Fetch the next token or sentence.
- * Must be called after mr_set_text().
- * The behaviour of this function depends on the chosen tokenization mode:
- * - If it is MR_TOKEN, looks for the next token in the input text. If there is
- *   one, makes the provided token pointer point to a structure filled with
- *   informations about it, and returns 1.
- * - If it is MR_SENTENCE, looks for the next sentence in the input text. If
- *   there is one, makes the provided token pointer point to an array of token
- *   structures, and returns the number of tokens in the sentence.
- * If at the end of the text, makes the provided token pointer point to NULL,
- * and returns 0.
- */
-size_t mr_next(struct mascara *, struct mr_token **);
+static inline void (gn_vec_free)(size_t *vec)
+{
+   if (vec != gn_vec_void)
+      free(vec);
+}
 
 #endif
-#line 4 "encode.c"
+#line 5 "cache.c"
+#line 1 "mem.h"
+#ifndef GN_MEM_H
+#define GN_MEM_H
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdnoreturn.h>
 #line 1 "imp.h"
 #ifndef GN_IMP_H
 #define GN_IMP_H
@@ -756,272 +437,1790 @@ void kb_fini(struct kabak *);
 /* Append data at the end of a buffer. */
 void kb_cat(struct kabak *restrict, const char *restrict str, size_t len);
 
-/* Encodes a code point to UTF-8 and appends it to a buffer. */
-void kb_catc(struct kabak *restrict, char32_t);
+/* Encodes a code point to UTF-8 and appends it to a buffer. */
+void kb_catc(struct kabak *restrict, char32_t);
+
+/* Appends a single byte to a buffer. */
+void kb_catb(struct kabak *restrict, int);
+
+/* Appends formatted data to a buffer. */
+void kb_printf(struct kabak *restrict, const char *restrict fmt, ...);
+
+/* Ensures that there's enough room for storing "size" more bytes.
+ * Returns a pointer to the end of the buffer.
+ */
+void *kb_grow(struct kabak *, size_t size);
+
+/* Truncation to the empty string. */
+void kb_clear(struct kabak *);
+
+/* Returns a buffer's contents as an allocated string.
+ * The returned string must be freed with free(). It is zero-terminated. If
+ * "len" is not NULL, it is filled with the length of the returned string.
+ */
+char *kb_detach(struct kabak *restrict, size_t *restrict len);
+
+
+/*******************************************************************************
+ * Normalization.
+ ******************************************************************************/
+
+#define KB_REPLACEMENT_CHAR 0xFFFD
+
+enum {
+   /* Compose code points. */
+   KB_COMPOSE = 1 << 0,
+   
+   /* Decompose code points. */
+   KB_DECOMPOSE = 1 << 1,
+   
+   /* Use compatibility mappings, with custom additional mappings. Must be
+    * combined with KB_COMPOSE or KB_DECOMPOSE to be taken into account.
+    */
+   KB_COMPAT = 1 << 2,
+   
+   /* Lump some characters together. */
+   KB_LUMP = 1 << 3,
+   
+   /* Use Unicode casefold mappings. */
+   KB_CASE_FOLD = 1 << 4,
+
+   /* Drop code points in Default_Ignorable_Code_Point. See
+    * http://www.unicode.org/Public/8.0.0/ucd/DerivedCoreProperties.txt
+    */
+   KB_STRIP_IGNORABLE = 1 << 5,
+   
+   /* Drop code points in categories Cn (Other, Not Assigned) and Co (Other,
+    * Private Use). Code points in Cs (Other, Surrogate) don't appear in UTF-8
+    * strings.
+    */
+   KB_STRIP_UNKNOWN = 1 << 6,
+   
+   /* Drop diacritical marks (categories Mc, Me, and Mn). Must be combined with
+    * KB_COMPOSE or KB_DECOMPOSE to be taken into account.
+    */
+   KB_STRIP_DIACRITIC = 1 << 7,
+
+   /* NFC normalization. */
+   KB_NFC = KB_COMPOSE | KB_DECOMPOSE,
+   
+   /* NFKC normalization (with custom additional mappings). */
+   KB_NFKC = KB_COMPOSE | KB_DECOMPOSE | KB_COMPAT,
+};
+
+/* Transforms a string in some way.
+ * On success, returns KB_OK, otherwise an error code. In both cases, the
+ * output buffer is filled with the normalized string.
+ * Bytes that cannot form valid UTF-8 sequences are replaced with REPLACEMENT
+ * CHARACTER (U+FFFD). Unassigned code points and non-characters are deemed to
+ * be valid. Only surrogates and code points > 0x10FFFF are considered invalid.
+ * The output buffer is cleared beforehand.
+ */
+int kb_transform(struct kabak *restrict, const char *restrict str, size_t len,
+                 unsigned opts);
+
+
+/*******************************************************************************
+ * I/O.
+ ******************************************************************************/
+
+/* FILE object wrapper. */
+struct kb_file {
+   FILE *fp;
+   size_t pending;
+   uint8_t backup[4];
+   char32_t last;
+};
+
+/* Wraps an opened file for reading UTF-8 data from it.
+ * The file can be opened in binary mode. It must not be used while the
+ * kb_file structure is in use. It must be closed by the caller after use if
+ * necessary. We assume that no data has been read from the file yet, and check
+ * for a leading BOM.
+ */
+void kb_wrap(struct kb_file *restrict, FILE *restrict);
+
+/* Reads a single line from a file and, optionally, normalizes it.
+ * All possible EOL sequences are supported. The EOL sequence at the end of a
+ * line, if any, is trimmed. The last line of the file is skipped if empty.
+ * Returns KB_OK if a line was read, KB_FINI if at EOF, otherwise an error code.
+ * I/O errors are not reported and must be checked separately. Notes above
+ * kb_transform() apply here, too.
+ */
+int kb_get_line(struct kb_file *restrict, struct kabak *restrict,
+                unsigned opts);
+
+
+/*******************************************************************************
+ * UTF-8.
+ ******************************************************************************/
+
+/* Decodes a single code point.
+ * *clen is filled with the number of decoded bytes.
+ * Typical usage:
+ *
+ *   for (size_t i = 0, clen; i < len; i += clen)
+ *      char32_t c = kb_decode(&str[i], &clen);
+ *
+ * The provided UTF-8 string must be valid.
+ */
+char32_t kb_decode(const char *restrict str, size_t *restrict clen);
+
+/* Safe version of kb_decode().
+ *
+ * Bytes that cannot form valid UTF-8 sequences are replaced with REPLACEMENT
+ * CHARACTER (U+FFFD). In this case, *clen is set to 1. If at the end of the
+ * string, REPLACEMENT CHARACTER is also returned, but *clen is set to 0.
+ * Typical usage:
+ *
+ *   for (size_t i = 0, clen; i < len; i += clen) {
+ *      char32_t c = kb_decode_s(&str[i], len - i, &clen);
+ *      if (c == KB_REPLACEMENT_CHAR && clen == 1)
+ *         puts("encoding error");
+ *   }
+ */
+char32_t kb_decode_s(const char *restrict str, size_t len,
+                     size_t *restrict clen);
+
+/* Encodes a single code point.
+ * Returns the number of bytes written.
+ * The provided code point must be valid.
+ */
+size_t kb_encode(char buf[static 4], char32_t c);
+
+/* Counts the number of code points in a UTF-8 string.
+ * The provided UTF-8 string must be valid.
+ */
+size_t kb_count(const char *str, size_t len);
+
+/* Returns the offset of the nth code point of a string.
+ * If n is negative, code points are counted from the end of the string.
+ * If the input string contains less than abs(n) code point, the string length
+ * is returned if n is strictly positive, zero otherwise.
+ * The provided UTF-8 string must be valid.
+ */
+size_t kb_offset(const char *str, size_t len, ptrdiff_t n);
+
+
+/*******************************************************************************
+ * Character classification.
+ ******************************************************************************/
+
+enum kb_category {
+   KB_CATEGORY_CN,
+   KB_CATEGORY_LU,
+   KB_CATEGORY_LL,
+   KB_CATEGORY_LT,
+   KB_CATEGORY_LM,
+   KB_CATEGORY_LO,
+   KB_CATEGORY_MN,
+   KB_CATEGORY_MC,
+   KB_CATEGORY_ME,
+   KB_CATEGORY_ND,
+   KB_CATEGORY_NL,
+   KB_CATEGORY_NO,
+   KB_CATEGORY_PC,
+   KB_CATEGORY_PD,
+   KB_CATEGORY_PS,
+   KB_CATEGORY_PE,
+   KB_CATEGORY_PI,
+   KB_CATEGORY_PF,
+   KB_CATEGORY_PO,
+   KB_CATEGORY_SM,
+   KB_CATEGORY_SC,
+   KB_CATEGORY_SK,
+   KB_CATEGORY_SO,
+   KB_CATEGORY_ZS,
+   KB_CATEGORY_ZL,
+   KB_CATEGORY_ZP,
+   KB_CATEGORY_CC,
+   KB_CATEGORY_CF,
+   KB_CATEGORY_CS,
+   KB_CATEGORY_CO,
+};
+
+enum kb_category kb_category(char32_t);
+
+/* Categories L*. */
+bool kb_is_letter(char32_t);
+
+/* Category Lu. */
+bool kb_is_upper(char32_t);
+
+/* Category Ll. */
+bool kb_is_lower(char32_t);
+
+/* Categories N*. */
+bool kb_is_number(char32_t);
+
+/* Code points 0009..000D, 0085 and categories Z*. */
+bool kb_is_space(char32_t);
+
+#endif
+#line 8 "imp.h"
+
+struct span {
+   size_t start;
+   size_t end;
+};
+
+struct gourgandine {
+
+   /* Buffer for normalizing an acronym and its expansion. They are stored
+    * consecutively: acronym '\0' expansion '\0'.
+    */
+   char *buf;
+
+   /* Buffer for holding the string to match, which is normalized. We write here
+    * a string of the form: acronym TAB (expansion_word SPACE)+.
+    */
+   int32_t *str;
+
+   /* Over-segmenting tokens is necessary for matching, e.g.:
+    *
+    *    [GAP] D-glyercaldehyde 3-phosphate
+    *
+    * Our tokenizer doesn't split on '-', in particular, so we must perform a
+    * new segmentation of each token. The following keeps track of the relation
+    * between the token chunks we produce here and the position of the
+    * corresponding token in the input sentence, so that we can obtain correct
+    * offsets after processing.
+    */
+   struct assoc {
+      /* Offset in the "str" of the current normalized token. */
+      size_t norm_off;
+      /* Position of the corresponding real token in the sentence. */
+      size_t token_no;
+   } *tokens;
+
+   /* Dictionary of known acronyms, or NULL. */
+   const struct gn_dict *dict;
+};
+
+struct gn_acronym;
+
+local void gn_encode(struct gourgandine *rec, const struct mr_token *sent,
+                     size_t abbr, const struct span *exp);
+
+local void gn_extract(struct gourgandine *rec, const struct mr_token *sent,
+                      struct gn_acronym *def);
+
+struct gn_dict;
+struct gn_dict_acronym;
+
+/* Finds an acronym in a dictionary. Periods in the given string are ignored.
+ * Returns NULL if it is not there.
+ */
+local const struct gn_dict_acronym *gn_dict_lookup(const struct gn_dict *,
+                                                   const char *str, size_t len);
+
+/* Returns the normalized form of a dictionary acronym. */
+local const char *gn_dict_key(const struct gn_dict *,
+                              const struct gn_dict_acronym *);
+
+/* Returns the expansion number "i" of a dictionary acronym, or NULL if the
+ * dictionary is corrupt.
+ */
+local const char *gn_dict_get(const struct gn_dict *,
+                              const struct gn_dict_acronym *, size_t i,
+                              size_t *len);
+
+/* Same as extract_rev() and extract_fwd(), but matches the text against the
+ * expansions the dictionary gives for the acronym.
+ */
+local bool gn_dict_match_rev(const struct gn_dict *, const struct mr_token *sent,
+                             size_t abbr, struct span *exp);
+local bool gn_dict_match_fwd(const struct gn_dict *, const struct mr_token *sent,
+                             size_t abbr, struct span *exp);
+#endif
+#line 8 "mem.h"
+
+local noreturn void gn_fatal(const char *msg, ...);
+
+local void *gn_malloc(size_t)
+#ifdef ___GNUC__
+   __attribute__((malloc))
+#endif
+   ;
+
+local void *gn_realloc(void *, size_t);
+
+#endif
+#line 6 "cache.c"
+
+#define CACHE_NONE SIZE_MAX
+
+/* A definition of a cached sentence. Strings are offsets into the sentence
+ * entry arena, as: acronym '\0' expansion '\0'.
+ */
+struct cached_def {
+   size_t str;
+   size_t acronym_len, expansion_len;
+   size_t acronym_start, acronym_end;
+   size_t expansion_start, expansion_end;
+};
+
+struct cached {
+   uint64_t hash;
+   char *text;                /* Sentence bytes. */
+   size_t tokens;             /* Number of tokens. */
+   struct cached_def *defs;
+   char *arena;
+   size_t prev, next;         /* Neighbours in the recency list. */
+};
+
+struct gn_cache {
+   struct cached *entries;
+   size_t size, used;
+
+   /* Open-addressing table with linear probing, as for counters, at most half
+    * full.
+    */
+   size_t *slots;
+   size_t mask;
+
+   size_t head, tail;         /* Most and least recently used entries. */
+   struct gn_acronym *found;
+   size_t hits, misses;
+};
+
+struct gn_cache *gn_cache_alloc(size_t size)
+{
+   if (!size)
+      size = 1;
+   size_t nr_slots = 2;
+   while (nr_slots / 2 < size) {
+      if (nr_slots > SIZE_MAX / 2 / sizeof(size_t))
+         gn_fatal("integer overflow");
+      nr_slots *= 2;
+   }
+   if (size > SIZE_MAX / sizeof(struct cached))
+      gn_fatal("integer overflow");
+
+   struct gn_cache *c = gn_malloc(sizeof *c);
+   *c = (struct gn_cache){
+      .entries = gn_malloc(size * sizeof *c->entries),
+      .size = size,
+      .slots = gn_malloc(nr_slots * sizeof *c->slots),
+      .mask = nr_slots - 1,
+      .head = CACHE_NONE,
+      .tail = CACHE_NONE,
+      .found = GN_VEC_INIT,
+   };
+   memset(c->slots, 0, nr_slots * sizeof *c->slots);
+   return c;
+}
+
+void gn_cache_dealloc(struct gn_cache *c)
+{
+   for (size_t i = 0; i < c->used; i++) {
+      gn_vec_free(c->entries[i].text);
+      gn_vec_free(c->entries[i].defs);
+      gn_vec_free(c->entries[i].arena);
+   }
+   gn_vec_free(c->found);
+   free(c->entries);
+   free(c->slots);
+   free(c);
+}
+
+void gn_cache_stats(const struct gn_cache *c, size_t *hits, size_t *misses)
+{
+   *hits = c->hits;
+   *misses = c->misses;
+}
+
+/* FNV-1a. */
+static uint64_t cache_hash(const char *str, size_t len, size_t tokens)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325) ^ tokens;
+   for (size_t i = 0; i < len; i++) {
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+static void cache_detach(struct gn_cache *c, size_t i)
+{
+   struct cached *e = &c->entries[i];
+   if (e->prev != CACHE_NONE)
+      c->entries[e->prev].next = e->next;
+   else
+      c->head = e->next;
+   if (e->next != CACHE_NONE)
+      c->entries[e->next].prev = e->prev;
+   else
+      c->tail = e->prev;
+}
+
+static void cache_push(struct gn_cache *c, size_t i)
+{
+   struct cached *e = &c->entries[i];
+   e->prev = CACHE_NONE;
+   e->next = c->head;
+   if (c->head != CACHE_NONE)
+      c->entries[c->head].prev = i;
+   else
+      c->tail = i;
+   c->head = i;
+}
+
+/* Frees a slot, moving following slots back if needed, as for top-k
+ * sketches.
+ */
+static void cache_unlink(struct gn_cache *c, size_t pos)
+{
+   size_t i = pos, j = pos;
+   for (;;) {
+      j = (j + 1) & c->mask;
+      if (!c->slots[j])
+         break;
+      size_t home = c->entries[c->slots[j] - 1].hash & c->mask;
+      if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+         c->slots[i] = c->slots[j];
+         i = j;
+      }
+   }
+   c->slots[i] = 0;
+}
+
+/* Returns the slot of an entry. */
+static size_t cache_slot_of(const struct gn_cache *c, size_t i)
+{
+   size_t pos = c->entries[i].hash & c->mask;
+   while (c->slots[pos] != i + 1)
+      pos = (pos + 1) & c->mask;
+   return pos;
+}
+
+/* Only sentences with an opening bracket after their first token, and
+ * followed by another token, can hold definitions, as in gn_search().
+ */
+static bool has_opening_bracket(const struct mr_token *sent, size_t len)
+{
+   for (size_t i = 1; i + 1 < len; i++)
+      if (sent[i].len == 1 && (*sent[i].str == '(' || *sent[i].str == '['
+                            || *sent[i].str == '{'))
+         return true;
+   return false;
+}
+
+static void cache_fill(struct cached *e, struct gourgandine *gn,
+                       const struct mr_token *sent, size_t len)
+{
+   gn_vec_clear(e->defs);
+   gn_vec_clear(e->arena);
+
+   struct gn_acronym def = {0};
+   while (gn_search(gn, sent, len, &def)) {
+      struct cached_def d = {
+         .str = gn_vec_len(e->arena),
+         .acronym_len = def.acronym_len,
+         .expansion_len = def.expansion_len,
+         .acronym_start = def.acronym_start,
+         .acronym_end = def.acronym_end,
+         .expansion_start = def.expansion_start,
+         .expansion_end = def.expansion_end,
+      };
+      size_t size = def.acronym_len + def.expansion_len + 2;
+      gn_vec_grow(e->arena, size);
+      char *str = &e->arena[d.str];
+      memcpy(str, def.acronym, def.acronym_len + 1);
+      memcpy(&str[def.acronym_len + 1], def.expansion, def.expansion_len + 1);
+      gn_vec_len(e->arena) += size;
+      gn_vec_push(e->defs, d);
+   }
+}
+
+size_t gn_cache_search(struct gn_cache *c, struct gourgandine *gn,
+                       const struct mr_token *sent, size_t len,
+                       const struct gn_acronym **defs)
+{
+   *defs = NULL;
+   if (!has_opening_bracket(sent, len))
+      return 0;
+
+   const char *text = sent[0].str;
+   size_t text_len = sent[len - 1].str + sent[len - 1].len - text;
+   uint64_t h = cache_hash(text, text_len, len);
+
+   size_t pos = h & c->mask;
+   size_t idx;
+   while ((idx = c->slots[pos])) {
+      const struct cached *e = &c->entries[idx - 1];
+      if (e->hash == h && e->tokens == len && gn_vec_len(e->text) == text_len
+       && !memcmp(e->text, text, text_len))
+         break;
+      pos = (pos + 1) & c->mask;
+   }
+
+   size_t i;
+   if (idx) {
+      c->hits++;
+      i = idx - 1;
+      cache_detach(c, i);
+   } else {
+      c->misses++;
+      if (c->used < c->size) {
+         i = c->used++;
+         c->entries[i] = (struct cached){
+            .text = GN_VEC_INIT,
+            .defs = GN_VEC_INIT,
+            .arena = GN_VEC_INIT,
+         };
+      } else {
+         /* Evict the least recently used sentence. */
+         i = c->tail;
+         cache_detach(c, i);
+         cache_unlink(c, cache_slot_of(c, i));
+         pos = h & c->mask;
+         while (c->slots[pos])
+            pos = (pos + 1) & c->mask;
+      }
+      struct cached *e = &c->entries[i];
+      e->hash = h;
+      e->tokens = len;
+      gn_vec_clear(e->text);
+      gn_vec_grow(e->text, text_len);
+      memcpy(e->text, text, text_len);
+      gn_vec_len(e->text) = text_len;
+      cache_fill(e, gn, sent, len);
+      c->slots[pos] = i + 1;
+   }
+   cache_push(c, i);
+
+   const struct cached *e = &c->entries[i];
+   size_t nr = gn_vec_len(e->defs);
+   gn_vec_clear(c->found);
+   gn_vec_grow(c->found, nr);
+   for (size_t j = 0; j < nr; j++) {
+      const struct cached_def *d = &e->defs[j];
+      c->found[j] = (struct gn_acronym){
+         .acronym = &e->arena[d->str],
+         .acronym_len = d->acronym_len,
+         .expansion = &e->arena[d->str + d->acronym_len + 1],
+         .expansion_len = d->expansion_len,
+         .acronym_start = d->acronym_start,
+         .acronym_end = d->acronym_end,
+         .expansion_start = d->expansion_start,
+         .expansion_end = d->expansion_end,
+      };
+   }
+   gn_vec_len(c->found) = nr;
+   *defs = c->found;
+   return nr;
+}
+#line 1 "count.c"
+#include <string.h>
+#include <assert.h>
+
+/* A counted definition. Strings are stored in the arena, as: acronym '\0'
+ * expansion '\0'. We keep offsets rather than pointers, since the arena moves
+ * when it grows.
+ */
+struct pair {
+   uint64_t hash;
+   size_t str;
+   size_t acronym_len, expansion_len;
+   size_t freq, docs;
+   size_t first_doc, last_doc;   /* In order of addition, if docs > 0. */
+};
+
+struct gn_counter {
+   struct pair *pairs;        /* In insertion order. */
+   char *arena;
+
+   /* Open-addressing table with linear probing. Each slot holds the index of
+    * a pair incremented by one, or 0 if the slot is free. Its size is a power
+    * of two, and it is kept at most half full.
+    */
+   size_t *slots;
+   size_t mask;
+
+   struct gn_count *sorted;
+};
+
+#define MIN_SLOTS 256
+
+/* FNV-1a. */
+static uint64_t hash_str(uint64_t h, const char *str, size_t len)
+{
+   for (size_t i = 0; i < len; i++) {
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+static uint64_t hash_pair(const char *acr, size_t acr_len,
+                          const char *exp, size_t exp_len)
+{
+   uint64_t h = hash_str(UINT64_C(0xcbf29ce484222325), acr, acr_len);
+   return hash_str(h ^ 0xff, exp, exp_len);
+}
+
+struct gn_counter *gn_counter_alloc(void)
+{
+   struct gn_counter *c = gn_malloc(sizeof *c);
+   *c = (struct gn_counter){
+      .pairs = GN_VEC_INIT,
+      .arena = GN_VEC_INIT,
+      .slots = gn_malloc(MIN_SLOTS * sizeof *c->slots),
+      .mask = MIN_SLOTS - 1,
+      .sorted = GN_VEC_INIT,
+   };
+   memset(c->slots, 0, MIN_SLOTS * sizeof *c->slots);
+   return c;
+}
+
+void gn_counter_dealloc(struct gn_counter *c)
+{
+   gn_vec_free(c->pairs);
+   gn_vec_free(c->arena);
+   gn_vec_free(c->sorted);
+   free(c->slots);
+   free(c);
+}
+
+static void rehash(struct gn_counter *c)
+{
+   size_t size = (c->mask + 1) * 2;
+   if (size > SIZE_MAX / sizeof *c->slots)
+      gn_fatal("integer overflow");
+   free(c->slots);
+   c->slots = gn_malloc(size * sizeof *c->slots);
+   memset(c->slots, 0, size * sizeof *c->slots);
+   c->mask = size - 1;
+
+   for (size_t i = 0; i < gn_vec_len(c->pairs); i++) {
+      size_t pos = c->pairs[i].hash & c->mask;
+      while (c->slots[pos])
+         pos = (pos + 1) & c->mask;
+      c->slots[pos] = i + 1;
+   }
+}
+
+/* Returns the pair for a definition, adding it with null counts if needed. */
+static struct pair *find_pair(struct gn_counter *c,
+                              const char *acr, size_t acr_len,
+                              const char *exp, size_t exp_len)
+{
+   uint64_t h = hash_pair(acr, acr_len, exp, exp_len);
+   size_t pos = h & c->mask;
+   size_t idx;
+   while ((idx = c->slots[pos])) {
+      struct pair *p = &c->pairs[idx - 1];
+      const char *str = &c->arena[p->str];
+      if (p->hash == h && p->acronym_len == acr_len && p->expansion_len == exp_len
+       && !memcmp(str, acr, acr_len) && !memcmp(&str[acr_len + 1], exp, exp_len))
+         return p;
+      pos = (pos + 1) & c->mask;
+   }
+
+   struct pair p = {
+      .hash = h,
+      .str = gn_vec_len(c->arena),
+      .acronym_len = acr_len,
+      .expansion_len = exp_len,
+   };
+   gn_vec_grow(c->arena, acr_len + exp_len + 2);
+   char *str = &c->arena[p.str];
+   memcpy(str, acr, acr_len);
+   str[acr_len] = '\0';
+   memcpy(&str[acr_len + 1], exp, exp_len);
+   str[acr_len + 1 + exp_len] = '\0';
+   gn_vec_len(c->arena) += acr_len + exp_len + 2;
+
+   gn_vec_push(c->pairs, p);
+   c->slots[pos] = gn_vec_len(c->pairs);
+   if (gn_vec_len(c->pairs) > (c->mask + 1) / 2)
+      rehash(c);
+   return &c->pairs[gn_vec_len(c->pairs) - 1];
+}
+
+void gn_counter_add(struct gn_counter *c, const struct gn_acronym *def,
+                    size_t doc)
+{
+   struct pair *p = find_pair(c, def->acronym, def->acronym_len,
+                              def->expansion, def->expansion_len);
+   p->freq++;
+   if (!p->docs) {
+      p->first_doc = p->last_doc = doc;
+      p->docs = 1;
+   } else if (doc != p->last_doc) {
+      p->last_doc = doc;
+      p->docs++;
+   }
+}
+
+void gn_counter_merge(struct gn_counter *dst, const struct gn_counter *src)
+{
+   assert(dst != src);
+   for (size_t i = 0; i < gn_vec_len(src->pairs); i++) {
+      const struct pair *s = &src->pairs[i];
+      const char *str = &src->arena[s->str];
+      struct pair *d = find_pair(dst, str, s->acronym_len,
+                                 &str[s->acronym_len + 1], s->expansion_len);
+      d->freq += s->freq;
+      if (!d->docs) {
+         d->docs = s->docs;
+         d->first_doc = s->first_doc;
+         d->last_doc = s->last_doc;
+         continue;
+      }
+      d->docs += s->docs - (d->last_doc == s->first_doc);
+      d->last_doc = s->last_doc;
+   }
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+   const struct gn_count *x = a, *y = b;
+   int ret = strcmp(x->acronym, y->acronym);
+   return ret ? ret : strcmp(x->expansion, y->expansion);
+}
+
+static int compare_counts(const void *a, const void *b)
+{
+   const struct gn_count *x = a, *y = b;
+   if (x->freq != y->freq)
+      return x->freq < y->freq ? 1 : -1;
+   return compare_keys(a, b);
+}
+
+static const struct gn_count *sort(struct gn_counter *c, size_t *nr,
+                                   int (*cmp)(const void *, const void *))
+{
+   gn_vec_clear(c->sorted);
+   gn_vec_grow(c->sorted, gn_vec_len(c->pairs));
+   for (size_t i = 0; i < gn_vec_len(c->pairs); i++) {
+      const struct pair *p = &c->pairs[i];
+      const char *str = &c->arena[p->str];
+      c->sorted[i] = (struct gn_count){
+         .acronym = str,
+         .acronym_len = p->acronym_len,
+         .expansion = &str[p->acronym_len + 1],
+         .expansion_len = p->expansion_len,
+         .freq = p->freq,
+         .docs = p->docs,
+         .first_doc = p->first_doc,
+         .last_doc = p->last_doc,
+      };
+   }
+   gn_vec_len(c->sorted) = gn_vec_len(c->pairs);
+   qsort(c->sorted, gn_vec_len(c->sorted), sizeof *c->sorted, cmp);
+   *nr = gn_vec_len(c->sorted);
+   return c->sorted;
+}
+
+const struct gn_count *gn_counter_sort(struct gn_counter *c, size_t *nr)
+{
+   return sort(c, nr, compare_counts);
+}
+
+const struct gn_count *gn_counter_list(struct gn_counter *c, size_t *nr)
+{
+   return sort(c, nr, compare_keys);
+}
+
+size_t gn_counter_memory(const struct gn_counter *c)
+{
+   return sizeof *c
+        + gn_vec_capacity(c->pairs) * sizeof *c->pairs
+        + gn_vec_capacity(c->arena)
+        + gn_vec_capacity(c->sorted) * sizeof *c->sorted
+        + (c->mask + 1) * sizeof *c->slots;
+}
+
+/* Memory is released, rather than kept for reuse, so that a counter that is
+ * cleared for exceeding its budget is back under it.
+ */
+void gn_counter_clear(struct gn_counter *c)
+{
+   gn_vec_free(c->pairs);
+   gn_vec_free(c->arena);
+   gn_vec_free(c->sorted);
+   free(c->slots);
+   c->pairs = GN_VEC_INIT;
+   c->arena = GN_VEC_INIT;
+   c->sorted = GN_VEC_INIT;
+   c->slots = gn_malloc(MIN_SLOTS * sizeof *c->slots);
+   c->mask = MIN_SLOTS - 1;
+   memset(c->slots, 0, MIN_SLOTS * sizeof *c->slots);
+}
+
+/* A definition tracked by a sketch. */
+struct tracked {
+   char *str;                 /* acronym '\0' expansion '\0', or NULL. */
+   size_t size;               /* Allocated size of str. */
+   size_t acronym_len, expansion_len;
+   uint64_t hash;
+   size_t count, error;
+   size_t heap_pos;
+};
+
+struct gn_topk {
+   size_t k;
+   struct tracked *tracked;   /* k entries, nr of which are used. */
+   size_t nr;
+
+   /* Min-heap of tracked definitions, by count. */
+   size_t *heap;
+
+   /* Table of tracked definitions, as for counters, with twice as many slots
+    * as definitions, rounded up to a power of two.
+    */
+   size_t *slots;
+   size_t mask;
+
+   struct gn_count *sorted;
+};
+
+struct gn_topk *gn_topk_alloc(size_t k)
+{
+   if (!k)
+      k = 1;
+   size_t size = MIN_SLOTS;
+   while (size < 2 * k) {
+      if (size > SIZE_MAX / 2 / sizeof(size_t))
+         gn_fatal("integer overflow");
+      size *= 2;
+   }
+   if (k > SIZE_MAX / sizeof(struct tracked))
+      gn_fatal("integer overflow");
+
+   struct gn_topk *t = gn_malloc(sizeof *t);
+   *t = (struct gn_topk){
+      .k = k,
+      .tracked = gn_malloc(k * sizeof *t->tracked),
+      .heap = gn_malloc(k * sizeof *t->heap),
+      .slots = gn_malloc(size * sizeof *t->slots),
+      .mask = size - 1,
+      .sorted = GN_VEC_INIT,
+   };
+   memset(t->tracked, 0, k * sizeof *t->tracked);
+   memset(t->slots, 0, size * sizeof *t->slots);
+   return t;
+}
+
+void gn_topk_dealloc(struct gn_topk *t)
+{
+   for (size_t i = 0; i < t->k; i++)
+      free(t->tracked[i].str);
+   free(t->tracked);
+   free(t->heap);
+   free(t->slots);
+   gn_vec_free(t->sorted);
+   free(t);
+}
+
+/* Returns the slot of a definition, or the free slot where it would go. */
+static size_t topk_slot(const struct gn_topk *t, uint64_t h,
+                        const char *acr, size_t acr_len,
+                        const char *exp, size_t exp_len)
+{
+   size_t pos = h & t->mask;
+   size_t idx;
+   while ((idx = t->slots[pos])) {
+      const struct tracked *e = &t->tracked[idx - 1];
+      if (e->hash == h && e->acronym_len == acr_len && e->expansion_len == exp_len
+       && !memcmp(e->str, acr, acr_len) && !memcmp(&e->str[acr_len + 1], exp, exp_len))
+         break;
+      pos = (pos + 1) & t->mask;
+   }
+   return pos;
+}
+
+/* Frees a slot. Following slots are moved back if needed, so that lookups
+ * don't stop early.
+ */
+static void topk_unlink(struct gn_topk *t, size_t pos)
+{
+   size_t i = pos, j = pos;
+   for (;;) {
+      j = (j + 1) & t->mask;
+      if (!t->slots[j])
+         break;
+      size_t home = t->tracked[t->slots[j] - 1].hash & t->mask;
+      /* The entry can move to i if its home slot is not between i and j. */
+      if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+         t->slots[i] = t->slots[j];
+         i = j;
+      }
+   }
+   t->slots[i] = 0;
+}
+
+static bool heap_less(const struct gn_topk *t, size_t a, size_t b)
+{
+   return t->tracked[t->heap[a]].count < t->tracked[t->heap[b]].count;
+}
+
+static void heap_swap(struct gn_topk *t, size_t a, size_t b)
+{
+   size_t tmp = t->heap[a];
+   t->heap[a] = t->heap[b];
+   t->heap[b] = tmp;
+   t->tracked[t->heap[a]].heap_pos = a;
+   t->tracked[t->heap[b]].heap_pos = b;
+}
+
+static void heap_up(struct gn_topk *t, size_t i)
+{
+   while (i && heap_less(t, i, (i - 1) / 2)) {
+      heap_swap(t, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+   }
+}
+
+static void heap_down(struct gn_topk *t, size_t i)
+{
+   for (;;) {
+      size_t min = i, l = 2 * i + 1, r = l + 1;
+      if (l < t->nr && heap_less(t, l, min))
+         min = l;
+      if (r < t->nr && heap_less(t, r, min))
+         min = r;
+      if (min == i)
+         return;
+      heap_swap(t, i, min);
+      i = min;
+   }
+}
+
+static void topk_add(struct gn_topk *t, const char *acr, size_t acr_len,
+                     const char *exp, size_t exp_len, size_t count,
+                     size_t error)
+{
+   uint64_t h = hash_pair(acr, acr_len, exp, exp_len);
+   size_t pos = topk_slot(t, h, acr, acr_len, exp, exp_len);
+   struct tracked *e;
+   if (t->slots[pos]) {
+      e = &t->tracked[t->slots[pos] - 1];
+      e->count += count;
+      e->error += error;
+      heap_down(t, e->heap_pos);
+      return;
+   }
+
+   if (t->nr < t->k) {
+      e = &t->tracked[t->nr];
+      e->heap_pos = t->nr;
+      t->heap[t->nr++] = e - t->tracked;
+      e->count = e->error = 0;
+   } else {
+      /* Replace the definition with the lowest count. */
+      e = &t->tracked[t->heap[0]];
+      topk_unlink(t, topk_slot(t, e->hash, e->str, e->acronym_len,
+                               &e->str[e->acronym_len + 1], e->expansion_len));
+      pos = topk_slot(t, h, acr, acr_len, exp, exp_len);
+      e->error = e->count;
+   }
+
+   size_t size = acr_len + exp_len + 2;
+   if (e->size < size) {
+      e->str = gn_realloc(e->str, size);
+      e->size = size;
+   }
+   memcpy(e->str, acr, acr_len);
+   e->str[acr_len] = '\0';
+   memcpy(&e->str[acr_len + 1], exp, exp_len);
+   e->str[acr_len + 1 + exp_len] = '\0';
+   e->acronym_len = acr_len;
+   e->expansion_len = exp_len;
+   e->hash = h;
+   e->count += count;
+   e->error += error;
+   t->slots[pos] = e - t->tracked + 1;
+   heap_up(t, e->heap_pos);
+   heap_down(t, e->heap_pos);
+}
+
+void gn_topk_add(struct gn_topk *t, const struct gn_acronym *def)
+{
+   topk_add(t, def->acronym, def->acronym_len, def->expansion,
+            def->expansion_len, 1, 0);
+}
+
+/* Count of the definitions that are not tracked: at most the lowest count,
+ * once the sketch is full, and zero before.
+ */
+static size_t topk_floor(const struct gn_topk *t)
+{
+   return t->nr < t->k ? 0 : t->tracked[t->heap[0]].count;
+}
+
+/* Combined counts of a definition tracked by one of two sketches. */
+static void topk_combine(const struct gn_topk *other, const struct tracked *e,
+                         size_t *count, size_t *error)
+{
+   const char *exp = &e->str[e->acronym_len + 1];
+   size_t pos = topk_slot(other, e->hash, e->str, e->acronym_len, exp,
+                          e->expansion_len);
+   if (other->slots[pos]) {
+      const struct tracked *o = &other->tracked[other->slots[pos] - 1];
+      *count = e->count + o->count;
+      *error = e->error + o->error;
+   } else {
+      *count = e->count + topk_floor(other);
+      *error = e->error + topk_floor(other);
+   }
+}
+
+struct candidate {
+   const struct tracked *e;
+   size_t count, error;
+};
+
+static int compare_candidates(const void *a, const void *b)
+{
+   const struct candidate *x = a, *y = b;
+   if (x->count != y->count)
+      return x->count < y->count ? 1 : -1;
+   return 0;
+}
+
+void gn_topk_merge(struct gn_topk *dst, const struct gn_topk *src)
+{
+   assert(dst != src);
+   struct candidate *cands = gn_malloc((dst->nr + src->nr + 1) * sizeof *cands);
+   size_t nr = 0;
+   for (size_t i = 0; i < dst->nr; i++) {
+      struct candidate *c = &cands[nr++];
+      c->e = &dst->tracked[i];
+      topk_combine(src, c->e, &c->count, &c->error);
+   }
+   for (size_t i = 0; i < src->nr; i++) {
+      const struct tracked *e = &src->tracked[i];
+      size_t pos = topk_slot(dst, e->hash, e->str, e->acronym_len,
+                             &e->str[e->acronym_len + 1], e->expansion_len);
+      if (dst->slots[pos])
+         continue;
+      struct candidate *c = &cands[nr++];
+      c->e = e;
+      topk_combine(dst, e, &c->count, &c->error);
+   }
+   qsort(cands, nr, sizeof *cands, compare_candidates);
+   if (nr > dst->k)
+      nr = dst->k;
+
+   /* Fill a new sketch, since candidates point into the old one. */
+   struct gn_topk *t = gn_topk_alloc(dst->k);
+   for (size_t i = 0; i < nr; i++) {
+      const struct tracked *e = cands[i].e;
+      topk_add(t, e->str, e->acronym_len, &e->str[e->acronym_len + 1],
+               e->expansion_len, cands[i].count, cands[i].error);
+   }
+   free(cands);
+
+   struct gn_topk tmp = *dst;
+   *dst = *t;
+   *t = tmp;
+   gn_topk_dealloc(t);
+}
+
+const struct gn_count *gn_topk_sort(struct gn_topk *t, size_t *nr)
+{
+   gn_vec_clear(t->sorted);
+   gn_vec_grow(t->sorted, t->nr);
+   for (size_t i = 0; i < t->nr; i++) {
+      const struct tracked *e = &t->tracked[i];
+      t->sorted[i] = (struct gn_count){
+         .acronym = e->str,
+         .acronym_len = e->acronym_len,
+         .expansion = &e->str[e->acronym_len + 1],
+         .expansion_len = e->expansion_len,
+         .freq = e->count,
+         .error = e->error,
+      };
+   }
+   gn_vec_len(t->sorted) = t->nr;
+   qsort(t->sorted, t->nr, sizeof *t->sorted, compare_counts);
+   *nr = t->nr;
+   return t->sorted;
+}
+#line 1 "dict.c"
+#include <string.h>
+#line 1 "utf8proc.h"
+/*
+ * Copyright (c) 2015 Steven G. Johnson, Jiahao Chen, Peter Colberg, Tony Kelman, Scott P. Jones, and other contributors.
+ * Copyright (c) 2009 Public Software Group e. V., Berlin, Germany
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @mainpage
+ *
+ * utf8proc is a free/open-source (MIT/expat licensed) C library
+ * providing Unicode normalization, case-folding, and other operations
+ * for strings in the UTF-8 encoding, supporting Unicode version
+ * 8.0.0.  See the utf8proc home page (http://julialang.org/utf8proc/)
+ * for downloads and other information, or the source code on github
+ * (https://github.com/JuliaLang/utf8proc).
+ *
+ * For the utf8proc API documentation, see: @ref utf8proc.h
+ *
+ * The features of utf8proc include:
+ *
+ * - Transformation of strings (@ref utf8proc_map) to:
+ *    - decompose (@ref UTF8PROC_DECOMPOSE) or compose (@ref UTF8PROC_COMPOSE) Unicode combining characters (http://en.wikipedia.org/wiki/Combining_character)
+ *    - canonicalize Unicode compatibility characters (@ref UTF8PROC_COMPAT)
+ *    - strip "ignorable" (@ref UTF8PROC_IGNORE) characters, control characters (@ref UTF8PROC_STRIPCC), or combining characters such as accents (@ref UTF8PROC_STRIPMARK)
+ *    - case-folding (@ref UTF8PROC_CASEFOLD)
+ * - Unicode normalization: @ref utf8proc_NFD, @ref utf8proc_NFC, @ref utf8proc_NFKD, @ref utf8proc_NFKC
+ * - Detecting grapheme boundaries (@ref utf8proc_grapheme_break and @ref UTF8PROC_CHARBOUND)
+ * - Character-width computation: @ref utf8proc_charwidth
+ * - Classification of characters by Unicode category: @ref utf8proc_category and @ref utf8proc_category_string
+ * - Encode (@ref utf8proc_encode_char) and decode (@ref utf8proc_iterate) Unicode codepoints to/from UTF-8.
+ */
+
+/** @file */
+
+#ifndef UTF8PROC_H
+#define UTF8PROC_H
+
+/** @name API version
+ *
+ * The utf8proc API version MAJOR.MINOR.PATCH, following
+ * semantic-versioning rules (http://semver.org) based on API
+ * compatibility.
+ *
+ * This is also returned at runtime by @ref utf8proc_version; however, the
+ * runtime version may append a string like "-dev" to the version number
+ * for prerelease versions.
+ *
+ * @note The shared-library version number in the Makefile may be different,
+ *       being based on ABI compatibility rather than API compatibility.
+ */
+/** @{ */
+/** The MAJOR version number (increased when backwards API compatibility is broken). */
+#define UTF8PROC_VERSION_MAJOR 1
+/** The MINOR version number (increased when new functionality is added in a backwards-compatible manner). */
+#define UTF8PROC_VERSION_MINOR 3
+/** The PATCH version (increased for fixes that do not change the API). */
+#define UTF8PROC_VERSION_PATCH 0
+/** @} */
+
+#include <stdlib.h>
+#include <sys/types.h>
+#ifdef _MSC_VER
+typedef signed char utf8proc_int8_t;
+typedef unsigned char utf8proc_uint8_t;
+typedef short utf8proc_int16_t;
+typedef unsigned short utf8proc_uint16_t;
+typedef int utf8proc_int32_t;
+typedef unsigned int utf8proc_uint32_t;
+#  ifdef _WIN64
+typedef __int64 utf8proc_ssize_t;
+typedef unsigned __int64 utf8proc_size_t;
+#  else
+typedef int utf8proc_ssize_t;
+typedef unsigned int utf8proc_size_t;
+#  endif
+#  ifndef __cplusplus
+typedef unsigned char utf8proc_bool;
+enum {false, true};
+#  else
+typedef bool utf8proc_bool;
+#  endif
+#else
+#  include <stdbool.h>
+#  include <inttypes.h>
+typedef int8_t utf8proc_int8_t;
+typedef uint8_t utf8proc_uint8_t;
+typedef int16_t utf8proc_int16_t;
+typedef uint16_t utf8proc_uint16_t;
+typedef int32_t utf8proc_int32_t;
+typedef uint32_t utf8proc_uint32_t;
+typedef size_t utf8proc_size_t;
+typedef ssize_t utf8proc_ssize_t;
+typedef bool utf8proc_bool;
+#endif
+#include <limits.h>
+
+#ifdef _WIN32
+#  ifdef UTF8PROC_EXPORTS
+#    define UTF8PROC_DLLEXPORT __declspec(dllexport)
+#  else
+#    define UTF8PROC_DLLEXPORT __declspec(dllimport)
+#  endif
+#elif __GNUC__ >= 4
+#  define UTF8PROC_DLLEXPORT __attribute__ ((visibility("default")))
+#else
+#  define UTF8PROC_DLLEXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SSIZE_MAX
+#define SSIZE_MAX ((size_t)SIZE_MAX/2)
+#endif
+
+#ifndef UINT16_MAX
+#  define UINT16_MAX ~(utf8proc_uint16_t)0
+#endif
+
+/**
+ * Option flags used by several functions in the library.
+ */
+typedef enum {
+  /** The given UTF-8 input is NULL terminated. */
+  UTF8PROC_NULLTERM  = (1<<0),
+  /** Unicode Versioning Stability has to be respected. */
+  UTF8PROC_STABLE    = (1<<1),
+  /** Compatibility decomposition (i.e. formatting information is lost). */
+  UTF8PROC_COMPAT    = (1<<2),
+  /** Return a result with decomposed characters. */
+  UTF8PROC_COMPOSE   = (1<<3),
+  /** Return a result with decomposed characters. */
+  UTF8PROC_DECOMPOSE = (1<<4),
+  /** Strip "default ignorable characters" such as SOFT-HYPHEN or ZERO-WIDTH-SPACE. */
+  UTF8PROC_IGNORE    = (1<<5),
+  /** Return an error, if the input contains unassigned codepoints. */
+  UTF8PROC_REJECTNA  = (1<<6),
+  /**
+   * Indicating that NLF-sequences (LF, CRLF, CR, NEL) are representing a
+   * line break, and should be converted to the codepoint for line
+   * separation (LS).
+   */
+  UTF8PROC_NLF2LS    = (1<<7),
+  /**
+   * Indicating that NLF-sequences are representing a paragraph break, and
+   * should be converted to the codepoint for paragraph separation
+   * (PS).
+   */
+  UTF8PROC_NLF2PS    = (1<<8),
+  /** Indicating that the meaning of NLF-sequences is unknown. */
+  UTF8PROC_NLF2LF    = (UTF8PROC_NLF2LS | UTF8PROC_NLF2PS),
+  /** Strips and/or convers control characters.
+   *
+   * NLF-sequences are transformed into space, except if one of the
+   * NLF2LS/PS/LF options is given. HorizontalTab (HT) and FormFeed (FF)
+   * are treated as a NLF-sequence in this case.  All other control
+   * characters are simply removed.
+   */
+  UTF8PROC_STRIPCC   = (1<<9),
+  /**
+   * Performs unicode case folding, to be able to do a case-insensitive
+   * string comparison.
+   */
+  UTF8PROC_CASEFOLD  = (1<<10),
+  /**
+   * Inserts 0xFF bytes at the beginning of each sequence which is
+   * representing a single grapheme cluster (see UAX#29).
+   */
+  UTF8PROC_CHARBOUND = (1<<11),
+  /** Lumps certain characters together.
+   *
+   * E.g. HYPHEN U+2010 and MINUS U+2212 to ASCII "-". See lump.md for details.
+   *
+   * If NLF2LF is set, this includes a transformation of paragraph and
+   * line separators to ASCII line-feed (LF).
+   */
+  UTF8PROC_LUMP      = (1<<12),
+  /** Strips all character markings.
+   *
+   * This includes non-spacing, spacing and enclosing (i.e. accents).
+   * @note This option works only with @ref UTF8PROC_COMPOSE or
+   *       @ref UTF8PROC_DECOMPOSE
+   */
+  UTF8PROC_STRIPMARK = (1<<13),
+} utf8proc_option_t;
+
+/** @name Error codes
+ * Error codes being returned by almost all functions.
+ */
+/** @{ */
+/** Memory could not be allocated. */
+#define UTF8PROC_ERROR_NOMEM -1
+/** The given string is too long to be processed. */
+#define UTF8PROC_ERROR_OVERFLOW -2
+/** The given string is not a legal UTF-8 string. */
+#define UTF8PROC_ERROR_INVALIDUTF8 -3
+/** The @ref UTF8PROC_REJECTNA flag was set and an unassigned codepoint was found. */
+#define UTF8PROC_ERROR_NOTASSIGNED -4
+/** Invalid options have been used. */
+#define UTF8PROC_ERROR_INVALIDOPTS -5
+/** @} */
+
+/* @name Types */
+
+/** Holds the value of a property. */
+typedef utf8proc_int16_t utf8proc_propval_t;
+
+/** Struct containing information about a codepoint. */
+typedef struct utf8proc_property_struct {
+  /**
+   * Unicode category.
+   * @see utf8proc_category_t.
+   */
+  utf8proc_propval_t category;
+  utf8proc_propval_t combining_class;
+  /**
+   * Bidirectional class.
+   * @see utf8proc_bidi_class_t.
+   */
+  utf8proc_propval_t bidi_class;
+  /**
+   * @anchor Decomposition type.
+   * @see utf8proc_decomp_type_t.
+   */
+  utf8proc_propval_t decomp_type;
+  utf8proc_uint16_t decomp_mapping;
+  utf8proc_uint16_t casefold_mapping;
+  utf8proc_int32_t uppercase_mapping;
+  utf8proc_int32_t lowercase_mapping;
+  utf8proc_int32_t titlecase_mapping;
+  utf8proc_int32_t comb1st_index;
+  utf8proc_int32_t comb2nd_index;
+  unsigned bidi_mirrored:1;
+  unsigned comp_exclusion:1;
+  /**
+   * Can this codepoint be ignored?
+   *
+   * Used by @ref utf8proc_decompose_char when @ref UTF8PROC_IGNORE is
+   * passed as an option.
+   */
+  unsigned ignorable:1;
+  unsigned control_boundary:1;
+  /**
+   * Boundclass.
+   * @see utf8proc_boundclass_t.
+   */
+  unsigned boundclass:4;
+  /** The width of the codepoint. */
+  unsigned charwidth:2;
+} utf8proc_property_t;
+
+/** Unicode categories. */
+typedef enum {
+  UTF8PROC_CATEGORY_CN  = 0, /**< Other, not assigned */
+  UTF8PROC_CATEGORY_LU  = 1, /**< Letter, uppercase */
+  UTF8PROC_CATEGORY_LL  = 2, /**< Letter, lowercase */
+  UTF8PROC_CATEGORY_LT  = 3, /**< Letter, titlecase */
+  UTF8PROC_CATEGORY_LM  = 4, /**< Letter, modifier */
+  UTF8PROC_CATEGORY_LO  = 5, /**< Letter, other */
+  UTF8PROC_CATEGORY_MN  = 6, /**< Mark, nonspacing */
+  UTF8PROC_CATEGORY_MC  = 7, /**< Mark, spacing combining */
+  UTF8PROC_CATEGORY_ME  = 8, /**< Mark, enclosing */
+  UTF8PROC_CATEGORY_ND  = 9, /**< Number, decimal digit */
+  UTF8PROC_CATEGORY_NL = 10, /**< Number, letter */
+  UTF8PROC_CATEGORY_NO = 11, /**< Number, other */
+  UTF8PROC_CATEGORY_PC = 12, /**< Punctuation, connector */
+  UTF8PROC_CATEGORY_PD = 13, /**< Punctuation, dash */
+  UTF8PROC_CATEGORY_PS = 14, /**< Punctuation, open */
+  UTF8PROC_CATEGORY_PE = 15, /**< Punctuation, close */
+  UTF8PROC_CATEGORY_PI = 16, /**< Punctuation, initial quote */
+  UTF8PROC_CATEGORY_PF = 17, /**< Punctuation, final quote */
+  UTF8PROC_CATEGORY_PO = 18, /**< Punctuation, other */
+  UTF8PROC_CATEGORY_SM = 19, /**< Symbol, math */
+  UTF8PROC_CATEGORY_SC = 20, /**< Symbol, currency */
+  UTF8PROC_CATEGORY_SK = 21, /**< Symbol, modifier */
+  UTF8PROC_CATEGORY_SO = 22, /**< Symbol, other */
+  UTF8PROC_CATEGORY_ZS = 23, /**< Separator, space */
+  UTF8PROC_CATEGORY_ZL = 24, /**< Separator, line */
+  UTF8PROC_CATEGORY_ZP = 25, /**< Separator, paragraph */
+  UTF8PROC_CATEGORY_CC = 26, /**< Other, control */
+  UTF8PROC_CATEGORY_CF = 27, /**< Other, format */
+  UTF8PROC_CATEGORY_CS = 28, /**< Other, surrogate */
+  UTF8PROC_CATEGORY_CO = 29, /**< Other, private use */
+} utf8proc_category_t;
+
+/** Bidirectional character classes. */
+typedef enum {
+  UTF8PROC_BIDI_CLASS_L     = 1, /**< Left-to-Right */
+  UTF8PROC_BIDI_CLASS_LRE   = 2, /**< Left-to-Right Embedding */
+  UTF8PROC_BIDI_CLASS_LRO   = 3, /**< Left-to-Right Override */
+  UTF8PROC_BIDI_CLASS_R     = 4, /**< Right-to-Left */
+  UTF8PROC_BIDI_CLASS_AL    = 5, /**< Right-to-Left Arabic */
+  UTF8PROC_BIDI_CLASS_RLE   = 6, /**< Right-to-Left Embedding */
+  UTF8PROC_BIDI_CLASS_RLO   = 7, /**< Right-to-Left Override */
+  UTF8PROC_BIDI_CLASS_PDF   = 8, /**< Pop Directional Format */
+  UTF8PROC_BIDI_CLASS_EN    = 9, /**< European Number */
+  UTF8PROC_BIDI_CLASS_ES   = 10, /**< European Separator */
+  UTF8PROC_BIDI_CLASS_ET   = 11, /**< European Number Terminator */
+  UTF8PROC_BIDI_CLASS_AN   = 12, /**< Arabic Number */
+  UTF8PROC_BIDI_CLASS_CS   = 13, /**< Common Number Separator */
+  UTF8PROC_BIDI_CLASS_NSM  = 14, /**< Nonspacing Mark */
+  UTF8PROC_BIDI_CLASS_BN   = 15, /**< Boundary Neutral */
+  UTF8PROC_BIDI_CLASS_B    = 16, /**< Paragraph Separator */
+  UTF8PROC_BIDI_CLASS_S    = 17, /**< Segment Separator */
+  UTF8PROC_BIDI_CLASS_WS   = 18, /**< Whitespace */
+  UTF8PROC_BIDI_CLASS_ON   = 19, /**< Other Neutrals */
+  UTF8PROC_BIDI_CLASS_LRI  = 20, /**< Left-to-Right Isolate */
+  UTF8PROC_BIDI_CLASS_RLI  = 21, /**< Right-to-Left Isolate */
+  UTF8PROC_BIDI_CLASS_FSI  = 22, /**< First Strong Isolate */
+  UTF8PROC_BIDI_CLASS_PDI  = 23, /**< Pop Directional Isolate */
+} utf8proc_bidi_class_t;
 
-/* Appends a single byte to a buffer. */
-void kb_catb(struct kabak *restrict, int);
+/** Decomposition type. */
+typedef enum {
+  UTF8PROC_DECOMP_TYPE_FONT      = 1, /**< Font */
+  UTF8PROC_DECOMP_TYPE_NOBREAK   = 2, /**< Nobreak */
+  UTF8PROC_DECOMP_TYPE_INITIAL   = 3, /**< Initial */
+  UTF8PROC_DECOMP_TYPE_MEDIAL    = 4, /**< Medial */
+  UTF8PROC_DECOMP_TYPE_FINAL     = 5, /**< Final */
+  UTF8PROC_DECOMP_TYPE_ISOLATED  = 6, /**< Isolated */
+  UTF8PROC_DECOMP_TYPE_CIRCLE    = 7, /**< Circle */
+  UTF8PROC_DECOMP_TYPE_SUPER     = 8, /**< Super */
+  UTF8PROC_DECOMP_TYPE_SUB       = 9, /**< Sub */
+  UTF8PROC_DECOMP_TYPE_VERTICAL = 10, /**< Vertical */
+  UTF8PROC_DECOMP_TYPE_WIDE     = 11, /**< Wide */
+  UTF8PROC_DECOMP_TYPE_NARROW   = 12, /**< Narrow */
+  UTF8PROC_DECOMP_TYPE_SMALL    = 13, /**< Small */
+  UTF8PROC_DECOMP_TYPE_SQUARE   = 14, /**< Square */
+  UTF8PROC_DECOMP_TYPE_FRACTION = 15, /**< Fraction */
+  UTF8PROC_DECOMP_TYPE_COMPAT   = 16, /**< Compat */
+} utf8proc_decomp_type_t;
 
-/* Appends formatted data to a buffer. */
-void kb_printf(struct kabak *restrict, const char *restrict fmt, ...);
+/** Boundclass property. */
+typedef enum {
+  UTF8PROC_BOUNDCLASS_START              =  0, /**< Start */
+  UTF8PROC_BOUNDCLASS_OTHER              =  1, /**< Other */
+  UTF8PROC_BOUNDCLASS_CR                 =  2, /**< Cr */
+  UTF8PROC_BOUNDCLASS_LF                 =  3, /**< Lf */
+  UTF8PROC_BOUNDCLASS_CONTROL            =  4, /**< Control */
+  UTF8PROC_BOUNDCLASS_EXTEND             =  5, /**< Extend */
+  UTF8PROC_BOUNDCLASS_L                  =  6, /**< L */
+  UTF8PROC_BOUNDCLASS_V                  =  7, /**< V */
+  UTF8PROC_BOUNDCLASS_T                  =  8, /**< T */
+  UTF8PROC_BOUNDCLASS_LV                 =  9, /**< Lv */
+  UTF8PROC_BOUNDCLASS_LVT                = 10, /**< Lvt */
+  UTF8PROC_BOUNDCLASS_REGIONAL_INDICATOR = 11, /**< Regional indicator */
+  UTF8PROC_BOUNDCLASS_SPACINGMARK        = 12, /**< Spacingmark */
+} utf8proc_boundclass_t;
 
-/* Ensures that there's enough room for storing "size" more bytes.
- * Returns a pointer to the end of the buffer.
+/**
+ * Array containing the byte lengths of a UTF-8 encoded codepoint based
+ * on the first byte.
  */
-void *kb_grow(struct kabak *, size_t size);
-
-/* Truncation to the empty string. */
-void kb_clear(struct kabak *);
+UTF8PROC_DLLEXPORT extern const utf8proc_int8_t utf8proc_utf8class[256];
 
-/* Returns a buffer's contents as an allocated string.
- * The returned string must be freed with free(). It is zero-terminated. If
- * "len" is not NULL, it is filled with the length of the returned string.
+/**
+ * Returns the utf8proc API version as a string MAJOR.MINOR.PATCH
+ * (http://semver.org format), possibly with a "-dev" suffix for
+ * development versions.
  */
-char *kb_detach(struct kabak *restrict, size_t *restrict len);
-
-
-/*******************************************************************************
- * Normalization.
- ******************************************************************************/
-
-#define KB_REPLACEMENT_CHAR 0xFFFD
-
-enum {
-   /* Compose code points. */
-   KB_COMPOSE = 1 << 0,
-   
-   /* Decompose code points. */
-   KB_DECOMPOSE = 1 << 1,
-   
-   /* Use compatibility mappings, with custom additional mappings. Must be
-    * combined with KB_COMPOSE or KB_DECOMPOSE to be taken into account.
-    */
-   KB_COMPAT = 1 << 2,
-   
-   /* Lump some characters together. */
-   KB_LUMP = 1 << 3,
-   
-   /* Use Unicode casefold mappings. */
-   KB_CASE_FOLD = 1 << 4,
-
-   /* Drop code points in Default_Ignorable_Code_Point. See
-    * http://www.unicode.org/Public/8.0.0/ucd/DerivedCoreProperties.txt
-    */
-   KB_STRIP_IGNORABLE = 1 << 5,
-   
-   /* Drop code points in categories Cn (Other, Not Assigned) and Co (Other,
-    * Private Use). Code points in Cs (Other, Surrogate) don't appear in UTF-8
-    * strings.
-    */
-   KB_STRIP_UNKNOWN = 1 << 6,
-   
-   /* Drop diacritical marks (categories Mc, Me, and Mn). Must be combined with
-    * KB_COMPOSE or KB_DECOMPOSE to be taken into account.
-    */
-   KB_STRIP_DIACRITIC = 1 << 7,
-
-   /* NFC normalization. */
-   KB_NFC = KB_COMPOSE | KB_DECOMPOSE,
-   
-   /* NFKC normalization (with custom additional mappings). */
-   KB_NFKC = KB_COMPOSE | KB_DECOMPOSE | KB_COMPAT,
-};
+UTF8PROC_DLLEXPORT const char *utf8proc_version(void);
 
-/* Transforms a string in some way.
- * On success, returns KB_OK, otherwise an error code. In both cases, the
- * output buffer is filled with the normalized string.
- * Bytes that cannot form valid UTF-8 sequences are replaced with REPLACEMENT
- * CHARACTER (U+FFFD). Unassigned code points and non-characters are deemed to
- * be valid. Only surrogates and code points > 0x10FFFF are considered invalid.
- * The output buffer is cleared beforehand.
+/**
+ * Returns an informative error string for the given utf8proc error code
+ * (e.g. the error codes returned by @ref utf8proc_map).
  */
-int kb_transform(struct kabak *restrict, const char *restrict str, size_t len,
-                 unsigned opts);
-
-
-/*******************************************************************************
- * I/O.
- ******************************************************************************/
+UTF8PROC_DLLEXPORT const char *utf8proc_errmsg(utf8proc_ssize_t errcode);
 
-/* FILE object wrapper. */
-struct kb_file {
-   FILE *fp;
-   size_t pending;
-   uint8_t backup[4];
-   char32_t last;
-};
+/**
+ * Reads a single codepoint from the UTF-8 sequence being pointed to by `str`.
+ * The maximum number of bytes read is `strlen`, unless `strlen` is
+ * negative (in which case up to 4 bytes are read).
+ *
+ * If a valid codepoint could be read, it is stored in the variable
+ * pointed to by `codepoint_ref`, otherwise that variable will be set to -1.
+ * In case of success, the number of bytes read is returned; otherwise, a
+ * negative error code is returned.
+ */
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_iterate(const utf8proc_uint8_t *str, utf8proc_ssize_t strlen, utf8proc_int32_t *codepoint_ref);
 
-/* Wraps an opened file for reading UTF-8 data from it.
- * The file can be opened in binary mode. It must not be used while the
- * kb_file structure is in use. It must be closed by the caller after use if
- * necessary. We assume that no data has been read from the file yet, and check
- * for a leading BOM.
+/**
+ * Check if a codepoint is valid (regardless of whether it has been
+ * assigned a value by the current Unicode standard).
+ *
+ * @return 1 if the given `codepoint` is valid and otherwise return 0.
  */
-void kb_wrap(struct kb_file *restrict, FILE *restrict);
+UTF8PROC_DLLEXPORT utf8proc_bool utf8proc_codepoint_valid(utf8proc_int32_t codepoint);
 
-/* Reads a single line from a file and, optionally, normalizes it.
- * All possible EOL sequences are supported. The EOL sequence at the end of a
- * line, if any, is trimmed. The last line of the file is skipped if empty.
- * Returns KB_OK if a line was read, KB_FINI if at EOF, otherwise an error code.
- * I/O errors are not reported and must be checked separately. Notes above
- * kb_transform() apply here, too.
+/**
+ * Encodes the codepoint as an UTF-8 string in the byte array pointed
+ * to by `dst`. This array must be at least 4 bytes long.
+ *
+ * In case of success the number of bytes written is returned, and
+ * otherwise 0 is returned.
+ *
+ * This function does not check whether `codepoint` is valid Unicode.
  */
-int kb_get_line(struct kb_file *restrict, struct kabak *restrict,
-                unsigned opts);
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_encode_char(utf8proc_int32_t codepoint, utf8proc_uint8_t *dst);
 
+/**
+ * Look up the properties for a given codepoint.
+ *
+ * @param codepoint The Unicode codepoint.
+ *
+ * @returns
+ * A pointer to a (constant) struct containing information about
+ * the codepoint.
+ * @par
+ * If the codepoint is unassigned or invalid, a pointer to a special struct is
+ * returned in which `category` is 0 (@ref UTF8PROC_CATEGORY_CN).
+ */
+UTF8PROC_DLLEXPORT const utf8proc_property_t *utf8proc_get_property(utf8proc_int32_t codepoint);
 
-/*******************************************************************************
- * UTF-8.
- ******************************************************************************/
+/** Decompose a codepoint into an array of codepoints.
+ *
+ * @param codepoint the codepoint.
+ * @param dst the destination buffer.
+ * @param bufsize the size of the destination buffer.
+ * @param options one or more of the following flags:
+ * - @ref UTF8PROC_REJECTNA  - return an error `codepoint` is unassigned
+ * - @ref UTF8PROC_IGNORE    - strip "default ignorable" codepoints
+ * - @ref UTF8PROC_CASEFOLD  - apply Unicode casefolding
+ * - @ref UTF8PROC_COMPAT    - replace certain codepoints with their
+ *                             compatibility decomposition
+ * - @ref UTF8PROC_CHARBOUND - insert 0xFF bytes before each grapheme cluster
+ * - @ref UTF8PROC_LUMP      - lump certain different codepoints together
+ * - @ref UTF8PROC_STRIPMARK - remove all character marks
+ * @param last_boundclass
+ * Pointer to an integer variable containing
+ * the previous codepoint's boundary class if the @ref UTF8PROC_CHARBOUND
+ * option is used.  Otherwise, this parameter is ignored.
+ *
+ * @return
+ * In case of success, the number of codepoints written is returned; in case
+ * of an error, a negative error code is returned (@ref utf8proc_errmsg).
+ * @par
+ * If the number of written codepoints would be bigger than `bufsize`, the
+ * required buffer size is returned, while the buffer will be overwritten with
+ * undefined data.
+ */
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_decompose_char(
+  utf8proc_int32_t codepoint, utf8proc_int32_t *dst, utf8proc_ssize_t bufsize,
+  utf8proc_option_t options, int *last_boundclass
+);
 
-/* Decodes a single code point.
- * *clen is filled with the number of decoded bytes.
- * Typical usage:
+/**
+ * The same as @ref utf8proc_decompose_char, but acts on a whole UTF-8
+ * string and orders the decomposed sequences correctly.
  *
- *   for (size_t i = 0, clen; i < len; i += clen)
- *      char32_t c = kb_decode(&str[i], &clen);
+ * If the @ref UTF8PROC_NULLTERM flag in `options` is set, processing
+ * will be stopped, when a NULL byte is encounted, otherwise `strlen`
+ * bytes are processed.  The result (in the form of 32-bit unicode
+ * codepoints) is written into the buffer being pointed to by
+ * `buffer` (which must contain at least `bufsize` entries).  In case of
+ * success, the number of codepoints written is returned; in case of an
+ * error, a negative error code is returned (@ref utf8proc_errmsg).
  *
- * The provided UTF-8 string must be valid.
+ * If the number of written codepoints would be bigger than `bufsize`, the
+ * required buffer size is returned, while the buffer will be overwritten with
+ * undefined data.
  */
-char32_t kb_decode(const char *restrict str, size_t *restrict clen);
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_decompose(
+  const utf8proc_uint8_t *str, utf8proc_ssize_t strlen,
+  utf8proc_int32_t *buffer, utf8proc_ssize_t bufsize, utf8proc_option_t options
+);
 
-/* Safe version of kb_decode().
+/**
+ * Reencodes the sequence of `length` codepoints pointed to by `buffer`
+ * UTF-8 data in-place (i.e., the result is also stored in `buffer`).
  *
- * Bytes that cannot form valid UTF-8 sequences are replaced with REPLACEMENT
- * CHARACTER (U+FFFD). In this case, *clen is set to 1. If at the end of the
- * string, REPLACEMENT CHARACTER is also returned, but *clen is set to 0.
- * Typical usage:
+ * @param buffer the (native-endian UTF-32) unicode codepoints to re-encode.
+ * @param length the length (in codepoints) of the buffer.
+ * @param options a bitwise or (`|`) of one or more of the following flags:
+ * - @ref UTF8PROC_NLF2LS  - convert LF, CRLF, CR and NEL into LS
+ * - @ref UTF8PROC_NLF2PS  - convert LF, CRLF, CR and NEL into PS
+ * - @ref UTF8PROC_NLF2LF  - convert LF, CRLF, CR and NEL into LF
+ * - @ref UTF8PROC_STRIPCC - strip or convert all non-affected control characters
+ * - @ref UTF8PROC_COMPOSE - try to combine decomposed codepoints into composite
+ *                           codepoints
+ * - @ref UTF8PROC_STABLE  - prohibit combining characters that would violate
+ *                           the unicode versioning stability
  *
- *   for (size_t i = 0, clen; i < len; i += clen) {
- *      char32_t c = kb_decode_s(&str[i], len - i, &clen);
- *      if (c == KB_REPLACEMENT_CHAR && clen == 1)
- *         puts("encoding error");
- *   }
+ * @return
+ * In case of success, the length (in bytes) of the resulting UTF-8 string is
+ * returned; otherwise, a negative error code is returned (@ref utf8proc_errmsg).
+ *
+ * @warning The amount of free space pointed to by `buffer` must
+ *          exceed the amount of the input data by one byte, and the
+ *          entries of the array pointed to by `str` have to be in the
+ *          range `0x0000` to `0x10FFFF`. Otherwise, the program might crash!
  */
-char32_t kb_decode_s(const char *restrict str, size_t len,
-                     size_t *restrict clen);
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_reencode(utf8proc_int32_t *buffer, utf8proc_ssize_t length, utf8proc_option_t options);
 
-/* Encodes a single code point.
- * Returns the number of bytes written.
- * The provided code point must be valid.
+/**
+ * Given a pair of consecutive codepoints, return whether a grapheme break is
+ * permitted between them (as defined by the extended grapheme clusters in UAX#29).
  */
-size_t kb_encode(char buf[static 4], char32_t c);
+UTF8PROC_DLLEXPORT utf8proc_bool utf8proc_grapheme_break(utf8proc_int32_t codepoint1, utf8proc_int32_t codepoint2);
 
-/* Counts the number of code points in a UTF-8 string.
- * The provided UTF-8 string must be valid.
- */
-size_t kb_count(const char *str, size_t len);
 
-/* Returns the offset of the nth code point of a string.
- * If n is negative, code points are counted from the end of the string.
- * If the input string contains less than abs(n) code point, the string length
- * is returned if n is strictly positive, zero otherwise.
- * The provided UTF-8 string must be valid.
+/**
+ * Given a codepoint `c`, return the codepoint of the corresponding
+ * lower-case character, if any; otherwise (if there is no lower-case
+ * variant, or if `c` is not a valid codepoint) return `c`.
  */
-size_t kb_offset(const char *str, size_t len, ptrdiff_t n);
-
-
-/*******************************************************************************
- * Character classification.
- ******************************************************************************/
-
-enum kb_category {
-   KB_CATEGORY_CN,
-   KB_CATEGORY_LU,
-   KB_CATEGORY_LL,
-   KB_CATEGORY_LT,
-   KB_CATEGORY_LM,
-   KB_CATEGORY_LO,
-   KB_CATEGORY_MN,
-   KB_CATEGORY_MC,
-   KB_CATEGORY_ME,
-   KB_CATEGORY_ND,
-   KB_CATEGORY_NL,
-   KB_CATEGORY_NO,
-   KB_CATEGORY_PC,
-   KB_CATEGORY_PD,
-   KB_CATEGORY_PS,
-   KB_CATEGORY_PE,
-   KB_CATEGORY_PI,
-   KB_CATEGORY_PF,
-   KB_CATEGORY_PO,
-   KB_CATEGORY_SM,
-   KB_CATEGORY_SC,
-   KB_CATEGORY_SK,
-   KB_CATEGORY_SO,
-   KB_CATEGORY_ZS,
-   KB_CATEGORY_ZL,
-   KB_CATEGORY_ZP,
-   KB_CATEGORY_CC,
-   KB_CATEGORY_CF,
-   KB_CATEGORY_CS,
-   KB_CATEGORY_CO,
-};
+UTF8PROC_DLLEXPORT utf8proc_int32_t utf8proc_tolower(utf8proc_int32_t c);
 
-enum kb_category kb_category(char32_t);
+/**
+ * Given a codepoint `c`, return the codepoint of the corresponding
+ * upper-case character, if any; otherwise (if there is no upper-case
+ * variant, or if `c` is not a valid codepoint) return `c`.
+ */
+UTF8PROC_DLLEXPORT utf8proc_int32_t utf8proc_toupper(utf8proc_int32_t c);
 
-/* Categories L*. */
-bool kb_is_letter(char32_t);
+/**
+ * Given a codepoint, return a character width analogous to `wcwidth(codepoint)`,
+ * except that a width of 0 is returned for non-printable codepoints
+ * instead of -1 as in `wcwidth`.
+ *
+ * @note
+ * If you want to check for particular types of non-printable characters,
+ * (analogous to `isprint` or `iscntrl`), use @ref utf8proc_category. */
+UTF8PROC_DLLEXPORT int utf8proc_charwidth(utf8proc_int32_t codepoint);
 
-/* Category Lu. */
-bool kb_is_upper(char32_t);
+/**
+ * Return the Unicode category for the codepoint (one of the
+ * @ref utf8proc_category_t constants.)
+ */
+UTF8PROC_DLLEXPORT utf8proc_category_t utf8proc_category(utf8proc_int32_t codepoint);
 
-/* Category Ll. */
-bool kb_is_lower(char32_t);
+/**
+ * Return the two-letter (nul-terminated) Unicode category string for
+ * the codepoint (e.g. `"Lu"` or `"Co"`).
+ */
+UTF8PROC_DLLEXPORT const char *utf8proc_category_string(utf8proc_int32_t codepoint);
 
-/* Categories N*. */
-bool kb_is_number(char32_t);
+/**
+ * Maps the given UTF-8 string pointed to by `str` to a new UTF-8
+ * string, allocated dynamically by `malloc` and returned via `dstptr`.
+ *
+ * If the @ref UTF8PROC_NULLTERM flag in the `options` field is set,
+ * the length is determined by a NULL terminator, otherwise the
+ * parameter `strlen` is evaluated to determine the string length, but
+ * in any case the result will be NULL terminated (though it might
+ * contain NULL characters with the string if `str` contained NULL
+ * characters). Other flags in the `options` field are passed to the
+ * functions defined above, and regarded as described.
+ *
+ * In case of success the length of the new string is returned,
+ * otherwise a negative error code is returned.
+ *
+ * @note The memory of the new UTF-8 string will have been allocated
+ * with `malloc`, and should therefore be deallocated with `free`.
+ */
+UTF8PROC_DLLEXPORT utf8proc_ssize_t utf8proc_map(
+  const utf8proc_uint8_t *str, utf8proc_ssize_t strlen, utf8proc_uint8_t **dstptr, utf8proc_option_t options
+);
 
-/* Code points 0009..000D, 0085 and categories Z*. */
-bool kb_is_space(char32_t);
+/** @name Unicode normalization
+ *
+ * Returns a pointer to newly allocated memory of a NFD, NFC, NFKD or NFKC
+ * normalized version of the null-terminated string `str`.  These
+ * are shortcuts to calling @ref utf8proc_map with @ref UTF8PROC_NULLTERM
+ * combined with @ref UTF8PROC_STABLE and flags indicating the normalization.
+ */
+/** @{ */
+/** NFD normalization (@ref UTF8PROC_DECOMPOSE). */
+UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFD(const utf8proc_uint8_t *str);
+/** NFC normalization (@ref UTF8PROC_COMPOSE). */
+UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFC(const utf8proc_uint8_t *str);
+/** NFD normalization (@ref UTF8PROC_DECOMPOSE and @ref UTF8PROC_COMPAT). */
+UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFKD(const utf8proc_uint8_t *str);
+/** NFD normalization (@ref UTF8PROC_COMPOSE and @ref UTF8PROC_COMPAT). */
+UTF8PROC_DLLEXPORT utf8proc_uint8_t *utf8proc_NFKC(const utf8proc_uint8_t *str);
+/** @} */
 
+#ifdef __cplusplus
+}
 #endif
-#line 8 "imp.h"
 
-struct span {
-   size_t start;
-   size_t end;
-};
+#endif
+#line 3 "dict.c"
+#line 1 "dict.h"
+#ifndef GN_DICT_H
+#define GN_DICT_H
 
-struct gourgandine {
+/* Layout of compiled dictionaries, shared by the library, which reads them,
+ * and the command-line tool, which writes them.
+ *
+ * A dictionary is a static hash table of normalized acronyms, each with a list
+ * of expansions. It is meant to be mapped in memory: a lookup hashes the
+ * acronym and usually reads a single slot and a single acronym entry. All
+ * integers are in native byte order, which the header records, and all tables
+ * start on an 8 bytes boundary.
+ *
+ * A file starts with a 56 bytes header:
+ *
+ *    char magic[8]              GN_DICT_MAGIC.
+ *    u32 version                GN_DICT_VERSION.
+ *    u32 byte_order             GN_DICT_BYTE_ORDER, as written.
+ *    u32 max_len                Length of the longest acronym, in bytes.
+ *    u32 zero
+ *    u64 slots                  Size of the hash table, a power of two.
+ *    u64 acronyms               Number of entries of the tables below.
+ *    u64 expansions
+ *    u64 strings_size           Size of the string heap, in bytes.
+ *
+ * followed by:
+ *
+ *    struct gn_dict_acronym acronyms[acronyms]
+ *    struct gn_dict_expansion expansions[expansions]
+ *                               The expansions of each acronym follow each
+ *                               other, in the order of the source dictionary.
+ *    u32 slots[slots]           Hash table with linear probing, at most three
+ *                               quarters full. Each slot holds the index of an
+ *                               acronym incremented by one, or 0 if it is free.
+ *                               Acronyms are hashed with gn_dict_hash(), and
+ *                               start at slot (hash & (slots - 1)).
+ *    char strings[strings_size] String heap. Strings are nul-terminated.
+ *    padding                    Up to the next multiple of 8.
+ */
 
-   /* Buffer for normalizing an acronym and its expansion. They are stored
-    * consecutively: acronym '\0' expansion '\0'.
-    */
-   char *buf;
+#include <stdint.h>
+#include <stddef.h>
 
-   /* Buffer for holding the string to match, which is normalized. We write here
-    * a string of the form: acronym TAB (expansion_word SPACE)+.
-    */
-   int32_t *str;
+#define GN_DICT_MAGIC "gndict\0\n"
+#define GN_DICT_VERSION 1
+#define GN_DICT_BYTE_ORDER 0x01020304
+#define GN_DICT_HEADER_SIZE 56
 
-   /* Over-segmenting tokens is necessary for matching, e.g.:
-    *
-    *    [GAP] D-glyercaldehyde 3-phosphate
-    *
-    * Our tokenizer doesn't split on '-', in particular, so we must perform a
-    * new segmentation of each token. The following keeps track of the relation
-    * between the token chunks we produce here and the position of the
-    * corresponding token in the input sentence, so that we can obtain correct
-    * offsets after processing.
-    */
-   struct assoc {
-      /* Offset in the "str" of the current normalized token. */
-      size_t norm_off;
-      /* Position of the corresponding real token in the sentence. */
-      size_t token_no;
-   } *tokens;
+struct gn_dict_acronym {
+   uint64_t str;              /* Heap offset of the acronym. */
+   uint32_t len;
+   uint32_t count;            /* Number of expansions. */
+   uint64_t first;            /* Index of the first one. */
 };
 
-struct gn_acronym;
+struct gn_dict_expansion {
+   uint64_t str;              /* Heap offset of the expansion. */
+   uint64_t len;
+};
 
-local void gn_encode(struct gourgandine *rec, const struct mr_token *sent,
-                     size_t abbr, const struct span *exp);
+/* FNV-1a. Periods are skipped, so that acronyms found in text can be looked up
+ * before they are normalized.
+ */
+static inline uint64_t gn_dict_hash(const char *str, size_t len)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325);
+   for (size_t i = 0; i < len; i++) {
+      if (str[i] == '.')
+         continue;
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
 
-local void gn_extract(struct gourgandine *rec, const struct mr_token *sent,
-                      struct gn_acronym *def);
 #endif
-#line 5 "encode.c"
+#line 6 "dict.c"
 #line 1 "utf8.h"
 #ifndef GN_UTF8_H
 #define GN_UTF8_H
@@ -1033,46 +2232,248 @@ local void gn_extract(struct gourgandine *rec, const struct mr_token *sent,
 local bool gn_is_alnum(char32_t c);
 local bool gn_is_double_quote(int32_t c);
 
-#endif
-#line 6 "encode.c"
-#line 1 "vec.h"
-#ifndef GN_VEC_H
-#define GN_VEC_H
+#endif
+#line 7 "dict.c"
+
+struct gn_dict {
+   const struct gn_dict_acronym *acronyms;
+   const struct gn_dict_expansion *expansions;
+   const uint32_t *slots;
+   const char *strings;
+   uint64_t nr_acronyms, nr_expansions;
+   uint64_t mask;
+   uint64_t strings_size;
+   size_t max_len;
+};
+
+/* Checks that a table of "nr" items of the given size fits at "pos". */
+static bool dict_fits(size_t size, size_t *pos, uint64_t nr, size_t item_size)
+{
+   if (nr > (size - *pos) / item_size)
+      return false;
+   *pos += nr * item_size;
+   return true;
+}
+
+struct gn_dict *gn_dict_open(const void *data, size_t size)
+{
+   const char *map = data;
+   if (size < GN_DICT_HEADER_SIZE || (uintptr_t)map % 8
+    || memcmp(map, GN_DICT_MAGIC, 8))
+      return NULL;
+
+   uint32_t hdr[4];
+   uint64_t counts[4];
+   memcpy(hdr, &map[8], sizeof hdr);
+   memcpy(counts, &map[24], sizeof counts);
+   if (hdr[0] != GN_DICT_VERSION || hdr[1] != GN_DICT_BYTE_ORDER)
+      return NULL;
+   /* The hash table must have a free slot, for lookups to terminate. */
+   uint64_t nr_slots = counts[0];
+   if (!nr_slots || nr_slots & (nr_slots - 1) || counts[1] >= nr_slots
+    || counts[1] > UINT32_MAX)
+      return NULL;
+
+   struct gn_dict d = {
+      .nr_acronyms = counts[1],
+      .nr_expansions = counts[2],
+      .strings_size = counts[3],
+      .mask = nr_slots - 1,
+      .max_len = hdr[2],
+   };
+   size_t pos = GN_DICT_HEADER_SIZE;
+   d.acronyms = (const struct gn_dict_acronym *)&map[pos];
+   bool ok = dict_fits(size, &pos, d.nr_acronyms, sizeof *d.acronyms);
+   d.expansions = (const struct gn_dict_expansion *)&map[pos];
+   ok = ok && dict_fits(size, &pos, d.nr_expansions, sizeof *d.expansions);
+   d.slots = (const uint32_t *)&map[pos];
+   ok = ok && dict_fits(size, &pos, nr_slots, sizeof *d.slots);
+   d.strings = &map[pos];
+   ok = ok && dict_fits(size, &pos, d.strings_size, 1);
+   if (!ok || (d.strings_size && d.strings[d.strings_size - 1]))
+      return NULL;
+
+   struct gn_dict *ret = gn_malloc(sizeof *ret);
+   *ret = d;
+   return ret;
+}
 
-#include <stdlib.h>
+void gn_dict_close(struct gn_dict *d)
+{
+   free(d);
+}
 
-extern size_t gn_vec_void[2];
+/* Compares a token with a normalized acronym, ignoring periods in the
+ * token.
+ */
+static bool dict_same(const char *tok, size_t len, const char *acr,
+                      size_t acr_len)
+{
+   size_t j = 0;
+   for (size_t i = 0; i < len; i++) {
+      if (tok[i] == '.')
+         continue;
+      if (j == acr_len || tok[i] != acr[j++])
+         return false;
+   }
+   return j == acr_len;
+}
 
-#define GN_VEC_INIT (void *)&gn_vec_void[2]
+local const struct gn_dict_acronym *gn_dict_lookup(const struct gn_dict *d,
+                                                   const char *str, size_t len)
+{
+   /* Periods make tokens at most twice as long as the acronym. */
+   if (len > 2 * d->max_len)
+      return NULL;
+
+   size_t pos = gn_dict_hash(str, len) & d->mask;
+   uint32_t idx;
+   while ((idx = d->slots[pos])) {
+      if (idx > d->nr_acronyms)
+         return NULL;
+      const struct gn_dict_acronym *a = &d->acronyms[idx - 1];
+      if (a->str < d->strings_size && a->len < d->strings_size - a->str
+       && dict_same(str, len, &d->strings[a->str], a->len)) {
+         if (a->first > d->nr_expansions || a->count > d->nr_expansions - a->first)
+            return NULL;
+         return a;
+      }
+      pos = (pos + 1) & d->mask;
+   }
+   return NULL;
+}
 
-#define gn_vec_header(vec) ((size_t *)((char *)(vec) - sizeof gn_vec_void))
+local const char *gn_dict_key(const struct gn_dict *d,
+                              const struct gn_dict_acronym *a)
+{
+   return &d->strings[a->str];
+}
 
-#define gn_vec_len(vec)  gn_vec_header(vec)[0]
-#define gn_vec_free(vec) gn_vec_free(gn_vec_header(vec))
+local const char *gn_dict_get(const struct gn_dict *d,
+                              const struct gn_dict_acronym *a, size_t i,
+                              size_t *len)
+{
+   const struct gn_dict_expansion *e = &d->expansions[a->first + i];
+   if (e->str >= d->strings_size || e->len >= d->strings_size - e->str)
+      return NULL;
+   *len = e->len;
+   return &d->strings[e->str];
+}
 
-#define gn_vec_grow(vec, nr) do {                                              \
-   vec = gn_vec_grow(gn_vec_header(vec), nr, sizeof *(vec));                   \
-} while (0)
+const char *gn_dict_expansion(const struct gn_dict *d, const char *acronym,
+                              size_t len, size_t i, size_t *exp_len)
+{
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, acronym, len);
+   if (!a || i >= a->count)
+      return NULL;
+   return gn_dict_get(d, a, i, exp_len);
+}
 
-#define gn_vec_clear(vec) do {                                                 \
-   gn_vec_len(vec) = 0;                                                        \
-} while (0)
+/* Returns the next character of a string for comparing expansions, or -1 at
+ * its end. Double quotes are skipped and spans of white space read as a single
+ * space, as when normalizing expansions, and letters are lowercased.
+ */
+static int32_t next_char(const char *str, size_t len, size_t *pos)
+{
+   for (;;) {
+      size_t clen;
+      char32_t c = kb_decode_s(&str[*pos], len - *pos, &clen);
+      if (!clen)
+         return -1;
+      *pos += clen;
+      if (gn_is_double_quote(c))
+         continue;
+      if (kb_is_space(c)) {
+         while ((c = kb_decode_s(&str[*pos], len - *pos, &clen)), clen && kb_is_space(c))
+            *pos += clen;
+         return ' ';
+      }
+      return utf8proc_tolower(c);
+   }
+}
 
-#define gn_vec_push(vec, x) do {                                               \
-   gn_vec_grow(vec, 1);                                                        \
-   vec[gn_vec_len(vec)++] = x;                                                 \
-} while (0)
+/* Matches the start of a text against an expansion. Returns the number of
+ * bytes of the text that match, or 0 if the text doesn't start with the
+ * expansion.
+ */
+static size_t match_prefix(const char *text, size_t len, const char *exp,
+                           size_t exp_len)
+{
+   size_t i = 0, j = 0;
+   int32_t c;
+   while ((c = next_char(exp, exp_len, &j)) >= 0)
+      if (next_char(text, len, &i) != c)
+         return 0;
+   return i;
+}
 
-void *(gn_vec_grow)(size_t *vec, size_t incr, size_t elt_size);
+/* Returns the first letter of a string, lowercased. */
+static int32_t first_char(const char *str, size_t len)
+{
+   size_t pos = 0;
+   return next_char(str, len, &pos);
+}
 
-static inline void (gn_vec_free)(size_t *vec)
+local bool gn_dict_match_rev(const struct gn_dict *d, const struct mr_token *sent,
+                             size_t abbr, struct span *exp)
 {
-   if (vec != gn_vec_void)
-      free(vec);
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, sent[abbr].str, sent[abbr].len);
+   if (!a)
+      return false;
+
+   /* Try the longest expansions first. */
+   const char *end = sent[exp->end - 1].str + sent[exp->end - 1].len;
+   for (size_t k = exp->start; k < exp->end; k++) {
+      int32_t c = first_char(sent[k].str, sent[k].len);
+      for (size_t i = 0; i < a->count; i++) {
+         size_t len;
+         const char *str = gn_dict_get(d, a, i, &len);
+         if (!str || first_char(str, len) != c)
+            continue;
+         size_t text_len = end - sent[k].str;
+         if (match_prefix(sent[k].str, text_len, str, len) == text_len) {
+            exp->start = k;
+            return true;
+         }
+      }
+   }
+   return false;
 }
 
-#endif
-#line 7 "encode.c"
+local bool gn_dict_match_fwd(const struct gn_dict *d, const struct mr_token *sent,
+                             size_t abbr, struct span *exp)
+{
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, sent[abbr].str, sent[abbr].len);
+   if (!a)
+      return false;
+
+   /* Keep the longest expansion that ends at the end of a token. */
+   const char *start = sent[exp->start].str;
+   size_t text_len = sent[exp->end - 1].str + sent[exp->end - 1].len - start;
+   size_t best = 0;
+   for (size_t i = 0; i < a->count; i++) {
+      size_t len;
+      const char *str = gn_dict_get(d, a, i, &len);
+      if (!str)
+         continue;
+      size_t n = match_prefix(start, text_len, str, len);
+      if (!n)
+         continue;
+      for (size_t k = exp->start; k < exp->end; k++) {
+         if (sent[k].str + sent[k].len == start + n) {
+            if (k + 1 > best)
+               best = k + 1;
+            break;
+         }
+      }
+   }
+   if (!best)
+      return false;
+   exp->end = best;
+   return true;
+}
+#line 1 "encode.c"
+#include <assert.h>
 
 /* Before comparing an acronym to its expansion, we do the following:
  * (a) Use Unicode decomposition mappings (NFKC).
@@ -1189,26 +2590,6 @@ local void gn_encode(struct gourgandine *rec, const struct mr_token *sent,
 #line 1 "mem.c"
 #include <stdlib.h>
 #include <stdio.h>
-#line 1 "mem.h"
-#ifndef GN_MEM_H
-#define GN_MEM_H
-
-#include <stddef.h>
-#include <stdarg.h>
-#include <stdnoreturn.h>
-
-local noreturn void gn_fatal(const char *msg, ...);
-
-local void *gn_malloc(size_t)
-#ifdef ___GNUC__
-   __attribute__((malloc))
-#endif
-   ;
-
-local void *gn_realloc(void *, size_t);
-
-#endif
-#line 4 "mem.c"
 
 local noreturn void gn_fatal(const char *msg, ...)
 {
@@ -1242,67 +2623,6 @@ local void *gn_realloc(void *mem, size_t size)
    return mem;
 }
 #line 1 "normalize.c"
-#line 1 "api.h"
-#ifndef GOURGANDINE_H
-#define GOURGANDINE_H
-
-#define GN_VERSION "0.3"
-
-#include <stddef.h>
-
-struct gourgandine *gn_alloc(void);
-void gn_dealloc(struct gourgandine *);
-
-/* An acronym definition. */
-struct gn_acronym {
-
-   /* The acronym and its expansion, normalized: periods are removed in the
-    * acronym, while double quotes and excessive white space are trimmed in the
-    * corresponding expansion. These strings do not point into the source
-    * text. They are nul-terminated.
-    */
-   const char *acronym;
-   size_t acronym_len;
-   const char *expansion;
-   size_t expansion_len;
-
-   /* Start and end offset, in the input sentence, of the acronym and its
-    * expansion. We count in tokens. The end offset of the expansion is the
-    * offset of the token that follows its last word in the input sentence,
-    * such that substracting the expansion start offset from it gives the
-    * length, in tokens, of the expansion. The same applies to the abbreviation.
-    */
-   size_t acronym_start;
-   size_t acronym_end;
-   size_t expansion_start;
-   size_t expansion_end;
-};
-
-/* Token structure. Declared in my tokenization library
- * (https://github.com/michaelnmmeyer/mascara), which can be used for
- * preprocessing.
- */
-struct mr_token;
-
-/* Finds acronym definitions in a sentence.
- *
- * If an acronym definition is found in the provided sentence, fills the
- * provided acronym structure with informations about it, and returns 1.
- * Otherwise, leaves the acronym structure untouched, and returns 0.
- *
- * This must be called several times in a loop to obtain all acronyms in a
- * sentence. Before the first call, the acronym structure must be zeroed.
- * Afterwards, the same structure must be passed again, untouched: the offsets
- * it contains are used to determine where to restart on each call.
- *
- * The provided sentence must be valid UTF-8. Otherwise, the result is
- * undefined.
- */
-int gn_search(struct gourgandine *, const struct mr_token *sent, size_t sent_len,
-              struct gn_acronym *);
-
-#endif
-#line 3 "normalize.c"
 
 static size_t norm_exp(char *buf, const char *str, size_t len)
 {
@@ -1626,6 +2946,7 @@ static int find_acronym(struct gourgandine *rec, const struct mr_token *sent,
    rtrim_sym(sent, exp);
    ltrim_sym(sent, abbr);
    rtrim_sym(sent, abbr);
+   size_t bound;
 
    /* Nothing to do if we end up with the empty string after truncation. */
    if (exp->start == exp->end || abbr->start == abbr->end)
@@ -1665,10 +2986,15 @@ static int find_acronym(struct gourgandine *rec, const struct mr_token *sent,
       exp->start = exp->end - MAX_EXPANSION_LEN;
    if (!pre_check(&sent[abbr->start]))
       goto reverse;
-   if (!extract_rev(rec, sent, abbr->start, exp))
-      goto reverse;
-   if (!post_check(sent, abbr->start, exp))
-      goto reverse;
+   bound = exp->start;
+   if (!extract_rev(rec, sent, abbr->start, exp)
+    || !post_check(sent, abbr->start, exp)) {
+      /* Fall back to the expansions known for the acronym, if any. */
+      exp->start = bound;
+      if (!rec->dict || !gn_dict_match_rev(rec->dict, sent, abbr->start, exp)
+       || !post_check(sent, abbr->start, exp))
+         goto reverse;
+   }
 
    acr->acronym_start = abbr->start;
    acr->acronym_end = abbr->end;
@@ -1685,10 +3011,14 @@ reverse:
       abbr->start = abbr->end - MAX_EXPANSION_LEN;
    if (!pre_check(&sent[exp->start]))
       return 0;
-   if (!extract_fwd(rec, sent, exp->start, abbr))
-      return 0;
-   if (!post_check(sent, exp->start, abbr))
-      return 0;
+   bound = abbr->end;
+   if (!extract_fwd(rec, sent, exp->start, abbr)
+    || !post_check(sent, exp->start, abbr)) {
+      abbr->end = bound;
+      if (!rec->dict || !gn_dict_match_fwd(rec->dict, sent, exp->start, abbr)
+       || !post_check(sent, exp->start, abbr))
+         return 0;
+   }
 
    acr->acronym_start = exp->start;
    acr->acronym_end = exp->end;
@@ -1788,6 +3118,11 @@ struct gourgandine *gn_alloc(void)
    return gn;
 }
 
+void gn_set_dict(struct gourgandine *gn, const struct gn_dict *dict)
+{
+   gn->dict = dict;
+}
+
 void gn_dealloc(struct gourgandine *gn)
 {
    gn_vec_free(gn->buf);
@@ -1795,6 +3130,263 @@ void gn_dealloc(struct gourgandine *gn)
    gn_vec_free(gn->tokens);
    free(gn);
 }
+#line 1 "uses.c"
+#include <string.h>
+
+/* A defined acronym. Strings are stored in the arena, as: acronym '\0'
+ * expansion '\0'.
+ */
+struct entry {
+   uint64_t hash;
+   size_t str;
+   size_t acronym_len, expansion_len;
+
+   /* Number of the sentence the acronym is defined in, and position of the
+    * first token after the definition in this sentence. Uses are only
+    * reported past that point.
+    */
+   size_t sent_no;
+   size_t after;
+};
+
+struct gn_glossary {
+   struct entry *entries;
+   char *arena;
+
+   /* Open-addressing table with linear probing, as for counters. */
+   size_t *slots;
+   size_t mask;
+
+   size_t max_len;            /* Length of the longest acronym. */
+   size_t sent_no;            /* Number of the current sentence. */
+
+   /* Positions of the acronyms defined in the current sentence, which are not
+    * uses, even when the acronym is defined again.
+    */
+   size_t *defined;
+
+   const struct gn_dict *dict;   /* Known acronyms, or NULL. */
+};
+
+#define GLOSSARY_MIN_SLOTS 64
+
+/* FNV-1a, ignoring periods, which are dropped when normalizing acronyms.
+ * Stores the length of the normalized string in "norm_len", or a length larger
+ * than "max_len" if it is too long.
+ */
+static uint64_t hash_acronym(const char *str, size_t len, size_t max_len,
+                             size_t *norm_len)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325);
+   size_t n = 0;
+   for (size_t i = 0; i < len; i++) {
+      if (str[i] == '.')
+         continue;
+      if (++n > max_len)
+         break;
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   *norm_len = n;
+   return h;
+}
+
+/* Compares a token with a normalized acronym. */
+static bool same_acronym(const char *tok, size_t len, const char *acr)
+{
+   for (size_t i = 0; i < len; i++) {
+      if (tok[i] == '.')
+         continue;
+      if (tok[i] != *acr++)
+         return false;
+   }
+   return true;
+}
+
+struct gn_glossary *gn_glossary_alloc(void)
+{
+   struct gn_glossary *g = gn_malloc(sizeof *g);
+   *g = (struct gn_glossary){
+      .entries = GN_VEC_INIT,
+      .arena = GN_VEC_INIT,
+      .slots = gn_malloc(GLOSSARY_MIN_SLOTS * sizeof *g->slots),
+      .mask = GLOSSARY_MIN_SLOTS - 1,
+      .defined = GN_VEC_INIT,
+   };
+   memset(g->slots, 0, GLOSSARY_MIN_SLOTS * sizeof *g->slots);
+   return g;
+}
+
+void gn_glossary_dealloc(struct gn_glossary *g)
+{
+   gn_vec_free(g->entries);
+   gn_vec_free(g->arena);
+   gn_vec_free(g->defined);
+   free(g->slots);
+   free(g);
+}
+
+void gn_glossary_clear(struct gn_glossary *g)
+{
+   gn_vec_clear(g->entries);
+   gn_vec_clear(g->arena);
+   gn_vec_clear(g->defined);
+   memset(g->slots, 0, (g->mask + 1) * sizeof *g->slots);
+   g->max_len = 0;
+   g->sent_no = 0;
+}
+
+static void glossary_rehash(struct gn_glossary *g)
+{
+   size_t size = (g->mask + 1) * 2;
+   if (size > SIZE_MAX / sizeof *g->slots)
+      gn_fatal("integer overflow");
+   free(g->slots);
+   g->slots = gn_malloc(size * sizeof *g->slots);
+   memset(g->slots, 0, size * sizeof *g->slots);
+   g->mask = size - 1;
+
+   for (size_t i = 0; i < gn_vec_len(g->entries); i++) {
+      size_t pos = g->entries[i].hash & g->mask;
+      while (g->slots[pos])
+         pos = (pos + 1) & g->mask;
+      g->slots[pos] = i + 1;
+   }
+}
+
+void gn_glossary_add(struct gn_glossary *g, const struct gn_acronym *def)
+{
+   gn_vec_push(g->defined, def->acronym_start);
+
+   size_t len;
+   uint64_t h = hash_acronym(def->acronym, def->acronym_len, SIZE_MAX, &len);
+   size_t pos = h & g->mask;
+   size_t idx;
+   while ((idx = g->slots[pos])) {
+      const struct entry *e = &g->entries[idx - 1];
+      if (e->hash == h && e->acronym_len == len
+       && !memcmp(&g->arena[e->str], def->acronym, len))
+         return;
+      pos = (pos + 1) & g->mask;
+   }
+
+   size_t after = def->acronym_end;
+   if (def->expansion_end > after)
+      after = def->expansion_end;
+   struct entry e = {
+      .hash = h,
+      .str = gn_vec_len(g->arena),
+      .acronym_len = len,
+      .expansion_len = def->expansion_len,
+      .sent_no = g->sent_no,
+      .after = after,
+   };
+   gn_vec_grow(g->arena, len + def->expansion_len + 2);
+   char *str = &g->arena[e.str];
+   memcpy(str, def->acronym, len);
+   str[len] = '\0';
+   memcpy(&str[len + 1], def->expansion, def->expansion_len);
+   str[len + 1 + def->expansion_len] = '\0';
+   gn_vec_len(g->arena) += len + def->expansion_len + 2;
+
+   gn_vec_push(g->entries, e);
+   g->slots[pos] = gn_vec_len(g->entries);
+   if (len > g->max_len)
+      g->max_len = len;
+   if (gn_vec_len(g->entries) > (g->mask + 1) / 2)
+      glossary_rehash(g);
+}
+
+void gn_glossary_set_dict(struct gn_glossary *g, const struct gn_dict *dict)
+{
+   g->dict = dict;
+}
+
+/* Finds the entry of the acronym a token is a use of. Returns 0 if it is not
+ * defined, 1 if it is, or -1 if it is defined later in the sentence.
+ */
+static int find_entry(const struct gn_glossary *g, const struct mr_token *tk,
+                      size_t tok_no, const struct entry **ret)
+{
+   size_t len;
+   uint64_t h = hash_acronym(tk->str, tk->len, g->max_len, &len);
+   if (len > g->max_len)
+      return 0;
+
+   size_t pos = h & g->mask;
+   size_t idx;
+   while ((idx = g->slots[pos])) {
+      const struct entry *e = &g->entries[idx - 1];
+      if (e->hash == h && e->acronym_len == len
+       && same_acronym(tk->str, tk->len, &g->arena[e->str])) {
+         if (e->sent_no == g->sent_no && tok_no < e->after)
+            return -1;
+         *ret = e;
+         return 1;
+      }
+      pos = (pos + 1) & g->mask;
+   }
+   return 0;
+}
+
+/* Fills "use" if a token is a use of a defined or known acronym. */
+static bool find_use(const struct gn_glossary *g, const struct mr_token *tk,
+                     size_t tok_no, struct gn_use *use)
+{
+   /* Acronyms start with an alphanumeric character, which excludes most
+    * punctuation cheaply.
+    */
+   if (tk->type == MR_SYM)
+      return false;
+   for (size_t i = 0; i < gn_vec_len(g->defined); i++)
+      if (g->defined[i] == tok_no)
+         return false;
+
+   const struct entry *e;
+   switch (find_entry(g, tk, tok_no, &e)) {
+   case 1: {
+      const char *str = &g->arena[e->str];
+      use->acronym = str;
+      use->acronym_len = e->acronym_len;
+      use->expansion = &str[e->acronym_len + 1];
+      use->expansion_len = e->expansion_len;
+      use->known = 0;
+      return true;
+   }
+   case -1:
+      return false;
+   }
+   if (!g->dict)
+      return false;
+
+   const struct gn_dict_acronym *a = gn_dict_lookup(g->dict, tk->str, tk->len);
+   if (!a || !a->count)
+      return false;
+   use->expansion = gn_dict_get(g->dict, a, 0, &use->expansion_len);
+   if (!use->expansion)
+      return false;
+   use->acronym = gn_dict_key(g->dict, a);
+   use->acronym_len = a->len;
+   use->known = 1;
+   return true;
+}
+
+int gn_glossary_search(struct gn_glossary *g, const struct mr_token *sent,
+                       size_t len, struct gn_use *use)
+{
+   if (gn_vec_len(g->entries) || g->dict) {
+      for (size_t i = use->end; i < len; i++) {
+         if (find_use(g, &sent[i], i, use)) {
+            use->start = i;
+            use->end = i + 1;
+            return 1;
+         }
+      }
+   }
+   g->sent_no++;
+   gn_vec_clear(g->defined);
+   return 0;
+}
 #line 1 "utf8.c"
 
 local bool gn_is_alnum(char32_t c)
@@ -1840,7 +3432,8 @@ void *(gn_vec_grow)(size_t *vec, size_t nr, size_t elt_size)
       if (need > (SIZE_MAX - sizeof gn_vec_void) / elt_size)
          gn_fatal("integer overflow");
       vec = gn_malloc(sizeof gn_vec_void + need * elt_size);
-      vec[0] = vec[1] = 0;
+      vec[0] = 0;
+      vec[1] = need;
       return vec + 2;
    }
 
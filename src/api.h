@@ -56,4 +56,173 @@ struct mr_token;
 int gn_search(struct gourgandine *, const struct mr_token *sent, size_t sent_len,
               struct gn_acronym *);
 
+/* Dictionary of known acronyms and their expansions, compiled from a TSV file
+ * with the "dict" command of the command-line tool. A compiled dictionary is
+ * meant to be mapped in memory: it is read in place, and lookups don't
+ * allocate. Its layout is documented in "src/dict.h".
+ *
+ * Returns a dictionary reading the given data, which must be aligned on an 8
+ * bytes boundary and stay valid until the dictionary is closed, or NULL if it
+ * is not a compiled dictionary.
+ */
+struct gn_dict *gn_dict_open(const void *data, size_t size);
+void gn_dict_close(struct gn_dict *);
+
+/* Returns the expansion number "i" of an acronym, in the order of the source
+ * dictionary, and stores its length in "exp_len". Periods in the acronym are
+ * ignored. Returns NULL if there is no such expansion.
+ */
+const char *gn_dict_expansion(const struct gn_dict *, const char *acronym,
+                              size_t len, size_t i, size_t *exp_len);
+
+/* Makes gn_search() consult a dictionary, or stop doing so if it is NULL.
+ * Definitions whose expansion doesn't match the acronym by the usual rules are
+ * then accepted if the expansion is one the dictionary gives for it, e.g.:
+ *
+ *    Maritime Forces Atlantic (MARLANT)
+ *
+ * A dictionary can be shared by several threads.
+ */
+void gn_set_dict(struct gourgandine *, const struct gn_dict *);
+
+/* Cache of the definitions found in the last "size" distinct sentences, for
+ * corpora where the same sentences occur again and again (boilerplate,
+ * disclaimers, navigation text). Sentences are keyed by their bytes, from the
+ * start of their first token to the end of their last one, and the least
+ * recently used one is evicted when the cache is full. A cache is not
+ * thread-safe, and must always be used with the same gourgandine structure,
+ * as cached results depend on its settings.
+ */
+struct gn_cache *gn_cache_alloc(size_t size);
+void gn_cache_dealloc(struct gn_cache *);
+
+/* Finds all acronym definitions in a sentence, as calling gn_search() in a
+ * loop would, and returns their number. Definitions are stored in "defs", and
+ * are valid until the next call. Sentences without an opening bracket, which
+ * can't hold definitions, bypass the cache.
+ */
+size_t gn_cache_search(struct gn_cache *, struct gourgandine *,
+                       const struct mr_token *sent, size_t sent_len,
+                       const struct gn_acronym **defs);
+
+/* Number of sentences looked up that were found in the cache, and that were
+ * not.
+ */
+void gn_cache_stats(const struct gn_cache *, size_t *hits, size_t *misses);
+
+/* Counts of acronym definitions, by normalized acronym and expansion. A
+ * counter is not thread-safe, but counters filled on separate threads can be
+ * merged afterwards.
+ */
+struct gn_counter *gn_counter_alloc(void);
+void gn_counter_dealloc(struct gn_counter *);
+
+/* Counts a definition found in the document numbered "doc". The number of
+ * documents a definition occurs in is only exact if the definitions of a
+ * document are added one after the other.
+ */
+void gn_counter_add(struct gn_counter *, const struct gn_acronym *, size_t doc);
+
+/* Adds the counts of a counter to another one. A document seen by both
+ * counters is counted twice, unless it is the last document of a definition in
+ * the destination counter and the first one in the source counter, as happens
+ * when merging, in order, the counts of consecutive parts of a document.
+ */
+void gn_counter_merge(struct gn_counter *dst, const struct gn_counter *src);
+
+/* A counted definition. Strings are nul-terminated. */
+struct gn_count {
+   const char *acronym;
+   size_t acronym_len;
+   const char *expansion;
+   size_t expansion_len;
+   size_t freq;               /* Number of occurrences. */
+   size_t docs;               /* Number of documents it occurs in. */
+   size_t first_doc;          /* Numbers of the first and last of these */
+   size_t last_doc;           /* documents, in the order they were added. */
+   size_t error;              /* For approximate counts, by how much freq
+                               * may be overestimated. */
+};
+
+/* Returns the counted definitions by decreasing frequency, then by acronym
+ * and expansion, and stores their number in "nr". The returned array is valid
+ * until the counter is modified.
+ */
+const struct gn_count *gn_counter_sort(struct gn_counter *, size_t *nr);
+
+/* Same as gn_counter_sort(), but sorts definitions by acronym, then by
+ * expansion, in byte order, for merging counts with other sorted lists.
+ */
+const struct gn_count *gn_counter_list(struct gn_counter *, size_t *nr);
+
+/* Number of bytes allocated by the counter, for keeping its size bounded. */
+size_t gn_counter_memory(const struct gn_counter *);
+
+/* Removes all counted definitions, and releases the memory they used. */
+void gn_counter_clear(struct gn_counter *);
+
+/* Approximate counts of the most frequent acronym definitions, with the
+ * Space-Saving algorithm, in fixed memory. Only "k" definitions are tracked.
+ * When a definition that is not tracked is added, it replaces the one with the
+ * lowest count, and inherits its count as error. Counts are thus upper bounds,
+ * and any definition that occurs more than N/k times, N being the total number
+ * of definitions added, is guaranteed to be tracked. As for counters, sketches
+ * filled on separate threads can be merged.
+ */
+struct gn_topk *gn_topk_alloc(size_t k);
+void gn_topk_dealloc(struct gn_topk *);
+
+void gn_topk_add(struct gn_topk *, const struct gn_acronym *);
+
+/* Adds the counts of a sketch to another one, which then tracks the "k"
+ * definitions with the highest combined counts.
+ */
+void gn_topk_merge(struct gn_topk *dst, const struct gn_topk *src);
+
+/* Same as gn_counter_sort(). Document counts are not available. */
+const struct gn_count *gn_topk_sort(struct gn_topk *, size_t *nr);
+
+/* Acronyms defined in a document, for finding where they are used afterwards,
+ * in the same pass over its sentences. Uses are tokens that are equal to a
+ * defined acronym once normalized, and are looked up in a hash table. Only the
+ * first definition of an acronym in a document is kept.
+ */
+struct gn_glossary *gn_glossary_alloc(void);
+void gn_glossary_dealloc(struct gn_glossary *);
+
+/* Forgets all definitions, before processing a new document. */
+void gn_glossary_clear(struct gn_glossary *);
+
+/* Adds a definition found by gn_search() in the current sentence. */
+void gn_glossary_add(struct gn_glossary *, const struct gn_acronym *);
+
+/* A use of a defined acronym. Strings are nul-terminated, and valid until the
+ * glossary is modified.
+ */
+struct gn_use {
+   const char *acronym;
+   size_t acronym_len;
+   const char *expansion;     /* Expansion of the acronym where it is */
+   size_t expansion_len;      /* defined. */
+   size_t start;              /* Token offsets of the use in the sentence. */
+   size_t end;
+   int known;                 /* Whether the acronym isn't defined in the
+                               * document, and the expansion is the first one
+                               * the dictionary gives. */
+};
+
+/* Makes gn_glossary_search() also report uses of the acronyms of a dictionary
+ * that are not defined in the document, or stop doing so if it is NULL.
+ */
+void gn_glossary_set_dict(struct gn_glossary *, const struct gn_dict *);
+
+/* Finds uses of the defined acronyms in a sentence, after the place they are
+ * defined at. This works as gn_search(): it must be called in a loop, with a
+ * zeroed structure, once the definitions of the sentence have been added.
+ * When it returns 0, the sentence is considered complete: the next call is
+ * about the next sentence of the document.
+ */
+int gn_glossary_search(struct gn_glossary *, const struct mr_token *sent,
+                       size_t sent_len, struct gn_use *);
+
 #endif
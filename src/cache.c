@@ -0,0 +1,270 @@
+#include <string.h>
+#include "lib/mascara.h"
+#include "api.h"
+#include "vec.h"
+#include "mem.h"
+#include "imp.h"
+
+#define CACHE_NONE SIZE_MAX
+
+/* A definition of a cached sentence. Strings are offsets into the sentence
+ * entry arena, as: acronym '\0' expansion '\0'.
+ */
+struct cached_def {
+   size_t str;
+   size_t acronym_len, expansion_len;
+   size_t acronym_start, acronym_end;
+   size_t expansion_start, expansion_end;
+};
+
+struct cached {
+   uint64_t hash;
+   char *text;                /* Sentence bytes. */
+   size_t tokens;             /* Number of tokens. */
+   struct cached_def *defs;
+   char *arena;
+   size_t prev, next;         /* Neighbours in the recency list. */
+};
+
+struct gn_cache {
+   struct cached *entries;
+   size_t size, used;
+
+   /* Open-addressing table with linear probing, as for counters, at most half
+    * full.
+    */
+   size_t *slots;
+   size_t mask;
+
+   size_t head, tail;         /* Most and least recently used entries. */
+   struct gn_acronym *found;
+   size_t hits, misses;
+};
+
+struct gn_cache *gn_cache_alloc(size_t size)
+{
+   if (!size)
+      size = 1;
+   size_t nr_slots = 2;
+   while (nr_slots / 2 < size) {
+      if (nr_slots > SIZE_MAX / 2 / sizeof(size_t))
+         gn_fatal("integer overflow");
+      nr_slots *= 2;
+   }
+   if (size > SIZE_MAX / sizeof(struct cached))
+      gn_fatal("integer overflow");
+
+   struct gn_cache *c = gn_malloc(sizeof *c);
+   *c = (struct gn_cache){
+      .entries = gn_malloc(size * sizeof *c->entries),
+      .size = size,
+      .slots = gn_malloc(nr_slots * sizeof *c->slots),
+      .mask = nr_slots - 1,
+      .head = CACHE_NONE,
+      .tail = CACHE_NONE,
+      .found = GN_VEC_INIT,
+   };
+   memset(c->slots, 0, nr_slots * sizeof *c->slots);
+   return c;
+}
+
+void gn_cache_dealloc(struct gn_cache *c)
+{
+   for (size_t i = 0; i < c->used; i++) {
+      gn_vec_free(c->entries[i].text);
+      gn_vec_free(c->entries[i].defs);
+      gn_vec_free(c->entries[i].arena);
+   }
+   gn_vec_free(c->found);
+   free(c->entries);
+   free(c->slots);
+   free(c);
+}
+
+void gn_cache_stats(const struct gn_cache *c, size_t *hits, size_t *misses)
+{
+   *hits = c->hits;
+   *misses = c->misses;
+}
+
+/* FNV-1a. */
+static uint64_t cache_hash(const char *str, size_t len, size_t tokens)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325) ^ tokens;
+   for (size_t i = 0; i < len; i++) {
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+static void cache_detach(struct gn_cache *c, size_t i)
+{
+   struct cached *e = &c->entries[i];
+   if (e->prev != CACHE_NONE)
+      c->entries[e->prev].next = e->next;
+   else
+      c->head = e->next;
+   if (e->next != CACHE_NONE)
+      c->entries[e->next].prev = e->prev;
+   else
+      c->tail = e->prev;
+}
+
+static void cache_push(struct gn_cache *c, size_t i)
+{
+   struct cached *e = &c->entries[i];
+   e->prev = CACHE_NONE;
+   e->next = c->head;
+   if (c->head != CACHE_NONE)
+      c->entries[c->head].prev = i;
+   else
+      c->tail = i;
+   c->head = i;
+}
+
+/* Frees a slot, moving following slots back if needed, as for top-k
+ * sketches.
+ */
+static void cache_unlink(struct gn_cache *c, size_t pos)
+{
+   size_t i = pos, j = pos;
+   for (;;) {
+      j = (j + 1) & c->mask;
+      if (!c->slots[j])
+         break;
+      size_t home = c->entries[c->slots[j] - 1].hash & c->mask;
+      if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+         c->slots[i] = c->slots[j];
+         i = j;
+      }
+   }
+   c->slots[i] = 0;
+}
+
+/* Returns the slot of an entry. */
+static size_t cache_slot_of(const struct gn_cache *c, size_t i)
+{
+   size_t pos = c->entries[i].hash & c->mask;
+   while (c->slots[pos] != i + 1)
+      pos = (pos + 1) & c->mask;
+   return pos;
+}
+
+/* Only sentences with an opening bracket after their first token, and
+ * followed by another token, can hold definitions, as in gn_search().
+ */
+static bool has_opening_bracket(const struct mr_token *sent, size_t len)
+{
+   for (size_t i = 1; i + 1 < len; i++)
+      if (sent[i].len == 1 && (*sent[i].str == '(' || *sent[i].str == '['
+                            || *sent[i].str == '{'))
+         return true;
+   return false;
+}
+
+static void cache_fill(struct cached *e, struct gourgandine *gn,
+                       const struct mr_token *sent, size_t len)
+{
+   gn_vec_clear(e->defs);
+   gn_vec_clear(e->arena);
+
+   struct gn_acronym def = {0};
+   while (gn_search(gn, sent, len, &def)) {
+      struct cached_def d = {
+         .str = gn_vec_len(e->arena),
+         .acronym_len = def.acronym_len,
+         .expansion_len = def.expansion_len,
+         .acronym_start = def.acronym_start,
+         .acronym_end = def.acronym_end,
+         .expansion_start = def.expansion_start,
+         .expansion_end = def.expansion_end,
+      };
+      size_t size = def.acronym_len + def.expansion_len + 2;
+      gn_vec_grow(e->arena, size);
+      char *str = &e->arena[d.str];
+      memcpy(str, def.acronym, def.acronym_len + 1);
+      memcpy(&str[def.acronym_len + 1], def.expansion, def.expansion_len + 1);
+      gn_vec_len(e->arena) += size;
+      gn_vec_push(e->defs, d);
+   }
+}
+
+size_t gn_cache_search(struct gn_cache *c, struct gourgandine *gn,
+                       const struct mr_token *sent, size_t len,
+                       const struct gn_acronym **defs)
+{
+   *defs = NULL;
+   if (!has_opening_bracket(sent, len))
+      return 0;
+
+   const char *text = sent[0].str;
+   size_t text_len = sent[len - 1].str + sent[len - 1].len - text;
+   uint64_t h = cache_hash(text, text_len, len);
+
+   size_t pos = h & c->mask;
+   size_t idx;
+   while ((idx = c->slots[pos])) {
+      const struct cached *e = &c->entries[idx - 1];
+      if (e->hash == h && e->tokens == len && gn_vec_len(e->text) == text_len
+       && !memcmp(e->text, text, text_len))
+         break;
+      pos = (pos + 1) & c->mask;
+   }
+
+   size_t i;
+   if (idx) {
+      c->hits++;
+      i = idx - 1;
+      cache_detach(c, i);
+   } else {
+      c->misses++;
+      if (c->used < c->size) {
+         i = c->used++;
+         c->entries[i] = (struct cached){
+            .text = GN_VEC_INIT,
+            .defs = GN_VEC_INIT,
+            .arena = GN_VEC_INIT,
+         };
+      } else {
+         /* Evict the least recently used sentence. */
+         i = c->tail;
+         cache_detach(c, i);
+         cache_unlink(c, cache_slot_of(c, i));
+         pos = h & c->mask;
+         while (c->slots[pos])
+            pos = (pos + 1) & c->mask;
+      }
+      struct cached *e = &c->entries[i];
+      e->hash = h;
+      e->tokens = len;
+      gn_vec_clear(e->text);
+      gn_vec_grow(e->text, text_len);
+      memcpy(e->text, text, text_len);
+      gn_vec_len(e->text) = text_len;
+      cache_fill(e, gn, sent, len);
+      c->slots[pos] = i + 1;
+   }
+   cache_push(c, i);
+
+   const struct cached *e = &c->entries[i];
+   size_t nr = gn_vec_len(e->defs);
+   gn_vec_clear(c->found);
+   gn_vec_grow(c->found, nr);
+   for (size_t j = 0; j < nr; j++) {
+      const struct cached_def *d = &e->defs[j];
+      c->found[j] = (struct gn_acronym){
+         .acronym = &e->arena[d->str],
+         .acronym_len = d->acronym_len,
+         .expansion = &e->arena[d->str + d->acronym_len + 1],
+         .expansion_len = d->expansion_len,
+         .acronym_start = d->acronym_start,
+         .acronym_end = d->acronym_end,
+         .expansion_start = d->expansion_start,
+         .expansion_end = d->expansion_end,
+      };
+   }
+   gn_vec_len(c->found) = nr;
+   *defs = c->found;
+   return nr;
+}
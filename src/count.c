@@ -0,0 +1,532 @@
+#include <string.h>
+#include <assert.h>
+#include "api.h"
+#include "vec.h"
+#include "mem.h"
+#include "imp.h"
+
+/* A counted definition. Strings are stored in the arena, as: acronym '\0'
+ * expansion '\0'. We keep offsets rather than pointers, since the arena moves
+ * when it grows.
+ */
+struct pair {
+   uint64_t hash;
+   size_t str;
+   size_t acronym_len, expansion_len;
+   size_t freq, docs;
+   size_t first_doc, last_doc;   /* In order of addition, if docs > 0. */
+};
+
+struct gn_counter {
+   struct pair *pairs;        /* In insertion order. */
+   char *arena;
+
+   /* Open-addressing table with linear probing. Each slot holds the index of
+    * a pair incremented by one, or 0 if the slot is free. Its size is a power
+    * of two, and it is kept at most half full.
+    */
+   size_t *slots;
+   size_t mask;
+
+   struct gn_count *sorted;
+};
+
+#define MIN_SLOTS 256
+
+/* FNV-1a. */
+static uint64_t hash_str(uint64_t h, const char *str, size_t len)
+{
+   for (size_t i = 0; i < len; i++) {
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+static uint64_t hash_pair(const char *acr, size_t acr_len,
+                          const char *exp, size_t exp_len)
+{
+   uint64_t h = hash_str(UINT64_C(0xcbf29ce484222325), acr, acr_len);
+   return hash_str(h ^ 0xff, exp, exp_len);
+}
+
+struct gn_counter *gn_counter_alloc(void)
+{
+   struct gn_counter *c = gn_malloc(sizeof *c);
+   *c = (struct gn_counter){
+      .pairs = GN_VEC_INIT,
+      .arena = GN_VEC_INIT,
+      .slots = gn_malloc(MIN_SLOTS * sizeof *c->slots),
+      .mask = MIN_SLOTS - 1,
+      .sorted = GN_VEC_INIT,
+   };
+   memset(c->slots, 0, MIN_SLOTS * sizeof *c->slots);
+   return c;
+}
+
+void gn_counter_dealloc(struct gn_counter *c)
+{
+   gn_vec_free(c->pairs);
+   gn_vec_free(c->arena);
+   gn_vec_free(c->sorted);
+   free(c->slots);
+   free(c);
+}
+
+static void rehash(struct gn_counter *c)
+{
+   size_t size = (c->mask + 1) * 2;
+   if (size > SIZE_MAX / sizeof *c->slots)
+      gn_fatal("integer overflow");
+   free(c->slots);
+   c->slots = gn_malloc(size * sizeof *c->slots);
+   memset(c->slots, 0, size * sizeof *c->slots);
+   c->mask = size - 1;
+
+   for (size_t i = 0; i < gn_vec_len(c->pairs); i++) {
+      size_t pos = c->pairs[i].hash & c->mask;
+      while (c->slots[pos])
+         pos = (pos + 1) & c->mask;
+      c->slots[pos] = i + 1;
+   }
+}
+
+/* Returns the pair for a definition, adding it with null counts if needed. */
+static struct pair *find_pair(struct gn_counter *c,
+                              const char *acr, size_t acr_len,
+                              const char *exp, size_t exp_len)
+{
+   uint64_t h = hash_pair(acr, acr_len, exp, exp_len);
+   size_t pos = h & c->mask;
+   size_t idx;
+   while ((idx = c->slots[pos])) {
+      struct pair *p = &c->pairs[idx - 1];
+      const char *str = &c->arena[p->str];
+      if (p->hash == h && p->acronym_len == acr_len && p->expansion_len == exp_len
+       && !memcmp(str, acr, acr_len) && !memcmp(&str[acr_len + 1], exp, exp_len))
+         return p;
+      pos = (pos + 1) & c->mask;
+   }
+
+   struct pair p = {
+      .hash = h,
+      .str = gn_vec_len(c->arena),
+      .acronym_len = acr_len,
+      .expansion_len = exp_len,
+   };
+   gn_vec_grow(c->arena, acr_len + exp_len + 2);
+   char *str = &c->arena[p.str];
+   memcpy(str, acr, acr_len);
+   str[acr_len] = '\0';
+   memcpy(&str[acr_len + 1], exp, exp_len);
+   str[acr_len + 1 + exp_len] = '\0';
+   gn_vec_len(c->arena) += acr_len + exp_len + 2;
+
+   gn_vec_push(c->pairs, p);
+   c->slots[pos] = gn_vec_len(c->pairs);
+   if (gn_vec_len(c->pairs) > (c->mask + 1) / 2)
+      rehash(c);
+   return &c->pairs[gn_vec_len(c->pairs) - 1];
+}
+
+void gn_counter_add(struct gn_counter *c, const struct gn_acronym *def,
+                    size_t doc)
+{
+   struct pair *p = find_pair(c, def->acronym, def->acronym_len,
+                              def->expansion, def->expansion_len);
+   p->freq++;
+   if (!p->docs) {
+      p->first_doc = p->last_doc = doc;
+      p->docs = 1;
+   } else if (doc != p->last_doc) {
+      p->last_doc = doc;
+      p->docs++;
+   }
+}
+
+void gn_counter_merge(struct gn_counter *dst, const struct gn_counter *src)
+{
+   assert(dst != src);
+   for (size_t i = 0; i < gn_vec_len(src->pairs); i++) {
+      const struct pair *s = &src->pairs[i];
+      const char *str = &src->arena[s->str];
+      struct pair *d = find_pair(dst, str, s->acronym_len,
+                                 &str[s->acronym_len + 1], s->expansion_len);
+      d->freq += s->freq;
+      if (!d->docs) {
+         d->docs = s->docs;
+         d->first_doc = s->first_doc;
+         d->last_doc = s->last_doc;
+         continue;
+      }
+      d->docs += s->docs - (d->last_doc == s->first_doc);
+      d->last_doc = s->last_doc;
+   }
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+   const struct gn_count *x = a, *y = b;
+   int ret = strcmp(x->acronym, y->acronym);
+   return ret ? ret : strcmp(x->expansion, y->expansion);
+}
+
+static int compare_counts(const void *a, const void *b)
+{
+   const struct gn_count *x = a, *y = b;
+   if (x->freq != y->freq)
+      return x->freq < y->freq ? 1 : -1;
+   return compare_keys(a, b);
+}
+
+static const struct gn_count *sort(struct gn_counter *c, size_t *nr,
+                                   int (*cmp)(const void *, const void *))
+{
+   gn_vec_clear(c->sorted);
+   gn_vec_grow(c->sorted, gn_vec_len(c->pairs));
+   for (size_t i = 0; i < gn_vec_len(c->pairs); i++) {
+      const struct pair *p = &c->pairs[i];
+      const char *str = &c->arena[p->str];
+      c->sorted[i] = (struct gn_count){
+         .acronym = str,
+         .acronym_len = p->acronym_len,
+         .expansion = &str[p->acronym_len + 1],
+         .expansion_len = p->expansion_len,
+         .freq = p->freq,
+         .docs = p->docs,
+         .first_doc = p->first_doc,
+         .last_doc = p->last_doc,
+      };
+   }
+   gn_vec_len(c->sorted) = gn_vec_len(c->pairs);
+   qsort(c->sorted, gn_vec_len(c->sorted), sizeof *c->sorted, cmp);
+   *nr = gn_vec_len(c->sorted);
+   return c->sorted;
+}
+
+const struct gn_count *gn_counter_sort(struct gn_counter *c, size_t *nr)
+{
+   return sort(c, nr, compare_counts);
+}
+
+const struct gn_count *gn_counter_list(struct gn_counter *c, size_t *nr)
+{
+   return sort(c, nr, compare_keys);
+}
+
+size_t gn_counter_memory(const struct gn_counter *c)
+{
+   return sizeof *c
+        + gn_vec_capacity(c->pairs) * sizeof *c->pairs
+        + gn_vec_capacity(c->arena)
+        + gn_vec_capacity(c->sorted) * sizeof *c->sorted
+        + (c->mask + 1) * sizeof *c->slots;
+}
+
+/* Memory is released, rather than kept for reuse, so that a counter that is
+ * cleared for exceeding its budget is back under it.
+ */
+void gn_counter_clear(struct gn_counter *c)
+{
+   gn_vec_free(c->pairs);
+   gn_vec_free(c->arena);
+   gn_vec_free(c->sorted);
+   free(c->slots);
+   c->pairs = GN_VEC_INIT;
+   c->arena = GN_VEC_INIT;
+   c->sorted = GN_VEC_INIT;
+   c->slots = gn_malloc(MIN_SLOTS * sizeof *c->slots);
+   c->mask = MIN_SLOTS - 1;
+   memset(c->slots, 0, MIN_SLOTS * sizeof *c->slots);
+}
+
+/* A definition tracked by a sketch. */
+struct tracked {
+   char *str;                 /* acronym '\0' expansion '\0', or NULL. */
+   size_t size;               /* Allocated size of str. */
+   size_t acronym_len, expansion_len;
+   uint64_t hash;
+   size_t count, error;
+   size_t heap_pos;
+};
+
+struct gn_topk {
+   size_t k;
+   struct tracked *tracked;   /* k entries, nr of which are used. */
+   size_t nr;
+
+   /* Min-heap of tracked definitions, by count. */
+   size_t *heap;
+
+   /* Table of tracked definitions, as for counters, with twice as many slots
+    * as definitions, rounded up to a power of two.
+    */
+   size_t *slots;
+   size_t mask;
+
+   struct gn_count *sorted;
+};
+
+struct gn_topk *gn_topk_alloc(size_t k)
+{
+   if (!k)
+      k = 1;
+   size_t size = MIN_SLOTS;
+   while (size < 2 * k) {
+      if (size > SIZE_MAX / 2 / sizeof(size_t))
+         gn_fatal("integer overflow");
+      size *= 2;
+   }
+   if (k > SIZE_MAX / sizeof(struct tracked))
+      gn_fatal("integer overflow");
+
+   struct gn_topk *t = gn_malloc(sizeof *t);
+   *t = (struct gn_topk){
+      .k = k,
+      .tracked = gn_malloc(k * sizeof *t->tracked),
+      .heap = gn_malloc(k * sizeof *t->heap),
+      .slots = gn_malloc(size * sizeof *t->slots),
+      .mask = size - 1,
+      .sorted = GN_VEC_INIT,
+   };
+   memset(t->tracked, 0, k * sizeof *t->tracked);
+   memset(t->slots, 0, size * sizeof *t->slots);
+   return t;
+}
+
+void gn_topk_dealloc(struct gn_topk *t)
+{
+   for (size_t i = 0; i < t->k; i++)
+      free(t->tracked[i].str);
+   free(t->tracked);
+   free(t->heap);
+   free(t->slots);
+   gn_vec_free(t->sorted);
+   free(t);
+}
+
+/* Returns the slot of a definition, or the free slot where it would go. */
+static size_t topk_slot(const struct gn_topk *t, uint64_t h,
+                        const char *acr, size_t acr_len,
+                        const char *exp, size_t exp_len)
+{
+   size_t pos = h & t->mask;
+   size_t idx;
+   while ((idx = t->slots[pos])) {
+      const struct tracked *e = &t->tracked[idx - 1];
+      if (e->hash == h && e->acronym_len == acr_len && e->expansion_len == exp_len
+       && !memcmp(e->str, acr, acr_len) && !memcmp(&e->str[acr_len + 1], exp, exp_len))
+         break;
+      pos = (pos + 1) & t->mask;
+   }
+   return pos;
+}
+
+/* Frees a slot. Following slots are moved back if needed, so that lookups
+ * don't stop early.
+ */
+static void topk_unlink(struct gn_topk *t, size_t pos)
+{
+   size_t i = pos, j = pos;
+   for (;;) {
+      j = (j + 1) & t->mask;
+      if (!t->slots[j])
+         break;
+      size_t home = t->tracked[t->slots[j] - 1].hash & t->mask;
+      /* The entry can move to i if its home slot is not between i and j. */
+      if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+         t->slots[i] = t->slots[j];
+         i = j;
+      }
+   }
+   t->slots[i] = 0;
+}
+
+static bool heap_less(const struct gn_topk *t, size_t a, size_t b)
+{
+   return t->tracked[t->heap[a]].count < t->tracked[t->heap[b]].count;
+}
+
+static void heap_swap(struct gn_topk *t, size_t a, size_t b)
+{
+   size_t tmp = t->heap[a];
+   t->heap[a] = t->heap[b];
+   t->heap[b] = tmp;
+   t->tracked[t->heap[a]].heap_pos = a;
+   t->tracked[t->heap[b]].heap_pos = b;
+}
+
+static void heap_up(struct gn_topk *t, size_t i)
+{
+   while (i && heap_less(t, i, (i - 1) / 2)) {
+      heap_swap(t, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+   }
+}
+
+static void heap_down(struct gn_topk *t, size_t i)
+{
+   for (;;) {
+      size_t min = i, l = 2 * i + 1, r = l + 1;
+      if (l < t->nr && heap_less(t, l, min))
+         min = l;
+      if (r < t->nr && heap_less(t, r, min))
+         min = r;
+      if (min == i)
+         return;
+      heap_swap(t, i, min);
+      i = min;
+   }
+}
+
+static void topk_add(struct gn_topk *t, const char *acr, size_t acr_len,
+                     const char *exp, size_t exp_len, size_t count,
+                     size_t error)
+{
+   uint64_t h = hash_pair(acr, acr_len, exp, exp_len);
+   size_t pos = topk_slot(t, h, acr, acr_len, exp, exp_len);
+   struct tracked *e;
+   if (t->slots[pos]) {
+      e = &t->tracked[t->slots[pos] - 1];
+      e->count += count;
+      e->error += error;
+      heap_down(t, e->heap_pos);
+      return;
+   }
+
+   if (t->nr < t->k) {
+      e = &t->tracked[t->nr];
+      e->heap_pos = t->nr;
+      t->heap[t->nr++] = e - t->tracked;
+      e->count = e->error = 0;
+   } else {
+      /* Replace the definition with the lowest count. */
+      e = &t->tracked[t->heap[0]];
+      topk_unlink(t, topk_slot(t, e->hash, e->str, e->acronym_len,
+                               &e->str[e->acronym_len + 1], e->expansion_len));
+      pos = topk_slot(t, h, acr, acr_len, exp, exp_len);
+      e->error = e->count;
+   }
+
+   size_t size = acr_len + exp_len + 2;
+   if (e->size < size) {
+      e->str = gn_realloc(e->str, size);
+      e->size = size;
+   }
+   memcpy(e->str, acr, acr_len);
+   e->str[acr_len] = '\0';
+   memcpy(&e->str[acr_len + 1], exp, exp_len);
+   e->str[acr_len + 1 + exp_len] = '\0';
+   e->acronym_len = acr_len;
+   e->expansion_len = exp_len;
+   e->hash = h;
+   e->count += count;
+   e->error += error;
+   t->slots[pos] = e - t->tracked + 1;
+   heap_up(t, e->heap_pos);
+   heap_down(t, e->heap_pos);
+}
+
+void gn_topk_add(struct gn_topk *t, const struct gn_acronym *def)
+{
+   topk_add(t, def->acronym, def->acronym_len, def->expansion,
+            def->expansion_len, 1, 0);
+}
+
+/* Count of the definitions that are not tracked: at most the lowest count,
+ * once the sketch is full, and zero before.
+ */
+static size_t topk_floor(const struct gn_topk *t)
+{
+   return t->nr < t->k ? 0 : t->tracked[t->heap[0]].count;
+}
+
+/* Combined counts of a definition tracked by one of two sketches. */
+static void topk_combine(const struct gn_topk *other, const struct tracked *e,
+                         size_t *count, size_t *error)
+{
+   const char *exp = &e->str[e->acronym_len + 1];
+   size_t pos = topk_slot(other, e->hash, e->str, e->acronym_len, exp,
+                          e->expansion_len);
+   if (other->slots[pos]) {
+      const struct tracked *o = &other->tracked[other->slots[pos] - 1];
+      *count = e->count + o->count;
+      *error = e->error + o->error;
+   } else {
+      *count = e->count + topk_floor(other);
+      *error = e->error + topk_floor(other);
+   }
+}
+
+struct candidate {
+   const struct tracked *e;
+   size_t count, error;
+};
+
+static int compare_candidates(const void *a, const void *b)
+{
+   const struct candidate *x = a, *y = b;
+   if (x->count != y->count)
+      return x->count < y->count ? 1 : -1;
+   return 0;
+}
+
+void gn_topk_merge(struct gn_topk *dst, const struct gn_topk *src)
+{
+   assert(dst != src);
+   struct candidate *cands = gn_malloc((dst->nr + src->nr + 1) * sizeof *cands);
+   size_t nr = 0;
+   for (size_t i = 0; i < dst->nr; i++) {
+      struct candidate *c = &cands[nr++];
+      c->e = &dst->tracked[i];
+      topk_combine(src, c->e, &c->count, &c->error);
+   }
+   for (size_t i = 0; i < src->nr; i++) {
+      const struct tracked *e = &src->tracked[i];
+      size_t pos = topk_slot(dst, e->hash, e->str, e->acronym_len,
+                             &e->str[e->acronym_len + 1], e->expansion_len);
+      if (dst->slots[pos])
+         continue;
+      struct candidate *c = &cands[nr++];
+      c->e = e;
+      topk_combine(dst, e, &c->count, &c->error);
+   }
+   qsort(cands, nr, sizeof *cands, compare_candidates);
+   if (nr > dst->k)
+      nr = dst->k;
+
+   /* Fill a new sketch, since candidates point into the old one. */
+   struct gn_topk *t = gn_topk_alloc(dst->k);
+   for (size_t i = 0; i < nr; i++) {
+      const struct tracked *e = cands[i].e;
+      topk_add(t, e->str, e->acronym_len, &e->str[e->acronym_len + 1],
+               e->expansion_len, cands[i].count, cands[i].error);
+   }
+   free(cands);
+
+   struct gn_topk tmp = *dst;
+   *dst = *t;
+   *t = tmp;
+   gn_topk_dealloc(t);
+}
+
+const struct gn_count *gn_topk_sort(struct gn_topk *t, size_t *nr)
+{
+   gn_vec_clear(t->sorted);
+   gn_vec_grow(t->sorted, t->nr);
+   for (size_t i = 0; i < t->nr; i++) {
+      const struct tracked *e = &t->tracked[i];
+      t->sorted[i] = (struct gn_count){
+         .acronym = e->str,
+         .acronym_len = e->acronym_len,
+         .expansion = &e->str[e->acronym_len + 1],
+         .expansion_len = e->expansion_len,
+         .freq = e->count,
+         .error = e->error,
+      };
+   }
+   gn_vec_len(t->sorted) = t->nr;
+   qsort(t->sorted, t->nr, sizeof *t->sorted, compare_counts);
+   *nr = t->nr;
+   return t->sorted;
+}
@@ -0,0 +1,246 @@
+#include <string.h>
+#include "lib/utf8proc.h"
+#include "lib/mascara.h"
+#include "api.h"
+#include "dict.h"
+#include "utf8.h"
+#include "mem.h"
+#include "imp.h"
+
+struct gn_dict {
+   const struct gn_dict_acronym *acronyms;
+   const struct gn_dict_expansion *expansions;
+   const uint32_t *slots;
+   const char *strings;
+   uint64_t nr_acronyms, nr_expansions;
+   uint64_t mask;
+   uint64_t strings_size;
+   size_t max_len;
+};
+
+/* Checks that a table of "nr" items of the given size fits at "pos". */
+static bool dict_fits(size_t size, size_t *pos, uint64_t nr, size_t item_size)
+{
+   if (nr > (size - *pos) / item_size)
+      return false;
+   *pos += nr * item_size;
+   return true;
+}
+
+struct gn_dict *gn_dict_open(const void *data, size_t size)
+{
+   const char *map = data;
+   if (size < GN_DICT_HEADER_SIZE || (uintptr_t)map % 8
+    || memcmp(map, GN_DICT_MAGIC, 8))
+      return NULL;
+
+   uint32_t hdr[4];
+   uint64_t counts[4];
+   memcpy(hdr, &map[8], sizeof hdr);
+   memcpy(counts, &map[24], sizeof counts);
+   if (hdr[0] != GN_DICT_VERSION || hdr[1] != GN_DICT_BYTE_ORDER)
+      return NULL;
+   /* The hash table must have a free slot, for lookups to terminate. */
+   uint64_t nr_slots = counts[0];
+   if (!nr_slots || nr_slots & (nr_slots - 1) || counts[1] >= nr_slots
+    || counts[1] > UINT32_MAX)
+      return NULL;
+
+   struct gn_dict d = {
+      .nr_acronyms = counts[1],
+      .nr_expansions = counts[2],
+      .strings_size = counts[3],
+      .mask = nr_slots - 1,
+      .max_len = hdr[2],
+   };
+   size_t pos = GN_DICT_HEADER_SIZE;
+   d.acronyms = (const struct gn_dict_acronym *)&map[pos];
+   bool ok = dict_fits(size, &pos, d.nr_acronyms, sizeof *d.acronyms);
+   d.expansions = (const struct gn_dict_expansion *)&map[pos];
+   ok = ok && dict_fits(size, &pos, d.nr_expansions, sizeof *d.expansions);
+   d.slots = (const uint32_t *)&map[pos];
+   ok = ok && dict_fits(size, &pos, nr_slots, sizeof *d.slots);
+   d.strings = &map[pos];
+   ok = ok && dict_fits(size, &pos, d.strings_size, 1);
+   if (!ok || (d.strings_size && d.strings[d.strings_size - 1]))
+      return NULL;
+
+   struct gn_dict *ret = gn_malloc(sizeof *ret);
+   *ret = d;
+   return ret;
+}
+
+void gn_dict_close(struct gn_dict *d)
+{
+   free(d);
+}
+
+/* Compares a token with a normalized acronym, ignoring periods in the
+ * token.
+ */
+static bool dict_same(const char *tok, size_t len, const char *acr,
+                      size_t acr_len)
+{
+   size_t j = 0;
+   for (size_t i = 0; i < len; i++) {
+      if (tok[i] == '.')
+         continue;
+      if (j == acr_len || tok[i] != acr[j++])
+         return false;
+   }
+   return j == acr_len;
+}
+
+local const struct gn_dict_acronym *gn_dict_lookup(const struct gn_dict *d,
+                                                   const char *str, size_t len)
+{
+   /* Periods make tokens at most twice as long as the acronym. */
+   if (len > 2 * d->max_len)
+      return NULL;
+
+   size_t pos = gn_dict_hash(str, len) & d->mask;
+   uint32_t idx;
+   while ((idx = d->slots[pos])) {
+      if (idx > d->nr_acronyms)
+         return NULL;
+      const struct gn_dict_acronym *a = &d->acronyms[idx - 1];
+      if (a->str < d->strings_size && a->len < d->strings_size - a->str
+       && dict_same(str, len, &d->strings[a->str], a->len)) {
+         if (a->first > d->nr_expansions || a->count > d->nr_expansions - a->first)
+            return NULL;
+         return a;
+      }
+      pos = (pos + 1) & d->mask;
+   }
+   return NULL;
+}
+
+local const char *gn_dict_key(const struct gn_dict *d,
+                              const struct gn_dict_acronym *a)
+{
+   return &d->strings[a->str];
+}
+
+local const char *gn_dict_get(const struct gn_dict *d,
+                              const struct gn_dict_acronym *a, size_t i,
+                              size_t *len)
+{
+   const struct gn_dict_expansion *e = &d->expansions[a->first + i];
+   if (e->str >= d->strings_size || e->len >= d->strings_size - e->str)
+      return NULL;
+   *len = e->len;
+   return &d->strings[e->str];
+}
+
+const char *gn_dict_expansion(const struct gn_dict *d, const char *acronym,
+                              size_t len, size_t i, size_t *exp_len)
+{
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, acronym, len);
+   if (!a || i >= a->count)
+      return NULL;
+   return gn_dict_get(d, a, i, exp_len);
+}
+
+/* Returns the next character of a string for comparing expansions, or -1 at
+ * its end. Double quotes are skipped and spans of white space read as a single
+ * space, as when normalizing expansions, and letters are lowercased.
+ */
+static int32_t next_char(const char *str, size_t len, size_t *pos)
+{
+   for (;;) {
+      size_t clen;
+      char32_t c = kb_decode_s(&str[*pos], len - *pos, &clen);
+      if (!clen)
+         return -1;
+      *pos += clen;
+      if (gn_is_double_quote(c))
+         continue;
+      if (kb_is_space(c)) {
+         while ((c = kb_decode_s(&str[*pos], len - *pos, &clen)), clen && kb_is_space(c))
+            *pos += clen;
+         return ' ';
+      }
+      return utf8proc_tolower(c);
+   }
+}
+
+/* Matches the start of a text against an expansion. Returns the number of
+ * bytes of the text that match, or 0 if the text doesn't start with the
+ * expansion.
+ */
+static size_t match_prefix(const char *text, size_t len, const char *exp,
+                           size_t exp_len)
+{
+   size_t i = 0, j = 0;
+   int32_t c;
+   while ((c = next_char(exp, exp_len, &j)) >= 0)
+      if (next_char(text, len, &i) != c)
+         return 0;
+   return i;
+}
+
+/* Returns the first letter of a string, lowercased. */
+static int32_t first_char(const char *str, size_t len)
+{
+   size_t pos = 0;
+   return next_char(str, len, &pos);
+}
+
+local bool gn_dict_match_rev(const struct gn_dict *d, const struct mr_token *sent,
+                             size_t abbr, struct span *exp)
+{
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, sent[abbr].str, sent[abbr].len);
+   if (!a)
+      return false;
+
+   /* Try the longest expansions first. */
+   const char *end = sent[exp->end - 1].str + sent[exp->end - 1].len;
+   for (size_t k = exp->start; k < exp->end; k++) {
+      int32_t c = first_char(sent[k].str, sent[k].len);
+      for (size_t i = 0; i < a->count; i++) {
+         size_t len;
+         const char *str = gn_dict_get(d, a, i, &len);
+         if (!str || first_char(str, len) != c)
+            continue;
+         size_t text_len = end - sent[k].str;
+         if (match_prefix(sent[k].str, text_len, str, len) == text_len) {
+            exp->start = k;
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+local bool gn_dict_match_fwd(const struct gn_dict *d, const struct mr_token *sent,
+                             size_t abbr, struct span *exp)
+{
+   const struct gn_dict_acronym *a = gn_dict_lookup(d, sent[abbr].str, sent[abbr].len);
+   if (!a)
+      return false;
+
+   /* Keep the longest expansion that ends at the end of a token. */
+   const char *start = sent[exp->start].str;
+   size_t text_len = sent[exp->end - 1].str + sent[exp->end - 1].len - start;
+   size_t best = 0;
+   for (size_t i = 0; i < a->count; i++) {
+      size_t len;
+      const char *str = gn_dict_get(d, a, i, &len);
+      if (!str)
+         continue;
+      size_t n = match_prefix(start, text_len, str, len);
+      if (!n)
+         continue;
+      for (size_t k = exp->start; k < exp->end; k++) {
+         if (sent[k].str + sent[k].len == start + n) {
+            if (k + 1 > best)
+               best = k + 1;
+            break;
+         }
+      }
+   }
+   if (!best)
+      return false;
+   exp->end = best;
+   return true;
+}
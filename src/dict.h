@@ -0,0 +1,75 @@
+#ifndef GN_DICT_H
+#define GN_DICT_H
+
+/* Layout of compiled dictionaries, shared by the library, which reads them,
+ * and the command-line tool, which writes them.
+ *
+ * A dictionary is a static hash table of normalized acronyms, each with a list
+ * of expansions. It is meant to be mapped in memory: a lookup hashes the
+ * acronym and usually reads a single slot and a single acronym entry. All
+ * integers are in native byte order, which the header records, and all tables
+ * start on an 8 bytes boundary.
+ *
+ * A file starts with a 56 bytes header:
+ *
+ *    char magic[8]              GN_DICT_MAGIC.
+ *    u32 version                GN_DICT_VERSION.
+ *    u32 byte_order             GN_DICT_BYTE_ORDER, as written.
+ *    u32 max_len                Length of the longest acronym, in bytes.
+ *    u32 zero
+ *    u64 slots                  Size of the hash table, a power of two.
+ *    u64 acronyms               Number of entries of the tables below.
+ *    u64 expansions
+ *    u64 strings_size           Size of the string heap, in bytes.
+ *
+ * followed by:
+ *
+ *    struct gn_dict_acronym acronyms[acronyms]
+ *    struct gn_dict_expansion expansions[expansions]
+ *                               The expansions of each acronym follow each
+ *                               other, in the order of the source dictionary.
+ *    u32 slots[slots]           Hash table with linear probing, at most three
+ *                               quarters full. Each slot holds the index of an
+ *                               acronym incremented by one, or 0 if it is free.
+ *                               Acronyms are hashed with gn_dict_hash(), and
+ *                               start at slot (hash & (slots - 1)).
+ *    char strings[strings_size] String heap. Strings are nul-terminated.
+ *    padding                    Up to the next multiple of 8.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GN_DICT_MAGIC "gndict\0\n"
+#define GN_DICT_VERSION 1
+#define GN_DICT_BYTE_ORDER 0x01020304
+#define GN_DICT_HEADER_SIZE 56
+
+struct gn_dict_acronym {
+   uint64_t str;              /* Heap offset of the acronym. */
+   uint32_t len;
+   uint32_t count;            /* Number of expansions. */
+   uint64_t first;            /* Index of the first one. */
+};
+
+struct gn_dict_expansion {
+   uint64_t str;              /* Heap offset of the expansion. */
+   uint64_t len;
+};
+
+/* FNV-1a. Periods are skipped, so that acronyms found in text can be looked up
+ * before they are normalized.
+ */
+static inline uint64_t gn_dict_hash(const char *str, size_t len)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325);
+   for (size_t i = 0; i < len; i++) {
+      if (str[i] == '.')
+         continue;
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+#endif
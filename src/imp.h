@@ -39,6 +39,9 @@ struct gourgandine {
       /* Position of the corresponding real token in the sentence. */
       size_t token_no;
    } *tokens;
+
+   /* Dictionary of known acronyms, or NULL. */
+   const struct gn_dict *dict;
 };
 
 struct gn_acronym;
@@ -48,4 +51,32 @@ local void gn_encode(struct gourgandine *rec, const struct mr_token *sent,
 
 local void gn_extract(struct gourgandine *rec, const struct mr_token *sent,
                       struct gn_acronym *def);
+
+struct gn_dict;
+struct gn_dict_acronym;
+
+/* Finds an acronym in a dictionary. Periods in the given string are ignored.
+ * Returns NULL if it is not there.
+ */
+local const struct gn_dict_acronym *gn_dict_lookup(const struct gn_dict *,
+                                                   const char *str, size_t len);
+
+/* Returns the normalized form of a dictionary acronym. */
+local const char *gn_dict_key(const struct gn_dict *,
+                              const struct gn_dict_acronym *);
+
+/* Returns the expansion number "i" of a dictionary acronym, or NULL if the
+ * dictionary is corrupt.
+ */
+local const char *gn_dict_get(const struct gn_dict *,
+                              const struct gn_dict_acronym *, size_t i,
+                              size_t *len);
+
+/* Same as extract_rev() and extract_fwd(), but matches the text against the
+ * expansions the dictionary gives for the acronym.
+ */
+local bool gn_dict_match_rev(const struct gn_dict *, const struct mr_token *sent,
+                             size_t abbr, struct span *exp);
+local bool gn_dict_match_fwd(const struct gn_dict *, const struct mr_token *sent,
+                             size_t abbr, struct span *exp);
 #endif
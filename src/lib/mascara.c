@@ -74,6 +74,13 @@ int mr_alloc(struct mascara **, const char *lang, enum mr_mode);
 /* Destructor. */
 void mr_dealloc(struct mascara *);
 
+/* Allocates a new tokenizer with the same configuration as an existing one.
+ * Models are shared instead of being loaded again, which makes this much
+ * cheaper than mr_alloc(). The copy can be used from another thread, and can
+ * outlive the original.
+ */
+int mr_clone(struct mascara **, const struct mascara *);
+
 /* Returns the chosen tokenization mode. */
 enum mr_mode mr_mode(const struct mascara *);
 
@@ -129,6 +136,7 @@ struct mr_imp {
    void (*set_text)(struct mascara *, const unsigned char *, size_t, size_t);
    size_t (*next)(struct mascara *, struct mr_token **);
    void (*fini)(struct mascara *);  /* Can be = 0. */
+   int (*clone)(struct mascara **, const struct mascara *);
 };
 
 struct mascara {
@@ -178,6 +186,9 @@ struct tokenizer {
    /* > 0 if there is a pending suffix waiting to be emitted. */
    size_t suffix_len;
 
+   /* Initial state of the machine, which it is in between tokens. */
+   int start;
+
    struct mr_token token;
 };
 
@@ -211,6 +222,12 @@ struct sentencizer {
    const unsigned char *pe;
 
    struct sentence sent;
+
+   /* Tokenizer running over the whole text, and tokens it produced that are
+    * not yet part of a sentence.
+    */
+   struct tokenizer tkr;
+   struct sentence ahead;
 };
 
 local void sentencizer_init(struct sentencizer *,
@@ -244,6 +261,11 @@ local int bayes_load(struct bayes **, const char *path,
 
 local void bayes_dealloc(struct bayes *);
 
+/* Models are reference-counted, so that they can be shared between
+ * tokenizers. This increments the count, bayes_dealloc() decrements it.
+ */
+local struct bayes *bayes_ref(struct bayes *);
+
 enum {
    EOS,
    NOT_EOS,
@@ -22856,6 +22878,11 @@ size_t mr_next(struct mascara *mr, struct mr_token **tk)
    return mr->imp->next(mr, tk);
 }
 
+int mr_clone(struct mascara **mrp, const struct mascara *mr)
+{
+   return mr->imp->clone(mrp, mr);
+}
+
 void mr_dealloc(struct mascara *mr)
 {
    void (*fini)(struct mascara *) = mr->imp->fini;
@@ -22870,6 +22897,7 @@ void mr_dealloc(struct mascara *mr)
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdalign.h>
+#include <stdatomic.h>
 
 struct feature {
    double probs[2];
@@ -22878,6 +22906,7 @@ struct feature {
 };
 
 struct bayes {
+   atomic_uint refs;
    double priors[2];
    double *unknown_probs;
    size_t table_mask;
@@ -23036,6 +23065,7 @@ local int load_fp(struct bayes **mdlp, FILE *fp, const struct bayes_config *cfg)
    struct bayes *mdl = mr_calloc(1, total);
 
    int ret = MR_OK;
+   atomic_init(&mdl->refs, 1);
    mdl->priors[0] = priors[0];
    mdl->priors[1] = priors[1];
    mdl->unknown_probs = (void *)((char *)mdl + unk_off);
@@ -23090,8 +23120,16 @@ local int bayes_load(struct bayes **mdl, const char *path,
    return MR_OK;
 }
 
+local struct bayes *bayes_ref(struct bayes *mdl)
+{
+   atomic_fetch_add_explicit(&mdl->refs, 1, memory_order_relaxed);
+   return mdl;
+}
+
 local void bayes_dealloc(struct bayes *mdl)
 {
+   if (atomic_fetch_sub_explicit(&mdl->refs, 1, memory_order_acq_rel) > 1)
+      return;
    bayes_clear(mdl);
    free(mdl);
 }
@@ -23347,6 +23385,7 @@ local void sentencizer_fini(struct mascara *imp)
 {
    struct sentencizer *tkr = (struct sentencizer *)imp;
    free(tkr->sent.tokens);
+   free(tkr->ahead.tokens);
 }
 
 local void sentencizer_set_text(struct mascara *imp,
@@ -23358,6 +23397,8 @@ local void sentencizer_set_text(struct mascara *imp,
    tkr->offset_incr = offset_incr;
    tkr->str = tkr->p = str;
    tkr->pe = &str[len];
+   tokenizer_set_text(&tkr->tkr.base, str, len, offset_incr);
+   sentence_clear(&tkr->ahead);
 }
 
 local void sentence_add(struct sentence *sent, const struct mr_token *tk)
@@ -26455,14 +26496,14 @@ static const int sentencize_en_main = 1;
 #line 124 "fsm/sentencize.rl"
 
 static const unsigned char *next_sentence(struct sentencizer *tkr,
-                                          size_t *len,
+                                          const unsigned char *p,
+                                          const unsigned char *pe,
+                                          const unsigned char **end,
                                           const unsigned char **period)
 {
    int cs, act, top, stack[1];
    const unsigned char *ts, *te;
-   const unsigned char *p = tkr->p;
-   const unsigned char *pe = tkr->pe;
-   const unsigned char *const eof = pe;
+   const unsigned char *const eof = tkr->pe;
 
    const unsigned char *start = NULL;
 
@@ -26755,6 +26796,13 @@ _again:
 #line 139 "fsm/sentencize.rl"
 
    *period = NULL;
+   *end = NULL;
+
+   /* Stopped before the end of the text, without finding where the sentence
+    * ends.
+    */
+   if (p == pe && pe != eof)
+      return start;
 
    /* Last sentence. Don't know how to trim whitespace on the right. */
    if (start) {
@@ -26764,8 +26812,7 @@ _again:
    return NULL;
 
 found:
-   *len = te - start;
-   tkr->p = te;
+   *end = te;
    return start;
 
    (void)stack;
@@ -26774,26 +26821,27 @@ found:
 }
 #line 89 "sentencize.c"
 
-local size_t sentencizer_next(struct mascara *imp, struct mr_token **tks)
+/* Finds the next sentence by running the sentence FSM up to its end, then
+ * tokenizing it separately. Used when a sentence might be too long.
+ */
+local size_t split_sentence(struct sentencizer *szr, struct mr_token **tks)
 {
-   struct sentencizer *szr = (struct sentencizer *)imp;
    struct sentence *sent = &szr->sent;
-
-   assert(szr->str && "text no set");
    sentence_clear(sent);
 
-   size_t len;
-   const unsigned char *last_period;
-   const unsigned char *str = next_sentence(szr, &len, &last_period);
+   const unsigned char *end, *last_period;
+   const unsigned char *str = next_sentence(szr, szr->p, szr->pe, &end,
+                                            &last_period);
    if (!str) {
       *tks = NULL;
       return 0;
    }
+   szr->p = end;
    size_t offset_incr = szr->offset_incr + str - szr->str;
 
    struct tokenizer tkr;
    tokenizer_init(&tkr, szr->vtab);
-   tokenizer_set_text(&tkr.base, str, len, offset_incr);
+   tokenizer_set_text(&tkr.base, str, end - str, offset_incr);
 
    struct mr_token *tk;
    while (tokenizer_next(&tkr.base, &tk)) {
@@ -26810,10 +26858,247 @@ local size_t sentencizer_next(struct mascara *imp, struct mr_token **tks)
    return sent->len;
 }
 
+/* Sentences are found in a single pass over the text: tokens come from a
+ * tokenizer that runs over the whole text, and the sentence FSM is only run
+ * around the places where a sentence might end. This gives the same result as
+ * split_sentence(), as long as the tokenizer doesn't match text across a
+ * sentence boundary, which is checked. A suffix token is part of the same match
+ * as the token before it.
+ *
+ * Sentences can only end at a period, a question or exclamation mark, a line
+ * break, or a few non-ASCII characters, all of which start with one of the
+ * following bytes.
+ */
+static const bool may_end_sentence[256] = {
+   ['.'] = true, ['!'] = true, ['?'] = true,
+   ['\n'] = true, ['\v'] = true, ['\f'] = true, ['\r'] = true,
+   [0xc2] = true, [0xe2] = true, [0xef] = true,
+};
+
+local bool is_ascii_alnum(unsigned char c)
+{
+   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+       || (c >= '0' && c <= '9');
+}
+
+/* Whether the sentence FSM is in its initial state at a given position,
+ * whatever precedes it. This is the case after a single space or tab that
+ * follows a letter or a digit other than "t", when a letter or a digit comes
+ * next: of the patterns of the FSM, only abbreviations ending with a period,
+ * "et al.", and runs of white space or of closing punctuation extend past white
+ * space. Must be kept in sync with sentencize.rl.
+ */
+local bool at_restart_point(const struct sentencizer *szr,
+                            const unsigned char *s)
+{
+   return s - szr->str >= 2 && is_ascii_alnum(s[0])
+       && (s[-1] == ' ' || s[-1] == '\t')
+       && is_ascii_alnum(s[-2]) && s[-2] != 't';
+}
+
+/* Returns the token number "i" of the text, counting from the first token that
+ * is not yet part of a sentence, or NULL at the end of the text.
+ */
+local struct mr_token *token_ahead(struct sentencizer *szr, size_t i)
+{
+   struct sentence *ahead = &szr->ahead;
+   if (i == ahead->len) {
+      struct mr_token *tk;
+      if (!tokenizer_next(&szr->tkr.base, &tk))
+         return NULL;
+      sentence_add(ahead, tk);
+   }
+   return &ahead->tokens[i];
+}
+
+/* Runs the sentence FSM on a part of the text. Sets the start of the sentence,
+ * if it isn't known yet, and returns whether the sentence ends there.
+ */
+local bool find_end(struct sentencizer *szr, const unsigned char *p,
+                    const unsigned char *pe, const unsigned char **start,
+                    const unsigned char **end, const unsigned char **period)
+{
+   const unsigned char *str = next_sentence(szr, p, pe, end, period);
+   if (!*start)
+      *start = str;
+   return *end != NULL;
+}
+
+/* Falls back to split_sentence(), and restarts the tokenizer after the
+ * sentence it found.
+ */
+local size_t resync(struct sentencizer *szr, struct mr_token **tks)
+{
+   size_t len = split_sentence(szr, tks);
+   tokenizer_set_text(&szr->tkr.base, szr->p, szr->pe - szr->p,
+                      szr->offset_incr + (szr->p - szr->str));
+   sentence_clear(&szr->ahead);
+   return len;
+}
+
+/* Adds the tokens read ahead, from "*done" to "nr", to the current sentence.
+ * Stops if the sentence becomes too long, in which case it returns true.
+ */
+local bool take_tokens(struct sentencizer *szr, size_t *done, size_t nr,
+                       const unsigned char *last_period)
+{
+   struct sentence *sent = &szr->sent;
+   while (*done < nr) {
+      const struct mr_token *tk = &szr->ahead.tokens[(*done)++];
+      if (tk->str == (const char *)last_period ||
+         !sentencizer_reattach_period(sent, tk)) {
+         sentence_add(sent, tk);
+         if (sent->len == MR_MAX_SENTENCE_LEN)
+            return true;
+      }
+   }
+   return false;
+}
+
+/* Drops the tokens read ahead that are now part of the current sentence, and
+ * returns it. The next sentence starts at "end".
+ */
+local size_t finish_sentence(struct sentencizer *szr, size_t done,
+                             const unsigned char *end, struct mr_token **tks)
+{
+   struct sentence *ahead = &szr->ahead;
+   ahead->len -= done;
+   memmove(ahead->tokens, &ahead->tokens[done], ahead->len * sizeof *ahead->tokens);
+   szr->p = end;
+   *tks = szr->sent.tokens;
+   return szr->sent.len;
+}
+
+/* Returns the end of the last token added to the current sentence. */
+local const unsigned char *token_end(const struct sentencizer *szr, size_t done)
+{
+   const struct mr_token *tk = &szr->ahead.tokens[done - 1];
+   return (const unsigned char *)tk->str + tk->len;
+}
+
+/* Number of tokens after which we first look for the end of a sentence
+ * between restart points.
+ */
+#define SENTENCIZER_PROBE 32
+
+local size_t sentencizer_next(struct mascara *imp, struct mr_token **tks)
+{
+   struct sentencizer *szr = (struct sentencizer *)imp;
+   struct sentence *ahead = &szr->ahead;
+
+   assert(szr->str && "text no set");
+   sentence_clear(&szr->sent);
+
+   /* If the next sentence starts with an ASCII character, we know where it
+    * starts. Otherwise, the FSM must be run from the end of the previous one,
+    * to skip white space.
+    */
+   const unsigned char *start = szr->p;
+   while (start < szr->pe && (*start == ' ' || (*start >= '\t' && *start <= '\r')))
+      start++;
+   if (start == szr->pe) {
+      szr->p = start;
+      *tks = NULL;
+      return 0;
+   }
+   if (*start >= 0x80)
+      start = NULL;
+
+   /* Position the FSM would restart from, if a sentence can end past it, and
+    * start of the part of the text it must be run on, if it might end there.
+    * Tokens before the restart position are added to the sentence as we go,
+    * so that long sentences can be cut without looking for their end.
+    */
+   const unsigned char *from = start ? start : szr->p;
+   const unsigned char *window = start ? NULL : from;
+
+   const unsigned char *end = NULL, *last_period = NULL;
+   const unsigned char *prev = from;
+   size_t i, done = 0, probe = SENTENCIZER_PROBE;
+   for (i = 0; ; i++) {
+      if (i - done == MR_MAX_SENTENCE_LEN)
+         return resync(szr, tks);
+      struct mr_token *tk = token_ahead(szr, i);
+      const unsigned char *str = tk ? (const unsigned char *)tk->str : szr->pe;
+
+      /* Anything but spaces between tokens can end a sentence. */
+      for (const unsigned char *s = prev; !window && s < str; s++)
+         if (*s != ' ' && *s != '\t')
+            window = from;
+      if (!tk)
+         break;
+
+      /* Restart points can be far apart, e.g. in tables or lists of numbers.
+       * Look for the end of the sentence at increasing intervals meanwhile,
+       * which at most doubles the work of the FSM. It can only report an end
+       * it would also find with more of the text.
+       */
+      if (window && i - done == probe) {
+         if (find_end(szr, window, str, &start, &end, &last_period))
+            break;
+         probe *= 2;
+      }
+
+      if (str > from && at_restart_point(szr, str)) {
+         if (window && find_end(szr, window, str + 1, &start, &end, &last_period))
+            break;
+         if (!done && ahead->tokens[0].str < (const char *)start)
+            return resync(szr, tks);
+         if (take_tokens(szr, &done, i, NULL))
+            return finish_sentence(szr, done, token_end(szr, done), tks);
+         from = str;
+         window = NULL;
+         probe = SENTENCIZER_PROBE;
+      }
+      for (size_t j = 0; !window && j < tk->len; j++)
+         if (may_end_sentence[(unsigned char)tk->str[j]])
+            window = from;
+      prev = str + tk->len;
+   }
+   if (!end) {
+      if (window)
+         find_end(szr, window, szr->pe, &start, &end, &last_period);
+      else
+         end = szr->pe;
+   }
+   if (!start) {
+      szr->p = szr->pe;
+      *tks = NULL;
+      return 0;
+   }
+
+   /* Remaining tokens of the sentence. */
+   size_t len = done;
+   while (len < ahead->len && ahead->tokens[len].str < (const char *)end)
+      len++;
+   if (len > done) {
+      const struct mr_token *next = token_ahead(szr, len);
+      const struct mr_token *last = &ahead->tokens[len - 1];
+      if ((!done && ahead->tokens[0].str < (const char *)start)
+       || (const unsigned char *)last->str + last->len > end
+       || (next && next->type == MR_SUFFIX))
+         return resync(szr, tks);
+   }
+
+   if (take_tokens(szr, &done, len, last_period))
+      end = token_end(szr, done);
+   return finish_sentence(szr, done, end, tks);
+}
+
+local int sentencizer_clone(struct mascara **mrp, const struct mascara *imp)
+{
+   const struct sentencizer *src = (const void *)imp;
+   struct sentencizer *tkr = mr_malloc(sizeof *tkr);
+   sentencizer_init(tkr, src->vtab);
+   *mrp = &tkr->base;
+   return MR_OK;
+}
+
 local const struct mr_imp sentencizer_imp = {
    .set_text = sentencizer_set_text,
    .next = sentencizer_next,
    .fini = sentencizer_fini,
+   .clone = sentencizer_clone,
 };
 
 local void sentencizer_init(struct sentencizer *tkr,
@@ -26823,6 +27108,7 @@ local void sentencizer_init(struct sentencizer *tkr,
       .base.imp = &sentencizer_imp,
       .vtab = vtab,
    };
+   tokenizer_init(&tkr->tkr, vtab);
 }
 #line 1 "sentencize2.c"
 #include <string.h>
@@ -29033,10 +29319,13 @@ local size_t sentencizer2_next(struct mascara *imp, struct mr_token **tks)
    return mr_sentencize2_next(szr, tks);
 }
 
+local int sentencizer2_clone(struct mascara **, const struct mascara *);
+
 local const struct mr_imp sentencizer2_imp = {
    .set_text = sentencizer2_set_text,
    .next = sentencizer2_next,
    .fini = sentencizer2_fini,
+   .clone = sentencizer2_clone,
 };
 
 local int sentencizer2_init(struct sentencizer2 *tkr,
@@ -29066,11 +29355,38 @@ local int sentencizer2_init(struct sentencizer2 *tkr,
    tokenizer_init(&tkr->tkr, vtab);
    return MR_OK;
 }
+
+local int sentencizer2_clone(struct mascara **mrp, const struct mascara *imp)
+{
+   const struct sentencizer2 *src = (const void *)imp;
+   struct sentencizer2 *tkr = mr_malloc(sizeof *tkr);
+
+   *tkr = (struct sentencizer2){
+      .base.imp = &sentencizer2_imp,
+      .bayes = bayes_ref(src->bayes),
+      .at_eos = src->at_eos,
+      .lhs = KB_INIT,
+      .rhs = KB_INIT,
+   };
+   tokenizer_init(&tkr->tkr, src->tkr.vtab);
+   *mrp = &tkr->base;
+   return MR_OK;
+}
 #line 1 "tokenize.c"
 
+local int tokenizer_clone(struct mascara **mrp, const struct mascara *imp)
+{
+   const struct tokenizer *src = (const void *)imp;
+   struct tokenizer *tkr = mr_malloc(sizeof *tkr);
+   tokenizer_init(tkr, src->vtab);
+   *mrp = &tkr->base;
+   return MR_OK;
+}
+
 const struct mr_imp mr_tokenizer_imp = {
    .set_text = tokenizer_set_text,
    .next = tokenizer_next,
+   .clone = tokenizer_clone,
 };
 
 local void tokenizer_init(struct tokenizer *tkr,
@@ -29093,6 +29409,86 @@ local void tokenizer_set_text(struct mascara *imp,
    tkr->suffix_len = 0;
    tkr->offset_incr = offset_incr;
    tkr->vtab->init(tkr);
+   tkr->start = tkr->cs;
+}
+
+#define ONES UINT64_C(0x0101010101010101)
+#define HIGH_BITS (ONES * 0x80)
+
+local bool is_ascii_letter(unsigned char c)
+{
+   return (unsigned char)((c | 0x20) - 'a') < 26;
+}
+
+local bool is_ascii_space(unsigned char c)
+{
+   return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Returns a pointer to the first byte that is not an ASCII letter in [p, pe),
+ * or pe. Bytes are tested 8 at a time: with the case bit set and the high bit
+ * cleared, a letter lies between 'a' and 'z', which we check by adding
+ * constants to each byte, so that its high bit is set if it exceeds a bound.
+ * No addition can carry over to the next byte.
+ */
+local const unsigned char *skip_letters(const unsigned char *p,
+                                        const unsigned char *pe)
+{
+   while (pe - p >= 8) {
+      uint64_t w;
+      memcpy(&w, p, sizeof w);
+      uint64_t low = (w | ONES * 0x20) & ~HIGH_BITS;
+      uint64_t ge_a = low + ONES * (0x80 - 'a');
+      uint64_t gt_z = low + ONES * (0x80 - 'z' - 1);
+      uint64_t other = (~ge_a | gt_z | w) & HIGH_BITS;
+      if (other) {
+#if !defined(__GNUC__)
+         /* Find the byte with the byte loop below. */
+         break;
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+         return p + __builtin_clzll(other) / 8;
+#else
+         return p + __builtin_ctzll(other) / 8;
+#endif
+      }
+      p += 8;
+   }
+   while (p < pe && is_ascii_letter(*p))
+      p++;
+   return p;
+}
+
+#undef ONES
+#undef HIGH_BITS
+
+/* Most tokens are runs of ASCII letters between ASCII white space. All the
+ * tokenizers emit them as a single MR_LATIN token, whatever the letters, so we
+ * do it directly instead of going through the state machine one byte at a
+ * time. This is only valid between tokens, and only if the run is followed by
+ * white space, as other characters can extend it (URIs, emails, suffixes,
+ * etc.). Preceding white space is skipped here only when a run follows it,
+ * as the machine would otherwise merge it with the next non-ASCII spaces.
+ */
+local bool next_word(struct tokenizer *tkr, struct mr_token *tk)
+{
+   if (tkr->cs != tkr->start)
+      return false;
+
+   const unsigned char *p = tkr->p, *pe = tkr->pe;
+   while (p < pe && is_ascii_space(*p))
+      p++;
+   if (p == pe || !is_ascii_letter(*p))
+      return false;
+   const unsigned char *end = skip_letters(p + 1, pe);
+   if (end == pe || !is_ascii_space(*end))
+      return false;
+
+   tk->type = MR_LATIN;
+   tk->str = (const char *)p;
+   tk->offset = p - tkr->str + tkr->offset_incr;
+   tk->len = end - p;
+   tkr->p = tkr->te = end;
+   return true;
 }
 
 local size_t tokenizer_next(struct mascara *imp, struct mr_token **tkp)
@@ -29112,6 +29508,11 @@ local size_t tokenizer_next(struct mascara *imp, struct mr_token **tkp)
       return 1;
    }
 
+   if (next_word(tkr, tk)) {
+      *tkp = tk;
+      return 1;
+   }
+
    tk->str = NULL;
    tkr->vtab->exec(tkr, tk);
    if (tk->str) {
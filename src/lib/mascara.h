@@ -67,6 +67,13 @@ int mr_alloc(struct mascara **, const char *lang, enum mr_mode);
 /* Destructor. */
 void mr_dealloc(struct mascara *);
 
+/* Allocates a new tokenizer with the same configuration as an existing one.
+ * Models are shared instead of being loaded again, which makes this much
+ * cheaper than mr_alloc(). The copy can be used from another thread, and can
+ * outlive the original.
+ */
+int mr_clone(struct mascara **, const struct mascara *);
+
 /* Returns the chosen tokenization mode. */
 enum mr_mode mr_mode(const struct mascara *);
 
@@ -268,6 +268,7 @@ static int find_acronym(struct gourgandine *rec, const struct mr_token *sent,
    rtrim_sym(sent, exp);
    ltrim_sym(sent, abbr);
    rtrim_sym(sent, abbr);
+   size_t bound;
 
    /* Nothing to do if we end up with the empty string after truncation. */
    if (exp->start == exp->end || abbr->start == abbr->end)
@@ -307,10 +308,15 @@ static int find_acronym(struct gourgandine *rec, const struct mr_token *sent,
       exp->start = exp->end - MAX_EXPANSION_LEN;
    if (!pre_check(&sent[abbr->start]))
       goto reverse;
-   if (!extract_rev(rec, sent, abbr->start, exp))
-      goto reverse;
-   if (!post_check(sent, abbr->start, exp))
-      goto reverse;
+   bound = exp->start;
+   if (!extract_rev(rec, sent, abbr->start, exp)
+    || !post_check(sent, abbr->start, exp)) {
+      /* Fall back to the expansions known for the acronym, if any. */
+      exp->start = bound;
+      if (!rec->dict || !gn_dict_match_rev(rec->dict, sent, abbr->start, exp)
+       || !post_check(sent, abbr->start, exp))
+         goto reverse;
+   }
 
    acr->acronym_start = abbr->start;
    acr->acronym_end = abbr->end;
@@ -327,10 +333,14 @@ reverse:
       abbr->start = abbr->end - MAX_EXPANSION_LEN;
    if (!pre_check(&sent[exp->start]))
       return 0;
-   if (!extract_fwd(rec, sent, exp->start, abbr))
-      return 0;
-   if (!post_check(sent, exp->start, abbr))
-      return 0;
+   bound = abbr->end;
+   if (!extract_fwd(rec, sent, exp->start, abbr)
+    || !post_check(sent, exp->start, abbr)) {
+      abbr->end = bound;
+      if (!rec->dict || !gn_dict_match_fwd(rec->dict, sent, exp->start, abbr)
+       || !post_check(sent, exp->start, abbr))
+         return 0;
+   }
 
    acr->acronym_start = exp->start;
    acr->acronym_end = exp->end;
@@ -430,6 +440,11 @@ struct gourgandine *gn_alloc(void)
    return gn;
 }
 
+void gn_set_dict(struct gourgandine *gn, const struct gn_dict *dict)
+{
+   gn->dict = dict;
+}
+
 void gn_dealloc(struct gourgandine *gn)
 {
    gn_vec_free(gn->buf);
@@ -0,0 +1,262 @@
+#include <string.h>
+#include "lib/mascara.h"
+#include "api.h"
+#include "dict.h"
+#include "vec.h"
+#include "mem.h"
+#include "imp.h"
+
+/* A defined acronym. Strings are stored in the arena, as: acronym '\0'
+ * expansion '\0'.
+ */
+struct entry {
+   uint64_t hash;
+   size_t str;
+   size_t acronym_len, expansion_len;
+
+   /* Number of the sentence the acronym is defined in, and position of the
+    * first token after the definition in this sentence. Uses are only
+    * reported past that point.
+    */
+   size_t sent_no;
+   size_t after;
+};
+
+struct gn_glossary {
+   struct entry *entries;
+   char *arena;
+
+   /* Open-addressing table with linear probing, as for counters. */
+   size_t *slots;
+   size_t mask;
+
+   size_t max_len;            /* Length of the longest acronym. */
+   size_t sent_no;            /* Number of the current sentence. */
+
+   /* Positions of the acronyms defined in the current sentence, which are not
+    * uses, even when the acronym is defined again.
+    */
+   size_t *defined;
+
+   const struct gn_dict *dict;   /* Known acronyms, or NULL. */
+};
+
+#define GLOSSARY_MIN_SLOTS 64
+
+/* FNV-1a, ignoring periods, which are dropped when normalizing acronyms.
+ * Stores the length of the normalized string in "norm_len", or a length larger
+ * than "max_len" if it is too long.
+ */
+static uint64_t hash_acronym(const char *str, size_t len, size_t max_len,
+                             size_t *norm_len)
+{
+   uint64_t h = UINT64_C(0xcbf29ce484222325);
+   size_t n = 0;
+   for (size_t i = 0; i < len; i++) {
+      if (str[i] == '.')
+         continue;
+      if (++n > max_len)
+         break;
+      h ^= (unsigned char)str[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   *norm_len = n;
+   return h;
+}
+
+/* Compares a token with a normalized acronym. */
+static bool same_acronym(const char *tok, size_t len, const char *acr)
+{
+   for (size_t i = 0; i < len; i++) {
+      if (tok[i] == '.')
+         continue;
+      if (tok[i] != *acr++)
+         return false;
+   }
+   return true;
+}
+
+struct gn_glossary *gn_glossary_alloc(void)
+{
+   struct gn_glossary *g = gn_malloc(sizeof *g);
+   *g = (struct gn_glossary){
+      .entries = GN_VEC_INIT,
+      .arena = GN_VEC_INIT,
+      .slots = gn_malloc(GLOSSARY_MIN_SLOTS * sizeof *g->slots),
+      .mask = GLOSSARY_MIN_SLOTS - 1,
+      .defined = GN_VEC_INIT,
+   };
+   memset(g->slots, 0, GLOSSARY_MIN_SLOTS * sizeof *g->slots);
+   return g;
+}
+
+void gn_glossary_dealloc(struct gn_glossary *g)
+{
+   gn_vec_free(g->entries);
+   gn_vec_free(g->arena);
+   gn_vec_free(g->defined);
+   free(g->slots);
+   free(g);
+}
+
+void gn_glossary_clear(struct gn_glossary *g)
+{
+   gn_vec_clear(g->entries);
+   gn_vec_clear(g->arena);
+   gn_vec_clear(g->defined);
+   memset(g->slots, 0, (g->mask + 1) * sizeof *g->slots);
+   g->max_len = 0;
+   g->sent_no = 0;
+}
+
+static void glossary_rehash(struct gn_glossary *g)
+{
+   size_t size = (g->mask + 1) * 2;
+   if (size > SIZE_MAX / sizeof *g->slots)
+      gn_fatal("integer overflow");
+   free(g->slots);
+   g->slots = gn_malloc(size * sizeof *g->slots);
+   memset(g->slots, 0, size * sizeof *g->slots);
+   g->mask = size - 1;
+
+   for (size_t i = 0; i < gn_vec_len(g->entries); i++) {
+      size_t pos = g->entries[i].hash & g->mask;
+      while (g->slots[pos])
+         pos = (pos + 1) & g->mask;
+      g->slots[pos] = i + 1;
+   }
+}
+
+void gn_glossary_add(struct gn_glossary *g, const struct gn_acronym *def)
+{
+   gn_vec_push(g->defined, def->acronym_start);
+
+   size_t len;
+   uint64_t h = hash_acronym(def->acronym, def->acronym_len, SIZE_MAX, &len);
+   size_t pos = h & g->mask;
+   size_t idx;
+   while ((idx = g->slots[pos])) {
+      const struct entry *e = &g->entries[idx - 1];
+      if (e->hash == h && e->acronym_len == len
+       && !memcmp(&g->arena[e->str], def->acronym, len))
+         return;
+      pos = (pos + 1) & g->mask;
+   }
+
+   size_t after = def->acronym_end;
+   if (def->expansion_end > after)
+      after = def->expansion_end;
+   struct entry e = {
+      .hash = h,
+      .str = gn_vec_len(g->arena),
+      .acronym_len = len,
+      .expansion_len = def->expansion_len,
+      .sent_no = g->sent_no,
+      .after = after,
+   };
+   gn_vec_grow(g->arena, len + def->expansion_len + 2);
+   char *str = &g->arena[e.str];
+   memcpy(str, def->acronym, len);
+   str[len] = '\0';
+   memcpy(&str[len + 1], def->expansion, def->expansion_len);
+   str[len + 1 + def->expansion_len] = '\0';
+   gn_vec_len(g->arena) += len + def->expansion_len + 2;
+
+   gn_vec_push(g->entries, e);
+   g->slots[pos] = gn_vec_len(g->entries);
+   if (len > g->max_len)
+      g->max_len = len;
+   if (gn_vec_len(g->entries) > (g->mask + 1) / 2)
+      glossary_rehash(g);
+}
+
+void gn_glossary_set_dict(struct gn_glossary *g, const struct gn_dict *dict)
+{
+   g->dict = dict;
+}
+
+/* Finds the entry of the acronym a token is a use of. Returns 0 if it is not
+ * defined, 1 if it is, or -1 if it is defined later in the sentence.
+ */
+static int find_entry(const struct gn_glossary *g, const struct mr_token *tk,
+                      size_t tok_no, const struct entry **ret)
+{
+   size_t len;
+   uint64_t h = hash_acronym(tk->str, tk->len, g->max_len, &len);
+   if (len > g->max_len)
+      return 0;
+
+   size_t pos = h & g->mask;
+   size_t idx;
+   while ((idx = g->slots[pos])) {
+      const struct entry *e = &g->entries[idx - 1];
+      if (e->hash == h && e->acronym_len == len
+       && same_acronym(tk->str, tk->len, &g->arena[e->str])) {
+         if (e->sent_no == g->sent_no && tok_no < e->after)
+            return -1;
+         *ret = e;
+         return 1;
+      }
+      pos = (pos + 1) & g->mask;
+   }
+   return 0;
+}
+
+/* Fills "use" if a token is a use of a defined or known acronym. */
+static bool find_use(const struct gn_glossary *g, const struct mr_token *tk,
+                     size_t tok_no, struct gn_use *use)
+{
+   /* Acronyms start with an alphanumeric character, which excludes most
+    * punctuation cheaply.
+    */
+   if (tk->type == MR_SYM)
+      return false;
+   for (size_t i = 0; i < gn_vec_len(g->defined); i++)
+      if (g->defined[i] == tok_no)
+         return false;
+
+   const struct entry *e;
+   switch (find_entry(g, tk, tok_no, &e)) {
+   case 1: {
+      const char *str = &g->arena[e->str];
+      use->acronym = str;
+      use->acronym_len = e->acronym_len;
+      use->expansion = &str[e->acronym_len + 1];
+      use->expansion_len = e->expansion_len;
+      use->known = 0;
+      return true;
+   }
+   case -1:
+      return false;
+   }
+   if (!g->dict)
+      return false;
+
+   const struct gn_dict_acronym *a = gn_dict_lookup(g->dict, tk->str, tk->len);
+   if (!a || !a->count)
+      return false;
+   use->expansion = gn_dict_get(g->dict, a, 0, &use->expansion_len);
+   if (!use->expansion)
+      return false;
+   use->acronym = gn_dict_key(g->dict, a);
+   use->acronym_len = a->len;
+   use->known = 1;
+   return true;
+}
+
+int gn_glossary_search(struct gn_glossary *g, const struct mr_token *sent,
+                       size_t len, struct gn_use *use)
+{
+   if (gn_vec_len(g->entries) || g->dict) {
+      for (size_t i = use->end; i < len; i++) {
+         if (find_use(g, &sent[i], i, use)) {
+            use->start = i;
+            use->end = i + 1;
+            return 1;
+         }
+      }
+   }
+   g->sent_no++;
+   gn_vec_clear(g->defined);
+   return 0;
+}
@@ -18,7 +18,8 @@ void *(gn_vec_grow)(size_t *vec, size_t nr, size_t elt_size)
       if (need > (SIZE_MAX - sizeof gn_vec_void) / elt_size)
          gn_fatal("integer overflow");
       vec = gn_malloc(sizeof gn_vec_void + need * elt_size);
-      vec[0] = vec[1] = 0;
+      vec[0] = 0;
+      vec[1] = need;
       return vec + 2;
    }
 
@@ -10,6 +10,7 @@ extern size_t gn_vec_void[2];
 #define gn_vec_header(vec) ((size_t *)((char *)(vec) - sizeof gn_vec_void))
 
 #define gn_vec_len(vec)  gn_vec_header(vec)[0]
+#define gn_vec_capacity(vec) gn_vec_header(vec)[1]
 #define gn_vec_free(vec) gn_vec_free(gn_vec_header(vec))
 
 #define gn_vec_grow(vec, nr) do {                                              \
@@ -1,9 +1,19 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <lua.h>
 #include <lauxlib.h>
 #include "../gourgandine.h"
 #include "../src/lib/mascara.h"
 
 #define GN_MT "gourgandine"
+#define GN_DICT_MT "gourgandine.dict"
+
+/* A compiled dictionary, and a copy of its data, since it must be aligned. */
+struct lua_dict {
+   struct gn_dict *dict;
+   void *data;
+};
 
 static int gn_lua_new(lua_State *lua)
 {
@@ -21,12 +31,67 @@ static int gn_lua_fini(lua_State *lua)
    return 0;
 }
 
+/* Opens a compiled dictionary held in a string. Returns nil if it is not a
+ * compiled dictionary.
+ */
+static int gn_lua_dict(lua_State *lua)
+{
+   size_t len;
+   const char *str = luaL_checklstring(lua, 1, &len);
+   void *data = malloc(len ? len : 1);
+   if (!data)
+      return luaL_error(lua, "out of memory");
+   memcpy(data, str, len);
+   struct gn_dict *dict = gn_dict_open(data, len);
+   if (!dict) {
+      free(data);
+      lua_pushnil(lua);
+      return 1;
+   }
+   struct lua_dict *d = lua_newuserdata(lua, sizeof *d);
+   *d = (struct lua_dict){dict, data};
+   luaL_getmetatable(lua, GN_DICT_MT);
+   lua_setmetatable(lua, -2);
+   return 1;
+}
+
+static int gn_lua_dict_fini(lua_State *lua)
+{
+   struct lua_dict *d = luaL_checkudata(lua, 1, GN_DICT_MT);
+   gn_dict_close(d->dict);
+   free(d->data);
+   return 0;
+}
+
+/* Returns the list of expansions of an acronym, in dictionary order. */
+static int gn_lua_dict_expansions(lua_State *lua)
+{
+   struct lua_dict *d = luaL_checkudata(lua, 1, GN_DICT_MT);
+   size_t len;
+   const char *acronym = luaL_checklstring(lua, 2, &len);
+
+   lua_newtable(lua);
+   const char *exp;
+   size_t i, exp_len;
+   for (i = 0; (exp = gn_dict_expansion(d->dict, acronym, len, i, &exp_len)); i++) {
+      lua_pushlstring(lua, exp, exp_len);
+      lua_rawseti(lua, -2, i + 1);
+   }
+   return 1;
+}
+
+/* Returns the definitions found in the first sentence of a text, consulting a
+ * dictionary if one is given.
+ */
 static int gn_lua_extract(lua_State *lua)
 {
    struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
    size_t len;
    const char *str = luaL_checklstring(lua, 2, &len);
    const char *lang = luaL_optstring(lua, 3, "en fsm");
+   const struct lua_dict *d = NULL;
+   if (!lua_isnoneornil(lua, 4))
+      d = luaL_checkudata(lua, 4, GN_DICT_MT);
 
    struct mascara *mr;
    int ret = mr_alloc(&mr, lang, MR_SENTENCE);
@@ -38,6 +103,7 @@ static int gn_lua_extract(lua_State *lua)
    size_t sent_len = mr_next(mr, &sent);
 
    lua_newtable(lua);
+   gn_set_dict(*gn, d ? d->dict : NULL);
    if (sent_len) {
       struct gn_acronym def = {0};
       size_t i = 0;
@@ -48,15 +114,243 @@ static int gn_lua_extract(lua_State *lua)
          lua_rawseti(lua, -2, ++i);
       }
    }
+   gn_set_dict(*gn, NULL);
+   mr_dealloc(mr);
+   return 1;
+}
+
+/* Adds the definitions of the list of documents at the given index to a
+ * counter, numbering documents from 1, or to a sketch if counts is NULL.
+ */
+static void add_docs(lua_State *lua, int idx, struct gourgandine *gn,
+                     struct mascara *mr, struct gn_counter *counts,
+                     struct gn_topk *top)
+{
+   size_t nr_docs = lua_rawlen(lua, idx);
+   for (size_t doc = 1; doc <= nr_docs; doc++) {
+      lua_rawgeti(lua, idx, doc);
+      size_t len;
+      const char *str = lua_tolstring(lua, -1, &len);
+      mr_set_text(mr, str, len);
+      struct mr_token *sent;
+      size_t sent_len;
+      while ((sent_len = mr_next(mr, &sent))) {
+         struct gn_acronym def = {0};
+         while (gn_search(gn, sent, sent_len, &def)) {
+            if (counts)
+               gn_counter_add(counts, &def, doc);
+            else
+               gn_topk_add(top, &def);
+         }
+      }
+      lua_pop(lua, 1);
+   }
+}
+
+/* Pushes a list of rows {acronym, expansion, freq, docs}, or {acronym,
+ * expansion, freq, error} for approximate counts.
+ */
+static void push_counts(lua_State *lua, const struct gn_count *c, size_t nr,
+                        bool approx)
+{
+   lua_createtable(lua, nr, 0);
+   for (size_t i = 0; i < nr; i++) {
+      lua_createtable(lua, 4, 0);
+      lua_pushlstring(lua, c[i].acronym, c[i].acronym_len);
+      lua_rawseti(lua, -2, 1);
+      lua_pushlstring(lua, c[i].expansion, c[i].expansion_len);
+      lua_rawseti(lua, -2, 2);
+      lua_pushinteger(lua, c[i].freq);
+      lua_rawseti(lua, -2, 3);
+      lua_pushinteger(lua, approx ? c[i].error : c[i].docs);
+      lua_rawseti(lua, -2, 4);
+      lua_rawseti(lua, -2, i + 1);
+   }
+}
+
+/* Counts the definitions of a list of documents. Returns a list of rows
+ * {acronym, expansion, freq, docs}.
+ */
+static int gn_lua_count(lua_State *lua)
+{
+   struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
+   luaL_checktype(lua, 2, LUA_TTABLE);
+   const char *lang = luaL_optstring(lua, 3, "en fsm");
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, lang, MR_SENTENCE);
+   if (ret)
+      return luaL_error(lua, "cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct gn_counter *counts = gn_counter_alloc();
+   add_docs(lua, 2, *gn, mr, counts, NULL);
+   size_t nr;
+   const struct gn_count *c = gn_counter_sort(counts, &nr);
+   push_counts(lua, c, nr, false);
+   gn_counter_dealloc(counts);
+   mr_dealloc(mr);
+   return 1;
+}
+
+/* Same as count(), but returns the rows in list order, then the memory used by
+ * the counter, the memory it uses once cleared, and the rows of the documents
+ * counted again after that.
+ */
+static int gn_lua_list(lua_State *lua)
+{
+   struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
+   luaL_checktype(lua, 2, LUA_TTABLE);
+   const char *lang = luaL_optstring(lua, 3, "en fsm");
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, lang, MR_SENTENCE);
+   if (ret)
+      return luaL_error(lua, "cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct gn_counter *counts = gn_counter_alloc();
+   add_docs(lua, 2, *gn, mr, counts, NULL);
+   size_t nr;
+   const struct gn_count *c = gn_counter_list(counts, &nr);
+   push_counts(lua, c, nr, false);
+   lua_pushinteger(lua, gn_counter_memory(counts));
+   gn_counter_clear(counts);
+   lua_pushinteger(lua, gn_counter_memory(counts));
+   add_docs(lua, 2, *gn, mr, counts, NULL);
+   c = gn_counter_list(counts, &nr);
+   push_counts(lua, c, nr, false);
+   gn_counter_dealloc(counts);
+   mr_dealloc(mr);
+   return 4;
+}
+
+/* Tracks the most frequent definitions of lists of documents, with a sketch
+ * of size k for each list, merged into the first one. Returns a list of rows
+ * {acronym, expansion, freq, error}.
+ */
+static int gn_lua_top(lua_State *lua)
+{
+   struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
+   size_t k = luaL_checkinteger(lua, 2);
+   int nr_lists = lua_gettop(lua) - 2;
+   for (int i = 0; i < nr_lists; i++)
+      luaL_checktype(lua, 3 + i, LUA_TTABLE);
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, "en fsm", MR_SENTENCE);
+   if (ret)
+      return luaL_error(lua, "cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct gn_topk *top = gn_topk_alloc(k);
+   for (int i = 0; i < nr_lists; i++) {
+      struct gn_topk *t = i ? gn_topk_alloc(k) : top;
+      add_docs(lua, 3 + i, *gn, mr, NULL, t);
+      if (t != top) {
+         gn_topk_merge(top, t);
+         gn_topk_dealloc(t);
+      }
+   }
+   size_t nr;
+   const struct gn_count *c = gn_topk_sort(top, &nr);
+   push_counts(lua, c, nr, true);
+   gn_topk_dealloc(top);
+   mr_dealloc(mr);
+   return 1;
+}
+
+/* Finds the uses of the acronyms defined in a document. Returns a list of rows
+ * {acronym, expansion, sentence number, token offset}, numbered from 1.
+ */
+static int gn_lua_uses(lua_State *lua)
+{
+   struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
+   size_t len;
+   const char *str = luaL_checklstring(lua, 2, &len);
+   const char *lang = luaL_optstring(lua, 3, "en fsm");
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, lang, MR_SENTENCE);
+   if (ret)
+      return luaL_error(lua, "cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct gn_glossary *g = gn_glossary_alloc();
+   mr_set_text(mr, str, len);
+   struct mr_token *sent;
+   size_t sent_len, sent_no = 0, i = 0;
+   lua_newtable(lua);
+   while ((sent_len = mr_next(mr, &sent))) {
+      struct gn_acronym def = {0};
+      while (gn_search(*gn, sent, sent_len, &def))
+         gn_glossary_add(g, &def);
+      struct gn_use use = {0};
+      sent_no++;
+      while (gn_glossary_search(g, sent, sent_len, &use)) {
+         lua_createtable(lua, 4, 0);
+         lua_pushlstring(lua, use.acronym, use.acronym_len);
+         lua_rawseti(lua, -2, 1);
+         lua_pushlstring(lua, use.expansion, use.expansion_len);
+         lua_rawseti(lua, -2, 2);
+         lua_pushinteger(lua, sent_no);
+         lua_rawseti(lua, -2, 3);
+         lua_pushinteger(lua, use.start + 1);
+         lua_rawseti(lua, -2, 4);
+         lua_rawseti(lua, -2, ++i);
+      }
+   }
+   gn_glossary_dealloc(g);
    mr_dealloc(mr);
    return 1;
 }
 
+/* Same as extract(), for all the sentences of a text, through a sentence cache
+ * of the given size. Also returns the number of cache hits and misses.
+ */
+static int gn_lua_cached(lua_State *lua)
+{
+   struct gourgandine **gn = luaL_checkudata(lua, 1, GN_MT);
+   size_t len;
+   const char *str = luaL_checklstring(lua, 2, &len);
+   size_t size = luaL_checkinteger(lua, 3);
+   const char *lang = luaL_optstring(lua, 4, "en fsm");
+
+   struct mascara *mr;
+   int ret = mr_alloc(&mr, lang, MR_SENTENCE);
+   if (ret)
+      return luaL_error(lua, "cannot create tokenizer: %s", mr_strerror(ret));
+
+   struct gn_cache *c = gn_cache_alloc(size);
+   mr_set_text(mr, str, len);
+   struct mr_token *sent;
+   size_t sent_len, i = 0;
+   lua_newtable(lua);
+   while ((sent_len = mr_next(mr, &sent))) {
+      const struct gn_acronym *defs;
+      size_t nr = gn_cache_search(c, *gn, sent, sent_len, &defs);
+      for (size_t j = 0; j < nr; j++) {
+         lua_pushlstring(lua, defs[j].acronym, defs[j].acronym_len);
+         lua_rawseti(lua, -2, ++i);
+         lua_pushlstring(lua, defs[j].expansion, defs[j].expansion_len);
+         lua_rawseti(lua, -2, ++i);
+      }
+   }
+   size_t hits, misses;
+   gn_cache_stats(c, &hits, &misses);
+   lua_pushinteger(lua, hits);
+   lua_pushinteger(lua, misses);
+   gn_cache_dealloc(c);
+   mr_dealloc(mr);
+   return 3;
+}
+
 int luaopen_gourgandine(lua_State *lua)
 {
    const luaL_Reg abbr_rec_methods[] = {
       {"__gc", gn_lua_fini},
       {"extract", gn_lua_extract},
+      {"count", gn_lua_count},
+      {"list", gn_lua_list},
+      {"top", gn_lua_top},
+      {"uses", gn_lua_uses},
+      {"cached", gn_lua_cached},
       {NULL, 0}
    };
    luaL_newmetatable(lua, GN_MT);
@@ -64,8 +358,19 @@ int luaopen_gourgandine(lua_State *lua)
    lua_setfield(lua, -2, "__index");
    luaL_setfuncs(lua, abbr_rec_methods, 0);
 
+   const luaL_Reg dict_methods[] = {
+      {"__gc", gn_lua_dict_fini},
+      {"expansions", gn_lua_dict_expansions},
+      {NULL, 0}
+   };
+   luaL_newmetatable(lua, GN_DICT_MT);
+   lua_pushvalue(lua, -1);
+   lua_setfield(lua, -2, "__index");
+   luaL_setfuncs(lua, dict_methods, 0);
+
    const luaL_Reg abbr_lib[] = {
       {"new", gn_lua_new},
+      {"dict", gn_lua_dict},
       {NULL, NULL},
    };
    luaL_newlib(lua, abbr_lib);
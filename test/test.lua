@@ -319,3 +319,250 @@ check{
       "CTBT", "Comprehensive Nuclear-Test-Ban Treaty",
    },
 }
+
+-------------------------------------------
+-- Rows
+-------------------------------------------
+
+-- Compares the rows returned by a function with the expected ones, which may
+-- be values or nested lists of values.
+local function check_rows(got, expect)
+   local function same(x, y)
+      if type(x) ~= "table" or type(y) ~= "table" then
+         return x == y
+      end
+      if #x ~= #y then
+         return false
+      end
+      for i = 1, #x do
+         if not same(x[i], y[i]) then
+            return false
+         end
+      end
+      return true
+   end
+   if not same(got, expect) then
+      local caller = assert(debug.getinfo(2))
+      print("-- Fail at line " .. caller.currentline)
+      print("-> Output:")
+      print(json.stringify(got))
+      print("-> Expected:")
+      print(json.stringify(expect))
+   end
+end
+
+-------------------------------------------
+-- Counting
+-------------------------------------------
+
+-- Ensure that definitions are counted after normalization, and that documents
+-- are counted once per definition.
+check_rows(gourgandine.new():count{
+   "The World Health Organization (WHO) said so. The W.H.O. (World Health Organization) agreed.",
+   "Ask the World Health Organization (WHO). Or ask your medical doctor (MD).",
+}, {
+   {"WHO", "World Health Organization", 3, 2},
+   {"MD", "medical doctor", 1, 1},
+})
+
+-- Ensure that listed definitions are sorted by acronym, then by expansion, and
+-- that a cleared counter releases its memory and counts from scratch.
+local docs = {
+   "The World Health Organization (WHO) met the World Hockey Organisation (WHO).",
+   "Ask your medical doctor (MD). Ask the World Health Organization (WHO).",
+}
+local expect = {
+   {"MD", "medical doctor", 1, 1},
+   {"WHO", "World Health Organization", 2, 2},
+   {"WHO", "World Hockey Organisation", 1, 1},
+}
+local rows, memory, cleared, again = gourgandine.new():list(docs)
+check_rows({rows, again, cleared < memory}, {expect, expect, true})
+
+-------------------------------------------
+-- Approximate counting
+-------------------------------------------
+
+local un = "The United Nations (UN) met."
+local who = "The World Health Organization (WHO) met."
+local md = "A medical doctor (MD) came."
+
+-- Ensure that counts are exact while definitions fit in the sketch.
+check_rows(gourgandine.new():top(3, {un, who, un, md}), {
+   {"UN", "United Nations", 2, 0},
+   {"MD", "medical doctor", 1, 0},
+   {"WHO", "World Health Organization", 1, 0},
+})
+
+-- Ensure that a new definition replaces the one with the lowest count, and
+-- inherits its count as error, including when the replaced definition comes
+-- back after being removed from the table.
+check_rows(gourgandine.new():top(2, {un, un, un, who, md, who}), {
+   {"UN", "United Nations", 3, 0},
+   {"WHO", "World Health Organization", 3, 2},
+})
+
+-- Ensure that merged sketches add up the counts of the definitions they both
+-- track, that definitions tracked by one of them only get the lowest count of
+-- the other one added as error, and that the k highest are kept.
+check_rows(gourgandine.new():top(2, {un, who, who}, {un, md, un}), {
+   {"UN", "United Nations", 3, 0},
+   {"WHO", "World Health Organization", 3, 1},
+})
+
+-- Ensure that, with many replacements, counts add up to the number of
+-- definitions, that each definition is tracked once, and that true counts lie
+-- within the error bounds.
+local docs, truth = {}, {}
+for i = 1, 1000 do
+   local n = (i * 7919) % (i % 4 == 0 and 30 or 300)
+   local acr = string.char(65 + n % 26, 65 + n // 26)
+   docs[i] = "The " .. acr:sub(1, 1) .. "lpha " .. acr:sub(2) .. "eta (" .. acr .. ") met."
+   truth[acr] = (truth[acr] or 0) + 1
+end
+local rows = gourgandine.new():top(100, docs)
+local total, seen, ok = 0, {}, #rows == 100
+for _, row in ipairs(rows) do
+   local n = truth[row[1]] or 0
+   total = total + row[3]
+   ok = ok and not seen[row[1]] and n <= row[3] and n >= row[3] - row[4]
+   seen[row[1]] = true
+end
+check_rows({total, ok}, {1000, true})
+
+-------------------------------------------
+-- Uses
+-------------------------------------------
+
+-- Uses are reported after the definition only, including in the same
+-- sentence, and are matched after normalization. The first definition of an
+-- acronym is kept, and acronyms that are defined again are not uses.
+check_rows(gourgandine.new():uses(
+   "The WHO met. The World Health Organization (WHO) and the WHO agreed. " ..
+   "Then the W.H.O. (World Hockey Organisation) met the W.H.O. and the who."
+), {
+   {"WHO", "World Health Organization", 2, 10},
+   {"WHO", "World Health Organization", 3, 11},
+})
+
+-------------------------------------------
+-- Sentence cache
+-------------------------------------------
+
+-- Ensure that cached definitions are the same as found ones, that the least
+-- recently used sentence is evicted, and that sentences without brackets
+-- bypass the cache.
+local who = who .. " "
+local md = md .. " "
+local doc = who .. who .. md .. "It rained. " .. who
+local expect = {
+   "WHO", "World Health Organization",
+   "WHO", "World Health Organization",
+   "MD", "medical doctor",
+   "WHO", "World Health Organization",
+}
+check_rows({gourgandine.new():cached(doc, 1)}, {expect, 1, 3})
+check_rows({gourgandine.new():cached(doc, 2)}, {expect, 2, 2})
+
+-------------------------------------------
+-- Dictionary
+-------------------------------------------
+
+-- Compiles a source dictionary with the command-line tool, and returns the
+-- compiled data.
+local function compile_dict(source)
+   local src, out = os.tmpname(), os.tmpname()
+   local fp = assert(io.open(src, "w"))
+   fp:write(source)
+   fp:close()
+   assert(os.execute("../gourgandine dict " .. src .. " " .. out))
+   fp = assert(io.open(out, "rb"))
+   local data = fp:read("a")
+   fp:close()
+   os.remove(src)
+   os.remove(out)
+   return data
+end
+
+-- Ensure that duplicate pairs are removed after normalization, and that the
+-- expansions of an acronym are kept in source order.
+local data = compile_dict(
+   "WHO\tWorld Hockey Organisation\n" ..
+   "MARLANT\tMaritime Forces Atlantic\n" ..
+   "W.H.O.\tWorld  Health \"Organization\"\n" ..
+   "WHO\tWorld Hockey Organisation\textra column\n" ..
+   "WHO\tWorld Health Organization\n")
+local dict = assert(gourgandine.dict(data))
+check_rows({dict:expansions("WHO"), dict:expansions("MARLANT"), dict:expansions("UN")}, {
+   {"World Hockey Organisation", "World Health Organization"},
+   {"Maritime Forces Atlantic"},
+   {},
+})
+
+-- Ensure that a definition that doesn't match by the usual rules is accepted
+-- only through the dictionary.
+local marlant = "The Maritime Forces Atlantic (MARLANT) sailed."
+check_rows({gourgandine.new():extract(marlant), gourgandine.new():extract(marlant, "en fsm", dict)}, {
+   {},
+   {"MARLANT", "Maritime Forces Atlantic"},
+})
+
+-- Ensure that truncated data and data with a bad signature are rejected.
+local rejected = {}
+for _, bad in ipairs{"", data:sub(1, 55), data:sub(1, 56), data:sub(1, #data // 2),
+                     "x" .. data:sub(2)} do
+   table.insert(rejected, gourgandine.dict(bad) == nil)
+end
+check_rows(rejected, {true, true, true, true, true})
+
+-------------------------------------------
+-- Command-line tool
+-------------------------------------------
+
+-- Runs the command-line tool on a text, and returns the lines it writes.
+local function run(options, text)
+   local path, out = os.tmpname(), os.tmpname()
+   local fp = assert(io.open(path, "w"))
+   fp:write(text)
+   fp:close()
+   assert(os.execute("../gourgandine -l 'en fsm' " .. options .. " " .. path .. " > " .. out))
+   local lines = {}
+   for line in io.lines(out) do
+      table.insert(lines, line)
+   end
+   os.remove(path)
+   os.remove(out)
+   return lines
+end
+
+-- Ensure that lazy mode finds the same definitions as the full pipeline when
+-- a sentence goes on after a paragraph break, which the sentencizer allows
+-- after final punctuation followed by a lowercase word, before or after the
+-- paragraph with the bracket, and likewise in pipelined mode.
+for _, text in ipairs{
+   "Call the World Health Abs.\n\norganization (WHO) now.\n",
+   "Call the World Health Abs.\"\n \n\n\norganization (WHO) now.\n",
+   "Call the World Health!\n\norganization (WHO) now.\n",
+   "The WHO (World Health Abs.\n\norganization) met.\n",
+   "The WHO (World Health.\n\n\u{201c}organization) met.\n",
+   "It rained.\n\nThe World Health Organization (WHO) met.\n\nThe end.\n",
+} do
+   local expect = run("", text)
+   check_rows(run("--lazy", text), expect)
+   check_rows(run("--pipeline --lazy", text), expect)
+end
+
+-- Ensure that paragraph mode reattaches periods to abbreviations, and finds the
+-- same definitions as sentence splitting around them.
+for _, case in ipairs{
+   {"We used the Std. Dev. (SD) here. The U.S. Army (USA) came.\n",
+    {"USA\tU.S. Army"}},
+   {"Foo Bar Inc. (FBI) agents came.\n", {"FBI\tFoo Bar Inc."}},
+   {"It was at 5 p.m. The National Guard (NG) came.\n",
+    {"NG\tNational Guard"}},
+   {"See e.g. the Data Base (DB), i.e. a store.\n", {"DB\tData Base"}},
+} do
+   local text, rows = table.unpack(case)
+   check_rows(run("--paragraphs", text), rows)
+   check_rows(run("", text), rows)
+end